@@ -46,9 +46,13 @@
 
 namespace DXBC2GLSL
 {
+	// One instance can translate any number of shaders, the IR storage is reused from one FeedDXBC to the next.
+	// Instances share nothing, use one per thread to translate in parallel.
 	class DXBC2GLSL
 	{
 	public:
+		DXBC2GLSL();
+
 		static uint32_t DefaultRules(GLSLVersion version);
 
 		void FeedDXBC(void const * dxbc_data,
@@ -90,6 +94,7 @@ namespace DXBC2GLSL
 	private:
 		std::shared_ptr<DXBCContainer> dxbc_;
 		std::shared_ptr<ShaderProgram> shader_;
+		GLSLGen converter_;
 		std::string glsl_;
 	};
 }
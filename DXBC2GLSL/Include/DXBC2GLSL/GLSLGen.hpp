@@ -86,7 +86,8 @@ enum GLSLRules : uint32_t
 	GSR_OESStandardDerivatives = 1UL << 21,
 	GSR_EXTFragDepth = 1UL << 22,
 	GSR_EXTTessellationShader = 1UL << 23,
-	GSR_PrecisionOnSampler = 1UL << 24
+	GSR_PrecisionOnSampler = 1UL << 24,
+	GSR_Optimize = 1UL << 25				// Set means running ShaderOptimize on the program before generating GLSL. On by default for GLSL ES.
 };
 
 struct RegisterDesc
@@ -100,8 +101,8 @@ struct RegisterDesc
 struct HSForkPhase
 {
 	uint32_t fork_instance_count;
-	std::vector<std::shared_ptr<ShaderDecl>> dcls;
-	std::vector<std::shared_ptr<ShaderInstruction>> insns;//instructions
+	std::vector<ShaderDecl*> dcls;
+	std::vector<ShaderInstruction*> insns;//instructions
 	
 	HSForkPhase()
 		: fork_instance_count(0)
@@ -112,8 +113,8 @@ struct HSForkPhase
 struct HSJoinPhase
 {
 	uint32_t join_instance_count;
-	std::vector<std::shared_ptr<ShaderDecl>> dcls;
-	std::vector<std::shared_ptr<ShaderInstruction>> insns;//instructions
+	std::vector<ShaderDecl*> dcls;
+	std::vector<ShaderInstruction*> insns;//instructions
 	
 	HSJoinPhase()
 		: join_instance_count(0)
@@ -123,8 +124,8 @@ struct HSJoinPhase
 
 struct HSControlPointPhase
 {
-	std::vector<std::shared_ptr<ShaderDecl>> dcls;
-	std::vector<std::shared_ptr<ShaderInstruction>> insns;//instructions
+	std::vector<ShaderDecl*> dcls;
+	std::vector<ShaderInstruction*> insns;//instructions
 };
 
 class GLSLGen
@@ -34,8 +34,11 @@
 #pragma once
 
 #include <KFL/KFL.hpp>
+#include <KFL/Util.hpp>
+#include <memory>
 #include <vector>
 #include <cstring>
+#include <boost/noncopyable.hpp>
 #include <DXBC2GLSL/DXBC.hpp>
 #include <DXBC2GLSL/Utils.hpp>
 #include <DXBC2GLSL/ShaderDefs.hpp>
@@ -277,7 +280,7 @@ struct ShaderOperand
 	struct
 	{
 		int64_t disp;
-		std::shared_ptr<ShaderOperand> reg;
+		ShaderOperand* reg;
 	} indices[3];
 
 	bool IsIndexSimple(uint32_t i) const
@@ -298,6 +301,7 @@ struct ShaderOperand
 		memset(swizzle, 0, sizeof(swizzle));
 		memset(imm_values, 0, sizeof(imm_values));
 		indices[0].disp = indices[1].disp = indices[2].disp = 0;
+		indices[0].reg = indices[1].reg = indices[2].reg = nullptr;
 	}
 };
 
@@ -312,19 +316,20 @@ struct ShaderInstruction : public TokenizedShaderInstruction
 
 	uint32_t num;
 	uint32_t num_ops;
-	std::shared_ptr<ShaderOperand> ops[SM_MAX_OPS];
+	ShaderOperand* ops[SM_MAX_OPS];
 
 	ShaderInstruction()
 		: resource_target(0), num(0), num_ops(0)
 	{
 		memset(sample_offset, 0, sizeof(sample_offset));
 		memset(resource_return_type, 0, sizeof(resource_return_type));
+		memset(ops, 0, sizeof(ops));
 	}
 };
 
 struct ShaderDecl : public TokenizedShaderInstruction
 {
-	std::shared_ptr<ShaderOperand> op;
+	ShaderOperand* op;
 	union
 	{
 		uint32_t num;
@@ -354,23 +359,71 @@ struct ShaderDecl : public TokenizedShaderInstruction
 	std::vector<uint8_t> data;
 
 	ShaderDecl()
+		: op(nullptr)
 	{
 		memset(&insn, 0, sizeof(insn));
 		memset(&intf, 0, sizeof(intf));
 	}
 };
 
+// Storage for the IR objects of a translation. Objects live in fixed size blocks, so pointers to them stay valid
+// until Clear, which keeps the blocks for the next translation.
+template <typename T>
+class ShaderArena : boost::noncopyable
+{
+public:
+	ShaderArena()
+		: num_objs_(0)
+	{
+	}
+
+	T* Alloc()
+	{
+		size_t const block = num_objs_ / BLOCK_SIZE;
+		if (block == blocks_.size())
+		{
+			blocks_.push_back(KlayGE::MakeUniquePtr<T[]>(BLOCK_SIZE));
+		}
+
+		T* obj = &blocks_[block][num_objs_ % BLOCK_SIZE];
+		*obj = T();
+		++ num_objs_;
+		return obj;
+	}
+
+	void Clear()
+	{
+		num_objs_ = 0;
+	}
+
+	size_t Size() const
+	{
+		return num_objs_;
+	}
+
+private:
+	static size_t constexpr BLOCK_SIZE = 256;
+
+	std::vector<std::unique_ptr<T[]>> blocks_;
+	size_t num_objs_;
+};
+
 struct LabelInfo
 {
 	uint32_t start_num; // the first instruction in label code after label l#
 	uint32_t end_num; // the last insn in label etc. ret
 };
 
-struct ShaderProgram
+struct ShaderProgram : boost::noncopyable
 {
 	TokenizedShaderVersion version;//program version
-	std::vector<std::shared_ptr<ShaderDecl>> dcls;//declarations
-	std::vector<std::shared_ptr<ShaderInstruction>> insns;//instructions
+	std::vector<ShaderDecl*> dcls;//declarations
+	std::vector<ShaderInstruction*> insns;//instructions
+
+	// Own every declaration, instruction and operand above, including the relative index operands
+	ShaderArena<ShaderDecl> dcl_arena;
+	ShaderArena<ShaderInstruction> insn_arena;
+	ShaderArena<ShaderOperand> operand_arena;
 
 	std::vector<DXBCSignatureParamDesc> params_in; //input signature
 	std::vector<DXBCSignatureParamDesc> params_out;//output signature
@@ -392,17 +445,54 @@ struct ShaderProgram
 	uint32_t cs_thread_group_size[3];
 
 	ShaderProgram()
-		: gs_input_primitive(SP_Undefined), max_gs_output_vertex(0),
-			gs_instance_count(0), hs_input_control_point_count(0),
-			hs_output_control_point_count(0), ds_tessellator_domain(SDT_Undefined),
-			ds_tessellator_partitioning(STP_Undefined), ds_tessellator_output_primitive(STOP_Undefined)
+	{
+		this->Clear();
+	}
+
+	// Back to the state of a new program, the arenas and the vectors keep their memory
+	void Clear()
 	{
 		memset(&version, 0, sizeof(version));
+		dcls.clear();
+		insns.clear();
+		dcl_arena.Clear();
+		insn_arena.Clear();
+		operand_arena.Clear();
+
+		params_in.clear();
+		params_out.clear();
+		params_patch.clear();
+		cbuffers.clear();
+		resource_bindings.clear();
+
+		gs_input_primitive = SP_Undefined;
+		gs_output_topology.clear();
+		max_gs_output_vertex = 0;
+		gs_instance_count = 0;
+		hs_input_control_point_count = 0;
+		hs_output_control_point_count = 0;
+		ds_tessellator_domain = SDT_Undefined;
+		ds_tessellator_partitioning = STP_Undefined;
+		ds_tessellator_output_primitive = STOP_Undefined;
 		memset(cs_thread_group_size, 0, sizeof(cs_thread_group_size));
 	}
 };
 
 std::shared_ptr<ShaderProgram> ShaderParse(DXBCContainer const & dxbc);
+// Parses into an existing program, reusing its storage. Returns false on failure.
+bool ShaderParse(DXBCContainer const & dxbc, ShaderProgram& program);
+
+struct ShaderOptimizeStats
+{
+	uint32_t num_insns_before;
+	uint32_t num_insns_after;
+	uint32_t num_temps_before;
+	uint32_t num_temps_after;
+};
+
+// Copy propagation of movs, constant folding of literal operands, dead temp elimination and renaming of the temps
+// left, in place. Hull shaders and relative addressed temps are left as they are.
+ShaderOptimizeStats ShaderOptimize(ShaderProgram& program);
 
 // Return the opcode's input type
 inline ShaderImmType GetOpInType(uint32_t opcode)
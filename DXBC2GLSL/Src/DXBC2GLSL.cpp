@@ -35,6 +35,11 @@
 
 namespace DXBC2GLSL
 {
+	DXBC2GLSL::DXBC2GLSL()
+		: shader_(KlayGE::MakeSharedPtr<ShaderProgram>())
+	{
+	}
+
 	uint32_t DXBC2GLSL::DefaultRules(GLSLVersion version)
 	{
 		return GLSLGen::DefaultRules(version);
@@ -51,18 +56,17 @@ namespace DXBC2GLSL
 			bool has_gs, bool has_ps, ShaderTessellatorPartitioning ds_partitioning, ShaderTessellatorOutputPrimitive ds_output_primitive,
 			GLSLVersion version, uint32_t glsl_rules)
 	{
+		glsl_.clear();
+
 		dxbc_ = DXBCParse(dxbc_data);
 		if (dxbc_)
 		{
-			if (dxbc_->shader_chunk)
+			if (dxbc_->shader_chunk && ShaderParse(*dxbc_, *shader_))
 			{
-				shader_ = ShaderParse(*dxbc_);
-
 				std::stringstream ss;
 
-				GLSLGen converter;
-				converter.FeedDXBC(shader_, has_gs, has_ps, ds_partitioning, ds_output_primitive, version, glsl_rules);
-				converter.ToGLSL(ss);
+				converter_.FeedDXBC(shader_, has_gs, has_ps, ds_partitioning, ds_output_primitive, version, glsl_rules);
+				converter_.ToGLSL(ss);
 
 				glsl_ = ss.str();
 			}
@@ -205,6 +205,7 @@ uint32_t GLSLGen::DefaultRules(GLSLVersion version)
 		if (version >= GSV_100_ES)
 		{
 			rules |= GSR_Precision;
+			rules |= GSR_Optimize;
 		}
 		if (version >= GSV_300_ES)
 		{
@@ -252,6 +253,20 @@ void GLSLGen::FeedDXBC(std::shared_ptr<ShaderProgram> const & program,
 	enter_final_hs_fork_phase_ = false;
 	enter_hs_join_phase_ = false;
 	enter_final_hs_join_phase_ = false;
+
+	// The same GLSLGen can translate many programs, drop what is left from the previous one
+	idx_range_info_.clear();
+	textures_.clear();
+	temp_dcls_.clear();
+	cb_index_mode_.clear();
+	hs_control_point_phase_.clear();
+	hs_fork_phases_.clear();
+	hs_join_phases_.clear();
+	label_to_insn_num_.clear();
+	labels_found_ = false;
+	temp_as_type_.clear();
+	cf_insn_linked_.clear();
+	end_of_program_ = 0;
 	
 	if (!(glsl_rules_ & GSR_UseUBO))
 	{
@@ -259,6 +274,11 @@ void GLSLGen::FeedDXBC(std::shared_ptr<ShaderProgram> const & program,
 		glsl_rules_ &= ~GSR_GlobalUniformsInUBO;
 	}
 
+	if (glsl_rules_ & GSR_Optimize)
+	{
+		ShaderOptimize(*program_);
+	}
+
 	this->LinkCFInsns();
 	this->FindLabels();
 	this->FindEndOfProgram();
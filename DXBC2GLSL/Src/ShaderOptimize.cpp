@@ -0,0 +1,887 @@
+/**
+ * @file ShaderOptimize.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <DXBC2GLSL/Shader.hpp>
+#include <DXBC2GLSL/Utils.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Instructions without side effects. Their first GetNumOutputs operands are the destinations, the rest are sources.
+	bool IsPureOpcode(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case SO_ADD:
+		case SO_AND:
+		case SO_DERIV_RTX:
+		case SO_DERIV_RTY:
+		case SO_DIV:
+		case SO_DP2:
+		case SO_DP3:
+		case SO_DP4:
+		case SO_EQ:
+		case SO_EXP:
+		case SO_FRC:
+		case SO_FTOI:
+		case SO_FTOU:
+		case SO_GE:
+		case SO_IADD:
+		case SO_IEQ:
+		case SO_IGE:
+		case SO_ILT:
+		case SO_IMAD:
+		case SO_IMAX:
+		case SO_IMIN:
+		case SO_IMUL:
+		case SO_INE:
+		case SO_INEG:
+		case SO_ISHL:
+		case SO_ISHR:
+		case SO_ITOF:
+		case SO_LD:
+		case SO_LD_MS:
+		case SO_LOG:
+		case SO_LT:
+		case SO_MAD:
+		case SO_MIN:
+		case SO_MAX:
+		case SO_MOV:
+		case SO_MOVC:
+		case SO_MUL:
+		case SO_NE:
+		case SO_NOT:
+		case SO_OR:
+		case SO_RESINFO:
+		case SO_ROUND_NE:
+		case SO_ROUND_NI:
+		case SO_ROUND_PI:
+		case SO_ROUND_Z:
+		case SO_RSQ:
+		case SO_SAMPLE:
+		case SO_SAMPLE_C:
+		case SO_SAMPLE_C_LZ:
+		case SO_SAMPLE_L:
+		case SO_SAMPLE_D:
+		case SO_SAMPLE_B:
+		case SO_SQRT:
+		case SO_SINCOS:
+		case SO_UDIV:
+		case SO_ULT:
+		case SO_UGE:
+		case SO_UMUL:
+		case SO_UMAD:
+		case SO_UMAX:
+		case SO_UMIN:
+		case SO_USHR:
+		case SO_UTOF:
+		case SO_XOR:
+		case SO_LOD:
+		case SO_GATHER4:
+		case SO_SAMPLE_POS:
+		case SO_SAMPLE_INFO:
+		case SO_BUFINFO:
+		case SO_DERIV_RTX_COARSE:
+		case SO_DERIV_RTX_FINE:
+		case SO_DERIV_RTY_COARSE:
+		case SO_DERIV_RTY_FINE:
+		case SO_GATHER4_C:
+		case SO_GATHER4_PO:
+		case SO_GATHER4_PO_C:
+		case SO_RCP:
+		case SO_F32TOF16:
+		case SO_F16TOF32:
+		case SO_UADDC:
+		case SO_USUBB:
+		case SO_COUNTBITS:
+		case SO_FIRSTBIT_HI:
+		case SO_FIRSTBIT_LO:
+		case SO_FIRSTBIT_SHI:
+		case SO_UBFE:
+		case SO_IBFE:
+		case SO_BFI:
+		case SO_BFREV:
+		case SO_SWAPC:
+		case SO_LD_UAV_TYPED:
+		case SO_LD_RAW:
+		case SO_LD_STRUCTURED:
+		case SO_EVAL_SNAPPED:
+		case SO_EVAL_SAMPLE_INDEX:
+		case SO_EVAL_CENTROID:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	// Write a temp in their first operand, but can't be removed
+	bool IsImmAtomicOpcode(uint32_t opcode)
+	{
+		return (opcode >= SO_IMM_ATOMIC_ALLOC) && (opcode <= SO_IMM_ATOMIC_UMIN);
+	}
+
+	// Copies and pending stores can't be tracked over these
+	bool IsBlockBoundary(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case SO_BREAK:
+		case SO_BREAKC:
+		case SO_CALL:
+		case SO_CALLC:
+		case SO_CASE:
+		case SO_CONTINUE:
+		case SO_CONTINUEC:
+		case SO_DEFAULT:
+		case SO_ELSE:
+		case SO_ENDIF:
+		case SO_ENDLOOP:
+		case SO_ENDSWITCH:
+		case SO_IF:
+		case SO_LABEL:
+		case SO_LOOP:
+		case SO_RET:
+		case SO_RETC:
+		case SO_SWITCH:
+		case SO_HS_DECLS:
+		case SO_HS_CONTROL_POINT_PHASE:
+		case SO_HS_FORK_PHASE:
+		case SO_HS_JOIN_PHASE:
+		case SO_INTERFACE_CALL:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	// Operations that ToInstruction prints the same way for literals and float temps
+	bool IsFloatArithmeticOpcode(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case SO_ADD:
+		case SO_DIV:
+		case SO_DP2:
+		case SO_DP3:
+		case SO_DP4:
+		case SO_MAD:
+		case SO_MAX:
+		case SO_MIN:
+		case SO_MOV:
+		case SO_MUL:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	uint32_t NumDests(ShaderInstruction const & insn)
+	{
+		if (IsPureOpcode(insn.opcode) || IsImmAtomicOpcode(insn.opcode))
+		{
+			return std::min(insn.num_ops, GetNumOutputs(insn.opcode));
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	// Components of the register a source operand may read
+	uint32_t ReadMask(ShaderOperand const & op)
+	{
+		if (1 == op.comps)
+		{
+			return 1UL << op.swizzle[0];
+		}
+		else if (4 == op.comps)
+		{
+			switch (op.mode)
+			{
+			case SOSM_MASK:
+				return op.mask;
+
+			case SOSM_SWIZZLE:
+				return (1UL << op.swizzle[0]) | (1UL << op.swizzle[1]) | (1UL << op.swizzle[2]) | (1UL << op.swizzle[3]);
+
+			case SOSM_SCALAR:
+				return 1UL << op.swizzle[0];
+
+			default:
+				return 0xF;
+			}
+		}
+		else
+		{
+			return 0xF;
+		}
+	}
+
+	// Components a destination operand is known to write, 0 if it can't be told
+	uint32_t WriteMask(ShaderOperand const & op)
+	{
+		return ((4 == op.comps) && (SOSM_MASK == op.mode)) ? op.mask : 0;
+	}
+
+	uint32_t ImmComponent(ShaderOperand const & op, uint32_t comp)
+	{
+		return op.imm_values[(1 == op.comps) ? 0 : comp].u32;
+	}
+
+	float AsFloat(uint32_t u)
+	{
+		ShaderAny any;
+		any.u32 = u;
+		return any.f32;
+	}
+
+	uint32_t AsUInt(float f)
+	{
+		ShaderAny any;
+		any.f32 = f;
+		return any.u32;
+	}
+}
+
+struct ShaderOptimizer
+{
+	// Where the components of a temp were copied from by a mov
+	struct CopyInfo
+	{
+		ShaderInstruction const * mov;
+		uint8_t src_comp;
+	};
+
+	ShaderProgram* program;
+	uint32_t num_temps;
+	std::vector<CopyInfo> copies;
+	std::vector<uint8_t> read_masks;
+	std::vector<uint8_t> dead_masks;
+	std::vector<uint32_t> temp_map;
+
+	explicit ShaderOptimizer(ShaderProgram& program)
+		: program(&program), num_temps(0)
+	{
+	}
+
+	ShaderOptimizeStats Optimize()
+	{
+		ShaderOptimizeStats stats;
+		stats.num_insns_before = static_cast<uint32_t>(program->insns.size());
+		stats.num_temps_before = this->CountTemps();
+
+		if ((program->version.type != ST_HS) && this->Optimizable())
+		{
+			num_temps = stats.num_temps_before;
+
+			bool changed = true;
+			for (int pass = 0; changed && (pass < 4); ++ pass)
+			{
+				changed = this->FoldConstants();
+				changed |= this->PropagateCopies();
+				changed |= this->EliminateDeadCode();
+			}
+			this->RenameTemps();
+		}
+
+		stats.num_insns_after = static_cast<uint32_t>(program->insns.size());
+		stats.num_temps_after = this->CountTemps();
+		return stats;
+	}
+
+	template <typename T>
+	void ForEachTemp(ShaderOperand& op, T const & func)
+	{
+		if (SOT_TEMP == op.type)
+		{
+			func(op);
+		}
+		for (uint32_t i = 0; i < op.num_indices; ++ i)
+		{
+			if (op.indices[i].reg)
+			{
+				this->ForEachTemp(*op.indices[i].reg, func);
+			}
+		}
+	}
+
+	// Calls func(op) for every temp operand the instruction reads, including the relative indices of its destinations
+	template <typename T>
+	void ForEachTempRead(ShaderInstruction& insn, T const & func)
+	{
+		uint32_t const num_dests = NumDests(insn);
+		for (uint32_t i = 0; i < insn.num_ops; ++ i)
+		{
+			ShaderOperand& op = *insn.ops[i];
+			if (i < num_dests)
+			{
+				for (uint32_t j = 0; j < op.num_indices; ++ j)
+				{
+					if (op.indices[j].reg)
+					{
+						this->ForEachTemp(*op.indices[j].reg, func);
+					}
+				}
+			}
+			else
+			{
+				this->ForEachTemp(op, func);
+			}
+		}
+	}
+
+	uint32_t CountTemps()
+	{
+		uint32_t count = 0;
+		for (auto const & dcl : program->dcls)
+		{
+			if (SO_DCL_TEMPS == dcl->opcode)
+			{
+				count = std::max(count, dcl->num);
+			}
+		}
+		for (auto const & insn : program->insns)
+		{
+			for (uint32_t i = 0; i < insn->num_ops; ++ i)
+			{
+				this->ForEachTemp(*insn->ops[i], [&count](ShaderOperand const & op)
+					{
+						count = std::max(count, static_cast<uint32_t>(op.indices[0].disp + 1));
+					});
+			}
+		}
+		return count;
+	}
+
+	// Temps are only tracked when they are addressed directly
+	bool Optimizable()
+	{
+		bool ret = true;
+		for (auto const & insn : program->insns)
+		{
+			for (uint32_t i = 0; i < insn->num_ops; ++ i)
+			{
+				this->ForEachTemp(*insn->ops[i], [&ret](ShaderOperand const & op)
+					{
+						ret &= op.HasSimpleIndex();
+					});
+			}
+		}
+		return ret;
+	}
+
+	// Instructions with literal sources only become a mov of the result
+	bool FoldConstants()
+	{
+		bool changed = false;
+		for (auto& insn : program->insns)
+		{
+			if ((1 == NumDests(*insn)) && !insn->insn.sat && (SOT_TEMP == insn->ops[0]->type) && WriteMask(*insn->ops[0]))
+			{
+				bool all_imm = insn->num_ops > 1;
+				for (uint32_t i = 1; i < insn->num_ops; ++ i)
+				{
+					all_imm &= (SOT_IMMEDIATE32 == insn->ops[i]->type);
+				}
+				if (all_imm)
+				{
+					changed |= this->FoldConstant(*insn);
+				}
+			}
+		}
+		return changed;
+	}
+
+	bool FoldConstant(ShaderInstruction& insn)
+	{
+		bool const float_op = (SIT_Float == GetOpInType(insn.opcode));
+		for (uint32_t i = 1; i < insn.num_ops; ++ i)
+		{
+			if (!float_op && (insn.ops[i]->neg || insn.ops[i]->abs))
+			{
+				return false;
+			}
+		}
+
+		auto src = [&insn, float_op](uint32_t i, uint32_t comp)
+		{
+			uint32_t value = ImmComponent(*insn.ops[i], comp);
+			if (float_op)
+			{
+				float f = AsFloat(value);
+				if (insn.ops[i]->abs)
+				{
+					f = std::abs(f);
+				}
+				if (insn.ops[i]->neg)
+				{
+					f = -f;
+				}
+				value = AsUInt(f);
+			}
+			return value;
+		};
+
+		uint32_t const mask = WriteMask(*insn.ops[0]);
+		uint32_t result[4] = { 0, 0, 0, 0 };
+		bool has_float = false;
+		bool has_int = false;
+		for (uint32_t c = 0; c < 4; ++ c)
+		{
+			if (!(mask & (1UL << c)))
+			{
+				continue;
+			}
+
+			switch (insn.opcode)
+			{
+			case SO_ADD:
+				result[c] = AsUInt(AsFloat(src(1, c)) + AsFloat(src(2, c)));
+				break;
+
+			case SO_MUL:
+				result[c] = AsUInt(AsFloat(src(1, c)) * AsFloat(src(2, c)));
+				break;
+
+			case SO_MAD:
+				result[c] = AsUInt(AsFloat(src(1, c)) * AsFloat(src(2, c)) + AsFloat(src(3, c)));
+				break;
+
+			case SO_MIN:
+				result[c] = AsUInt(std::min(AsFloat(src(1, c)), AsFloat(src(2, c))));
+				break;
+
+			case SO_MAX:
+				result[c] = AsUInt(std::max(AsFloat(src(1, c)), AsFloat(src(2, c))));
+				break;
+
+			case SO_IADD:
+				result[c] = src(1, c) + src(2, c);
+				break;
+
+			case SO_INEG:
+				result[c] = 0 - src(1, c);
+				break;
+
+			case SO_AND:
+				result[c] = src(1, c) & src(2, c);
+				break;
+
+			case SO_OR:
+				result[c] = src(1, c) | src(2, c);
+				break;
+
+			case SO_XOR:
+				result[c] = src(1, c) ^ src(2, c);
+				break;
+
+			case SO_NOT:
+				result[c] = ~src(1, c);
+				break;
+
+			case SO_ISHL:
+				result[c] = src(1, c) << (src(2, c) & 31);
+				break;
+
+			case SO_ISHR:
+				result[c] = static_cast<uint32_t>(static_cast<int32_t>(src(1, c)) >> (src(2, c) & 31));
+				break;
+
+			case SO_USHR:
+				result[c] = src(1, c) >> (src(2, c) & 31);
+				break;
+
+			case SO_ITOF:
+				result[c] = AsUInt(static_cast<float>(static_cast<int32_t>(src(1, c))));
+				break;
+
+			case SO_UTOF:
+				result[c] = AsUInt(static_cast<float>(src(1, c)));
+				break;
+
+			default:
+				return false;
+			}
+
+			// ToInstruction prints a literal as float or as int bits by ValidFloat, which must agree over the components
+			if (result[c] != 0)
+			{
+				if (ValidFloat(AsFloat(result[c])))
+				{
+					has_float = true;
+				}
+				else
+				{
+					has_int = true;
+				}
+			}
+		}
+		if (has_float && has_int)
+		{
+			return false;
+		}
+
+		ShaderOperand* imm = program->operand_arena.Alloc();
+		imm->type = SOT_IMMEDIATE32;
+		imm->comps = 4;
+		imm->mode = SOSM_MASK;
+		imm->mask = 0xF;
+		for (uint32_t c = 0; c < 4; ++ c)
+		{
+			imm->swizzle[c] = static_cast<uint8_t>(c);
+			imm->imm_values[c].u32 = result[c];
+		}
+
+		insn.opcode = SO_MOV;
+		insn.ops[1] = imm;
+		for (uint32_t i = 2; i < insn.num_ops; ++ i)
+		{
+			insn.ops[i] = nullptr;
+		}
+		insn.num_ops = 2;
+		return true;
+	}
+
+	// A mov that can be read through instead of its destination
+	bool IsPropagatableMov(ShaderInstruction const & insn) const
+	{
+		if ((insn.opcode != SO_MOV) || insn.insn.sat || (insn.num_ops != 2))
+		{
+			return false;
+		}
+
+		ShaderOperand const & dst = *insn.ops[0];
+		ShaderOperand const & src = *insn.ops[1];
+		if ((dst.type != SOT_TEMP) || !WriteMask(dst) || src.neg || src.abs)
+		{
+			return false;
+		}
+
+		switch (src.type)
+		{
+		case SOT_TEMP:
+			return (4 == src.comps) && (src.mode != SOSM_MASK) && (src.indices[0].disp != dst.indices[0].disp);
+
+		case SOT_CONSTANT_BUFFER:
+		case SOT_INPUT:
+			for (uint32_t i = 0; i < src.num_indices; ++ i)
+			{
+				if (!src.IsIndexSimple(i))
+				{
+					return false;
+				}
+			}
+			return (4 == src.comps) && (src.mode != SOSM_MASK);
+
+		case SOT_IMMEDIATE32:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	// Forwards the sources of movs to the instructions reading their destinations in the same block
+	bool PropagateCopies()
+	{
+		bool changed = false;
+
+		copies.assign(num_temps * 4, CopyInfo{ nullptr, 0 });
+		for (auto& insn : program->insns)
+		{
+			if (IsBlockBoundary(insn->opcode))
+			{
+				copies.assign(num_temps * 4, CopyInfo{ nullptr, 0 });
+				continue;
+			}
+
+			uint32_t const num_dests = NumDests(*insn);
+			if (IsPureOpcode(insn->opcode))
+			{
+				for (uint32_t i = num_dests; i < insn->num_ops; ++ i)
+				{
+					changed |= this->PropagateCopy(*insn, i);
+				}
+			}
+
+			// Anything overwriting a copy or its source ends it. Unknown instructions may write their first operand.
+			for (uint32_t i = 0; i < std::max(num_dests, std::min(insn->num_ops, 1U)); ++ i)
+			{
+				ShaderOperand const & dst = *insn->ops[i];
+				if (SOT_TEMP == dst.type)
+				{
+					uint32_t const reg = static_cast<uint32_t>(dst.indices[0].disp);
+					uint32_t const mask = (i < num_dests) && WriteMask(dst) ? WriteMask(dst) : 0xF;
+					for (uint32_t c = 0; c < 4; ++ c)
+					{
+						if (mask & (1UL << c))
+						{
+							copies[reg * 4 + c].mov = nullptr;
+						}
+					}
+					for (auto& copy : copies)
+					{
+						if (copy.mov && (SOT_TEMP == copy.mov->ops[1]->type)
+							&& (copy.mov->ops[1]->indices[0].disp == dst.indices[0].disp)
+							&& (mask & (1UL << copy.src_comp)))
+						{
+							copy.mov = nullptr;
+						}
+					}
+				}
+			}
+
+			if (this->IsPropagatableMov(*insn))
+			{
+				ShaderOperand const & dst = *insn->ops[0];
+				ShaderOperand const & src = *insn->ops[1];
+				uint32_t const reg = static_cast<uint32_t>(dst.indices[0].disp);
+				uint32_t const mask = WriteMask(dst);
+				for (uint32_t c = 0; c < 4; ++ c)
+				{
+					if (mask & (1UL << c))
+					{
+						CopyInfo& copy = copies[reg * 4 + c];
+						copy.mov = insn;
+						if (SOT_IMMEDIATE32 == src.type)
+						{
+							copy.src_comp = static_cast<uint8_t>(c);
+						}
+						else
+						{
+							copy.src_comp = (SOSM_SCALAR == src.mode) ? src.swizzle[0] : src.swizzle[c];
+						}
+					}
+				}
+			}
+		}
+
+		return changed;
+	}
+
+	bool PropagateCopy(ShaderInstruction& insn, uint32_t index)
+	{
+		ShaderOperand const & op = *insn.ops[index];
+		if ((op.type != SOT_TEMP) || (op.comps != 4) || (SOSM_MASK == op.mode))
+		{
+			return false;
+		}
+
+		uint32_t const num_comps = (SOSM_SCALAR == op.mode) ? 1 : 4;
+		uint32_t const reg = static_cast<uint32_t>(op.indices[0].disp);
+		ShaderInstruction const * mov = nullptr;
+		uint8_t src_comps[4];
+		for (uint32_t i = 0; i < num_comps; ++ i)
+		{
+			CopyInfo const & copy = copies[reg * 4 + op.swizzle[i]];
+			if (!copy.mov || (mov && (copy.mov != mov)))
+			{
+				return false;
+			}
+			mov = copy.mov;
+			src_comps[i] = copy.src_comp;
+		}
+
+		ShaderOperand const & src = *mov->ops[1];
+		ShaderOperand* new_op = program->operand_arena.Alloc();
+		if (SOT_IMMEDIATE32 == src.type)
+		{
+			// Literals are printed as written, keep them to the float ops where a float temp is printed the same way
+			if (!IsFloatArithmeticOpcode(insn.opcode))
+			{
+				return false;
+			}
+			for (uint32_t i = 0; i < num_comps; ++ i)
+			{
+				if (!ValidFloat(AsFloat(ImmComponent(src, src_comps[i]))))
+				{
+					return false;
+				}
+			}
+
+			new_op->type = SOT_IMMEDIATE32;
+			new_op->comps = static_cast<uint8_t>(num_comps);
+			new_op->mode = SOSM_MASK;
+			new_op->mask = 0xF;
+			for (uint32_t i = 0; i < 4; ++ i)
+			{
+				new_op->swizzle[i] = (1 == num_comps) ? 0 : static_cast<uint8_t>(i);
+				new_op->imm_values[i].u32 = ImmComponent(src, src_comps[std::min(i, num_comps - 1)]);
+			}
+		}
+		else
+		{
+			*new_op = src;
+			new_op->mode = op.mode;
+			for (uint32_t i = 0; i < 4; ++ i)
+			{
+				new_op->swizzle[i] = src_comps[std::min(i, num_comps - 1)];
+			}
+		}
+		new_op->neg = op.neg;
+		new_op->abs = op.abs;
+
+		insn.ops[index] = new_op;
+		return true;
+	}
+
+	// Removes the side effect free instructions whose temp results are never read, or overwritten before read in the block
+	bool EliminateDeadCode()
+	{
+		read_masks.assign(num_temps, 0);
+		for (auto& insn : program->insns)
+		{
+			this->ForEachTempRead(*insn, [this](ShaderOperand const & op)
+				{
+					read_masks[static_cast<size_t>(op.indices[0].disp)] |= static_cast<uint8_t>(ReadMask(op));
+				});
+		}
+
+		std::vector<bool> dead(program->insns.size(), false);
+		bool changed = false;
+
+		dead_masks.assign(num_temps, 0);
+		for (size_t i = program->insns.size(); i > 0; -- i)
+		{
+			ShaderInstruction& insn = *program->insns[i - 1];
+			if (IsBlockBoundary(insn.opcode))
+			{
+				dead_masks.assign(num_temps, 0);
+			}
+
+			uint32_t const num_dests = NumDests(insn);
+			if (IsPureOpcode(insn.opcode) && (num_dests > 0))
+			{
+				bool all_dead = true;
+				for (uint32_t j = 0; j < num_dests; ++ j)
+				{
+					ShaderOperand const & dst = *insn.ops[j];
+					if (SOT_TEMP == dst.type)
+					{
+						uint32_t const reg = static_cast<uint32_t>(dst.indices[0].disp);
+						uint32_t const mask = WriteMask(dst);
+						all_dead &= (mask != 0) && (!(read_masks[reg] & mask) || ((dead_masks[reg] & mask) == mask));
+					}
+					else
+					{
+						all_dead &= (SOT_NULL == dst.type);
+					}
+				}
+				if (all_dead)
+				{
+					dead[i - 1] = true;
+					changed = true;
+					continue;
+				}
+			}
+
+			for (uint32_t j = 0; j < num_dests; ++ j)
+			{
+				ShaderOperand const & dst = *insn.ops[j];
+				if (SOT_TEMP == dst.type)
+				{
+					dead_masks[static_cast<size_t>(dst.indices[0].disp)] |= static_cast<uint8_t>(WriteMask(dst));
+				}
+			}
+			this->ForEachTempRead(insn, [this](ShaderOperand const & op)
+				{
+					dead_masks[static_cast<size_t>(op.indices[0].disp)] &= static_cast<uint8_t>(~ReadMask(op));
+				});
+		}
+
+		if (changed)
+		{
+			size_t n = 0;
+			for (size_t i = 0; i < program->insns.size(); ++ i)
+			{
+				if (!dead[i])
+				{
+					program->insns[n] = program->insns[i];
+					++ n;
+				}
+			}
+			program->insns.resize(n);
+		}
+
+		return changed;
+	}
+
+	// Numbers the temps still in use densely, so fewer of them are declared
+	void RenameTemps()
+	{
+		temp_map.assign(num_temps, ~0U);
+		uint32_t num_used = 0;
+		for (auto& insn : program->insns)
+		{
+			for (uint32_t i = 0; i < insn->num_ops; ++ i)
+			{
+				this->ForEachTemp(*insn->ops[i], [this, &num_used](ShaderOperand& op)
+					{
+						uint32_t& new_reg = temp_map[static_cast<size_t>(op.indices[0].disp)];
+						if (~0U == new_reg)
+						{
+							new_reg = num_used;
+							++ num_used;
+						}
+					});
+			}
+		}
+
+		for (auto& insn : program->insns)
+		{
+			for (uint32_t i = 0; i < insn->num_ops; ++ i)
+			{
+				this->ForEachTemp(*insn->ops[i], [this](ShaderOperand& op)
+					{
+						op.indices[0].disp = temp_map[static_cast<size_t>(op.indices[0].disp)];
+					});
+			}
+		}
+
+		for (auto& dcl : program->dcls)
+		{
+			if (SO_DCL_TEMPS == dcl->opcode)
+			{
+				dcl->num = num_used;
+			}
+		}
+	}
+};
+
+ShaderOptimizeStats ShaderOptimize(ShaderProgram& program)
+{
+	ShaderOptimizer optimizer(program);
+	return optimizer.Optimize();
+}
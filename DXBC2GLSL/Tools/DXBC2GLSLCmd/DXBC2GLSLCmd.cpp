@@ -28,10 +28,16 @@
  * from http://www.klayge.org/licensing/.
  */
 
+#include <KFL/CXX17/filesystem.hpp>
 #include <DXBC2GLSL/DXBC2GLSL.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 void usage()
 {
@@ -41,9 +47,115 @@ void usage()
 	std::cerr << "Latest version available from http://www.klayge.org/\n";
 	std::cerr << "\n";
 	std::cerr << "Usage: DXBC2GLSLCmd FILE [OUTPUT]\n";
+	std::cerr << "       DXBC2GLSLCmd -batch DIR\n";
+	std::cerr << "\n";
+	std::cerr << "Batch mode translates every file in DIR on all cores, writes FILE.glsl next to each of them,\n";
+	std::cerr << "and reports the throughput of a fresh converter per shader against one reused converter per thread.\n";
 	std::cerr << std::endl;
 }
 
+std::vector<char> ReadFile(std::string const & name)
+{
+	std::ifstream in(name.c_str(), std::ios_base::in | std::ios_base::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Translates all blobs on num_threads threads, returns the time in seconds. glsls[i] is left empty if blobs[i] fails.
+double TranslateAll(std::vector<std::vector<char>> const & blobs, std::vector<std::string>& glsls,
+	uint32_t num_threads, bool reuse)
+{
+	glsls.assign(blobs.size(), std::string());
+
+	std::atomic<size_t> next(0);
+	auto worker = [&blobs, &glsls, &next, reuse]()
+	{
+		DXBC2GLSL::DXBC2GLSL reused;
+		for (size_t i = next ++; i < blobs.size(); i = next ++)
+		{
+			try
+			{
+				if (reuse)
+				{
+					reused.FeedDXBC(blobs[i].data(), true, true, STP_Fractional_Odd, STOP_Triangle_CW, GSV_430);
+					glsls[i] = reused.GLSLString();
+				}
+				else
+				{
+					DXBC2GLSL::DXBC2GLSL fresh;
+					fresh.FeedDXBC(blobs[i].data(), true, true, STP_Fractional_Odd, STOP_Triangle_CW, GSV_430);
+					glsls[i] = fresh.GLSLString();
+				}
+			}
+			catch (std::exception&)
+			{
+				glsls[i].clear();
+			}
+		}
+	};
+
+	auto const start = std::chrono::high_resolution_clock::now();
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < num_threads; ++ i)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int Batch(std::string const & dir)
+{
+	std::vector<std::string> names;
+	std::vector<std::vector<char>> blobs;
+	for (auto const & entry : std::filesystem::directory_iterator(dir))
+	{
+		std::filesystem::path const & path = entry.path();
+		if (std::filesystem::is_regular_file(path) && (path.extension() != ".glsl"))
+		{
+			names.push_back(path.string());
+			blobs.push_back(ReadFile(names.back()));
+		}
+	}
+	if (blobs.empty())
+	{
+		std::cerr << "No file found in " << dir << std::endl;
+		return 1;
+	}
+
+	uint32_t const num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+
+	std::vector<std::string> glsls;
+	double const fresh_time = TranslateAll(blobs, glsls, num_threads, false);
+	double const reuse_time = TranslateAll(blobs, glsls, num_threads, true);
+
+	uint32_t num_failed = 0;
+	for (size_t i = 0; i < names.size(); ++ i)
+	{
+		if (glsls[i].empty())
+		{
+			std::cout << "Failed: " << names[i] << std::endl;
+			++ num_failed;
+		}
+		else
+		{
+			std::ofstream out((names[i] + ".glsl").c_str());
+			out << glsls[i];
+		}
+	}
+
+	std::cout << blobs.size() << " shaders, " << num_failed << " failed, " << num_threads << " threads" << std::endl;
+	std::cout << "Fresh converter per shader: " << blobs.size() / fresh_time << " shaders/sec" << std::endl;
+	std::cout << "Reused converter per thread: " << blobs.size() / reuse_time << " shaders/sec" << std::endl;
+
+	return (num_failed > 0) ? 1 : 0;
+}
+
 int main(int argc, char** argv)
 {
 	if (argc < 2)
@@ -52,6 +164,16 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	if (std::string(argv[1]) == "-batch")
+	{
+		if (argc < 3)
+		{
+			usage();
+			return 1;
+		}
+		return Batch(argv[2]);
+	}
+
 	std::vector<char> data;
 	std::ifstream in(argv[1], std::ios_base::in | std::ios_base::binary);
 	std::ofstream out;
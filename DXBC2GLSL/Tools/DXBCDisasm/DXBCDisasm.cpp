@@ -88,6 +88,13 @@ int main(int argc, char** argv)
 					converter.ToASM(out);
 				}
 				converter.ToASM(std::cout);
+
+				// What GSR_Optimize saves on this shader
+				ShaderOptimizeStats const stats = ShaderOptimize(*shader);
+				std::cout << "// " << stats.num_insns_before << " instructions, " << stats.num_insns_after
+					<< " after optimization" << std::endl;
+				std::cout << "// " << stats.num_temps_before << " temps, " << stats.num_temps_after
+					<< " after optimization" << std::endl;
 			}
 		}
 	}
@@ -0,0 +1,197 @@
+/**
+ * @file RadixSort.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_RADIXSORT_HPP
+#define _KFL_RADIXSORT_HPP
+
+#pragma once
+
+#include <KFL/TaskScheduler.hpp>
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <vector>
+
+namespace KlayGE
+{
+	// Below this number of items the sort stays on the calling thread
+	uint32_t const RADIX_SORT_PARALLEL_THRESHOLD = 1UL << 15;
+
+	// Converts a float to an unsigned integer with the same ordering, for building radix sort keys
+	inline uint32_t RadixSortKey(float f)
+	{
+		union FNU
+		{
+			float f;
+			uint32_t u;
+		} fnu;
+		fnu.f = f;
+		return (fnu.u & 0x80000000U) ? ~fnu.u : (fnu.u | 0x80000000U);
+	}
+
+	// Stable LSD radix sort of num items by the unsigned integer key_func(item), 8 bits per pass. tmp must hold num
+	//  items, the result ends up in items. Passes over digits shared by all keys are skipped, so keys with unused high bits
+	//  cost less. With a task scheduler and a large enough input, histograms and scatters are split into contiguous chunks
+	//  across the workers; every chunk writes to its own precomputed range of each bucket, which keeps the sort stable.
+	template <typename T, typename KeyFunc>
+	void RadixSort(T* items, T* tmp, uint32_t num, KeyFunc const & key_func, task_scheduler* ts = nullptr)
+	{
+		typedef typename std::decay<decltype(key_func(*items))>::type KeyType;
+		static_assert(std::is_unsigned<KeyType>::value, "Radix sort keys must be unsigned integers.");
+
+		uint32_t const NUM_PASSES = sizeof(KeyType);
+		typedef std::array<uint32_t, 256> Histogram;
+
+		if (num < 2)
+		{
+			return;
+		}
+
+		uint32_t num_chunks = 1;
+		if (ts && (num >= RADIX_SORT_PARALLEL_THRESHOLD))
+		{
+			num_chunks = std::min(ts->num_workers() + 1, num / (RADIX_SORT_PARALLEL_THRESHOLD / 4));
+		}
+		uint32_t const chunk_size = (num + num_chunks - 1) / num_chunks;
+
+		auto for_each_chunk = [ts, num, num_chunks, chunk_size](auto const & func)
+		{
+			if (num_chunks > 1)
+			{
+				ts->parallel_for(0, num_chunks, 1, [&func, num, chunk_size](uint32_t begin, uint32_t end)
+					{
+						for (uint32_t c = begin; c < end; ++ c)
+						{
+							func(c, c * chunk_size, std::min((c + 1) * chunk_size, num));
+						}
+					});
+			}
+			else
+			{
+				func(0, 0, num);
+			}
+		};
+
+		// Histograms of all digits from one read of the input. Per chunk, summed afterwards.
+		std::vector<Histogram> histograms(num_chunks * NUM_PASSES);
+		for_each_chunk([items, &key_func, &histograms](uint32_t chunk, uint32_t begin, uint32_t end)
+			{
+				Histogram* hist = &histograms[chunk * NUM_PASSES];
+				for (uint32_t p = 0; p < NUM_PASSES; ++ p)
+				{
+					hist[p].fill(0);
+				}
+				for (uint32_t i = begin; i < end; ++ i)
+				{
+					KeyType const key = key_func(items[i]);
+					for (uint32_t p = 0; p < NUM_PASSES; ++ p)
+					{
+						++ hist[p][(key >> (p * 8)) & 0xFF];
+					}
+				}
+			});
+		for (uint32_t c = 1; c < num_chunks; ++ c)
+		{
+			for (uint32_t p = 0; p < NUM_PASSES; ++ p)
+			{
+				for (uint32_t d = 0; d < 256; ++ d)
+				{
+					histograms[p][d] += histograms[c * NUM_PASSES + p][d];
+				}
+			}
+		}
+
+		std::vector<Histogram> offsets(num_chunks);
+		T* src = items;
+		T* dst = tmp;
+		for (uint32_t p = 0; p < NUM_PASSES; ++ p)
+		{
+			Histogram const & total = histograms[p];
+			if (total[(key_func(src[0]) >> (p * 8)) & 0xFF] == num)
+			{
+				continue;
+			}
+
+			uint32_t const shift = p * 8;
+			if (num_chunks > 1)
+			{
+				// Items move between chunks after every pass, the per chunk counts of this digit have to be redone
+				for_each_chunk([src, &key_func, &offsets, shift](uint32_t chunk, uint32_t begin, uint32_t end)
+					{
+						Histogram& hist = offsets[chunk];
+						hist.fill(0);
+						for (uint32_t i = begin; i < end; ++ i)
+						{
+							++ hist[(key_func(src[i]) >> shift) & 0xFF];
+						}
+					});
+
+				uint32_t sum = 0;
+				for (uint32_t d = 0; d < 256; ++ d)
+				{
+					for (uint32_t c = 0; c < num_chunks; ++ c)
+					{
+						uint32_t const count = offsets[c][d];
+						offsets[c][d] = sum;
+						sum += count;
+					}
+				}
+			}
+			else
+			{
+				uint32_t sum = 0;
+				for (uint32_t d = 0; d < 256; ++ d)
+				{
+					offsets[0][d] = sum;
+					sum += total[d];
+				}
+			}
+
+			for_each_chunk([src, dst, &key_func, &offsets, shift](uint32_t chunk, uint32_t begin, uint32_t end)
+				{
+					Histogram& offset = offsets[chunk];
+					for (uint32_t i = begin; i < end; ++ i)
+					{
+						dst[offset[(key_func(src[i]) >> shift) & 0xFF] ++] = src[i];
+					}
+				});
+
+			std::swap(src, dst);
+		}
+
+		if (src != items)
+		{
+			std::copy(src, src + num, items);
+		}
+	}
+}
+
+#endif		// _KFL_RADIXSORT_HPP
@@ -0,0 +1,178 @@
+/**
+ * @file TaskScheduler.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_TASKSCHEDULER_HPP
+#define _KFL_TASKSCHEDULER_HPP
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace KlayGE
+{
+	// A work-stealing job system. Every worker owns a deque, pushes and pops its own tasks at the back, and steals from
+	//  the front of the others' when it runs dry. Tasks can have continuations, and threads waiting for a task help
+	//  executing queued tasks instead of blocking, so fork/join from inside a task is safe.
+	//  Long-lived or blocking jobs (loading threads, sockets, ...) should stay on thread_pool.
+	class task_scheduler : boost::noncopyable
+	{
+		struct task_node;
+
+	public:
+		typedef std::function<void()> task_func_t;
+		typedef std::shared_ptr<task_node> task_handle;
+
+	public:
+		// 0 means one worker per hardware thread, minus the one that calls wait()
+		explicit task_scheduler(uint32_t num_workers = 0);
+		~task_scheduler();
+
+		uint32_t num_workers() const
+		{
+			return static_cast<uint32_t>(workers_.size());
+		}
+
+		// Queues a task with no dependency
+		task_handle schedule(task_func_t const & func);
+		// Queues a task which starts after antecedent finishes
+		task_handle continue_with(task_handle const & antecedent, task_func_t const & func);
+		// Queues a task which starts after all antecedents finish
+		task_handle when_all(std::vector<task_handle> const & antecedents, task_func_t const & func);
+
+		// Executes queued tasks until the task is finished. Rethrows the exception thrown by the task, if any.
+		void wait(task_handle const & task);
+		bool is_done(task_handle const & task) const;
+
+		// Splits [begin, end) into chunks of grain_size and calls func(chunk_begin, chunk_end) on them in parallel.
+		//  A grain_size of 0 lets the scheduler choose one.
+		template <typename Func>
+		void parallel_for(uint32_t begin, uint32_t end, uint32_t grain_size, Func const & func);
+
+		// Pops and executes one queued task on the calling thread. Returns false if there is nothing to do.
+		bool run_one();
+
+	private:
+		struct worker_queue
+		{
+			std::mutex mutex;
+			std::deque<task_handle> tasks;
+		};
+
+		void enqueue(task_handle const & task);
+		task_handle dequeue();
+		void execute(task_handle const & task);
+		void add_dependency(task_handle const & antecedent, task_handle const & task);
+		void release_dependency(task_handle const & task);
+		uint32_t queue_index() const;
+
+		void worker_func();
+
+	private:
+		std::vector<std::thread> workers_;
+		std::vector<std::thread::id> worker_ids_;
+		// One queue per worker, the last one is shared by all non-worker threads
+		std::vector<std::unique_ptr<worker_queue>> queues_;
+
+		std::atomic<uint32_t> num_queued_;
+		std::atomic<uint32_t> steal_start_;
+		std::mutex sleep_mutex_;
+		std::condition_variable sleep_cond_;
+		bool quit_;
+	};
+
+	// A fork/join group on top of task_scheduler. The destructor waits for all tasks in the group.
+	class task_group : boost::noncopyable
+	{
+	public:
+		explicit task_group(task_scheduler& ts);
+		~task_group();
+
+		void run(task_scheduler::task_func_t const & func);
+
+		// Helps executing tasks until all tasks in the group are finished. Rethrows the first exception from the group.
+		void wait();
+
+	private:
+		task_scheduler& ts_;
+		std::atomic<uint32_t> num_pending_;
+
+		std::mutex exception_mutex_;
+		std::exception_ptr exception_;
+	};
+
+	template <typename Func>
+	void task_scheduler::parallel_for(uint32_t begin, uint32_t end, uint32_t grain_size, Func const & func)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+
+		uint32_t const count = end - begin;
+		if (0 == grain_size)
+		{
+			// About 4 chunks per thread gives stealing some room to balance
+			grain_size = std::max(count / ((this->num_workers() + 1) * 4), 1U);
+		}
+
+		if ((count <= grain_size) || workers_.empty())
+		{
+			func(begin, end);
+			return;
+		}
+
+		task_group group(*this);
+		uint32_t chunk_begin = begin;
+		for (; end - chunk_begin > grain_size; chunk_begin += grain_size)
+		{
+			uint32_t const chunk_end = chunk_begin + grain_size;
+			group.run([&func, chunk_begin, chunk_end]
+				{
+					func(chunk_begin, chunk_end);
+				});
+		}
+		// The calling thread takes the last chunk itself
+		func(chunk_begin, end);
+		group.wait();
+	}
+}
+
+#endif		// _KFL_TASKSCHEDULER_HPP
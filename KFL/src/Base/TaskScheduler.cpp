@@ -0,0 +1,371 @@
+/**
+ * @file TaskScheduler.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+
+#include <boost/assert.hpp>
+
+#include <KFL/TaskScheduler.hpp>
+
+namespace KlayGE
+{
+	struct task_scheduler::task_node
+	{
+		task_func_t func;
+
+		// Number of unfinished antecedents, plus one held by the scheduling call until the task is fully set up
+		std::atomic<uint32_t> num_deps;
+		std::atomic<bool> done;
+		std::exception_ptr exception;
+
+		std::mutex continuation_mutex;
+		std::vector<task_handle> continuations;
+	};
+
+
+	task_scheduler::task_scheduler(uint32_t num_workers)
+		: num_queued_(0), steal_start_(0), quit_(false)
+	{
+		if (0 == num_workers)
+		{
+			uint32_t const num_hw_threads = std::thread::hardware_concurrency();
+			num_workers = (num_hw_threads > 1) ? num_hw_threads - 1 : 0;
+		}
+
+		queues_.resize(num_workers + 1);
+		for (auto& queue : queues_)
+		{
+			queue = MakeUniquePtr<worker_queue>();
+		}
+
+		// Workers look themselves up in worker_ids_, hold them until the table is complete
+		std::lock_guard<std::mutex> lock(sleep_mutex_);
+		worker_ids_.resize(num_workers);
+		workers_.reserve(num_workers);
+		for (uint32_t i = 0; i < num_workers; ++ i)
+		{
+			workers_.emplace_back([this] { this->worker_func(); });
+			worker_ids_[i] = workers_.back().get_id();
+		}
+	}
+
+	task_scheduler::~task_scheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex_);
+			quit_ = true;
+		}
+		sleep_cond_.notify_all();
+
+		for (auto& worker : workers_)
+		{
+			worker.join();
+		}
+	}
+
+	task_scheduler::task_handle task_scheduler::schedule(task_func_t const & func)
+	{
+		auto task = MakeSharedPtr<task_node>();
+		task->func = func;
+		task->num_deps = 1;
+		task->done = false;
+
+		this->release_dependency(task);
+
+		return task;
+	}
+
+	task_scheduler::task_handle task_scheduler::continue_with(task_handle const & antecedent, task_func_t const & func)
+	{
+		return this->when_all({ antecedent }, func);
+	}
+
+	task_scheduler::task_handle task_scheduler::when_all(std::vector<task_handle> const & antecedents, task_func_t const & func)
+	{
+		auto task = MakeSharedPtr<task_node>();
+		task->func = func;
+		task->num_deps = static_cast<uint32_t>(antecedents.size() + 1);
+		task->done = false;
+
+		for (auto const & antecedent : antecedents)
+		{
+			this->add_dependency(antecedent, task);
+		}
+		this->release_dependency(task);
+
+		return task;
+	}
+
+	void task_scheduler::wait(task_handle const & task)
+	{
+		while (!task->done)
+		{
+			if (!this->run_one())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		if (task->exception)
+		{
+			std::rethrow_exception(task->exception);
+		}
+	}
+
+	bool task_scheduler::is_done(task_handle const & task) const
+	{
+		return task->done;
+	}
+
+	bool task_scheduler::run_one()
+	{
+		task_handle task = this->dequeue();
+		if (task)
+		{
+			this->execute(task);
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	void task_scheduler::enqueue(task_handle const & task)
+	{
+		{
+			auto& queue = *queues_[this->queue_index()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back(task);
+		}
+
+		++ num_queued_;
+		{
+			// Pairs with the predicate check in worker_func, so the notification can't slip in between
+			std::lock_guard<std::mutex> lock(sleep_mutex_);
+		}
+		sleep_cond_.notify_one();
+	}
+
+	task_scheduler::task_handle task_scheduler::dequeue()
+	{
+		if (0 == num_queued_)
+		{
+			return task_handle();
+		}
+
+		uint32_t const num_queues = static_cast<uint32_t>(queues_.size());
+		uint32_t const own_index = this->queue_index();
+
+		task_handle task;
+
+		// LIFO on the own queue for cache locality
+		{
+			auto& queue = *queues_[own_index];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty())
+			{
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+		}
+
+		// FIFO when stealing, the oldest tasks tend to be the biggest ones
+		if (!task)
+		{
+			uint32_t const start = steal_start_.fetch_add(1);
+			for (uint32_t i = 0; (i < num_queues) && !task; ++ i)
+			{
+				uint32_t const index = (start + i) % num_queues;
+				if (index != own_index)
+				{
+					auto& queue = *queues_[index];
+					std::lock_guard<std::mutex> lock(queue.mutex);
+					if (!queue.tasks.empty())
+					{
+						task = std::move(queue.tasks.front());
+						queue.tasks.pop_front();
+					}
+				}
+			}
+		}
+
+		if (task)
+		{
+			-- num_queued_;
+		}
+		return task;
+	}
+
+	void task_scheduler::execute(task_handle const & task)
+	{
+		try
+		{
+			task->func();
+		}
+		catch (...)
+		{
+			task->exception = std::current_exception();
+		}
+		task->func = task_func_t();
+
+		std::vector<task_handle> continuations;
+		{
+			std::lock_guard<std::mutex> lock(task->continuation_mutex);
+			task->done = true;
+			continuations.swap(task->continuations);
+		}
+
+		for (auto const & continuation : continuations)
+		{
+			this->release_dependency(continuation);
+		}
+	}
+
+	void task_scheduler::add_dependency(task_handle const & antecedent, task_handle const & task)
+	{
+		BOOST_ASSERT(antecedent);
+
+		bool finished;
+		{
+			std::lock_guard<std::mutex> lock(antecedent->continuation_mutex);
+			finished = antecedent->done;
+			if (!finished)
+			{
+				antecedent->continuations.push_back(task);
+			}
+		}
+
+		if (finished)
+		{
+			this->release_dependency(task);
+		}
+	}
+
+	void task_scheduler::release_dependency(task_handle const & task)
+	{
+		if (1 == task->num_deps.fetch_sub(1))
+		{
+			this->enqueue(task);
+		}
+	}
+
+	uint32_t task_scheduler::queue_index() const
+	{
+		std::thread::id const id = std::this_thread::get_id();
+		for (size_t i = 0; i < worker_ids_.size(); ++ i)
+		{
+			if (worker_ids_[i] == id)
+			{
+				return static_cast<uint32_t>(i);
+			}
+		}
+		return static_cast<uint32_t>(queues_.size() - 1);
+	}
+
+	void task_scheduler::worker_func()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex_);
+		}
+
+		for (;;)
+		{
+			if (!this->run_one())
+			{
+				std::unique_lock<std::mutex> lock(sleep_mutex_);
+				sleep_cond_.wait(lock, [this] { return quit_ || (num_queued_ > 0); });
+				if (quit_)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+
+	task_group::task_group(task_scheduler& ts)
+		: ts_(ts), num_pending_(0)
+	{
+	}
+
+	task_group::~task_group()
+	{
+		try
+		{
+			this->wait();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	void task_group::run(task_scheduler::task_func_t const & func)
+	{
+		++ num_pending_;
+		ts_.schedule([this, func]
+			{
+				try
+				{
+					func();
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(exception_mutex_);
+					if (!exception_)
+					{
+						exception_ = std::current_exception();
+					}
+				}
+				-- num_pending_;
+			});
+	}
+
+	void task_group::wait()
+	{
+		while (num_pending_ > 0)
+		{
+			if (!ts_.run_one())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		std::exception_ptr exception;
+		{
+			std::lock_guard<std::mutex> lock(exception_mutex_);
+			exception.swap(exception_);
+		}
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+}
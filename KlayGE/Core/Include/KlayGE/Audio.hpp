@@ -35,8 +35,13 @@
 
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/Vector.hpp>
+#include <KFL/Thread.hpp>
 
+#include <atomic>
+#include <condition_variable>
 #include <map>
+#include <mutex>
+#include <vector>
 
 #include <KlayGE/AudioDataSource.hpp>
 
@@ -90,8 +95,12 @@ namespace KlayGE
 		virtual void DoReset() = 0;
 	};
 
+	// Music is decoded ahead by AudioStreamService into a preallocated ring of chunks, each one holds
+	//  1 / BUFFERS_PER_SECOND second of data. The backends hand the chunks to the device in DoServiceStream.
 	class KLAYGE_CORE_API MusicBuffer : public AudioBuffer
 	{
+		friend class AudioStreamService;
+
 	public:
 		explicit MusicBuffer(AudioDataSourcePtr const & data_source);
 		~MusicBuffer() override;
@@ -103,11 +112,107 @@ namespace KlayGE
 		bool IsSound() const override;
 
 	protected:
+		struct StreamChunk
+		{
+			uint8_t const * data;
+			uint32_t size;
+			bool end_of_stream;
+		};
+
+		// Allocates the ring, buffer_seconds of data for the device and a second of decode-ahead
+		void InitStream(uint32_t buffer_seconds);
+
+		uint32_t ChunkSize() const
+		{
+			return chunk_size_;
+		}
+		uint32_t NumChunks() const
+		{
+			return num_chunks_;
+		}
+
+		// The oldest decoded chunk that is not acquired yet. The data stays valid until the chunk is released.
+		bool AcquireChunk(StreamChunk& chunk);
+		// The device is done with the num oldest acquired chunks, their space goes back to the decoder
+		void ReleaseChunks(uint32_t num);
+		uint32_t NumAcquiredChunks() const;
+		// The last chunk of a non-looping stream has been acquired
+		bool StreamFinished() const;
+
+		AudioStreamService& StreamService() const;
+
 		virtual void DoReset() = 0;
 		virtual void DoPlay(bool loop) = 0;
 		virtual void DoStop() = 0;
+		// Called on the stream service thread. Returns the milliseconds until the backend wants to be serviced again
+		//  without a wakeup, or AudioStreamService::WAIT_INFINITE.
+		virtual uint32_t DoServiceStream() = 0;
 
 		static uint32_t constexpr BUFFERS_PER_SECOND = 2;
+
+	private:
+		uint32_t ServiceStream();
+		void DecodeAhead();
+		void RewindStream();
+		void StopStreaming();
+
+	private:
+		std::vector<uint8_t> stream_data_;
+		std::vector<uint32_t> chunk_sizes_;
+		std::vector<uint8_t> chunk_end_;
+		uint32_t chunk_size_;
+		uint32_t num_chunks_;
+
+		// Monotonic chunk counters. decoded_ is written by the service thread, acquired_ and released_ by the consumer.
+		std::atomic<uint64_t> decoded_chunks_;
+		std::atomic<uint64_t> acquired_chunks_;
+		std::atomic<uint64_t> released_chunks_;
+		std::atomic<bool> decode_ended_;
+		std::atomic<bool> end_acquired_;
+
+		bool loop_;
+		// Set while registered. Cached, so stopping works while the engine is being torn down.
+		AudioStreamService* stream_service_;
+	};
+
+	// Services every playing MusicBuffer from one worker. It sleeps until a buffer asks for a wakeup, usually when the
+	//  device has finished a chunk, or until the earliest deadline returned by the backends.
+	class KLAYGE_CORE_API AudioStreamService : boost::noncopyable
+	{
+	public:
+		static uint32_t constexpr WAIT_INFINITE = 0xFFFFFFFFU;
+
+		AudioStreamService();
+		~AudioStreamService();
+
+		void Register(MusicBuffer* buffer);
+		// When it returns, the worker no longer touches the buffer
+		void Unregister(MusicBuffer* buffer);
+
+		// Can be called from any thread, including the callbacks of the audio device
+		void Wakeup();
+
+		uint32_t NumStreams() const;
+		uint64_t NumServicePasses() const
+		{
+			return num_passes_;
+		}
+
+	private:
+		void WorkerFunc();
+
+	private:
+		mutable std::mutex streams_mutex_;
+		std::vector<MusicBuffer*> streams_;
+
+		std::mutex wake_mutex_;
+		std::condition_variable wake_cond_;
+		bool wakeup_;
+		bool quit_;
+
+		std::atomic<uint64_t> num_passes_;
+
+		std::unique_ptr<joiner<void>> worker_;
 	};
 
 	class KLAYGE_CORE_API AudioEngine : boost::noncopyable
@@ -143,11 +248,20 @@ namespace KlayGE
 		virtual void GetListenerOri(float3& face, float3& up) const = 0;
 		virtual void SetListenerOri(float3 const & face, float3 const & up) = 0;
 
+		AudioStreamService& StreamService();
+
+		// Mixes num_frames frames of the playing buffers into interleaved stereo float samples. Only the backends
+		//  without an audio device mix in software, the others return 0 and leave output untouched.
+		virtual uint32_t MixOutput(float* output, uint32_t num_frames);
+
 	private:
 		virtual void DoSuspend() = 0;
 		virtual void DoResume() = 0;
 
 	protected:
+		// Declared before the buffers, so it outlives the music buffers it services
+		std::unique_ptr<AudioStreamService> stream_service_;
+
 		std::map<size_t, AudioBufferPtr> audio_buffs_;
 
 		float sound_vol_;
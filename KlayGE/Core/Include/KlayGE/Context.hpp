@@ -158,6 +158,11 @@ namespace KlayGE
 			return *gtp_instance_;
 		}
 
+		task_scheduler& TaskScheduler()
+		{
+			return *gts_instance_;
+		}
+
 	private:
 		void DestroyAll();
 
@@ -191,6 +196,7 @@ namespace KlayGE
 		DllLoader ads_loader_;
 
 		std::unique_ptr<thread_pool> gtp_instance_;
+		std::unique_ptr<task_scheduler> gts_instance_;
 	};
 }
 
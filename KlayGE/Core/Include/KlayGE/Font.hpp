@@ -43,11 +43,46 @@
 #include <KlayGE/RenderableHelper.hpp>
 
 #include <list>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace KlayGE
 {
 	class FontRenderable;
+	class TextLayoutRenderable;
+
+	// A string laid out once into glyph instances. The layout is redone only when the text, the size, the placement or
+	//  the color changes, or when the glyph cache of the font evicts a glyph. Each Render is one instanced draw.
+	/////////////////////////////////////////////////////////////////////////////////
+	class KLAYGE_CORE_API TextLayout : boost::noncopyable
+	{
+	public:
+		TextLayout(std::shared_ptr<TextLayoutRenderable> const & renderable, uint32_t fso_attrib);
+
+		void Text(std::wstring_view text);
+		std::wstring const & Text() const;
+		void FontSize(float font_size);
+		float FontSize() const;
+		void TextColor(Color const & clr);
+		Color const & TextColor() const;
+
+		// Lines start at x, one below the other
+		void Location(float x, float y, float z, float xScale, float yScale);
+		// Lines are aligned inside rc, glyphs completely outside of it are dropped
+		void Location(Rect const & rc, float z, float xScale, float yScale, uint32_t align);
+
+		// True if the next Render has to lay the text out again
+		bool Dirty() const;
+		uint32_t NumGlyphs() const;
+
+		void Render();
+		void Render(float4x4 const & mvp);
+
+	private:
+		std::shared_ptr<TextLayoutRenderable> renderable_;
+		SceneObjectHelperPtr layout_obj_;
+	};
 
 	// 3Dл
 	/////////////////////////////////////////////////////////////////////////////////
@@ -72,6 +107,19 @@ namespace KlayGE
 			FA_Ver_Bottom	= 1UL << 5
 		};
 
+		struct GlyphCacheStatistics
+		{
+			uint64_t num_hits;
+			uint64_t num_misses;
+			uint64_t num_evictions;
+
+			uint32_t num_cached;
+			// Cached glyphs still being decoded, text shows them blank
+			uint32_t num_pending;
+			uint32_t capacity;
+			uint32_t num_pages;
+		};
+
 	public:
 		explicit Font(std::shared_ptr<FontRenderable> const & fr);
 		Font(std::shared_ptr<FontRenderable> const & fr, uint32_t flags);
@@ -85,9 +133,27 @@ namespace KlayGE
 			std::wstring_view text, float font_size, uint32_t align);
 		void RenderText(float4x4 const & mvp, Color const & clr, std::wstring_view text, float font_size);
 
+		TextLayoutPtr MakeTextLayout();
+
+		// Starts decoding the glyphs of text in the background, so they are ready when the text shows up
+		void Prefetch(std::wstring_view text);
+		// Blocks until all requested glyphs are decoded and uploaded
+		void WaitForGlyphs();
+		GlyphCacheStatistics GlyphCacheStats() const;
+
+	private:
+		TextLayout& ImmediateLayout(size_t key);
+
 	private:
 		std::shared_ptr<FontRenderable> font_renderable_;
 		uint32_t		fso_attrib_;
+
+		// Layouts behind RenderText, keyed by the hash of the placement and the style. Those not rendered in the last
+		//  frame are dropped.
+		std::unordered_map<size_t, std::pair<TextLayoutPtr, uint32_t>> immediate_layouts_;
+		// How many times each key was asked for in the current frame
+		std::unordered_map<size_t, uint32_t> immediate_key_hits_;
+		uint32_t last_purge_frame_;
 	};
 
 	KLAYGE_CORE_API FontPtr SyncLoadFont(std::string const & font_name, uint32_t flags = 0);
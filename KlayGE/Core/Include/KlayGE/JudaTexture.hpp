@@ -21,9 +21,13 @@
 #include <KlayGE/TexCompressionBC.hpp>
 
 #include <vector>
+#include <list>
+#include <mutex>
 #include <deque>
 #include <unordered_map>
 
+#include <KFL/Timer.hpp>
+#include <KFL/TaskScheduler.hpp>
 #include <KlayGE/LZMACodec.hpp>
 
 namespace KlayGE
@@ -62,8 +66,32 @@ namespace KlayGE
 
 		static uint32_t const LEVEL_SHIFT = 28;
 
+		static uint32_t const DEFAULT_DECODED_BLOCK_BUDGET = 64;
+		// Number of tiles a decoding task takes from the request queue at a time
+		static uint32_t const TILES_PER_TASK = 4;
+
+	public:
+		struct CacheStatistics
+		{
+			uint64_t num_hits;
+			uint64_t num_misses;
+			uint64_t num_evictions;
+			uint64_t num_block_hits;
+			uint64_t num_block_misses;
+
+			uint32_t num_cached_tiles;
+			// Requested tiles still being decoded, the indirect texture keeps pointing to the old content
+			uint32_t num_pending_tiles;
+			uint32_t num_decoded_blocks;
+
+			// Seconds from the first request of a tile to its upload
+			double avg_latency;
+			double max_latency;
+		};
+
 	public:
 		JudaTexture(uint32_t num_tiles, uint32_t tile_size, ElementFormat format);
+		~JudaTexture();
 
 		uint32_t EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const;
 		void DecodeTileID(uint32_t& level, uint32_t& tile_x, uint32_t& tile_y, uint32_t tile_id) const;
@@ -81,6 +109,8 @@ namespace KlayGE
 		void DecodeTiles(std::vector<std::vector<uint8_t>>& data, std::vector<uint32_t> const & tile_ids, uint32_t mipmaps);
 
 		void CacheProperty(uint32_t pages, ElementFormat format, uint32_t border_size, uint32_t cache_tile_size = 0);
+		// 0 leaves a budget unchanged. The tile budget is clamped to the size of the cache texture.
+		void CacheBudgets(uint32_t decoded_blocks, uint32_t cache_tiles);
 
 		TexturePtr const & CacheTex() const;
 		std::vector<TexturePtr> const & CacheTexArray() const;
@@ -88,12 +118,27 @@ namespace KlayGE
 
 		void SetParams(RenderEffect const & effect);
 
+		// Tiles not in the cache are queued for the decoding tasks, and show up in later calls
 		void UpdateCache(std::vector<uint32_t> const & tile_ids);
+		// Blocks until all queued tiles are decoded, then uploads them
+		void WaitForTiles();
+		CacheStatistics CacheStats() const;
 
 	private:
+		struct BuiltTile
+		{
+			uint32_t tile_id;
+			std::vector<std::vector<uint8_t>> mip_data;
+			std::vector<uint32_t> mip_row_pitches;
+		};
+
 		void DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps);
 		uint32_t DecodeAAttr(uint32_t shuff);
-		uint8_t* RetriveATile(uint32_t data_index);
+		std::shared_ptr<std::vector<uint8_t>> RetriveATile(uint32_t data_index);
+
+		void DecodeQueuedTiles(TexCompression* codec);
+		void BuildTiles(std::vector<BuiltTile>& tiles, std::vector<uint32_t> const & tile_ids, TexCompression* codec);
+		void FlushTiles();
 
 		uint32_t NumNonEmptySubNodes(quadtree_node_ptr const & node) const;
 		quadtree_node_ptr const & GetNode(uint32_t shuff);
@@ -169,19 +214,19 @@ namespace KlayGE
 		// Input only
 		ResIdentifierPtr input_file_;
 		uint32_t data_blocks_offset_;
-		LZMACodec lzma_dec_;
+		std::mutex input_file_mutex_;
 		struct DecodedBlockInfo
 		{
 			std::shared_ptr<std::vector<uint8_t>> data;
-			uint64_t tick;
-
-			DecodedBlockInfo(std::shared_ptr<std::vector<uint8_t>> const & d, uint64_t t)
-				: data(d), tick(t)
-			{
-			}
+			std::list<uint32_t>::iterator lru_iter;
 		};
+		// Shared by the decoding tasks. Most recently used first.
+		mutable std::mutex decoded_block_mutex_;
 		std::unordered_map<uint32_t, DecodedBlockInfo> decoded_block_cache_;
-		uint64_t decode_tick_;
+		std::list<uint32_t> decoded_block_lru_;
+		uint32_t decoded_block_budget_;
+		uint64_t num_block_hits_;
+		uint64_t num_block_misses_;
 
 	private:
 		// Cache
@@ -195,12 +240,32 @@ namespace KlayGE
 		struct TileInfo
 		{
 			uint32_t x, y, z;
-			uint32_t attr;
-			uint64_t tick;
+			std::list<uint32_t>::iterator lru_iter;
 		};
 		std::unordered_map<uint32_t, TileInfo> tile_info_map_;
-		std::deque<std::pair<uint32_t, uint32_t>> tile_free_list_;
-		uint64_t tile_tick_;
+		// Most recently used first
+		std::list<uint32_t> tile_lru_;
+		std::vector<uint32_t> tile_free_slots_;
+		uint32_t next_tile_slot_;
+		uint32_t tile_budget_;
+
+		// Request time of every tile queued or being decoded
+		std::unordered_map<uint32_t, double> pending_tiles_;
+		Timer timer_;
+
+		// Shared with the decoding tasks
+		std::mutex tile_queue_mutex_;
+		std::deque<uint32_t> tile_request_queue_;
+		std::vector<BuiltTile> built_tiles_;
+		uint32_t num_running_tasks_;
+		std::vector<task_scheduler::task_handle> pending_tasks_;
+
+		uint64_t num_hits_;
+		uint64_t num_misses_;
+		uint64_t num_evictions_;
+		uint64_t num_latency_samples_;
+		double total_latency_;
+		double max_latency_;
 	};
 }
 
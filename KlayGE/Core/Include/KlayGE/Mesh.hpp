@@ -471,7 +471,8 @@ namespace KlayGE
 		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
 		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_base_indices,
 		std::vector<Joint> const & joints, std::shared_ptr<AnimationActionsType> const & actions,
-		std::shared_ptr<KeyFramesType> const & kfs, uint32_t num_frames, uint32_t frame_rate);
+		std::shared_ptr<KeyFramesType> const & kfs, uint32_t num_frames, uint32_t frame_rate,
+		bool compress_streams = false);
 	KLAYGE_CORE_API void SaveModel(RenderModelPtr const & model, std::string const & meshml_name);
 
 
@@ -36,12 +36,30 @@
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/CXX17/string_view.hpp>
 
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
 struct IInArchive;
 
 namespace KlayGE
 {
 	class KLAYGE_CORE_API Package
 	{
+	public:
+		struct Statistics
+		{
+			uint32_t num_items;
+			// Number of entries in the path index. Folders are not indexed.
+			uint32_t num_indexed_items;
+			// Time spent on reading the central directory and building the index, in seconds
+			double index_build_time;
+
+			uint64_t num_lookups;
+			uint64_t num_hits;
+		};
+
 	public:
 		explicit Package(ResIdentifierPtr const & archive_is);
 		Package(ResIdentifierPtr const & archive_is, std::string_view password);
@@ -54,16 +72,28 @@ namespace KlayGE
 			return archive_is_.get();
 		}
 
+		Statistics Stats() const;
+
 	private:
+		void BuildIndex();
 		uint32_t Find(std::string_view extract_file_path);
 
 	private:
 		ResIdentifierPtr archive_is_;
 
 		std::shared_ptr<IInArchive> archive_;
+		// Several loading threads can extract from the same package
+		std::mutex extract_mutex_;
 		std::string password_;
 
 		uint32_t num_items_;
+
+		// Case-folded path -> item index, 0xFFFFFFFF for items that can't be extracted
+		std::unordered_map<std::string, uint32_t> path_index_;
+		double index_build_time_;
+
+		std::atomic<uint64_t> num_lookups_;
+		std::atomic<uint64_t> num_hits_;
 	};
 }
 
@@ -37,6 +37,7 @@
 #include <KFL/Math.hpp>
 #include <KlayGE/SceneObjectHelper.hpp>
 
+#include <array>
 #include <mutex>
 #include <random>
 #include <vector>
@@ -55,6 +56,24 @@ namespace KlayGE
 		float init_life;
 	};
 
+	// A contiguous range of particles in structure of arrays layout. Each pointer addresses num floats.
+	struct ParticleSpan
+	{
+		float* pos_x;
+		float* pos_y;
+		float* pos_z;
+		float* vel_x;
+		float* vel_y;
+		float* vel_z;
+		float* life;
+		float* spin;
+		float* size;
+		float* alpha;
+		float* init_life;
+
+		uint32_t num;
+	};
+
 	class KLAYGE_CORE_API ParticleEmitter
 	{
 	public:
@@ -216,6 +235,14 @@ namespace KlayGE
 		virtual ParticleUpdaterPtr Clone() = 0;
 
 		virtual void Update(Particle& par, float elapse_time) = 0;
+		// Updates the particles of the span whose life is positive, the others must stay untouched. The default one
+		//  calls the per particle Update on each of them.
+		virtual void Update(ParticleSpan const & span, float elapse_time);
+		// True if the span Update can run on several spans from different threads at the same time
+		virtual bool ParallelUpdate() const
+		{
+			return false;
+		}
 
 	protected:
 		void DoClone(ParticleUpdaterPtr const & rhs);
@@ -290,20 +317,11 @@ namespace KlayGE
 
 		uint32_t NumParticles() const
 		{
-			return static_cast<uint32_t>(particles_.size());
+			return max_num_particles_;
 		}
 		uint32_t NumActiveParticles() const;
 		uint32_t GetActiveParticleIndex(uint32_t i) const;
-		Particle const & GetParticle(uint32_t i) const
-		{
-			BOOST_ASSERT(i < particles_.size());
-			return particles_[i];
-		}
-		Particle& GetParticle(uint32_t i)
-		{
-			BOOST_ASSERT(i < particles_.size());
-			return particles_[i];
-		}
+		Particle GetParticle(uint32_t i) const;
 		void ClearParticles();
 
 		void ParticleAlphaFromTex(std::string const & tex_name);
@@ -330,15 +348,42 @@ namespace KlayGE
 		void SceneDepthTexture(TexturePtr const & depth_tex);
 
 	private:
+		enum ParticleAttrib
+		{
+			PA_PosX = 0,
+			PA_PosY,
+			PA_PosZ,
+			PA_VelX,
+			PA_VelY,
+			PA_VelZ,
+			PA_Life,
+			PA_Spin,
+			PA_Size,
+			PA_Alpha,
+			PA_InitLife,
+
+			PA_NumAttribs
+		};
+
 		void UpdateParticlesNoLock(float elapsed_time, std::vector<std::pair<uint32_t, float>>& active_particles);
 		void UpdateParticleBufferNoLock(std::vector<std::pair<uint32_t, float>> const & active_particles);
 
+		ParticleSpan MakeSpan(uint32_t begin, uint32_t end);
+		void WriteParticle(uint32_t i, Particle const & par);
+
 	protected:
 		std::vector<ParticleEmitterPtr> emitters_;
 		std::vector<ParticleUpdaterPtr> updaters_;
 
-		std::vector<Particle> particles_;
+		uint32_t max_num_particles_;
+		// Particles in structure of arrays layout, padded to a multiple of the SIMD width with dead ones
+		std::array<std::vector<float>, PA_NumAttribs> particle_attribs_;
+		std::vector<uint8_t> particle_alive_;
+		// Indices of dead particles, emitters take them from the back
+		std::vector<uint32_t> free_particles_;
+
 		std::vector<std::pair<uint32_t, float>> actived_particles_;
+		std::vector<std::pair<uint32_t, float>> actived_particles_sort_buff_;
 		mutable std::mutex actived_particles_mutex_;
 
 		float gravity_;
@@ -389,6 +434,7 @@ namespace KlayGE
 		{
 			std::lock_guard<std::mutex> lock(update_mutex_);
 			size_over_life_ = size_over_life;
+			baked_curves_.reset();
 		}
 		std::vector<float2> const & SizeOverLife() const
 		{
@@ -398,6 +444,7 @@ namespace KlayGE
 		{
 			std::lock_guard<std::mutex> lock(update_mutex_);
 			mass_over_life_ = mass_over_life;
+			baked_curves_.reset();
 		}
 		std::vector<float2> const & MassOverLife() const
 		{
@@ -407,6 +454,7 @@ namespace KlayGE
 		{
 			std::lock_guard<std::mutex> lock(update_mutex_);
 			opacity_over_life_ = opacity_over_life;
+			baked_curves_.reset();
 		}
 		std::vector<float2> const & OpacityOverLife() const
 		{
@@ -414,12 +462,31 @@ namespace KlayGE
 		}
 
 		virtual void Update(Particle& par, float elapse_time) override;
+		virtual void Update(ParticleSpan const & span, float elapse_time) override;
+		virtual bool ParallelUpdate() const override
+		{
+			return true;
+		}
+
+	private:
+		// The curves sampled uniformly over the life, so the batch update doesn't walk the polylines per particle
+		struct CurveSample
+		{
+			float size;
+			float inv_mass;
+			float size3_inv_mass;
+			float alpha;
+		};
+
+		std::shared_ptr<std::vector<CurveSample>> BakedCurves();
 
 	private:
 		std::mutex update_mutex_;
 		std::vector<float2> size_over_life_;
 		std::vector<float2> mass_over_life_;
 		std::vector<float2> opacity_over_life_;
+		// Reset by the setters, rebuilt on the next batch update
+		std::shared_ptr<std::vector<CurveSample>> baked_curves_;
 	};
 }
 
@@ -36,9 +36,13 @@
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/Timer.hpp>
 
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <string>
 #include <tuple>
+#include <unordered_map>
+#include <vector>
 
 namespace KlayGE
 {
@@ -66,10 +70,41 @@ namespace KlayGE
 		bool dirty_;
 	};
 
+	struct PerfZoneThreadBuffer;
+	struct PerfZoneThreadBufferOwner;
+
+	// A scoped CPU zone. Unlike PerfRange it nests, knows its thread, and is cheap enough to stay in shipping builds:
+	//  disabled zones cost an atomic load, enabled ones two clock reads and a write to a per-thread ring buffer.
+	//  The name isn't copied, it has to be a string literal.
+	class KLAYGE_CORE_API PerfZone : boost::noncopyable
+	{
+	public:
+		explicit PerfZone(char const * name);
+		~PerfZone();
+
+	private:
+		PerfZoneThreadBuffer* buffer_;
+		char const * name_;
+		uint64_t begin_;
+		uint32_t id_;
+	};
+
+	struct PerfZoneStats
+	{
+		// Per frame totals of a zone's inclusive time in ms, over the recent frames the zone ran in
+		double min_time;
+		double avg_time;
+		double max_time;
+		uint32_t num_frames;
+	};
+
 	class KLAYGE_CORE_API PerfProfiler : boost::noncopyable
 	{
+		friend struct PerfZoneThreadBufferOwner;
+
 	public:
 		PerfProfiler();
+		~PerfProfiler();
 
 		static PerfProfiler& Instance();
 		static void Destroy();
@@ -82,13 +117,57 @@ namespace KlayGE
 
 		void ExportToCSV(std::string const & file_name) const;
 
+		static bool ZonesEnabled()
+		{
+			return zones_enabled_.load(std::memory_order_relaxed);
+		}
+		void EnableZones(bool enable);
+		// Names the calling thread in the exported traces
+		void ThreadName(std::string const & name);
+		// Closes a frame of the zones. Called by RenderEngine::Refresh in every build, a zone counts in the frame it
+		//  ended in.
+		void EndFrame();
+		PerfZoneStats ZoneStats(std::string const & name) const;
+		// The zones still in the ring buffers, as Chrome trace event JSON (chrome://tracing, Perfetto)
+		void ExportToChromeTrace(std::string const & file_name) const;
+
+		PerfZoneThreadBuffer* ThreadZoneBuffer();
+
+	private:
+		struct ZoneHistory
+		{
+			std::vector<double> frame_times;
+			uint32_t num_frames;
+			double this_frame_time;
+			bool in_this_frame;
+		};
+
+		ZoneHistory& ZoneHistoryOf(char const * name);
+		void ReleaseThreadZoneBuffer(std::shared_ptr<PerfZoneThreadBuffer> const & buffer);
+
 	private:
 		static std::unique_ptr<PerfProfiler> perf_profiler_instance_;
+		static std::atomic<bool> zones_enabled_;
 
 		std::vector<std::tuple<int, std::string, PerfRangePtr,
 			std::vector<std::tuple<uint32_t, double, double>>>> perf_ranges_;
 		uint32_t frame_id_;
+
+		mutable std::mutex zone_buffers_mutex_;
+		std::vector<std::shared_ptr<PerfZoneThreadBuffer>> zone_buffers_;
+		// Buffers of exited threads, still in zone_buffers_, handed to the next new threads
+		std::vector<std::shared_ptr<PerfZoneThreadBuffer>> idle_zone_buffers_;
+		uint32_t generation_;
+		uint32_t next_thread_index_;
+		// Guarded by zone_buffers_mutex_, copied to every buffer
+		uint32_t zone_frame_id_;
+
+		// Only touched by EndFrame and ZoneStats on the main thread
+		std::unordered_map<char const *, ZoneHistory*> zone_name_cache_;
+		std::map<std::string, ZoneHistory> zone_histories_;
 	};
 }
 
+#define KLAYGE_PERF_ZONE(name) KlayGE::PerfZone KFL_JOIN(perf_zone_, __LINE__)(name)
+
 #endif			// _KLAYGE_PERFPROFILER_HPP
@@ -58,6 +58,7 @@ namespace KlayGE
 	typedef std::shared_ptr<SceneObjectLightSourceProxy> SceneObjectLightSourceProxyPtr;
 	class SceneObjectCameraProxy;
 	typedef std::shared_ptr<SceneObjectCameraProxy> SceneObjectCameraProxyPtr;
+	class TransformHierarchy;
 
 	class Blitter;
 	typedef std::shared_ptr<Blitter> BlitterPtr;
@@ -74,6 +75,8 @@ namespace KlayGE
 	typedef std::shared_ptr<CameraPathController> CameraPathControllerPtr;
 	class Font;
 	typedef std::shared_ptr<Font> FontPtr;
+	class TextLayout;
+	typedef std::shared_ptr<TextLayout> TextLayoutPtr;
 	class RenderEngine;
 	struct RenderSettings;
 	struct RenderMaterial;
@@ -341,6 +344,7 @@ namespace KlayGE
 	typedef std::shared_ptr<AudioBuffer> AudioBufferPtr;
 	class SoundBuffer;
 	class MusicBuffer;
+	class AudioStreamService;
 	class AudioDataSource;
 	typedef std::shared_ptr<AudioDataSource> AudioDataSourcePtr;
 	class AudioFactory;
@@ -275,7 +275,7 @@ namespace KlayGE
 				if (val_in_cbuff != value)
 				{
 					val_in_cbuff = value;
-					data_.cbuff_desc.cbuff->Dirty(true);
+					data_.cbuff_desc.cbuff->Dirty(data_.cbuff_desc.offset, static_cast<uint32_t>(sizeof(T)));
 				}
 			}
 			else
@@ -413,7 +413,11 @@ namespace KlayGE
 					memcpy(target + i * this->data_.cbuff_desc.stride, &value[i], sizeof(value[i]));
 				}
 
-				this->data_.cbuff_desc.cbuff->Dirty(true);
+				if (!value.empty())
+				{
+					this->data_.cbuff_desc.cbuff->Dirty(this->data_.cbuff_desc.offset,
+						(size_ - 1) * this->data_.cbuff_desc.stride + static_cast<uint32_t>(sizeof(T)));
+				}
 			}
 			else
 			{
@@ -815,6 +819,7 @@ namespace KlayGE
 		void ResolveOverrideTechs(XMLDocument& doc, XMLNode& root);
 
 		void Load(XMLNode const & root, RenderEffect& effect);
+		void CompileShaders(RenderEffect& effect);
 #endif
 
 	private:
@@ -839,9 +844,13 @@ namespace KlayGE
 
 	class KLAYGE_CORE_API RenderTechnique : boost::noncopyable
 	{
+		friend class RenderEffectTemplate;
+
 	public:
 #if KLAYGE_IS_DEV_PLATFORM
 		void Load(RenderEffect& effect, XMLNodePtr const & node, uint32_t tech_index);
+		// After the shaders of the passes are compiled
+		void UpdateShaderStates(RenderEffect const & effect);
 #endif
 
 		bool StreamIn(RenderEffect& effect, ResIdentifierPtr const & res, uint32_t tech_index);
@@ -930,11 +939,18 @@ namespace KlayGE
 
 	class KLAYGE_CORE_API RenderPass : boost::noncopyable
 	{
+		friend class RenderEffectTemplate;
+
 	public:
 #if KLAYGE_IS_DEV_PLATFORM
 		void Load(RenderEffect& effect, XMLNodePtr const & node, uint32_t tech_index, uint32_t pass_index,
 			RenderPass const * inherit_pass);
 		void Load(RenderEffect& effect, uint32_t tech_index, uint32_t pass_index, RenderPass const * inherit_pass);
+
+		// Load only sets up the pass. The shaders are compiled afterwards by RenderEffectTemplate, passes that don't share
+		//  shaders with each other can be compiled concurrently.
+		void CompileShaders(RenderEffect& effect, uint32_t tech_index, uint32_t pass_index);
+		void LinkShaders(RenderEffect& effect);
 #endif
 
 		bool StreamIn(RenderEffect& effect, ResIdentifierPtr const & res, uint32_t tech_index, uint32_t pass_index);
@@ -1005,7 +1021,7 @@ namespace KlayGE
 	{
 	public:
 		RenderEffectConstantBuffer()
-			: dirty_(true)
+			: dirty_(true), dirty_begin_(0), dirty_end_(0)
 		{
 		}
 
@@ -1065,9 +1081,27 @@ namespace KlayGE
 			return r2t.t;
 		}
 
+		// The whole buffer
 		void Dirty(bool dirty)
 		{
 			dirty_ = dirty;
+			dirty_begin_ = 0;
+			dirty_end_ = dirty ? static_cast<uint32_t>(buff_.size()) : 0;
+		}
+		// Only the bytes in [offset, offset + size), Update uploads the span covering all of the dirty ranges
+		void Dirty(uint32_t offset, uint32_t size)
+		{
+			if (dirty_)
+			{
+				dirty_begin_ = std::min(dirty_begin_, offset);
+				dirty_end_ = std::max(dirty_end_, offset + size);
+			}
+			else
+			{
+				dirty_ = true;
+				dirty_begin_ = offset;
+				dirty_end_ = offset + size;
+			}
 		}
 		bool Dirty() const
 		{
@@ -1088,6 +1122,8 @@ namespace KlayGE
 		GraphicsBufferPtr hw_buff_;
 		std::vector<uint8_t> buff_;
 		bool dirty_;
+		uint32_t dirty_begin_;
+		uint32_t dirty_end_;
 	};
 
 	class KLAYGE_CORE_API RenderEffectParameter : boost::noncopyable
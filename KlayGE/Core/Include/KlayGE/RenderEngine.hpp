@@ -113,6 +113,20 @@ namespace KlayGE
 		uint32_t NumVerticesJustRendered();
 		uint32_t NumDrawsJustCalled();
 		uint32_t NumDispatchesJustCalled();
+		uint32_t NumCBufferUpdatesJustCalled();
+		uint64_t NumCBufferBytesJustUploaded();
+		// Bytes of the updated cbuffers left out of the uploads by the dirty ranges
+		uint64_t NumCBufferBytesJustSkipped();
+		void CBufferUpdated(uint32_t uploaded_bytes, uint32_t skipped_bytes);
+
+		// Updates of cbuffers take a new version from a per-frame ring and copy it in on the GPU, instead of writing
+		//  the buffer in place. Only turns on with no-overwrite maps and partial cbuffer updates.
+		void CBufferRingMode(bool ring);
+		bool CBufferRingMode() const
+		{
+			return cbuff_ring_mode_;
+		}
+		TransientBuffer& CBufferRing();
 
 		void CreateRenderWindow(std::string const & name, RenderSettings& settings);
 		void DestroyRenderWindow();
@@ -309,6 +323,12 @@ namespace KlayGE
 		uint32_t num_vertices_just_rendered_;
 		uint32_t num_draws_just_called_;
 		uint32_t num_dispatches_just_called_;
+		uint32_t num_cbuff_updates_just_called_;
+		uint64_t num_cbuff_bytes_just_uploaded_;
+		uint64_t num_cbuff_bytes_just_skipped_;
+
+		bool cbuff_ring_mode_;
+		std::unique_ptr<TransientBuffer> cbuff_ring_;
 
 		RenderDeviceCaps caps_;
 
@@ -34,18 +34,12 @@
 #pragma once
 
 #include <KlayGE/PreDeclare.hpp>
+#include <atomic>
+#include <condition_variable>
 #include <istream>
 #include <vector>
 #include <string>
-#if defined(KLAYGE_COMPILER_CLANGC2)
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter 'x', 'alloc'
-#pragma clang diagnostic ignored "-Wunused-variable" // Ignore unused variable (mpl_assertion_in_line_xxx) in boost
-#endif
-#include <boost/lockfree/spsc_queue.hpp>
-#if defined(KLAYGE_COMPILER_CLANGC2)
-#pragma clang diagnostic pop
-#endif
+#include <unordered_map>
 
 #include <KFL/ResIdentifier.hpp>
 #include <KFL/Thread.hpp>
@@ -64,6 +58,12 @@ namespace KlayGE
 		}
 
 		virtual uint64_t Type() const = 0;
+		// Descs with the same type and name are put in the same bucket of the resource index, and Match()ed there.
+		//  A desc without a name still works, but all of them of that type share one bucket.
+		virtual std::string_view Name() const
+		{
+			return std::string_view();
+		}
 
 		virtual bool StateLess() const = 0;
 
@@ -85,6 +85,23 @@ namespace KlayGE
 
 	class KLAYGE_CORE_API ResLoader : boost::noncopyable
 	{
+	public:
+		struct Statistics
+		{
+			uint32_t num_loading_threads;
+
+			// Requests waiting for a loading thread
+			uint32_t queue_depth;
+			uint64_t num_completed;
+			uint64_t num_cancelled;
+
+			// Average latency of each stage, in seconds. The queue stage is from ASyncQuery to a loading thread
+			//  picking it up, the main thread stage is from the end of sub thread stage to the end of MainThreadStage.
+			double avg_queue_time;
+			double avg_sub_thread_time;
+			double avg_main_thread_time;
+		};
+
 	public:
 		ResLoader();
 		~ResLoader();
@@ -111,6 +128,9 @@ namespace KlayGE
 
 		std::shared_ptr<void> SyncQuery(ResLoadingDescPtr const & res_desc);
 		std::shared_ptr<void> ASyncQuery(ResLoadingDescPtr const & res_desc);
+		// Requests with higher priority are picked up by the loading threads first
+		std::shared_ptr<void> ASyncQuery(ResLoadingDescPtr const & res_desc, float priority);
+		// Also cancels the sub thread stage of the resource, if it hasn't started yet
 		void Unload(std::shared_ptr<void> const & res);
 
 		template <typename T>
@@ -125,6 +145,12 @@ namespace KlayGE
 			return std::static_pointer_cast<T>(this->ASyncQuery(res_desc));
 		}
 
+		template <typename T>
+		std::shared_ptr<T> ASyncQueryT(ResLoadingDescPtr const & res_desc, float priority)
+		{
+			return std::static_pointer_cast<T>(this->ASyncQuery(res_desc, priority));
+		}
+
 		template <typename T>
 		void Unload(std::shared_ptr<T> const & res)
 		{
@@ -133,6 +159,47 @@ namespace KlayGE
 
 		void Update();
 
+		void NumLoadingThreads(uint32_t num);
+		uint32_t NumLoadingThreads() const;
+
+		Statistics Stats() const;
+
+	private:
+		enum LoadingStatus
+		{
+			LS_Loading,
+			LS_Complete,
+			LS_CanBeRemoved,
+			LS_Cancelled
+		};
+
+		typedef std::shared_ptr<std::atomic<LoadingStatus>> LoadingStatusPtr;
+
+		struct LoadingRequest
+		{
+			ResLoadingDescPtr res_desc;
+			LoadingStatusPtr status;
+			float priority;
+			uint64_t seq;
+			double queued_time;
+
+			bool operator<(LoadingRequest const & rhs) const
+			{
+				// Max-heap on priority, FIFO in the same priority
+				return (priority < rhs.priority) || ((priority == rhs.priority) && (seq > rhs.seq));
+			}
+		};
+
+		// Requests of a matching stateful desc get their own LoadingRes sharing the status. A stateless one only
+		//  counts as one more requester.
+		struct LoadingRes
+		{
+			ResLoadingDescPtr res_desc;
+			LoadingStatusPtr status;
+			double complete_time;
+			uint32_t num_requesters;
+		};
+
 	private:
 		std::string RealPath(std::string_view path);
 		std::string RealPath(std::string_view path,
@@ -142,8 +209,12 @@ namespace KlayGE
 
 		void AddLoadedResource(ResLoadingDescPtr const & res_desc, std::shared_ptr<void> const & res);
 		std::shared_ptr<void> FindMatchLoadedResource(ResLoadingDescPtr const & res_desc);
+		LoadingStatusPtr FindMatchLoadingResource(ResLoadingDescPtr const & res_desc, std::shared_ptr<void>& res,
+			bool add_requester);
 		void RemoveUnrefResources();
 
+		void StartLoadingThreads(uint32_t num);
+		void StopLoadingThreads();
 		void LoadingThreadFunc();
 
 #if defined(KLAYGE_PLATFORM_ANDROID)
@@ -157,27 +228,33 @@ namespace KlayGE
 	private:
 		static std::unique_ptr<ResLoader> res_loader_instance_;
 
-		enum LoadingStatus
-		{
-			LS_Loading,
-			LS_Complete,
-			LS_CanBeRemoved
-		};
-
 		std::string exe_path_;
 		std::string local_path_;
 		std::vector<std::tuple<uint64_t, uint32_t, std::string, PackagePtr>> paths_;
 		std::mutex paths_mutex_;
 
+		// Both are keyed by the hash of Type() and Name() of the desc
 		std::mutex loaded_mutex_;
 		std::mutex loading_mutex_;
-		std::vector<std::pair<ResLoadingDescPtr, std::weak_ptr<void>>> loaded_res_;
-		std::vector<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>> loading_res_;
-		boost::lockfree::spsc_queue<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>,
-			boost::lockfree::capacity<1024>> loading_res_queue_;
-
-		std::unique_ptr<joiner<void>> loading_thread_;
-		volatile bool quit_;
+		std::unordered_multimap<size_t, std::pair<ResLoadingDescPtr, std::weak_ptr<void>>> loaded_res_;
+		std::unordered_multimap<size_t, LoadingRes> loading_res_;
+
+		// A binary heap of LoadingRequest
+		mutable std::mutex loading_queue_mutex_;
+		std::condition_variable loading_queue_cond_;
+		std::vector<LoadingRequest> loading_queue_;
+		uint64_t loading_seq_;
+
+		std::vector<std::unique_ptr<joiner<void>>> loading_threads_;
+		bool quit_;
+
+		std::atomic<uint64_t> num_completed_;
+		std::atomic<uint64_t> num_cancelled_;
+		std::atomic<uint64_t> num_main_thread_stages_;
+		// In microseconds
+		std::atomic<uint64_t> total_queue_time_;
+		std::atomic<uint64_t> total_sub_thread_time_;
+		std::atomic<uint64_t> total_main_thread_time_;
 	};
 }
 
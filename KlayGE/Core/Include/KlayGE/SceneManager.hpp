@@ -24,8 +24,11 @@
 #include <KlayGE/PreDeclare.hpp>
 
 #include <KlayGE/Renderable.hpp>
+#include <KlayGE/TransformHierarchy.hpp>
 #include <KFL/Frustum.hpp>
 #include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/TaskScheduler.hpp>
 
 #include <vector>
 #include <unordered_map>
@@ -43,8 +46,24 @@ namespace KlayGE
 
 		void SmallObjectThreshold(float area);
 		void SceneUpdateElapse(float elapse);
+		// Flush culls against the frustum of the camera being rendered, this one is for calling ClipScene directly
+		void CullingFrustum(Frustum const & frustum);
 		virtual void ClipScene();
 
+		// Culls scene_objs_ from an SoA mirror of their world AABBs, several boxes per SIMD iteration across the
+		//  task scheduler. Overrides of AABBVisible() are still called for every box, from several workers at once,
+		//  turn it off if they aren't thread safe.
+		void ParallelCulling(bool parallel);
+		bool ParallelCulling() const;
+		// Runs SubThreadUpdate of different objects on several task scheduler workers. Turn it off if the update
+		//  functions share state that isn't thread safe, such as a script engine.
+		void ParallelSubThreadUpdate(bool parallel);
+		bool ParallelSubThreadUpdate() const;
+
+		// Options of scene plugins, such as LOOSE_MODE of OCTree
+		virtual void GetCustomAttrib(std::string_view name, void* value) const;
+		virtual void SetCustomAttrib(std::string_view name, void* value);
+
 		void AddCamera(CameraPtr const & camera);
 		void DelCamera(CameraPtr const & camera);
 
@@ -59,6 +78,8 @@ namespace KlayGE
 		LightSourcePtr& GetLight(uint32_t index);
 		LightSourcePtr const & GetLight(uint32_t index) const;
 
+		// Called from other threads, adding and deleting are queued until the next frame boundary.
+		//  The Locked versions apply immediately, they are for the main thread only.
 		void AddSceneObject(SceneObjectPtr const & obj);
 		void AddSceneObjectLocked(SceneObjectPtr const & obj);
 		void DelSceneObject(SceneObjectPtr const & obj);
@@ -86,6 +107,11 @@ namespace KlayGE
 		uint32_t NumVerticesRendered() const;
 		uint32_t NumDrawCalls() const;
 		uint32_t NumDispatchCalls() const;
+		// Changes of technique and material between consecutive draws of the render queues in the last frame
+		uint32_t NumTechniqueChanges() const;
+		uint32_t NumMaterialChanges() const;
+		// Seconds the main thread waited for SubThreadUpdate in the last frame
+		float MainThreadStallTime() const;
 
 	protected:
 		void Flush(uint32_t urt);
@@ -99,11 +125,20 @@ namespace KlayGE
 		virtual void DoSuspend() = 0;
 		virtual void DoResume() = 0;
 
-		void UpdateThreadFunc();
+		// SubThreadUpdate runs on the task scheduler from the end of a frame to the start of the next one.
+		//  Sync waits for it, publishes the model matrices it wrote and applies the queued adding and deleting.
+		void KickSubThreadUpdate();
+		void SyncSubThreadUpdate();
 
+		// Recomputes the world transforms of the moved objects and their subtrees in one pass over transforms_,
+		//  before culling reads PosBoundWS
+		void UpdateTransforms();
 		BoundOverlap VisibleTestFromParent(SceneObject* obj, float3 const & view_dir, float3 const & eye_pos,
 			float4x4 const & view_proj);
 
+		void ClipSceneSerial();
+		void ClipSceneParallel();
+
 	protected:
 		std::vector<CameraPtr> cameras_;
 		Frustum const * frustum_;
@@ -119,10 +154,46 @@ namespace KlayGE
 	private:
 		void FlushScene();
 
+		void CullObjects(uint32_t begin, uint32_t end, bool omni_dir, float3 const & view_dir, float3 const & eye_pos,
+			float4x4 const & view_proj);
+		void BuildRenderQueueKeys(Camera const & camera);
+
 	private:
 		uint32_t urt_;
 
-		std::vector<std::pair<RenderTechnique const *, std::vector<Renderable*>>> render_queue_;
+		enum CullingFlag
+		{
+			CF_Visible = 1UL << 0,
+			CF_Cullable = 1UL << 1,
+			CF_Moveable = 1UL << 2,
+			CF_HasParent = 1UL << 3
+		};
+
+		TransformHierarchy transforms_;
+
+		bool parallel_culling_;
+		// Mirrors of scene_objs_, padded to a multiple of the SIMD width
+		std::vector<float> cull_min_x_;
+		std::vector<float> cull_min_y_;
+		std::vector<float> cull_min_z_;
+		std::vector<float> cull_max_x_;
+		std::vector<float> cull_max_y_;
+		std::vector<float> cull_max_z_;
+		std::vector<uint8_t> cull_flags_;
+		std::vector<uint8_t> cull_results_;
+
+		// Draws are sorted by a packed key, from the most significant bits:
+		//  transparency (1), technique rank (13), material (18), front-to-back depth or submission order (32)
+		struct RenderQueueItem
+		{
+			uint64_t key;
+			Renderable* renderable;
+		};
+		std::vector<RenderQueueItem> render_queue_;
+		std::vector<RenderQueueItem> render_queue_sort_buff_;
+		std::vector<RenderTechnique const *> queue_techs_;
+		std::unordered_map<RenderTechnique const *, uint32_t> queue_tech_ranks_;
+		std::unordered_map<RenderMaterial const *, uint32_t> queue_mtl_ids_;
 
 		uint32_t num_objects_rendered_;
 		uint32_t num_renderables_rendered_;
@@ -130,10 +201,29 @@ namespace KlayGE
 		uint32_t num_vertices_rendered_;
 		uint32_t num_draw_calls_;
 		uint32_t num_dispatch_calls_;
-
-		std::mutex update_mutex_;
-		std::unique_ptr<joiner<void>> update_thread_;
-		volatile bool quit_;
+		uint32_t num_tech_changes_;
+		uint32_t num_mtl_changes_;
+		uint32_t frame_tech_changes_;
+		uint32_t frame_mtl_changes_;
+
+		bool parallel_sub_thread_update_;
+		std::vector<SceneObjectPtr> sub_thread_update_objs_;
+		std::vector<SceneObjectPtr> sub_thread_overlay_objs_;
+		std::unique_ptr<task_group> sub_thread_update_group_;
+		Timer sub_thread_update_timer_;
+		double last_sub_thread_update_time_;
+		double next_sub_thread_update_time_;
+		float sub_thread_app_time_;
+		float main_thread_stall_time_;
+
+		std::thread::id main_thread_id_;
+		struct SceneObjectCommand
+		{
+			SceneObjectPtr obj;
+			bool add;
+		};
+		std::mutex scene_obj_cmd_mutex_;
+		std::vector<SceneObjectCommand> scene_obj_cmds_;
 
 		bool deferred_mode_;
 	};
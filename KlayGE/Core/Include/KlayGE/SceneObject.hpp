@@ -54,9 +54,24 @@ namespace KlayGE
 		virtual float4x4 const & AbsModelMatrix() const;
 		virtual AABBox const & PosBoundWS() const;
 		void UpdateAbsModelMatrix();
+
+		// Attached to a transform hierarchy, AbsModelMatrix and PosBoundWS read from its arrays. The model matrix
+		//  itself stays here, subclasses write model_ directly.
+		void AttachTransform(TransformHierarchy* hierarchy);
+		void DetachTransform();
+		// Hands the model matrix and the bound to the hierarchy, whose next Update recomputes the world transform
+		//  if they changed. Detached objects are updated immediately.
+		void QueueAbsModelMatrixUpdate();
+		// Called after the hierarchy recomputed the world transform
+		void OnAbsModelMatrixUpdated();
+
 		void VisibleMark(BoundOverlap vm);
 		BoundOverlap VisibleMark() const;
 
+		// Slot of the object in the spatial structure of the scene manager, owned by the scene manager
+		void SpatialHandle(uint32_t handle);
+		uint32_t SpatialHandle() const;
+
 		virtual void OnAttachRenderable(bool add_to_scene);
 
 		virtual void AddToSceneManager();
@@ -70,6 +85,11 @@ namespace KlayGE
 		virtual void SubThreadUpdate(float app_time, float elapsed_time);
 		virtual bool MainThreadUpdate(float app_time, float elapsed_time);
 
+		// Model matrices set inside RunSubThreadUpdate go to a back buffer, which PublishSubThreadUpdate
+		//  makes current on the main thread
+		void RunSubThreadUpdate(float app_time, float elapsed_time);
+		void PublishSubThreadUpdate();
+
 		uint32_t Attrib() const;
 		bool Visible() const;
 		void Visible(bool vis);
@@ -103,8 +123,13 @@ namespace KlayGE
 		std::vector<VertexElement> instance_format_;
 
 		float4x4 model_;
+		float4x4 sub_thread_model_;
+		bool sub_thread_model_dirty_;
 		float4x4 abs_model_;
 		std::unique_ptr<AABBox> pos_aabb_ws_;
+		TransformHierarchy* transform_hierarchy_;
+		uint32_t transform_handle_;
+		uint32_t spatial_handle_;
 		BoundOverlap visible_mark_;
 
 		std::function<void(SceneObject&, float, float)> sub_thread_update_func_;
@@ -112,6 +112,8 @@ namespace KlayGE
 		virtual void AttachShader(ShaderType type, RenderEffect const & effect,
 			RenderTechnique const & tech, RenderPass const & pass, ShaderObjectPtr const & shared_so) = 0;
 		virtual void LinkShaders(RenderEffect const & effect) = 0;
+		// Whether AttachShader can run on different shader objects of an effect at the same time
+		virtual bool ConcurrentAttachSupport() const;
 		virtual ShaderObjectPtr Clone(RenderEffect const & effect) = 0;
 
 		virtual void Bind() = 0;
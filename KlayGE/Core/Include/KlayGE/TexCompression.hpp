@@ -55,10 +55,29 @@ namespace KlayGE
 	class KLAYGE_CORE_API TexCompression : boost::noncopyable
 	{
 	public:
+		TexCompression()
+			: parallel_(true)
+		{
+		}
 		virtual ~TexCompression()
 		{
 		}
 
+		// A new codec of the same kind. Encoders keep per-block scratch in members, so every band of a parallel
+		//  EncodeMem/DecodeMem runs on its own instance.
+		virtual TexCompressionPtr Clone() const = 0;
+
+		// EncodeMem/DecodeMem split the image into bands of block rows and run them on the task scheduler. The output is
+		//  identical to the serial path.
+		void Parallel(bool parallel)
+		{
+			parallel_ = parallel;
+		}
+		bool Parallel() const
+		{
+			return parallel_;
+		}
+
 		uint32_t BlockWidth() const
 		{
 			return block_width_;
@@ -82,6 +101,9 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) = 0;
 		virtual void DecodeBlock(void* output, void const * input) = 0;
+		// Decodes num_blocks consecutive blocks of a block row straight into the destination, all their texels must be
+		//  inside it. The default one goes through DecodeBlock, the palette based codecs override it with batch decoders.
+		virtual void DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks);
 
 		virtual void EncodeMem(uint32_t width, uint32_t height, 
 			void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
@@ -94,12 +116,23 @@ namespace KlayGE
 		virtual void EncodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex, TexCompressionMethod method);
 		virtual void DecodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex);
 
+	private:
+		void EncodeBlockRows(uint32_t block_row_begin, uint32_t block_row_end, uint32_t width, uint32_t height,
+			void* output, uint32_t out_row_pitch, void const * input, uint32_t in_row_pitch,
+			TexCompressionMethod method);
+		void DecodeBlockRows(uint32_t block_row_begin, uint32_t block_row_end, uint32_t width, uint32_t height,
+			void* output, uint32_t out_row_pitch, void const * input, uint32_t in_row_pitch);
+		bool ParallelizeBlockRows(uint32_t num_block_rows) const;
+
 	protected:
 		uint32_t block_width_;
 		uint32_t block_height_;
 		uint32_t block_depth_;
 		uint32_t block_bytes_;
 		ElementFormat decoded_fmt_;
+
+	private:
+		bool parallel_;
 	};
 
 	class ARGBColor32 : boost::equality_comparable<ARGBColor32>
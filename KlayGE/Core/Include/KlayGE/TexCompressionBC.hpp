@@ -80,10 +80,14 @@ namespace KlayGE
 	public:
 		TexCompressionBC1();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks) override;
 
 		void EncodeBC1Internal(BC1Block& bc1, ARGBColor32 const * argb, bool alpha, TexCompressionMethod method) const;
+		void DecodeBC1Palette(ARGBColor32* clr, BC1Block const & bc1) const;
 
 	private:
 		ARGBColor32 RGB565To888(uint16_t rgb) const;
@@ -98,6 +102,8 @@ namespace KlayGE
 	public:
 		TexCompressionBC2();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
@@ -110,8 +116,13 @@ namespace KlayGE
 	public:
 		TexCompressionBC4();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks) override;
+
+		void DecodeBC4Palette(uint8_t* alpha, BC4Block const & bc4) const;
 	};
 
 	class KLAYGE_CORE_API TexCompressionBC3 : public TexCompression
@@ -119,8 +130,11 @@ namespace KlayGE
 	public:
 		TexCompressionBC3();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks) override;
 
 	private:
 		TexCompressionBC1 bc1_codec_;
@@ -132,8 +146,11 @@ namespace KlayGE
 	public:
 		TexCompressionBC5();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks) override;
 
 	private:
 		TexCompressionBC4 bc4_codec_;
@@ -144,18 +161,23 @@ namespace KlayGE
 	public:
 		TexCompressionBC6U();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
+		void EncodeBC6Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt);
 		void DecodeBC6Internal(void* output, void const * input, bool signed_fmt);
 
 	private:
+		int Quantize(int comp, uint8_t bits_per_comp, bool signed_fmt);
 		int Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt);
 		int FinishUnquantize(int comp, bool signed_fmt);
 
 	private:
 		static uint32_t const BC6_MAX_REGIONS = 2;
 		static uint32_t const BC6_MAX_INDICES = 16;
+		static uint32_t const BC6_MAX_SHAPES = 32;
 
 		static int32_t const BC6_WEIGHT_MAX = 64;
 		static uint32_t const BC6_WEIGHT_SHIFT = 6;
@@ -198,6 +220,15 @@ namespace KlayGE
 		static ModeDescriptor const mode_desc_[][82];
 		static ModeInfo const mode_info_[];
 		static int const mode_to_info_[];
+
+	private:
+		typedef std::array<std::pair<int3, int3>, BC6_MAX_REGIONS> EndPointsType;
+
+		uint64_t QuantizedError(ModeInfo const & info, uint32_t shape, int3 const * pixels,
+			EndPointsType const & q_end_pts, uint8_t* indices, bool signed_fmt);
+		bool FixUpEndPoints(ModeInfo const & info, uint32_t shape, EndPointsType& q_end_pts, uint8_t* indices);
+		void WriteBC6Block(void* output, uint32_t mode_index, uint32_t shape,
+			EndPointsType const & q_end_pts, uint8_t const * indices);
 	};
 
 	class KLAYGE_CORE_API TexCompressionBC6S : public TexCompression
@@ -205,6 +236,8 @@ namespace KlayGE
 	public:
 		TexCompressionBC6S();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
@@ -270,6 +303,8 @@ namespace KlayGE
 	public:
 		TexCompressionBC7();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
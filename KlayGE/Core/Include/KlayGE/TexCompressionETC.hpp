@@ -129,12 +129,18 @@ namespace KlayGE
 	public:
 		TexCompressionETC1();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks) override;
 
 		uint64_t EncodeETC1BlockInternal(ETC1Block& output, ARGBColor32 const * argb, TexCompressionMethod method);
 		void DecodeETCIndividualModeInternal(ARGBColor32* argb, ETC1Block const & etc1) const;
 		void DecodeETCDifferentialModeInternal(ARGBColor32* argb, ETC1Block const & etc1, bool alpha) const;
+		// 8 colors, sub-block * 4 + selector
+		void DecodeETCIndividualModePalette(ARGBColor32* clr, ETC1Block const & etc1) const;
+		void DecodeETCDifferentialModePalette(ARGBColor32* clr, ETC1Block const & etc1, bool alpha) const;
 
 		static int GetModifier(int cw, int selector);
 
@@ -206,12 +212,18 @@ namespace KlayGE
 	public:
 		TexCompressionETC2RGB8();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks) override;
 
 		void DecodeETCTModeInternal(ARGBColor32* argb, ETC2TModeBlock const & etc2, bool alpha);
 		void DecodeETCHModeInternal(ARGBColor32* argb, ETC2HModeBlock const & etc2, bool alpha);
 		void DecodeETCPlanarModeInternal(ARGBColor32* argb, ETC2PlanarModeBlock const & etc2);
+		// 4 colors, indexed by the selector
+		void DecodeETCTModePalette(ARGBColor32* clr, ETC2TModeBlock const & etc2, bool alpha) const;
+		void DecodeETCHModePalette(ARGBColor32* clr, ETC2HModeBlock const & etc2, bool alpha) const;
 
 	private:
 		TexCompressionETC1Ptr etc1_codec_;
@@ -222,8 +234,11 @@ namespace KlayGE
 	public:
 		TexCompressionETC2RGB8A1();
 
+		virtual TexCompressionPtr Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual void DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks) override;
 
 	private:
 		TexCompressionETC1Ptr etc1_codec_;
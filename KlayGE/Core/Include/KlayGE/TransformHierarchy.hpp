@@ -0,0 +1,112 @@
+/**
+* @file TransformHierarchy.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _KLAYGE_TRANSFORMHIERARCHY_HPP
+#define _KLAYGE_TRANSFORMHIERARCHY_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KFL/AlignedAllocator.hpp>
+
+#include <vector>
+
+namespace KlayGE
+{
+	// Local and world matrices and world AABBs of scene objects, in contiguous arrays where parents precede their
+	//  children. Update recomputes the dirty subtrees in one pass with SIMD matrix math.
+	// Nodes are referred to by handles, which stay valid while other nodes are added and deleted. Adding, deleting
+	//  and updating are for the main thread only.
+	class KLAYGE_CORE_API TransformHierarchy : boost::noncopyable
+	{
+	public:
+		static uint32_t const INVALID_HANDLE = 0xFFFFFFFFU;
+
+	public:
+		TransformHierarchy();
+
+		// Nodes are appended, so a parent added before its children keeps them after it
+		uint32_t AddNode(SceneObject* owner, uint32_t parent_handle, float4x4 const & local);
+		// Leaves a tombstone, the next Update compacts the arrays. Children of the node become roots.
+		void DelNode(uint32_t handle);
+		void Clear();
+		uint32_t NumNodes() const;
+
+		// A parent placed after the node moves the subtree of the node behind everything else
+		void Parent(uint32_t handle, uint32_t parent_handle);
+		void LocalMatrix(uint32_t handle, float4x4 const & mat);
+		float4x4 const & LocalMatrix(uint32_t handle) const;
+		// Nodes without a local bound keep their world AABB untouched
+		void LocalBound(uint32_t handle, AABBox const & aabb);
+
+		float4x4 const & WorldMatrix(uint32_t handle) const;
+		AABBox const & WorldBound(uint32_t handle) const;
+
+		// Recomputes one node from the current world matrix of its parent. It stays dirty, so its children
+		//  follow in the next Update.
+		void UpdateNode(uint32_t handle);
+		void Update();
+		// Owners of the nodes recomputed in the last Update, parents first
+		std::vector<SceneObject*> const & UpdatedOwners() const;
+
+	private:
+		void UpdateWorld(uint32_t index);
+		// The node at the new index i is the one at order[i]. Nodes left out are dropped, their children become roots.
+		void Reorder(std::vector<uint32_t> const & order);
+
+	private:
+		enum NodeFlag
+		{
+			NF_Dirty = 1UL << 0,
+			NF_HasBound = 1UL << 1,
+			NF_Deleted = 1UL << 2
+		};
+
+		std::vector<float4x4, aligned_allocator<float4x4, 16>> locals_;
+		std::vector<float4x4, aligned_allocator<float4x4, 16>> worlds_;
+		// Center and half size of the local bounds
+		std::vector<float3> bound_centers_;
+		std::vector<float3> bound_extents_;
+		std::vector<AABBox> world_bounds_;
+		// Indices into the arrays, not handles
+		std::vector<uint32_t> parents_;
+		std::vector<uint8_t> flags_;
+		std::vector<SceneObject*> owners_;
+
+		std::vector<uint32_t> handle_to_index_;
+		std::vector<uint32_t> index_to_handle_;
+		std::vector<uint32_t> free_handles_;
+		uint32_t num_deleted_;
+
+		std::vector<SceneObject*> updated_owners_;
+	};
+}
+
+#endif			// _KLAYGE_TRANSFORMHIERARCHY_HPP
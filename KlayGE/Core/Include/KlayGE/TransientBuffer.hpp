@@ -35,8 +35,10 @@
 
 #include <KlayGE/PreDeclare.hpp>
 
+#include <atomic>
 #include <vector>
 #include <list>
+#include <mutex>
 
 namespace KlayGE
 {
@@ -77,13 +79,23 @@ namespace KlayGE
 			BF_Index
 		};
 
+		enum AllocMode
+		{
+			// First fit from a free list, sub allocs go back to it through Dealloc. Single threaded.
+			AM_FreeList,
+			// A bump pointer going around the buffer, whole frames are recycled in OnPresent and Dealloc does nothing.
+			//  Alloc can be called from several threads at once, but not during EnsureDataReady or OnPresent.
+			AM_Ring
+		};
+
 	public:
-		TransientBuffer(uint32_t size_in_byte, BindFlag bind_flag);
+		TransientBuffer(uint32_t size_in_byte, BindFlag bind_flag, AllocMode alloc_mode = AM_FreeList);
 
 		// Allocate a sub space from transient buffer
 		SubAlloc Alloc(uint32_t size_in_byte, void const * data);
 		// Knowtify transient buffer that this alloc is unused and will be freed at the end of the frame.
 		void Dealloc(SubAlloc const & alloc);
+		// Ring mode uploads the allocs made since the last call here, and could switch to a larger buffer
 		void EnsureDataReady();
 		// Do with retired frames
 		void OnPresent();
@@ -93,11 +105,26 @@ namespace KlayGE
 			return buffer_;
 		}
 
+		// Bytes allocated in the last frame
+		uint32_t BytesPerFrame() const
+		{
+			return bytes_per_frame_;
+		}
+		// Times the ring caught up with the frames still in flight and had to grow the buffer
+		uint32_t NumWrapStalls() const
+		{
+			return num_wrap_stalls_;
+		}
+
 	private:
 		GraphicsBufferPtr DoCreateBuffer(BindFlag bind_flag, uint32_t size_in_byte);
 		// Free the sub alloc and return the space allocated back to transient buffer.
 		void DoFree(SubAlloc const & alloc);
 
+		bool RingTryAlloc(uint32_t size_in_byte, uint32_t& offset);
+		SubAlloc RingAllocSlow(uint32_t size_in_byte, void const * data);
+		void RingUpload();
+
 	private:
 		bool use_no_overwrite_;
 		uint32_t num_pre_frames_;
@@ -110,6 +137,26 @@ namespace KlayGE
 		std::vector<uint8_t> simulate_buffer_;
 		uint32_t valid_min_;
 		uint32_t valid_max_;
+
+		AllocMode alloc_mode_;
+		// Ring positions are byte counts since the creation, the offset in the buffer is position % ring_size_.
+		//  In ring mode simulate_buffer_ always holds the data, EnsureDataReady copies it to buffer_.
+		uint32_t ring_size_;
+		std::atomic<uint64_t> ring_head_;
+		uint64_t ring_tail_;
+		uint64_t ring_uploaded_;
+		// Heads at the end of the last num_pre_frames_ frames
+		std::vector<uint64_t> ring_fences_;
+		uint32_t ring_fence_index_;
+		bool ring_upload_all_;
+		std::atomic<uint32_t> ring_writers_;
+		std::atomic<bool> ring_growing_;
+		std::mutex ring_grow_mutex_;
+
+		uint32_t stats_frame_id_;
+		std::atomic<uint32_t> frame_bytes_;
+		uint32_t bytes_per_frame_;
+		std::atomic<uint32_t> num_wrap_stalls_;
 	};
 }
 
@@ -167,10 +167,18 @@ namespace KlayGE
 			{
 				elements_[i]->Refresh();
 			}
+
+			this->MarkDirty();
 		}
 
 
 		virtual void Render() = 0;
+		// True while the look of the control changes over time without any input, such as a blinking caret.
+		//  The dialog regenerates its geometry every frame while one of its controls is animating.
+		virtual bool Animating() const
+		{
+			return false;
+		}
 
 		virtual bool CanHaveFocus() const
 		{
@@ -212,6 +220,7 @@ namespace KlayGE
 		virtual void SetEnabled(bool bEnabled)
 		{
 			enabled_ = bEnabled;
+			this->MarkDirty();
 		}
 		virtual bool GetEnabled() const
 		{
@@ -220,6 +229,7 @@ namespace KlayGE
 		virtual void SetVisible(bool bVisible)
 		{
 			visible_ = bVisible;
+			this->MarkDirty();
 		}
 		virtual bool GetVisible() const
 		{
@@ -245,12 +255,14 @@ namespace KlayGE
 			x_ = x;
 			y_ = y;
 			this->UpdateRects();
+			this->MarkDirty();
 		}
 		void SetSize(int width, int height)
 		{
 			width_ = width;
 			height_ = height;
 			this->UpdateRects();
+			this->MarkDirty();
 		}
 
 		void SetHotkey(uint8_t hotkey)
@@ -269,6 +281,7 @@ namespace KlayGE
 			{
 				element->FontColor().States[UICS_Normal] = color;
 			}
+			this->MarkDirty();
 		}
 		UIElement* GetElement(uint32_t iElement) const
 		{
@@ -284,6 +297,7 @@ namespace KlayGE
 
 			// Update the data
 			*elements_[iElement] = element;
+			this->MarkDirty();
 		}
 
 		bool GetIsDefault() const
@@ -348,6 +362,9 @@ namespace KlayGE
 			bounding_box_ = IRect(x_, y_, x_ + width_, y_ + height_);
 		}
 
+		// Tells the dialog its cached geometry is out of date. Every setter that changes how the control looks calls it.
+		void MarkDirty();
+
 		int  id_;				// ID number
 		uint32_t type_;			// Control type, set once in constructor
 		uint8_t hotkey_;		// Virtual key code for this control's hotkey
@@ -357,8 +374,12 @@ namespace KlayGE
 		IRect bounding_box_;		// Rectangle defining the active region of the control
 	};
 
+	class UIDialogRenderable;
+
 	class KLAYGE_CORE_API UIManager : boost::noncopyable, public std::enable_shared_from_this<UIManager>
 	{
+		friend class UIDialog;
+
 	public:
 		struct VertexFormat
 		{
@@ -415,6 +436,7 @@ namespace KlayGE
 
 		void Render();
 
+		// Only valid while a dialog regenerates its geometry, they append to the geometry of that dialog
 		void DrawRect(float3 const & pos, float width, float height, Color const * clrs,
 			IRect const & rcTexture, TexturePtr const & texture);
 		void DrawQuad(float3 const & offset, VertexFormat const * vertices, TexturePtr const & texture);
@@ -433,10 +455,20 @@ namespace KlayGE
 			return mouse_on_ui_;
 		}
 
+		// The immutable 2D textures of the dialogs packed into one texture, so a dialog draws in one call
+		TexturePtr const & AtlasTexture() const
+		{
+			return atlas_tex_;
+		}
+
 	private:
 		void Init();
 		void InputHandler(InputEngine const & sender, InputAction const & action);
 
+		void BuildAtlas();
+		void BeginGeometry(UIDialogRenderable& geometry);
+		void EndGeometry();
+
 	private:
 		static std::unique_ptr<UIManager> ui_mgr_instance_;
 
@@ -450,17 +482,11 @@ namespace KlayGE
 
 		std::array<std::vector<IRect >, UICT_Num_Control_Types> elem_texture_rcs_;
 
-		std::map<TexturePtr, RenderablePtr> rects_;
+		TexturePtr atlas_tex_;
+		std::map<Texture const *, float4> atlas_regions_;	// Scale and offset from the texcoords of a texture to the atlas
+		bool atlas_dirty_;
 
-		struct string_cache
-		{
-			Rect rc;
-			float depth;
-			Color clr;
-			std::wstring text;
-			uint32_t align;
-		};
-		std::map<size_t, std::vector<string_cache>> strings_;
+		UIDialogRenderable* cur_geometry_;		// The geometry being regenerated
 
 		bool mouse_on_ui_;
 		bool inited_;
@@ -518,8 +544,19 @@ namespace KlayGE
 
 		void ClearRadioButtonGroup(uint32_t nGroup);
 
+		// Regenerates the geometry only if something changed since the last frame, otherwise draws the cached one
 		void Render();
 
+		void MarkDirty()
+		{
+			dirty_ = true;
+		}
+		bool Dirty() const
+		{
+			return dirty_;
+		}
+		bool Animating() const;
+
 		void RequestFocus(UIControl& control);
 		void ClearFocus();
 
@@ -531,6 +568,7 @@ namespace KlayGE
 		void SetVisible(bool bVisible)
 		{
 			visible_ = bVisible;
+			dirty_ = true;
 		}
 		bool GetMinimized() const
 		{
@@ -539,6 +577,7 @@ namespace KlayGE
 		void SetMinimized(bool bMinimized)
 		{
 			minimized_ = bMinimized;
+			dirty_ = true;
 		}
 		void SetBackgroundColors(Color const & colorAllCorners);
 		void SetBackgroundColors(Color const & colorTopLeft, Color const & colorTopRight,
@@ -546,6 +585,7 @@ namespace KlayGE
 		void EnableCaption(bool bEnable)
 		{
 			show_caption_ = bEnable;
+			dirty_ = true;
 		}
 		bool IsCaptionEnabled() const
 		{
@@ -558,6 +598,7 @@ namespace KlayGE
 		void SetCaptionHeight(int nHeight)
 		{
 			caption_height_ = nHeight;
+			dirty_ = true;
 		}
 		void SetID(std::string const & id)
 		{
@@ -570,6 +611,7 @@ namespace KlayGE
 		void SetCaptionText(std::wstring const & strText)
 		{
 			caption_ = strText;
+			dirty_ = true;
 		}
 		int2 GetLocation() const
 		{
@@ -583,11 +625,13 @@ namespace KlayGE
 			bounding_box_.top() = y;
 			bounding_box_.right() = x + w;
 			bounding_box_.bottom() = y + h;
+			dirty_ = true;
 		}
 		void SetSize(int width, int height)
 		{
 			bounding_box_.right() = bounding_box_.left() + width;
 			bounding_box_.bottom() = bounding_box_.top() + height;
+			dirty_ = true;
 		}
 		int GetWidth() const
 		{
@@ -600,6 +644,7 @@ namespace KlayGE
 		void AlwaysInOpacity(bool opacity)
 		{
 			always_in_opacity_ = opacity;
+			dirty_ = true;
 		}
 		bool AlwaysInOpacity() const
 		{
@@ -653,6 +698,8 @@ namespace KlayGE
 		void MouseWheelHandler(uint32_t buttons, int2 const & pt, int32_t z_delta);
 		void MouseOverHandler(uint32_t buttons, int2 const & pt);
 
+		void BuildGeometry();
+
 	private:
 		bool keyboard_input_;
 		bool mouse_input_;
@@ -691,6 +738,10 @@ namespace KlayGE
 		float depth_base_;
 		float opacity_;
 
+		bool dirty_;
+		std::shared_ptr<UIDialogRenderable> geometry_;
+		SceneObjectHelperPtr geometry_obj_;
+
 		std::map<std::string, int> id_name_;
 		std::map<int, ControlLocation> id_location_;
 	};
@@ -1094,6 +1145,10 @@ namespace KlayGE
 		}
 
 		virtual void Render();
+		virtual bool Animating() const
+		{
+			return arrow_ != CLEAR;
+		}
 		virtual void UpdateRects();
 
 		void SetTrackRange(size_t nStart, size_t nEnd);
@@ -1199,6 +1254,10 @@ namespace KlayGE
 		}
 
 		virtual void    Render();
+		virtual bool    Animating() const
+		{
+			return scroll_bar_.Animating();
+		}
 		virtual void    UpdateRects();
 
 		STYLE GetStyle() const
@@ -1212,6 +1271,7 @@ namespace KlayGE
 		void SetStyle(STYLE style)
 		{
 			style_ = style;
+			this->MarkDirty();
 		}
 		int  GetScrollBarWidth() const
 		{
@@ -1221,11 +1281,13 @@ namespace KlayGE
 		{
 			sb_width_ = width;
 			this->UpdateRects();
+			this->MarkDirty();
 		}
 		void SetBorder(int border, int margin)
 		{
 			border_ = border;
 			margin_ = margin;
+			this->MarkDirty();
 		}
 		int AddItem(std::wstring const & strText);
 		void SetItemData(int nIndex, std::any const & data);
@@ -1314,6 +1376,10 @@ namespace KlayGE
 		virtual void OnHotkey();
 		virtual void OnFocusOut();
 		virtual void Render();
+		virtual bool Animating() const
+		{
+			return scroll_bar_.Animating();
+		}
 
 		virtual void UpdateRects();
 
@@ -1330,6 +1396,7 @@ namespace KlayGE
 		{
 			drop_height_ = nHeight;
 			this->UpdateRects();
+			this->MarkDirty();
 		}
 		int GetScrollBarWidth() const
 		{
@@ -1339,6 +1406,7 @@ namespace KlayGE
 		{
 			sb_width_ = nWidth;
 			this->UpdateRects();
+			this->MarkDirty();
 		}
 
 		std::any const GetSelectedData() const;
@@ -1494,6 +1562,11 @@ namespace KlayGE
 			mouse_drag_ = false;
 		}
 		virtual void Render();
+		// The caret blinks while focused
+		virtual bool Animating() const
+		{
+			return has_focus_;
+		}
 
 		void SetText(std::wstring const & wszText, bool bSelected = false);
 		std::wstring const & GetText() const
@@ -1508,29 +1581,35 @@ namespace KlayGE
 		virtual void SetTextColor(Color const & Color)
 		{
 			text_color_ = Color;	// Text color
+			this->MarkDirty();
 		}
 		void SetSelectedTextColor(Color const & Color)
 		{
 			sel_text_color_ = Color;	// Selected text color
+			this->MarkDirty();
 		}
 		void SetSelectedBackColor(Color const & Color)
 		{
 			sel_bk_color_ = Color;	// Selected background color
+			this->MarkDirty();
 		}
 		void SetCaretColor(Color const & Color)
 		{
 			caret_color_ = Color;	// Caret color
+			this->MarkDirty();
 		}
 		void SetBorderWidth(int nBorder)
 		{
 			// Border of the window
 			border_ = nBorder;
 			this->UpdateRects();
+			this->MarkDirty();
 		}
 		void SetSpacing(int nSpacing)
 		{
 			spacing_ = nSpacing;
 			this->UpdateRects();
+			this->MarkDirty();
 		}
 
 	public:
@@ -37,7 +37,8 @@
 namespace KlayGE
 {
 	AudioEngine::AudioEngine()
-		: sound_vol_(1), music_vol_(1)
+		: stream_service_(MakeUniquePtr<AudioStreamService>()),
+			sound_vol_(1), music_vol_(1)
 	{
 	}
 
@@ -145,4 +146,16 @@ namespace KlayGE
 	{
 		return music_vol_;
 	}
+
+	AudioStreamService& AudioEngine::StreamService()
+	{
+		return *stream_service_;
+	}
+
+	uint32_t AudioEngine::MixOutput(float* output, uint32_t num_frames)
+	{
+		KFL_UNUSED(output);
+		KFL_UNUSED(num_frames);
+		return 0;
+	}
 }
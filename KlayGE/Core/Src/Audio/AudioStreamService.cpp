@@ -0,0 +1,147 @@
+/**
+ * @file AudioStreamService.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/Audio.hpp>
+
+namespace KlayGE
+{
+	AudioStreamService::AudioStreamService()
+		: wakeup_(false), quit_(false), num_passes_(0)
+	{
+	}
+
+	AudioStreamService::~AudioStreamService()
+	{
+		BOOST_ASSERT(streams_.empty());
+
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex_);
+			quit_ = true;
+		}
+		wake_cond_.notify_one();
+
+		if (worker_)
+		{
+			(*worker_)();
+		}
+	}
+
+	void AudioStreamService::Register(MusicBuffer* buffer)
+	{
+		{
+			std::lock_guard<std::mutex> lock(streams_mutex_);
+
+			BOOST_ASSERT(std::find(streams_.begin(), streams_.end(), buffer) == streams_.end());
+			streams_.push_back(buffer);
+
+			// Started on the first stream, engines that never play music don't pay for the thread
+			if (!worker_)
+			{
+				worker_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+					[this] { this->WorkerFunc(); }));
+			}
+		}
+
+		this->Wakeup();
+	}
+
+	void AudioStreamService::Unregister(MusicBuffer* buffer)
+	{
+		// The worker holds streams_mutex_ for a whole pass, so the buffer is no longer in use once the lock is taken
+		std::lock_guard<std::mutex> lock(streams_mutex_);
+
+		auto iter = std::find(streams_.begin(), streams_.end(), buffer);
+		if (iter != streams_.end())
+		{
+			streams_.erase(iter);
+		}
+	}
+
+	void AudioStreamService::Wakeup()
+	{
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex_);
+			wakeup_ = true;
+		}
+		wake_cond_.notify_one();
+	}
+
+	uint32_t AudioStreamService::NumStreams() const
+	{
+		std::lock_guard<std::mutex> lock(streams_mutex_);
+		return static_cast<uint32_t>(streams_.size());
+	}
+
+	void AudioStreamService::WorkerFunc()
+	{
+		uint32_t wait = WAIT_INFINITE;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(wake_mutex_);
+				auto const wakeup_pred = [this] { return quit_ || wakeup_; };
+				if (WAIT_INFINITE == wait)
+				{
+					wake_cond_.wait(lock, wakeup_pred);
+				}
+				else
+				{
+					wake_cond_.wait_for(lock, std::chrono::milliseconds(wait), wakeup_pred);
+				}
+
+				if (quit_)
+				{
+					break;
+				}
+				wakeup_ = false;
+			}
+
+			wait = WAIT_INFINITE;
+			{
+				std::lock_guard<std::mutex> lock(streams_mutex_);
+				for (auto* stream : streams_)
+				{
+					wait = std::min(wait, stream->ServiceStream());
+				}
+			}
+
+			++ num_passes_;
+		}
+	}
+}
@@ -29,19 +29,29 @@
  */
 
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/AudioFactory.hpp>
 #include <KlayGE/AudioDataSource.hpp>
 
+#include <boost/assert.hpp>
+
 #include <KlayGE/Audio.hpp>
 
 namespace KlayGE
 {
 	MusicBuffer::MusicBuffer(AudioDataSourcePtr const & data_source)
-		: AudioBuffer(data_source)
+		: AudioBuffer(data_source),
+			chunk_size_(0), num_chunks_(0),
+			decoded_chunks_(0), acquired_chunks_(0), released_chunks_(0),
+			decode_ended_(false), end_acquired_(false),
+			loop_(false), stream_service_(nullptr)
 	{
 	}
 
 	MusicBuffer::~MusicBuffer()
 	{
+		BOOST_ASSERT(!stream_service_);
 	}
 
 	bool MusicBuffer::IsSound() const
@@ -58,16 +68,174 @@ namespace KlayGE
 
 	void MusicBuffer::Play(bool loop)
 	{
-		this->DoStop();
+		this->StopStreaming();
+		this->RewindStream();
+
+		loop_ = loop;
+
+		// Not registered yet, so the first chunks can be decoded here. The device starts with data.
+		this->DecodeAhead();
 		this->DoPlay(loop);
+
+		stream_service_ = &this->StreamService();
+		stream_service_->Register(this);
 	}
 
 	void MusicBuffer::Stop()
 	{
-		if (this->IsPlaying())
+		this->StopStreaming();
+		this->RewindStream();
+	}
+
+	void MusicBuffer::InitStream(uint32_t buffer_seconds)
+	{
+		uint32_t frame_size;
+		switch (format_)
 		{
-			this->DoStop();
-			data_source_->Reset();
+		case AF_Mono8:
+			frame_size = 1;
+			break;
+
+		case AF_Mono16:
+		case AF_Stereo8:
+			frame_size = 2;
+			break;
+
+		case AF_Stereo16:
+			frame_size = 4;
+			break;
+
+		default:
+			KFL_UNREACHABLE("Invalid audio format");
 		}
+
+		chunk_size_ = std::max(freq_ / BUFFERS_PER_SECOND, 1U) * frame_size;
+		num_chunks_ = (buffer_seconds + 1) * BUFFERS_PER_SECOND;
+
+		stream_data_.resize(static_cast<size_t>(chunk_size_) * num_chunks_);
+		chunk_sizes_.assign(num_chunks_, 0);
+		chunk_end_.assign(num_chunks_, 0);
+	}
+
+	bool MusicBuffer::AcquireChunk(StreamChunk& chunk)
+	{
+		uint64_t const acquired = acquired_chunks_;
+		if (acquired < decoded_chunks_)
+		{
+			uint32_t const index = static_cast<uint32_t>(acquired % num_chunks_);
+			chunk.data = &stream_data_[static_cast<size_t>(index) * chunk_size_];
+			chunk.size = chunk_sizes_[index];
+			chunk.end_of_stream = (chunk_end_[index] != 0);
+			if (chunk.end_of_stream)
+			{
+				end_acquired_ = true;
+			}
+
+			acquired_chunks_ = acquired + 1;
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	void MusicBuffer::ReleaseChunks(uint32_t num)
+	{
+		BOOST_ASSERT(released_chunks_ + num <= acquired_chunks_);
+		released_chunks_ += num;
+	}
+
+	uint32_t MusicBuffer::NumAcquiredChunks() const
+	{
+		return static_cast<uint32_t>(acquired_chunks_ - released_chunks_);
+	}
+
+	bool MusicBuffer::StreamFinished() const
+	{
+		return end_acquired_;
+	}
+
+	AudioStreamService& MusicBuffer::StreamService() const
+	{
+		return Context::Instance().AudioFactoryInstance().AudioEngineInstance().StreamService();
+	}
+
+	uint32_t MusicBuffer::ServiceStream()
+	{
+		this->DecodeAhead();
+		uint32_t const wait = this->DoServiceStream();
+		// Refill what the device just gave back
+		this->DecodeAhead();
+		return wait;
+	}
+
+	void MusicBuffer::DecodeAhead()
+	{
+		BOOST_ASSERT(num_chunks_ > 0);
+
+		while (!decode_ended_ && (decoded_chunks_ - released_chunks_ < num_chunks_))
+		{
+			uint32_t const index = static_cast<uint32_t>(decoded_chunks_ % num_chunks_);
+			uint8_t* dst = &stream_data_[static_cast<size_t>(index) * chunk_size_];
+
+			uint32_t size = 0;
+			bool end = false;
+			bool rewound = false;
+			while (size < chunk_size_)
+			{
+				size_t const read = data_source_->Read(dst + size, chunk_size_ - size);
+				size += static_cast<uint32_t>(read);
+				if (read > 0)
+				{
+					rewound = false;
+				}
+
+				if (size < chunk_size_)
+				{
+					// A short read is the end of the data. Looping streams continue in the same chunk, so there is no gap.
+					//  Nothing read right after a rewind means the source is empty.
+					if (loop_ && !rewound)
+					{
+						data_source_->Reset();
+						rewound = true;
+					}
+					else
+					{
+						end = true;
+						break;
+					}
+				}
+			}
+
+			chunk_sizes_[index] = size;
+			chunk_end_[index] = end;
+			decode_ended_ = end;
+			++ decoded_chunks_;
+		}
+	}
+
+	void MusicBuffer::RewindStream()
+	{
+		BOOST_ASSERT(!stream_service_);
+
+		decoded_chunks_ = 0;
+		acquired_chunks_ = 0;
+		released_chunks_ = 0;
+		decode_ended_ = false;
+		end_acquired_ = false;
+
+		data_source_->Reset();
+	}
+
+	void MusicBuffer::StopStreaming()
+	{
+		if (stream_service_)
+		{
+			stream_service_->Unregister(this);
+			stream_service_ = nullptr;
+		}
+
+		this->DoStop();
 	}
 }
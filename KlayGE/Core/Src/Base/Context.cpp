@@ -37,6 +37,7 @@
 #include <KlayGE/PerfProfiler.hpp>
 #include <KlayGE/UI.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/TaskScheduler.hpp>
 
 #include <fstream>
 #include <mutex>
@@ -135,6 +136,7 @@ namespace KlayGE
 #endif
 
 		gtp_instance_ = MakeUniquePtr<thread_pool>(1, 16);
+		gts_instance_ = MakeUniquePtr<task_scheduler>();
 	}
 
 	Context::~Context()
@@ -159,6 +161,7 @@ namespace KlayGE
 
 		app_ = nullptr;
 
+		gts_instance_.reset();
 		gtp_instance_.reset();
 	}
 
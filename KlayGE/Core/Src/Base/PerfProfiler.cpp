@@ -33,7 +33,12 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/Query.hpp>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <fstream>
+#include <iomanip>
+#include <limits>
 #include <mutex>
 
 #include <KlayGE/PerfProfiler.hpp>
@@ -41,11 +46,119 @@
 namespace
 {
 	std::mutex singleton_mutex;
+
+	// Zones per thread kept for the traces, older ones are overwritten
+	uint32_t const ZONE_BUFFER_CAPACITY = 1UL << 14;
+	// Deeper zones are still recorded, with the deepest tracked zone as their parent
+	uint32_t const MAX_ZONE_DEPTH = 64;
+	uint32_t const ZONE_HISTORY_FRAMES = 128;
+	// Buffers of exited threads kept for reuse, the others are freed
+	size_t const MAX_IDLE_ZONE_BUFFERS = 8;
+
+	std::atomic<uint32_t> profiler_generation(0);
+
+	uint64_t ZoneTicks()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	std::string JsonEscape(char const * str)
+	{
+		std::string ret;
+		for (; *str; ++ str)
+		{
+			if (('"' == *str) || ('\\' == *str))
+			{
+				ret += '\\';
+			}
+			ret += *str;
+		}
+		return ret;
+	}
+}
+
+namespace KlayGE
+{
+	struct PerfZoneRecord
+	{
+		char const * name;
+		uint64_t begin;
+		uint64_t end;
+		uint32_t id;
+		// 0 for the outermost zones of a thread
+		uint32_t parent_id;
+		uint32_t depth;
+		uint32_t frame_id;
+	};
+
+	// Written only by its thread. Readers copy a range without locking, and drop the slots the thread reused meanwhile.
+	struct PerfZoneThreadBuffer
+	{
+		std::vector<PerfZoneRecord> records;
+		std::atomic<uint64_t> head;
+		// A copy of PerfProfiler::zone_frame_id_, so zones never reach into the profiler
+		std::atomic<uint32_t> frame_id;
+
+		// Owned by the thread
+		uint32_t next_id;
+		uint32_t depth;
+		std::array<uint32_t, MAX_ZONE_DEPTH> stack;
+
+		// Owned by PerfProfiler::EndFrame
+		uint64_t read_pos;
+
+		uint32_t thread_index;
+		// Guarded by PerfProfiler::zone_buffers_mutex_
+		std::string name;
+	};
+
+	// Hands the buffer back to its profiler when the thread exits. The records stay readable, and the next new thread
+	//  appends after them instead of allocating another buffer.
+	struct PerfZoneThreadBufferOwner
+	{
+		std::shared_ptr<PerfZoneThreadBuffer> buffer;
+		uint32_t generation = 0;
+
+		~PerfZoneThreadBufferOwner();
+	};
+}
+
+namespace
+{
+	using namespace KlayGE;
+
+	std::vector<PerfZoneRecord> ReadZoneRecords(PerfZoneThreadBuffer const & buffer, uint64_t from, uint64_t& to)
+	{
+		uint64_t const head = buffer.head.load(std::memory_order_acquire);
+		uint64_t const begin = std::max(from, (head > ZONE_BUFFER_CAPACITY) ? head - ZONE_BUFFER_CAPACITY : 0);
+
+		std::vector<PerfZoneRecord> records;
+		records.reserve(static_cast<size_t>(head - begin));
+		for (uint64_t i = begin; i < head; ++ i)
+		{
+			records.push_back(buffer.records[i % ZONE_BUFFER_CAPACITY]);
+		}
+
+		// The thread could have been writing slot new_head while we were copying, everything before new_head + 1 - capacity
+		//  is torn
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t const new_head = buffer.head.load(std::memory_order_relaxed);
+		if (new_head + 1 > begin + ZONE_BUFFER_CAPACITY)
+		{
+			uint64_t const num_torn = std::min<uint64_t>(new_head + 1 - ZONE_BUFFER_CAPACITY - begin, records.size());
+			records.erase(records.begin(), records.begin() + static_cast<size_t>(num_torn));
+		}
+
+		to = head;
+		return records;
+	}
 }
 
 namespace KlayGE
 {
 	std::unique_ptr<PerfProfiler> PerfProfiler::perf_profiler_instance_;
+	std::atomic<bool> PerfProfiler::zones_enabled_(false);
 
 	PerfRange::PerfRange()
 		: cpu_time_(0), gpu_time_(0), dirty_(false)
@@ -107,9 +220,61 @@ namespace KlayGE
 	}
 
 
+	PerfZone::PerfZone(char const * name)
+		: buffer_(nullptr), name_(name), begin_(0), id_(0)
+	{
+		if (PerfProfiler::ZonesEnabled())
+		{
+			buffer_ = PerfProfiler::Instance().ThreadZoneBuffer();
+
+			id_ = ++ buffer_->next_id;
+			if (0 == id_)
+			{
+				id_ = ++ buffer_->next_id;
+			}
+			if (buffer_->depth < MAX_ZONE_DEPTH)
+			{
+				buffer_->stack[buffer_->depth] = id_;
+			}
+			++ buffer_->depth;
+
+			begin_ = ZoneTicks();
+		}
+	}
+
+	PerfZone::~PerfZone()
+	{
+		if (buffer_)
+		{
+			uint64_t const end = ZoneTicks();
+
+			-- buffer_->depth;
+			uint32_t const depth = buffer_->depth;
+
+			uint64_t const head = buffer_->head.load(std::memory_order_relaxed);
+			PerfZoneRecord& record = buffer_->records[head % ZONE_BUFFER_CAPACITY];
+			record.name = name_;
+			record.begin = begin_;
+			record.end = end;
+			record.id = id_;
+			record.parent_id = (depth > 0) ? buffer_->stack[std::min(depth, MAX_ZONE_DEPTH) - 1] : 0;
+			record.depth = depth;
+			record.frame_id = buffer_->frame_id.load(std::memory_order_relaxed);
+			buffer_->head.store(head + 1, std::memory_order_release);
+		}
+	}
+
+
 	PerfProfiler::PerfProfiler()
-		: frame_id_(0)
+		: frame_id_(0),
+			generation_(++ profiler_generation), next_thread_index_(0), zone_frame_id_(0)
 	{
+		zones_enabled_ = Context::Instance().Config().perf_profiler;
+	}
+
+	PerfProfiler::~PerfProfiler()
+	{
+		zones_enabled_ = false;
 	}
 
 	PerfProfiler& PerfProfiler::Instance()
@@ -194,4 +359,229 @@ namespace KlayGE
 			ofs << std::endl;
 		}
 	}
+
+	void PerfProfiler::EnableZones(bool enable)
+	{
+		zones_enabled_ = enable;
+	}
+
+	void PerfProfiler::ThreadName(std::string const & name)
+	{
+		PerfZoneThreadBuffer* buffer = this->ThreadZoneBuffer();
+
+		std::lock_guard<std::mutex> lock(zone_buffers_mutex_);
+		buffer->name = name;
+	}
+
+	PerfZoneThreadBuffer* PerfProfiler::ThreadZoneBuffer()
+	{
+		// Holding a reference keeps the buffer valid if the profiler is destroyed while the thread is still running
+		thread_local PerfZoneThreadBufferOwner tls_owner;
+
+		if (!tls_owner.buffer || (tls_owner.generation != generation_))
+		{
+			std::shared_ptr<PerfZoneThreadBuffer> buffer;
+
+			std::lock_guard<std::mutex> lock(zone_buffers_mutex_);
+			if (idle_zone_buffers_.empty())
+			{
+				buffer = MakeSharedPtr<PerfZoneThreadBuffer>();
+				buffer->records.resize(ZONE_BUFFER_CAPACITY);
+				buffer->head = 0;
+				buffer->next_id = 0;
+				buffer->read_pos = 0;
+				buffer->thread_index = next_thread_index_;
+				++ next_thread_index_;
+				zone_buffers_.push_back(buffer);
+			}
+			else
+			{
+				// Keeps head, read_pos and next_id running, the previous thread's zones are still to be read
+				buffer = idle_zone_buffers_.back();
+				idle_zone_buffers_.pop_back();
+			}
+			buffer->frame_id = zone_frame_id_;
+			buffer->depth = 0;
+			buffer->name = "Thread " + std::to_string(buffer->thread_index);
+
+			tls_owner.buffer = buffer;
+			tls_owner.generation = generation_;
+		}
+
+		return tls_owner.buffer.get();
+	}
+
+	void PerfProfiler::ReleaseThreadZoneBuffer(std::shared_ptr<PerfZoneThreadBuffer> const & buffer)
+	{
+		std::lock_guard<std::mutex> lock(zone_buffers_mutex_);
+		if (idle_zone_buffers_.size() < MAX_IDLE_ZONE_BUFFERS)
+		{
+			idle_zone_buffers_.push_back(buffer);
+		}
+		else
+		{
+			// Its unread zones are dropped with it
+			auto iter = std::find(zone_buffers_.begin(), zone_buffers_.end(), buffer);
+			if (iter != zone_buffers_.end())
+			{
+				zone_buffers_.erase(iter);
+			}
+		}
+	}
+
+	PerfZoneThreadBufferOwner::~PerfZoneThreadBufferOwner()
+	{
+		if (buffer)
+		{
+			// The profiler that handed out the buffer could be gone, or replaced by another one
+			std::lock_guard<std::mutex> lock(singleton_mutex);
+			auto const & profiler = PerfProfiler::perf_profiler_instance_;
+			if (profiler && (profiler->generation_ == generation))
+			{
+				profiler->ReleaseThreadZoneBuffer(buffer);
+			}
+		}
+	}
+
+	PerfProfiler::ZoneHistory& PerfProfiler::ZoneHistoryOf(char const * name)
+	{
+		// The same name can be different literals in different modules, the pointers only cache the lookup by string
+		auto iter = zone_name_cache_.find(name);
+		if (iter == zone_name_cache_.end())
+		{
+			auto history_iter = zone_histories_.find(name);
+			if (history_iter == zone_histories_.end())
+			{
+				ZoneHistory history;
+				history.frame_times.resize(ZONE_HISTORY_FRAMES);
+				history.num_frames = 0;
+				history.this_frame_time = 0;
+				history.in_this_frame = false;
+				history_iter = zone_histories_.emplace(name, std::move(history)).first;
+			}
+			iter = zone_name_cache_.emplace(name, &history_iter->second).first;
+		}
+		return *iter->second;
+	}
+
+	void PerfProfiler::EndFrame()
+	{
+		std::vector<std::shared_ptr<PerfZoneThreadBuffer>> buffers;
+		{
+			std::lock_guard<std::mutex> lock(zone_buffers_mutex_);
+			buffers = zone_buffers_;
+		}
+
+		for (auto const & buffer : buffers)
+		{
+			auto const records = ReadZoneRecords(*buffer, buffer->read_pos, buffer->read_pos);
+			for (auto const & record : records)
+			{
+				ZoneHistory& history = this->ZoneHistoryOf(record.name);
+				history.this_frame_time += (record.end - record.begin) / 1e6;
+				history.in_this_frame = true;
+			}
+		}
+
+		for (auto& history : zone_histories_)
+		{
+			ZoneHistory& h = history.second;
+			if (h.in_this_frame)
+			{
+				h.frame_times[h.num_frames % ZONE_HISTORY_FRAMES] = h.this_frame_time;
+				++ h.num_frames;
+				h.this_frame_time = 0;
+				h.in_this_frame = false;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(zone_buffers_mutex_);
+			++ zone_frame_id_;
+			for (auto const & buffer : zone_buffers_)
+			{
+				buffer->frame_id.store(zone_frame_id_, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	PerfZoneStats PerfProfiler::ZoneStats(std::string const & name) const
+	{
+		PerfZoneStats stats;
+		stats.min_time = 0;
+		stats.avg_time = 0;
+		stats.max_time = 0;
+		stats.num_frames = 0;
+
+		auto iter = zone_histories_.find(name);
+		if (iter != zone_histories_.end())
+		{
+			ZoneHistory const & history = iter->second;
+			stats.num_frames = std::min(history.num_frames, ZONE_HISTORY_FRAMES);
+			if (stats.num_frames > 0)
+			{
+				stats.min_time = history.frame_times[0];
+				stats.max_time = history.frame_times[0];
+				double sum = 0;
+				for (uint32_t i = 0; i < stats.num_frames; ++ i)
+				{
+					double const time = history.frame_times[i];
+					stats.min_time = std::min(stats.min_time, time);
+					stats.max_time = std::max(stats.max_time, time);
+					sum += time;
+				}
+				stats.avg_time = sum / stats.num_frames;
+			}
+		}
+
+		return stats;
+	}
+
+	void PerfProfiler::ExportToChromeTrace(std::string const & file_name) const
+	{
+		std::vector<std::tuple<uint32_t, std::string, std::vector<PerfZoneRecord>>> threads;
+		{
+			std::lock_guard<std::mutex> lock(zone_buffers_mutex_);
+			for (auto const & buffer : zone_buffers_)
+			{
+				uint64_t end;
+				threads.emplace_back(buffer->thread_index, buffer->name, ReadZoneRecords(*buffer, 0, end));
+			}
+		}
+
+		uint64_t base_ticks = std::numeric_limits<uint64_t>::max();
+		for (auto const & thread : threads)
+		{
+			for (auto const & record : std::get<2>(thread))
+			{
+				base_ticks = std::min(base_ticks, record.begin);
+			}
+		}
+
+		std::ofstream ofs(file_name.c_str());
+		ofs << std::fixed << std::setprecision(3);
+		ofs << "{\"traceEvents\":[";
+		bool first = true;
+		for (auto const & thread : threads)
+		{
+			uint32_t const tid = std::get<0>(thread);
+
+			ofs << (first ? "" : ",") << std::endl;
+			first = false;
+			ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid
+				<< ",\"args\":{\"name\":\"" << JsonEscape(std::get<1>(thread).c_str()) << "\"}}";
+
+			for (auto const & record : std::get<2>(thread))
+			{
+				ofs << ',' << std::endl;
+				ofs << "{\"name\":\"" << JsonEscape(record.name) << "\",\"cat\":\"KlayGE\",\"ph\":\"X\""
+					<< ",\"ts\":" << (record.begin - base_ticks) / 1e3
+					<< ",\"dur\":" << (record.end - record.begin) / 1e3
+					<< ",\"pid\":0,\"tid\":" << tid
+					<< ",\"args\":{\"frame\":" << record.frame_id << ",\"id\":" << record.id
+					<< ",\"parent\":" << record.parent_id << ",\"depth\":" << record.depth << "}}";
+			}
+		}
+		ofs << std::endl << "]}" << std::endl;
+	}
 }
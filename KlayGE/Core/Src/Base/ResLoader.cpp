@@ -30,10 +30,13 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/Timer.hpp>
 #include <KFL/Util.hpp>
 #include <KlayGE/Package.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 #include <KFL/CXX17/filesystem.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
@@ -71,6 +74,15 @@ namespace
 {
 	std::mutex singleton_mutex;
 
+	size_t ResIndexKey(KlayGE::ResLoadingDesc const & res_desc)
+	{
+		size_t seed = 0;
+		KlayGE::HashCombine(seed, res_desc.Type());
+		std::string_view const name = res_desc.Name();
+		KlayGE::HashRange(seed, name.begin(), name.end());
+		return seed;
+	}
+
 #ifdef KLAYGE_PLATFORM_ANDROID
 	class AAssetStreamBuf : public KlayGE::MemStreamBuf
 	{
@@ -99,7 +111,9 @@ namespace KlayGE
 	std::unique_ptr<ResLoader> ResLoader::res_loader_instance_;
 
 	ResLoader::ResLoader()
-		: quit_(false)
+		: loading_seq_(0), quit_(false),
+			num_completed_(0), num_cancelled_(0), num_main_thread_stages_(0),
+			total_queue_time_(0), total_sub_thread_time_(0), total_main_thread_time_(0)
 	{
 #if defined KLAYGE_PLATFORM_WINDOWS
 #if defined KLAYGE_PLATFORM_WINDOWS_DESKTOP
@@ -227,14 +241,13 @@ namespace KlayGE
 #endif
 #endif
 
-		loading_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
-			[this] { this->LoadingThreadFunc(); }));
+		// Loading is mostly bounded by IO and decompression, a few threads are enough to keep them busy
+		this->StartLoadingThreads(std::min(std::max(std::thread::hardware_concurrency() / 2, 1U), 4U));
 	}
 
 	ResLoader::~ResLoader()
 	{
-		quit_ = true;
-		(*loading_thread_)();
+		this->StopLoadingThreads();
 	}
 
 	ResLoader& ResLoader::Instance()
@@ -639,7 +652,7 @@ namespace KlayGE
 
 	std::shared_ptr<void> ResLoader::SyncQuery(ResLoadingDescPtr const & res_desc)
 	{
-		this->RemoveUnrefResources();
+		KLAYGE_PERF_ZONE("ResLoader::SyncQuery");
 
 		std::shared_ptr<void> loaded_res = this->FindMatchLoadedResource(res_desc);
 		std::shared_ptr<void> res;
@@ -660,25 +673,8 @@ namespace KlayGE
 		}
 		else
 		{
-			std::shared_ptr<volatile LoadingStatus> async_is_done;
-			bool found = false;
-			{
-				std::lock_guard<std::mutex> lock(loading_mutex_);
-
-				for (auto const & lrq : loading_res_)
-				{
-					if (lrq.first->Match(*res_desc))
-					{
-						res_desc->CopyDataFrom(*lrq.first);
-						res = lrq.first->Resource();
-						async_is_done = lrq.second;
-						found = true;
-						break;
-					}
-				}
-			}
-
-			if (found)
+			LoadingStatusPtr async_is_done = this->FindMatchLoadingResource(res_desc, res, false);
+			if (async_is_done)
 			{
 				*async_is_done = LS_Complete;
 			}
@@ -702,8 +698,11 @@ namespace KlayGE
 
 	std::shared_ptr<void> ResLoader::ASyncQuery(ResLoadingDescPtr const & res_desc)
 	{
-		this->RemoveUnrefResources();
+		return this->ASyncQuery(res_desc, 0);
+	}
 
+	std::shared_ptr<void> ResLoader::ASyncQuery(ResLoadingDescPtr const & res_desc, float priority)
+	{
 		std::shared_ptr<void> res;
 		std::shared_ptr<void> loaded_res = this->FindMatchLoadedResource(res_desc);
 		if (loaded_res)
@@ -723,45 +722,27 @@ namespace KlayGE
 		}
 		else
 		{
-			std::shared_ptr<volatile LoadingStatus> async_is_done;
-			bool found = false;
-			{
-				std::lock_guard<std::mutex> lock(loading_mutex_);
-
-				for (auto const & lrq : loading_res_)
-				{
-					if (lrq.first->Match(*res_desc))
-					{
-						res_desc->CopyDataFrom(*lrq.first);
-						res = lrq.first->Resource();
-						async_is_done = lrq.second;
-						found = true;
-						break;
-					}
-				}
-			}
-
-			if (found)
-			{
-				if (!res_desc->StateLess())
-				{
-					std::lock_guard<std::mutex> lock(loading_mutex_);
-					loading_res_.emplace_back(res_desc, async_is_done);
-				}
-			}
-			else
+			LoadingStatusPtr async_is_done = this->FindMatchLoadingResource(res_desc, res, true);
+			if (!async_is_done)
 			{
 				if (res_desc->HasSubThreadStage())
 				{
 					res = res_desc->CreateResource();
 
-					async_is_done = MakeSharedPtr<LoadingStatus>(LS_Loading);
+					async_is_done = MakeSharedPtr<std::atomic<LoadingStatus>>(LS_Loading);
 
 					{
 						std::lock_guard<std::mutex> lock(loading_mutex_);
-						loading_res_.emplace_back(res_desc, async_is_done);
+						loading_res_.emplace(ResIndexKey(*res_desc), LoadingRes{ res_desc, async_is_done, 0, 1 });
 					}
-					loading_res_queue_.push(std::make_pair(res_desc, async_is_done));
+					{
+						std::lock_guard<std::mutex> lock(loading_queue_mutex_);
+						loading_queue_.push_back(LoadingRequest{ res_desc, async_is_done, priority, loading_seq_,
+							Timer().current_time() });
+						++ loading_seq_;
+						std::push_heap(loading_queue_.begin(), loading_queue_.end());
+					}
+					loading_queue_cond_.notify_one();
 				}
 				else
 				{
@@ -776,61 +757,188 @@ namespace KlayGE
 
 	void ResLoader::Unload(std::shared_ptr<void> const & res)
 	{
-		std::lock_guard<std::mutex> lock(loaded_mutex_);
+		{
+			std::lock_guard<std::mutex> lock(loaded_mutex_);
+
+			for (auto iter = loaded_res_.begin(); iter != loaded_res_.end(); ++ iter)
+			{
+				if (res == iter->second.second.lock())
+				{
+					loaded_res_.erase(iter);
+					break;
+				}
+			}
+		}
 
-		for (auto iter = loaded_res_.begin(); iter != loaded_res_.end(); ++ iter)
 		{
-			if (res == iter->second.lock())
+			std::lock_guard<std::mutex> lock(loading_mutex_);
+
+			// Drops one requester. Every requester of a load shares its status, so the load is only cancelled
+			//  when none of them is left.
+			LoadingRes const * unloaded = nullptr;
+			for (auto& lr : loading_res_)
 			{
-				loaded_res_.erase(iter);
-				break;
+				if ((lr.second.num_requesters > 0) && (LS_Loading == *lr.second.status)
+					&& (res == lr.second.res_desc->Resource()))
+				{
+					-- lr.second.num_requesters;
+					unloaded = &lr.second;
+					break;
+				}
+			}
+
+			if (unloaded)
+			{
+				uint32_t num_requesters = 0;
+				auto range = loading_res_.equal_range(ResIndexKey(*unloaded->res_desc));
+				for (auto iter = range.first; iter != range.second; ++ iter)
+				{
+					if (iter->second.status == unloaded->status)
+					{
+						num_requesters += iter->second.num_requesters;
+					}
+				}
+
+				if (0 == num_requesters)
+				{
+					// A loading thread skips it if it's still in the queue
+					LoadingStatus expected = LS_Loading;
+					unloaded->status->compare_exchange_strong(expected, LS_Cancelled);
+				}
 			}
 		}
 	}
 
+	void ResLoader::NumLoadingThreads(uint32_t num)
+	{
+		num = std::max(num, 1U);
+		if (num != loading_threads_.size())
+		{
+			this->StopLoadingThreads();
+			this->StartLoadingThreads(num);
+		}
+	}
+
+	uint32_t ResLoader::NumLoadingThreads() const
+	{
+		return static_cast<uint32_t>(loading_threads_.size());
+	}
+
+	ResLoader::Statistics ResLoader::Stats() const
+	{
+		Statistics stats;
+		stats.num_loading_threads = this->NumLoadingThreads();
+		{
+			std::lock_guard<std::mutex> lock(loading_queue_mutex_);
+			stats.queue_depth = static_cast<uint32_t>(loading_queue_.size());
+		}
+		stats.num_completed = num_completed_;
+		stats.num_cancelled = num_cancelled_;
+
+		uint64_t const num_main_thread_stages = num_main_thread_stages_;
+		stats.avg_queue_time = (stats.num_completed + stats.num_cancelled > 0)
+			? total_queue_time_ * 1e-6 / (stats.num_completed + stats.num_cancelled) : 0;
+		stats.avg_sub_thread_time = (stats.num_completed > 0) ? total_sub_thread_time_ * 1e-6 / stats.num_completed : 0;
+		stats.avg_main_thread_time = (num_main_thread_stages > 0)
+			? total_main_thread_time_ * 1e-6 / num_main_thread_stages : 0;
+		return stats;
+	}
+
 	void ResLoader::AddLoadedResource(ResLoadingDescPtr const & res_desc, std::shared_ptr<void> const & res)
 	{
+		size_t const key = ResIndexKey(*res_desc);
+
 		std::lock_guard<std::mutex> lock(loaded_mutex_);
 
 		bool found = false;
-		for (auto& c_desc : loaded_res_)
+		auto range = loaded_res_.equal_range(key);
+		for (auto iter = range.first; iter != range.second; ++ iter)
 		{
-			if (c_desc.first == res_desc)
+			if (iter->second.first == res_desc)
 			{
-				c_desc.second = std::weak_ptr<void>(res);
+				iter->second.second = std::weak_ptr<void>(res);
 				found = true;
 				break;
 			}
 		}
 		if (!found)
 		{
-			loaded_res_.emplace_back(res_desc, std::weak_ptr<void>(res));
+			loaded_res_.emplace(key, std::make_pair(res_desc, std::weak_ptr<void>(res)));
 		}
 	}
 
 	std::shared_ptr<void> ResLoader::FindMatchLoadedResource(ResLoadingDescPtr const & res_desc)
 	{
+		size_t const key = ResIndexKey(*res_desc);
+
 		std::lock_guard<std::mutex> lock(loaded_mutex_);
 
 		std::shared_ptr<void> loaded_res;
-		for (auto const & lr : loaded_res_)
+		auto range = loaded_res_.equal_range(key);
+		for (auto iter = range.first; iter != range.second;)
 		{
-			if (lr.first->Match(*res_desc))
+			// Drops the unreferenced resources in the bucket on the way
+			auto res = iter->second.second.lock();
+			if (!res)
 			{
-				loaded_res = lr.second.lock();
-				break;
+				iter = loaded_res_.erase(iter);
+			}
+			else
+			{
+				if (iter->second.first->Match(*res_desc))
+				{
+					loaded_res = res;
+					break;
+				}
+				++ iter;
 			}
 		}
 		return loaded_res;
 	}
 
+	ResLoader::LoadingStatusPtr ResLoader::FindMatchLoadingResource(ResLoadingDescPtr const & res_desc,
+		std::shared_ptr<void>& res, bool add_requester)
+	{
+		size_t const key = ResIndexKey(*res_desc);
+
+		std::lock_guard<std::mutex> lock(loading_mutex_);
+
+		auto range = loading_res_.equal_range(key);
+		for (auto iter = range.first; iter != range.second; ++ iter)
+		{
+			LoadingRes& lr = iter->second;
+			if ((*lr.status != LS_Cancelled) && lr.res_desc->Match(*res_desc))
+			{
+				res_desc->CopyDataFrom(*lr.res_desc);
+				res = lr.res_desc->Resource();
+				LoadingStatusPtr const status = lr.status;
+
+				// Registered under the same lock as the loading thread stamps complete_time, so it's never missed
+				if (add_requester)
+				{
+					if (res_desc->StateLess())
+					{
+						++ lr.num_requesters;
+					}
+					else
+					{
+						loading_res_.emplace(key, LoadingRes{ res_desc, status, lr.complete_time, 1 });
+					}
+				}
+
+				return status;
+			}
+		}
+		return LoadingStatusPtr();
+	}
+
 	void ResLoader::RemoveUnrefResources()
 	{
 		std::lock_guard<std::mutex> lock(loaded_mutex_);
 
 		for (auto iter = loaded_res_.begin(); iter != loaded_res_.end();)
 		{
-			if (iter->second.lock())
+			if (iter->second.second.lock())
 			{
 				++ iter;
 			}
@@ -843,47 +951,66 @@ namespace KlayGE
 
 	void ResLoader::Update()
 	{
-		std::vector<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>> tmp_loading_res;
+		KLAYGE_PERF_ZONE("ResLoader::Update");
+
+		this->RemoveUnrefResources();
+
+		// Copied out, so the main thread stages run without holding loading_mutex_ or pointing into loading_res_
+		std::vector<LoadingRes> complete_res;
 		{
 			std::lock_guard<std::mutex> lock(loading_mutex_);
-			tmp_loading_res = loading_res_;
+			for (auto const & lr : loading_res_)
+			{
+				if (LS_Complete == *lr.second.status)
+				{
+					complete_res.push_back(lr.second);
+				}
+			}
 		}
 
-		for (auto& lrq : tmp_loading_res)
+		for (auto const & lr : complete_res)
 		{
-			if (LS_Complete == *lrq.second)
-			{
-				ResLoadingDescPtr const & res_desc = lrq.first;
+			ResLoadingDescPtr const & res_desc = lr.res_desc;
+
+			Timer timer;
 
-				std::shared_ptr<void> res;
-				std::shared_ptr<void> loaded_res = this->FindMatchLoadedResource(res_desc);
-				if (loaded_res)
+			std::shared_ptr<void> res;
+			std::shared_ptr<void> loaded_res = this->FindMatchLoadedResource(res_desc);
+			if (loaded_res)
+			{
+				if (!res_desc->StateLess())
 				{
-					if (!res_desc->StateLess())
+					res = res_desc->CloneResourceFrom(loaded_res);
+					if (res != loaded_res)
 					{
-						res = res_desc->CloneResourceFrom(loaded_res);
-						if (res != loaded_res)
-						{
-							this->AddLoadedResource(res_desc, res);
-						}
+						this->AddLoadedResource(res_desc, res);
 					}
 				}
-				else
-				{
-					res_desc->MainThreadStage();
-					res = res_desc->Resource();
-					this->AddLoadedResource(res_desc, res);
-				}
+			}
+			else
+			{
+				KLAYGE_PERF_ZONE("ResLoader::MainThreadStage");
 
-				*lrq.second = LS_CanBeRemoved;
+				res_desc->MainThreadStage();
+				res = res_desc->Resource();
+				this->AddLoadedResource(res_desc, res);
 			}
+
+			if (lr.complete_time > 0)
+			{
+				total_main_thread_time_ += static_cast<uint64_t>((timer.current_time() - lr.complete_time) * 1e6);
+				++ num_main_thread_stages_;
+			}
+
+			*lr.status = LS_CanBeRemoved;
 		}
 
 		{
 			std::lock_guard<std::mutex> lock(loading_mutex_);
 			for (auto iter = loading_res_.begin(); iter != loading_res_.end();)
 			{
-				if (LS_CanBeRemoved == *(iter->second))
+				LoadingStatus const status = *iter->second.status;
+				if ((LS_CanBeRemoved == status) || (LS_Cancelled == status))
 				{
 					iter = loading_res_.erase(iter);
 				}
@@ -895,21 +1022,93 @@ namespace KlayGE
 		}
 	}
 
+	void ResLoader::StartLoadingThreads(uint32_t num)
+	{
+		{
+			std::lock_guard<std::mutex> lock(loading_queue_mutex_);
+			quit_ = false;
+		}
+
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			loading_threads_.push_back(MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
+				[this] { this->LoadingThreadFunc(); })));
+		}
+	}
+
+	void ResLoader::StopLoadingThreads()
+	{
+		{
+			std::lock_guard<std::mutex> lock(loading_queue_mutex_);
+			quit_ = true;
+		}
+		loading_queue_cond_.notify_all();
+
+		for (auto& thread : loading_threads_)
+		{
+			(*thread)();
+		}
+		loading_threads_.clear();
+	}
+
 	void ResLoader::LoadingThreadFunc()
 	{
-		while (!quit_)
+		if (PerfProfiler::ZonesEnabled())
 		{
-			std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>> res_pair;
-			while (loading_res_queue_.pop(res_pair))
+			PerfProfiler::Instance().ThreadName("Resource loading");
+		}
+
+		Timer timer;
+		for (;;)
+		{
+			LoadingRequest request;
 			{
-				if (LS_Loading == *res_pair.second)
+				std::unique_lock<std::mutex> lock(loading_queue_mutex_);
+				loading_queue_cond_.wait(lock, [this] { return quit_ || !loading_queue_.empty(); });
+				if (quit_)
 				{
-					res_pair.first->SubThreadStage();
-					*res_pair.second = LS_Complete;
+					break;
 				}
+
+				std::pop_heap(loading_queue_.begin(), loading_queue_.end());
+				request = std::move(loading_queue_.back());
+				loading_queue_.pop_back();
 			}
 
-			Sleep(10);
+			double const start_time = timer.current_time();
+			total_queue_time_ += static_cast<uint64_t>((start_time - request.queued_time) * 1e6);
+
+			LoadingStatus const status = *request.status;
+			if (LS_Loading == status)
+			{
+				{
+					KLAYGE_PERF_ZONE("ResLoader::SubThreadStage");
+					request.res_desc->SubThreadStage();
+				}
+
+				double const complete_time = timer.current_time();
+				total_sub_thread_time_ += static_cast<uint64_t>((complete_time - start_time) * 1e6);
+				++ num_completed_;
+
+				{
+					std::lock_guard<std::mutex> lock(loading_mutex_);
+					auto range = loading_res_.equal_range(ResIndexKey(*request.res_desc));
+					for (auto iter = range.first; iter != range.second; ++ iter)
+					{
+						if (iter->second.status == request.status)
+						{
+							iter->second.complete_time = complete_time;
+						}
+					}
+				}
+
+				LoadingStatus expected = LS_Loading;
+				request.status->compare_exchange_strong(expected, LS_Complete);
+			}
+			else if (LS_Cancelled == status)
+			{
+				++ num_cancelled_;
+			}
 		}
 	}
 
@@ -0,0 +1,259 @@
+/**
+ * @file LZ4Codec.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+
+#include <cstring>
+
+#include <KlayGE/LZ4Codec.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const MIN_MATCH = 4;
+	// The format requires the last 5 bytes to be literals, and the last match to start at least 12 bytes before the end
+	uint32_t const LAST_LITERALS = 5;
+	uint32_t const MF_LIMIT = 12;
+	uint32_t const MAX_DISTANCE = 65535;
+	uint32_t const HASH_LOG = 16;
+
+	uint32_t Read32(uint8_t const * p)
+	{
+		uint32_t ret;
+		std::memcpy(&ret, p, sizeof(ret));
+		return ret;
+	}
+
+	uint32_t Hash(uint32_t seq)
+	{
+		return (seq * 2654435761U) >> (32 - HASH_LOG);
+	}
+
+	void WriteLength(std::vector<uint8_t>& output, uint32_t len)
+	{
+		for (; len >= 255; len -= 255)
+		{
+			output.push_back(255);
+		}
+		output.push_back(static_cast<uint8_t>(len));
+	}
+
+	void WriteSequence(std::vector<uint8_t>& output, uint8_t const * literals, uint32_t num_literals,
+		uint32_t offset, uint32_t match_len)
+	{
+		uint8_t const lit_token = static_cast<uint8_t>(std::min(num_literals, 15U));
+		uint8_t const match_token = (match_len > 0) ? static_cast<uint8_t>(std::min(match_len - MIN_MATCH, 15U)) : 0;
+		output.push_back(static_cast<uint8_t>((lit_token << 4) | match_token));
+		if (num_literals >= 15)
+		{
+			WriteLength(output, num_literals - 15);
+		}
+		output.insert(output.end(), literals, literals + num_literals);
+
+		if (match_len > 0)
+		{
+			output.push_back(static_cast<uint8_t>(offset & 0xFF));
+			output.push_back(static_cast<uint8_t>(offset >> 8));
+			if (match_len - MIN_MATCH >= 15)
+			{
+				WriteLength(output, match_len - MIN_MATCH - 15);
+			}
+		}
+	}
+
+	uint32_t ReadLength(uint8_t const *& p, uint8_t const * end)
+	{
+		uint32_t len = 0;
+		uint8_t s;
+		do
+		{
+			if (p >= end)
+			{
+				TMSG("Corrupted LZ4 block");
+			}
+			s = *p;
+			++ p;
+			len += s;
+		} while (255 == s);
+		return len;
+	}
+}
+
+namespace KlayGE
+{
+	LZ4Codec::LZ4Codec()
+	{
+	}
+
+	LZ4Codec::~LZ4Codec()
+	{
+	}
+
+	void LZ4Codec::Encode(std::vector<uint8_t>& output, void const * input, uint64_t len)
+	{
+		BOOST_ASSERT(len < 0x7FFFFFFF);
+
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		uint32_t const src_len = static_cast<uint32_t>(len);
+
+		output.clear();
+		output.reserve(src_len + src_len / 255 + 16);
+
+		uint32_t anchor = 0;
+		if (src_len > MF_LIMIT)
+		{
+			// Positions + 1, so 0 means empty
+			std::vector<uint32_t> hash_table(1UL << HASH_LOG, 0);
+
+			uint32_t const match_limit = src_len - MF_LIMIT;
+			uint32_t const match_end = src_len - LAST_LITERALS;
+			uint32_t pos = 0;
+			while (pos < match_limit)
+			{
+				uint32_t const seq = Read32(src + pos);
+				uint32_t& entry = hash_table[Hash(seq)];
+				uint32_t const candidate = entry;
+				entry = pos + 1;
+
+				if ((candidate != 0) && (pos - (candidate - 1) <= MAX_DISTANCE) && (Read32(src + candidate - 1) == seq))
+				{
+					uint32_t ref = candidate - 1;
+					uint32_t match_len = MIN_MATCH;
+					while ((pos + match_len < match_end) && (src[ref + match_len] == src[pos + match_len]))
+					{
+						++ match_len;
+					}
+
+					// Extend backward over the pending literals
+					while ((pos > anchor) && (ref > 0) && (src[pos - 1] == src[ref - 1]))
+					{
+						-- pos;
+						-- ref;
+						++ match_len;
+					}
+
+					WriteSequence(output, src + anchor, pos - anchor, pos - ref, match_len);
+
+					pos += match_len;
+					anchor = pos;
+				}
+				else
+				{
+					++ pos;
+				}
+			}
+		}
+
+		WriteSequence(output, src + anchor, src_len - anchor, 0, 0);
+	}
+
+	void LZ4Codec::Decode(std::vector<uint8_t>& output, void const * input, uint64_t len, uint64_t original_len)
+	{
+		output.resize(static_cast<size_t>(original_len));
+		this->Decode(output.data(), input, len, original_len);
+	}
+
+	void LZ4Codec::Decode(void* output, void const * input, uint64_t len, uint64_t original_len)
+	{
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		uint8_t const * const src_end = src + len;
+		uint8_t* const dst_begin = static_cast<uint8_t*>(output);
+		uint8_t* dst = dst_begin;
+		uint8_t* const dst_end = dst_begin + original_len;
+
+		while (src < src_end)
+		{
+			uint8_t const token = *src;
+			++ src;
+
+			uint32_t num_literals = token >> 4;
+			if (15 == num_literals)
+			{
+				num_literals += ReadLength(src, src_end);
+			}
+			if ((num_literals > static_cast<uint64_t>(src_end - src)) || (num_literals > static_cast<uint64_t>(dst_end - dst)))
+			{
+				TMSG("Corrupted LZ4 block");
+			}
+			std::memcpy(dst, src, num_literals);
+			src += num_literals;
+			dst += num_literals;
+
+			if (src >= src_end)
+			{
+				// The last sequence has no match
+				break;
+			}
+
+			if (src_end - src < 2)
+			{
+				TMSG("Corrupted LZ4 block");
+			}
+			uint32_t const offset = src[0] | (src[1] << 8);
+			src += 2;
+
+			uint32_t match_len = (token & 0xF) + MIN_MATCH;
+			if (15 + MIN_MATCH == match_len)
+			{
+				match_len += ReadLength(src, src_end);
+			}
+			if ((0 == offset) || (offset > static_cast<uint64_t>(dst - dst_begin))
+				|| (match_len > static_cast<uint64_t>(dst_end - dst)))
+			{
+				TMSG("Corrupted LZ4 block");
+			}
+
+			// Overlapped copies are legal and repeat the pattern, so copy byte by byte when they overlap
+			uint8_t const * match = dst - offset;
+			if (offset >= match_len)
+			{
+				std::memcpy(dst, match, match_len);
+				dst += match_len;
+			}
+			else
+			{
+				for (uint32_t i = 0; i < match_len; ++ i)
+				{
+					*dst = *match;
+					++ dst;
+					++ match;
+				}
+			}
+		}
+
+		if (dst != dst_end)
+		{
+			TMSG("Corrupted LZ4 block");
+		}
+	}
+}
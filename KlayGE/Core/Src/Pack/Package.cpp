@@ -33,6 +33,7 @@
 #include <KFL/COMPtr.hpp>
 #include <KFL/ErrorHandling.hpp>
 #include <KFL/ResIdentifier.hpp>
+#include <KFL/Timer.hpp>
 #include <KFL/Util.hpp>
 
 #include <CPP/Common/MyWindows.h>
@@ -48,7 +49,7 @@
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-variable" // Ignore unused variable (mpl_assertion_in_line_xxx) in boost
 #endif
-#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 #if defined(KLAYGE_COMPILER_CLANGC2)
 #pragma clang diagnostic pop
 #endif
@@ -157,7 +158,8 @@ namespace KlayGE
 	}
 
 	Package::Package(ResIdentifierPtr const & archive_is, std::string_view password)
-		: archive_is_(archive_is), password_(password)
+		: archive_is_(archive_is), password_(password),
+			index_build_time_(0), num_lookups_(0), num_hits_(0)
 	{
 		BOOST_ASSERT(archive_is);
 
@@ -172,6 +174,8 @@ namespace KlayGE
 		TIFHR(archive_->Open(file.get(), 0, ocb.get()));
 
 		TIFHR(archive_->GetNumberOfItems(&num_items_));
+
+		this->BuildIndex();
 	}
 
 	bool Package::Locate(std::string_view extract_file_path)
@@ -185,6 +189,8 @@ namespace KlayGE
 		uint32_t real_index = this->Find(extract_file_path);
 		if (real_index != 0xFFFFFFFF)
 		{
+			std::lock_guard<std::mutex> lock(extract_mutex_);
+
 			auto decoded_file = MakeSharedPtr<std::stringstream>();
 			auto out_stream = MakeCOMPtr(new OutStream(decoded_file));
 			auto ecb = MakeCOMPtr(new ArchiveExtractCallback(password_, out_stream));
@@ -210,10 +216,23 @@ namespace KlayGE
 		return ResIdentifierPtr();
 	}
 
-	uint32_t Package::Find(std::string_view extract_file_path)
+	Package::Statistics Package::Stats() const
 	{
-		uint32_t real_index = 0xFFFFFFFF;
+		Statistics stats;
+		stats.num_items = num_items_;
+		stats.num_indexed_items = static_cast<uint32_t>(path_index_.size());
+		stats.index_build_time = index_build_time_;
+		stats.num_lookups = num_lookups_;
+		stats.num_hits = num_hits_;
+		return stats;
+	}
 
+	void Package::BuildIndex()
+	{
+		Timer timer;
+
+		path_index_.clear();
+		path_index_.reserve(num_items_);
 		for (uint32_t i = 0; i < num_items_; ++ i)
 		{
 			bool is_folder = true;
@@ -223,37 +242,60 @@ namespace KlayGE
 				std::string file_path;
 				TIFHR(GetArchiveItemPath(archive_, i, file_path));
 				std::replace(file_path.begin(), file_path.end(), '\\', '/');
-				if (!boost::algorithm::ilexicographical_compare(extract_file_path, file_path)
-					&& !boost::algorithm::ilexicographical_compare(file_path, extract_file_path))
-				{
-					real_index = i;
-					break;
-				}
-			}
-		}
-		if (real_index != 0xFFFFFFFF)
-		{
-			PROPVARIANT prop;
-			prop.vt = VT_EMPTY;
-			TIFHR(archive_->GetProperty(real_index, kpidIsAnti, &prop));
-			if ((VT_BOOL == prop.vt) && (VARIANT_FALSE == prop.boolVal))
-			{
-				prop.vt = VT_EMPTY;
-				TIFHR(archive_->GetProperty(real_index, kpidPosition, &prop));
-				if (prop.vt != VT_EMPTY)
+				boost::algorithm::to_lower(file_path);
+
+				// The first item with the path wins, even if it can't be extracted
+				auto iter = path_index_.find(file_path);
+				if (iter == path_index_.end())
 				{
-					if ((prop.vt != VT_UI8) || (prop.uhVal.QuadPart != 0))
+					uint32_t real_index = i;
+
+					PROPVARIANT prop;
+					prop.vt = VT_EMPTY;
+					TIFHR(archive_->GetProperty(i, kpidIsAnti, &prop));
+					if ((VT_BOOL == prop.vt) && (VARIANT_FALSE == prop.boolVal))
+					{
+						prop.vt = VT_EMPTY;
+						TIFHR(archive_->GetProperty(i, kpidPosition, &prop));
+						if (prop.vt != VT_EMPTY)
+						{
+							if ((prop.vt != VT_UI8) || (prop.uhVal.QuadPart != 0))
+							{
+								real_index = 0xFFFFFFFF;
+							}
+						}
+					}
+					else
 					{
 						real_index = 0xFFFFFFFF;
 					}
+
+					path_index_.emplace(std::move(file_path), real_index);
 				}
 			}
-			else
-			{
-				real_index = 0xFFFFFFFF;
-			}
 		}
 
+		index_build_time_ = timer.elapsed();
+	}
+
+	uint32_t Package::Find(std::string_view extract_file_path)
+	{
+		++ num_lookups_;
+
+		std::string folded_path(extract_file_path);
+		boost::algorithm::to_lower(folded_path);
+
+		uint32_t real_index = 0xFFFFFFFF;
+		auto iter = path_index_.find(folded_path);
+		if (iter != path_index_.end())
+		{
+			real_index = iter->second;
+		}
+
+		if (real_index != 0xFFFFFFFF)
+		{
+			++ num_hits_;
+		}
 		return real_index;
 	}
 }
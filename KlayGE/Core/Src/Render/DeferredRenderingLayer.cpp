@@ -1356,6 +1356,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::Update(uint32_t pass)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::Update");
+
 		SceneManager& scene_mgr = Context::Instance().SceneManagerInstance();
 
 		if (0 == pass)
@@ -3910,6 +3912,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::GBufferGenerationDRJob(PerViewport& pvp, PassType pass_type)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::GBufferGeneration");
+
 		auto& rf = Context::Instance().RenderFactoryInstance();
 		auto& re = rf.RenderEngineInstance();
 
@@ -3947,6 +3951,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::GBufferProcessingDRJob(PerViewport const & pvp)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::GBufferProcessing");
+
 		auto& rf = Context::Instance().RenderFactoryInstance();
 		auto& re = rf.RenderEngineInstance();
 
@@ -3959,6 +3965,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::OpaqueGBufferProcessingDRJob(PerViewport const & pvp)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::OpaqueGBufferProcessing");
+
 		if (indirect_lighting_enabled_ && !(pvp.attrib & VPAM_NoGI))
 		{
 			pvp.il_layer->UpdateGBuffer(*pvp.frame_buffer->GetViewport()->camera);
@@ -3995,6 +4003,8 @@ namespace KlayGE
 	uint32_t DeferredRenderingLayer::ShadowMapGenerationDRJob(PerViewport const & pvp, PassType pass_type, int32_t org_no, 
 		int32_t index_in_pass)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::ShadowMapGeneration");
+
 		auto& rf = Context::Instance().RenderFactoryInstance();
 		auto& re = rf.RenderEngineInstance();
 		auto& scene_mgr = Context::Instance().SceneManagerInstance();
@@ -4063,6 +4073,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::IndirectLightingDRJob(PerViewport const & pvp, int32_t org_no)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::IndirectLighting");
+
 		depth_to_esm_pp_->Apply();
 		pvp.il_layer->UpdateRSM(*rsm_fb_->GetViewport()->camera, *lights_[org_no]);
 		return 0;
@@ -4070,6 +4082,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::ShadowingDRJob(PerViewport const & pvp, PassTargetBuffer pass_tb)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::Shadowing");
+
 #ifndef KLAYGE_SHIP
 		shadowing_perfs_[pass_tb]->Begin();
 #else
@@ -4098,6 +4112,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::ShadingDRJob(PerViewport const & pvp, PassType pass_type, int32_t index_in_pass)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::Shading");
+
 		auto const pass_tb = GetPassTargetBuffer(pass_type);
 
 #ifndef KLAYGE_SHIP
@@ -4166,6 +4182,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::ReflectionDRJob(PerViewport const & pvp, PassType pass_type)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::Reflection");
+
 		auto& rf = Context::Instance().RenderFactoryInstance();
 		auto& re = rf.RenderEngineInstance();
 
@@ -4183,6 +4201,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::VDMDRJob(PerViewport const & pvp)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::VDM");
+
 		auto& rf = Context::Instance().RenderFactoryInstance();
 		auto& re = rf.RenderEngineInstance();
 
@@ -4206,6 +4226,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::SpecialShadingDRJob(PerViewport& pvp, PassType pass_type)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::SpecialShading");
+
 		auto& rf = Context::Instance().RenderFactoryInstance();
 		auto& re = rf.RenderEngineInstance();
 
@@ -4230,12 +4252,16 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::MergeShadingAndDepthDRJob(PerViewport& pvp, PassTargetBuffer pass_tb)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::MergeShadingAndDepth");
+
 		this->MergeShadingAndDepth(pvp, pass_tb);
 		return 0;
 	}
 
 	uint32_t DeferredRenderingLayer::PostEffectsDRJob(PerViewport& pvp)
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::PostEffects");
+
 		if (has_sss_objs_ && sss_enabled_)
 		{
 #ifndef KLAYGE_SHIP
@@ -4295,6 +4321,8 @@ namespace KlayGE
 
 	uint32_t DeferredRenderingLayer::SimpleForwardDRJob()
 	{
+		KLAYGE_PERF_ZONE("DeferredRenderingLayer::SimpleForward");
+
 		for (auto const & deo : visible_scene_objs_)
 		{
 			if (deo->SimpleForward())
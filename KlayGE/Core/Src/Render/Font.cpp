@@ -44,16 +44,19 @@
 #include <KlayGE/ResLoader.hpp>
 #include <KlayGE/SceneObjectHelper.hpp>
 #include <KlayGE/LZMACodec.hpp>
-#include <KlayGE/TransientBuffer.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/TaskScheduler.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/Window.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <list>
+#include <mutex>
 #include <unordered_map>
 #include <tuple>
 #include <type_traits>
@@ -65,38 +68,47 @@
 
 namespace KlayGE
 {
-	class FontRenderable : public RenderableHelper
+	// Glyph cache of a font. The distance texture array, the effect and the glyph quad are shared by all the text layouts
+	//  of it. Missing glyphs are decoded on the task scheduler, a layout leaves them blank until Flush uploads them.
+	class FontRenderable
 	{
+	public:
+		struct CharInfo
+		{
+			Rect rc;
+			uint32_t page;
+			uint32_t slot;
+			// Identifies the decoding request, a result for an evicted and reused entry is dropped
+			uint32_t serial;
+			bool ready;
+			std::list<wchar_t>::iterator lru_iter;
+		};
+
 	public:
 		explicit FontRenderable(std::shared_ptr<KFont> const & kfl)
-				: RenderableHelper(L"Font"),
-					three_dim_(false),
-					kfont_loader_(kfl),
-					tick_(0)
+				: kfont_loader_(kfl),
+					decoded_(MakeSharedPtr<DecodedGlyphs>()),
+					next_serial_(0), generation_(0), arrivals_(0),
+					num_hits_(0), num_misses_(0), num_evictions_(0)
 		{
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
-			restart_ = rf.RenderEngineInstance().DeviceCaps().primitive_restart_support;
-
-			rl_ = rf.MakeRenderLayout();
-			if (restart_)
-			{
-				rl_->TopologyType(RenderLayout::TT_TriangleStrip);
-			}
-			else
-			{
-				rl_->TopologyType(RenderLayout::TT_TriangleList);
-			}
-
 			uint32_t const kfont_char_size = kfont_loader_->CharSize();
 
 			RenderEngine const & renderEngine = rf.RenderEngineInstance();
 			RenderDeviceCaps const & caps = renderEngine.DeviceCaps();
 			uint32_t size = std::min<uint32_t>(2048U, std::min<uint32_t>(caps.max_texture_width, caps.max_texture_height)) / kfont_char_size * kfont_char_size;
-			dist_texture_ = rf.MakeTexture2D(size, size, 1, 1, EF_R8, 1, 0, EAH_GPU_Read);
-			a_char_data_.resize(kfont_char_size * kfont_char_size);
-
-			char_free_list_.emplace_back(0, size * size / kfont_char_size / kfont_char_size);
+			uint32_t const num_pages = std::max<uint32_t>(1, std::min<uint32_t>(MAX_NUM_PAGES, caps.max_texture_array_length));
+			dist_texture_ = rf.MakeTexture2D(size, size, 1, num_pages, EF_R8, 1, 0, EAH_GPU_Read);
+
+			num_chars_a_row_ = size / kfont_char_size;
+			slots_per_page_ = num_chars_a_row_ * num_chars_a_row_;
+			num_slots_ = slots_per_page_ * num_pages;
+			free_slots_.resize(num_slots_);
+			for (uint32_t i = 0; i < num_slots_; ++ i)
+			{
+				free_slots_[i] = num_slots_ - 1 - i;
+			}
 
 			effect_ = SyncLoadRenderEffect("Font.fxml");
 			*(effect_->ParameterByName("distance_tex")) = dist_texture_;
@@ -106,104 +118,87 @@ namespace KlayGE
 			dpi_scale_ep_ = effect_->ParameterByName("dpi_scale");
 			mvp_ep_ = effect_->ParameterByName("mvp");
 
-			uint32_t const INDEX_PER_CHAR = restart_ ? 5 : 6;
-			uint32_t const INIT_NUM_CHAR = 1024;
-			tb_vb_ = MakeUniquePtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_CHAR * 4 * sizeof(FontVert)), TransientBuffer::BF_Vertex);
-			tb_ib_ = MakeUniquePtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_CHAR * INDEX_PER_CHAR * sizeof(uint16_t)), TransientBuffer::BF_Index);
-
-			rl_->BindVertexStream(tb_vb_->GetBuffer(), { VertexElement(VEU_Position, 0, EF_BGR32F),
-				VertexElement(VEU_Diffuse, 0, EF_ABGR8), VertexElement(VEU_TextureCoord, 0, EF_GR32F) });
-			rl_->BindIndexStream(tb_ib_->GetBuffer(), EF_R16UI);
-
-			pos_aabb_ = AABBox(float3(0, 0, 0), float3(0, 0, 0));
-			tc_aabb_ = AABBox(float3(0, 0, 0), float3(0, 0, 0));
-		}
-
-		RenderTechnique* GetRenderTechnique() const override
-		{
-			if (three_dim_)
+			float2 const corners[] =
 			{
-				return effect_->TechniqueByName("Font3DTec");
-			}
-			else
+				float2(0, 0),
+				float2(1, 0),
+				float2(0, 1),
+				float2(1, 1)
+			};
+			uint16_t const indices[] =
 			{
-				return effect_->TechniqueByName("Font2DTec");
-			}
+				0, 1, 2, 3
+			};
+			corner_vb_ = rf.MakeVertexBuffer(BU_Static, EAH_GPU_Read | EAH_Immutable, sizeof(corners), corners);
+			corner_ib_ = rf.MakeIndexBuffer(BU_Static, EAH_GPU_Read | EAH_Immutable, sizeof(indices), indices);
 		}
 
-		void OnRenderBegin()
+		RenderEffectPtr const & Effect() const
 		{
-			if (!three_dim_)
-			{
-				RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
-				float const half_width = re.CurFrameBuffer()->Width() / 2.0f;
-				float const half_height = re.CurFrameBuffer()->Height() / 2.0f;
-
-				*half_width_height_ep_ = float2(half_width, half_height);
-				*dpi_scale_ep_ = Context::Instance().AppInstance().MainWnd()->DPIScale();
-			}
-
-			tb_vb_->EnsureDataReady();
-			tb_ib_->EnsureDataReady();
-
-			rl_->SetVertexStream(0, tb_vb_->GetBuffer());
-			rl_->BindIndexStream(tb_ib_->GetBuffer(), EF_R16UI);
+			return effect_;
 		}
 
-		void OnRenderEnd()
+		GraphicsBufferPtr const & CornerVB() const
 		{
-			pos_aabb_ = AABBox(float3(0, 0, 0), float3(0, 0, 0));
-
-			tb_vb_sub_allocs_.clear();
-			tb_ib_sub_allocs_.clear();
+			return corner_vb_;
+		}
+		GraphicsBufferPtr const & CornerIB() const
+		{
+			return corner_ib_;
+		}
 
-			tb_vb_->OnPresent();
-			tb_ib_->OnPresent();
+		KFont const & Loader() const
+		{
+			return *kfont_loader_;
 		}
 
-		void Render()
+		// Changes every time a glyph is evicted from the cache, the texcoords of laid out text are stale after that
+		uint64_t Generation() const
 		{
-			RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+			return generation_;
+		}
 
-			this->OnRenderBegin();
+		// Changes every time decoded glyphs are uploaded, layouts with blank glyphs need to be redone
+		uint64_t Arrivals() const
+		{
+			return arrivals_;
+		}
 
-			BOOST_ASSERT(tb_vb_sub_allocs_.size() == tb_ib_sub_allocs_.size());
+		// The entry stays at the same address until the glyph is evicted
+		CharInfo* Glyph(wchar_t ch)
+		{
+			auto iter = char_info_map_.find(ch);
+			return (iter != char_info_map_.end()) ? &iter->second : nullptr;
+		}
 
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
+		// Marks the glyphs of a laid out text as the most recently used, without looking each character up again
+		void Touch(std::vector<CharInfo*> const & glyphs)
+		{
+			for (auto glyph : glyphs)
 			{
-				uint32_t vert_length = tb_vb_sub_allocs_[i].length_;
-				uint32_t const ind_offset = tb_ib_sub_allocs_[i].offset_;
-				uint32_t ind_length = tb_ib_sub_allocs_[i].length_;
-
-				while ((i + 1 < tb_vb_sub_allocs_.size())
-					&& (tb_vb_sub_allocs_[i].offset_ + tb_vb_sub_allocs_[i].length_ == tb_vb_sub_allocs_[i + 1].offset_)
-					&& (tb_ib_sub_allocs_[i].offset_ + tb_ib_sub_allocs_[i].length_ == tb_ib_sub_allocs_[i + 1].offset_))
-				{
-					vert_length += tb_vb_sub_allocs_[i + 1].length_;
-					ind_length += tb_ib_sub_allocs_[i + 1].length_;
-					++ i;
-				}
-
-				rl_->NumVertices(vert_length / sizeof(FontVert));
-				rl_->StartIndexLocation(ind_offset / sizeof(uint16_t));
-				rl_->NumIndices(ind_length / sizeof(uint16_t));
-
-				re.Render(*this->GetRenderEffect(), *this->GetRenderTechnique(), *rl_);
+				lru_.splice(lru_.begin(), lru_, glyph->lru_iter);
 			}
+		}
 
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
+		void BindParams(bool three_dim, float4x4 const & mvp)
+		{
+			if (three_dim)
 			{
-				tb_vb_->Dealloc(tb_vb_sub_allocs_[i]);
-				tb_ib_->Dealloc(tb_ib_sub_allocs_[i]);
+				*mvp_ep_ = mvp;
 			}
+			else
+			{
+				RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+				float const half_width = re.CurFrameBuffer()->Width() / 2.0f;
+				float const half_height = re.CurFrameBuffer()->Height() / 2.0f;
 
-			this->OnRenderEnd();
+				*half_width_height_ep_ = float2(half_width, half_height);
+				*dpi_scale_ep_ = Context::Instance().AppInstance().MainWnd()->DPIScale();
+			}
 		}
 
 		Size_T<float> CalcSize(std::wstring_view text, float font_size)
 		{
-			this->UpdateTexture(text);
-
 			KFont& kl = *kfont_loader_;
 
 			float const rel_size = font_size / kl.CharSize();
@@ -227,491 +222,576 @@ namespace KlayGE
 				font_size * lines.size());
 		}
 
-		void AddText2D(float sx, float sy, float sz,
-			float xScale, float yScale, Color const & clr, std::wstring_view text, float font_size)
+		// Requests the glyphs of text. Cached ones become the most recently used, missing ones take a slot, evicting the
+		//  least recently used glyph if the cache is full, and start decoding.
+		void UpdateTexture(std::wstring_view text)
 		{
-			three_dim_ = false;
-
-			this->AddText(sx, sy, sz, xScale, yScale, clr, text, font_size);
-		}
+			KFont const & kl = *kfont_loader_;
+			auto& cim = char_info_map_;
 
-		void AddText2D(Rect const & rc, float sz,
-			float xScale, float yScale, Color const & clr, std::wstring_view text, float font_size, uint32_t align)
-		{
-			three_dim_ = false;
+			uint32_t const kfont_char_size = kl.CharSize();
+			float const tex_size = static_cast<float>(dist_texture_->Width(0));
 
-			this->AddText(rc, sz, xScale, yScale, clr, text, font_size, align);
-		}
+			for (auto const & ch : text)
+			{
+				int32_t const offset = kl.CharIndex(ch);
+				if (offset != -1)
+				{
+					auto cmiter = cim.find(ch);
+					if (cmiter != cim.end())
+					{
+						++ num_hits_;
+						lru_.splice(lru_.begin(), lru_, cmiter->second.lru_iter);
+					}
+					else
+					{
+						++ num_misses_;
 
-		void AddText3D(float4x4 const & mvp, Color const & clr, std::wstring_view text, float font_size)
-		{
-			three_dim_ = true;
-			*mvp_ep_ = mvp;
+						if (free_slots_.empty())
+						{
+							auto evict_iter = cim.find(lru_.back());
+							free_slots_.push_back(evict_iter->second.slot);
+							cim.erase(evict_iter);
+							lru_.pop_back();
 
-			this->AddText(0, 0, 0, 1, 1, clr, text, font_size);
-		}
+							++ num_evictions_;
+							++ generation_;
+						}
 
-	private:
-		void AddText(Rect const & rc, float sz,
-			float xScale, float yScale, Color const & clr, std::wstring_view text, float font_size, uint32_t align)
-		{
-			this->UpdateTexture(text);
+						CharInfo char_info;
+						char_info.slot = free_slots_.back();
+						free_slots_.pop_back();
+						char_info.page = char_info.slot / slots_per_page_;
+						uint32_t const in_page = char_info.slot - char_info.page * slots_per_page_;
+						uint32_t const y = in_page / num_chars_a_row_;
+						uint32_t const x = in_page - y * num_chars_a_row_;
 
-			KFont const & kl = *kfont_loader_;
-			auto const & cim = char_info_map_;
+						KFont::font_info const & ci = kl.CharInfo(offset);
+						char_info.rc.left() = x * kfont_char_size / tex_size;
+						char_info.rc.top() = y * kfont_char_size / tex_size;
+						char_info.rc.right() = char_info.rc.left() + ci.width / tex_size;
+						char_info.rc.bottom() = char_info.rc.top() + ci.height / tex_size;
+						char_info.serial = ++ next_serial_;
+						char_info.ready = false;
 
-			std::vector<FontVert> vertices;
-			std::vector<uint16_t> indices;
+						lru_.push_front(ch);
+						char_info.lru_iter = lru_.begin();
 
-			float const h = font_size * yScale;
-			float const rel_size = font_size / kl.CharSize();
-			float const rel_size_x = rel_size * xScale;
-			float const rel_size_y = rel_size * yScale;
+						// The compressed data may come from the font file, it's read here. Only the LZMA decoding runs on a worker.
+						uint32_t lzma_size;
+						kl.GetLZMADistanceData(nullptr, lzma_size, offset);
+						std::vector<uint8_t> lzma_data(lzma_size);
+						kl.GetLZMADistanceData(lzma_data.data(), lzma_size, offset);
 
-			std::vector<std::pair<float, std::wstring>> lines(1, std::make_pair(0.0f, L""));
+						this->Decode(ch, char_info.serial, std::move(lzma_data));
 
-			for (auto const & ch : text)
-			{
-				if (ch != L'\n')
-				{
-					uint32_t advance = kl.CharAdvance(ch);
-					lines.back().first += (advance & 0xFFFF) * rel_size * xScale;
-					lines.back().second.push_back(ch);
-				}
-				else
-				{
-					lines.emplace_back(0.0f, L"");
+						cim.emplace(ch, char_info);
+					}
 				}
 			}
+		}
 
-			std::vector<float> sx;
-			sx.reserve(lines.size());
-			std::vector<float> sy;
-			sy.reserve(lines.size());
+		// Uploads the glyphs decoded since the last call
+		void Flush()
+		{
+			if (0 == decoded_->num_glyphs)
+			{
+				return;
+			}
 
-			if (align & Font::FA_Hor_Left)
+			std::vector<DecodedGlyph> glyphs;
 			{
-				sx.resize(lines.size(), rc.left());
+				std::lock_guard<std::mutex> lock(decoded_->mutex);
+				glyphs.swap(decoded_->glyphs);
+				decoded_->num_glyphs = 0;
 			}
-			else
+
+			uint32_t const kfont_char_size = kfont_loader_->CharSize();
+			for (auto const & glyph : glyphs)
 			{
-				if (align & Font::FA_Hor_Right)
-				{
-					for (auto const & p : lines)
-					{
-						sx.push_back(rc.right() - p.first);
-					}
-				}
-				else
+				auto cmiter = char_info_map_.find(glyph.ch);
+				if ((cmiter != char_info_map_.end()) && (cmiter->second.serial == glyph.serial))
 				{
-					// Font::FA_Hor_Center
-					for (auto const & p : lines)
-					{
-						sx.push_back((rc.left() + rc.right()) / 2 - p.first / 2);
-					}
+					CharInfo& char_info = cmiter->second;
+					uint32_t const in_page = char_info.slot - char_info.page * slots_per_page_;
+					uint32_t const y = in_page / num_chars_a_row_;
+					uint32_t const x = in_page - y * num_chars_a_row_;
+					dist_texture_->UpdateSubresource2D(char_info.page, 0, x * kfont_char_size, y * kfont_char_size,
+						kfont_char_size, kfont_char_size, glyph.data.data(), kfont_char_size);
+
+					char_info.ready = true;
+					++ arrivals_;
 				}
 			}
 
-			if (align & Font::FA_Ver_Top)
-			{
-				for (auto iter = lines.begin(); iter != lines.end(); ++ iter)
+			auto& ts = Context::Instance().TaskScheduler();
+			pending_tasks_.erase(std::remove_if(pending_tasks_.begin(), pending_tasks_.end(),
+				[&ts](task_scheduler::task_handle const & task)
 				{
-					sy.push_back(rc.top() + (iter - lines.begin()) * h);
-				}
+					return ts.is_done(task);
+				}), pending_tasks_.end());
+		}
+
+		// Blocks until all requested glyphs are decoded, then uploads them
+		void WaitForGlyphs()
+		{
+			auto& ts = Context::Instance().TaskScheduler();
+			for (auto const & task : pending_tasks_)
+			{
+				ts.wait(task);
 			}
-			else
+			pending_tasks_.clear();
+
+			this->Flush();
+		}
+
+		Font::GlyphCacheStatistics Stats() const
+		{
+			Font::GlyphCacheStatistics stats;
+			stats.num_hits = num_hits_;
+			stats.num_misses = num_misses_;
+			stats.num_evictions = num_evictions_;
+			stats.num_cached = static_cast<uint32_t>(char_info_map_.size());
+			stats.num_pending = 0;
+			for (auto const & ci : char_info_map_)
 			{
-				if (align & Font::FA_Ver_Bottom)
+				if (!ci.second.ready)
 				{
-					for (auto iter = lines.begin(); iter != lines.end(); ++ iter)
-					{
-						sy.push_back(rc.bottom() - (lines.size() - (iter - lines.begin())) * h);
-					}
-				}
-				else
-				{
-					// Font::FA_Ver_Middle
-					for (auto iter = lines.begin(); iter != lines.end(); ++ iter)
-					{
-						sy.push_back((rc.top() + rc.bottom()) / 2
-							- lines.size() * h / 2 + (iter - lines.begin()) * h);
-					}
+					++ stats.num_pending;
 				}
 			}
+			stats.capacity = num_slots_;
+			stats.num_pages = dist_texture_->ArraySize();
+			return stats;
+		}
+
+	private:
+		struct DecodedGlyph
+		{
+			wchar_t ch;
+			uint32_t serial;
+			std::vector<uint8_t> data;
+		};
+
+		// Shared with the decoding tasks, so they can finish after the font is gone
+		struct DecodedGlyphs
+		{
+			std::mutex mutex;
+			std::vector<DecodedGlyph> glyphs;
+			std::atomic<uint32_t> num_glyphs{0};
+		};
 
-			uint32_t const index_per_char = restart_ ? 5 : 6;
+		void Decode(wchar_t ch, uint32_t serial, std::vector<uint8_t> lzma_data)
+		{
+			uint32_t const char_bytes = kfont_loader_->CharSize() * kfont_loader_->CharSize();
+			auto decoded = decoded_;
+			auto decode = [decoded, ch, serial, lzma_data = std::move(lzma_data), char_bytes]()
+				{
+					DecodedGlyph glyph;
+					glyph.ch = ch;
+					glyph.serial = serial;
+					glyph.data.resize(char_bytes);
 
-			uint32_t const clr32 = clr.ABGR();
-			for (size_t i = 0; i < sx.size(); ++ i)
+					LZMACodec lzma;
+					lzma.Decode(glyph.data.data(), lzma_data.data(), lzma_data.size(), char_bytes);
+
+					std::lock_guard<std::mutex> lock(decoded->mutex);
+					decoded->glyphs.push_back(std::move(glyph));
+					++ decoded->num_glyphs;
+				};
+
+			auto& ts = Context::Instance().TaskScheduler();
+			if (ts.num_workers() > 0)
 			{
-				size_t const maxSize = lines[i].second.length();
-				float x = sx[i], y = sy[i];
+				pending_tasks_.push_back(ts.schedule(decode));
+			}
+			else
+			{
+				decode();
+			}
+		}
 
-				vertices.reserve(maxSize * 4);
+	private:
+		// 4 pages of 2048x2048 hold 16K glyphs of 32x32
+		static uint32_t constexpr MAX_NUM_PAGES = 4;
 
-				for (auto const & ch : lines[i].second)
-				{
-					std::pair<int32_t, uint32_t> const & offset_adv = kl.CharIndexAdvance(ch);
-					if (offset_adv.first != -1)
-					{
-						KFont::font_info const & ci = kl.CharInfo(offset_adv.first);
+		std::unordered_map<wchar_t, CharInfo> char_info_map_;
+		// Most recently used first
+		std::list<wchar_t> lru_;
+		std::vector<uint32_t> free_slots_;
+		uint32_t num_chars_a_row_;
+		uint32_t slots_per_page_;
+		uint32_t num_slots_;
 
-						float left = ci.left * rel_size_x;
-						float top = ci.top * rel_size_y;
-						float width = ci.width * rel_size_x;
-						float height = ci.height * rel_size_y;
+		TexturePtr		dist_texture_;
 
-						auto cmiter = cim.find(ch);
-						Rect const & texRect(cmiter->second.rc);
+		RenderEffectPtr effect_;
+		RenderEffectParameter* half_width_height_ep_;
+		RenderEffectParameter* dpi_scale_ep_;
+		RenderEffectParameter* mvp_ep_;
 
-						Rect pos_rc(x + left, y + top, x + left + width, y + top + height);
-						Rect intersect_rc = pos_rc & rc;
-						if ((intersect_rc.Width() > 0) && (intersect_rc.Height() > 0))
-						{
-							vertices.push_back(FontVert(float3(pos_rc.left(), pos_rc.top(), sz),
-													clr32,
-													float2(texRect.left(), texRect.top())));
-							vertices.push_back(FontVert(float3(pos_rc.right(), pos_rc.top(), sz),
-													clr32,
-													float2(texRect.right(), texRect.top())));
-							vertices.push_back(FontVert(float3(pos_rc.right(), pos_rc.bottom(), sz),
-													clr32,
-													float2(texRect.right(), texRect.bottom())));
-							vertices.push_back(FontVert(float3(pos_rc.left(), pos_rc.bottom(), sz),
-													clr32,
-													float2(texRect.left(), texRect.bottom())));
-						}
-					}
+		GraphicsBufferPtr corner_vb_;
+		GraphicsBufferPtr corner_ib_;
 
-					x += (offset_adv.second & 0xFFFF) * rel_size_x;
-					y += (offset_adv.second >> 16) * rel_size_y;
-				}
+		std::shared_ptr<KFont> kfont_loader_;
 
-				tb_vb_sub_allocs_.push_back(tb_vb_->Alloc(static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])), &vertices[0]));
+		std::shared_ptr<DecodedGlyphs> decoded_;
+		std::vector<task_scheduler::task_handle> pending_tasks_;
 
-				uint16_t last_index = static_cast<uint16_t>(tb_vb_sub_allocs_.back().offset_ / sizeof(FontVert));
-				uint32_t const num_chars = static_cast<uint32_t>(vertices.size() / 4);
-				indices.reserve(num_chars * index_per_char);
-				for (uint32_t c = 0; c < num_chars; ++ c)
-				{
-					indices.push_back(last_index + 0);
-					indices.push_back(last_index + 1);
-					if (restart_)
-					{
-						indices.push_back(last_index + 3);
-						indices.push_back(last_index + 2);
-						indices.push_back(0xFFFF);
-					}
-					else
-					{
-						indices.push_back(last_index + 2);
-						indices.push_back(last_index + 2);
-						indices.push_back(last_index + 3);
-						indices.push_back(last_index + 0);
-					}
-					last_index += 4;
-				}
-				BOOST_ASSERT(last_index + 3 <= 0xFFFF);
-				tb_ib_sub_allocs_.push_back(tb_ib_->Alloc(static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]));
+		uint32_t next_serial_;
+		uint64_t generation_;
+		uint64_t arrivals_;
 
-				pos_aabb_ |= AABBox(float3(sx[i], sy[i], sz), float3(sx[i] + lines[i].first, sy[i] + h, sz + 0.1f));
-			}
-		}
+		uint64_t num_hits_;
+		uint64_t num_misses_;
+		uint64_t num_evictions_;
+	};
 
-		void AddText(float sx, float sy, float sz,
-			float xScale, float yScale, Color const & clr, std::wstring_view text, float font_size)
+	class TextLayoutRenderable : public RenderableHelper
+	{
+	public:
+		explicit TextLayoutRenderable(std::shared_ptr<FontRenderable> const & font)
+				: RenderableHelper(L"TextLayout"),
+					font_(font),
+					font_size_(16), clr_(1, 1, 1, 1),
+					in_rect_(false), x_(0), y_(0), z_(0), x_scale_(1), y_scale_(1), align_(0),
+					three_dim_(false),
+					dirty_(true), generation_(0), arrivals_(0), num_glyphs_(0), num_pending_glyphs_(0)
 		{
-			this->UpdateTexture(text);
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
-			KFont const & kl = *kfont_loader_;
-			auto const & cim = char_info_map_;
+			rl_ = rf.MakeRenderLayout();
+			rl_->TopologyType(RenderLayout::TT_TriangleStrip);
+			rl_->BindVertexStream(font_->CornerVB(), VertexElement(VEU_Position, 0, EF_GR32F),
+				RenderLayout::ST_Geometry, 0);
+			rl_->BindIndexStream(font_->CornerIB(), EF_R16UI);
 
-			std::vector<FontVert> vertices;
-			std::vector<uint16_t> indices;
+			effect_ = font_->Effect();
+			technique_ = effect_->TechniqueByName("Font2DTec");
 
-			uint32_t const clr32 = clr.ABGR();
-			float const h = font_size * yScale;
-			float const rel_size = font_size / kl.CharSize();
-			float const rel_size_x = rel_size * xScale;
-			float const rel_size_y = rel_size * yScale;
-			size_t const maxSize = text.length() - std::count(text.begin(), text.end(), L'\n');
-			float x = sx, y = sy;
-			float maxx = sx, maxy = sy;
+			pos_aabb_ = AABBox(float3(0, 0, 0), float3(0, 0, 0));
+			tc_aabb_ = AABBox(float3(0, 0, 0), float3(0, 0, 0));
+		}
 
-			uint32_t const index_per_char = restart_ ? 5 : 6;
+		void Text(std::wstring_view text)
+		{
+			if (text_ != text)
+			{
+				text_.assign(text.begin(), text.end());
+				dirty_ = true;
+			}
+		}
+		std::wstring const & Text() const
+		{
+			return text_;
+		}
 
-			vertices.reserve(maxSize * 4);
+		void FontSize(float font_size)
+		{
+			if (font_size_ != font_size)
+			{
+				font_size_ = font_size;
+				dirty_ = true;
+			}
+		}
+		float FontSize() const
+		{
+			return font_size_;
+		}
 
-			for (auto const & ch : text)
+		void TextColor(Color const & clr)
+		{
+			if (!(clr_ == clr))
 			{
-				if (ch != L'\n')
-				{
-					std::pair<int32_t, uint32_t> const & offset_adv = kl.CharIndexAdvance(ch);
-					if (offset_adv.first != -1)
-					{
-						KFont::font_info const & ci = kl.CharInfo(offset_adv.first);
+				clr_ = clr;
+				dirty_ = true;
+			}
+		}
+		Color const & TextColor() const
+		{
+			return clr_;
+		}
 
-						float left = ci.left * rel_size_x;
-						float top = ci.top * rel_size_y;
-						float width = ci.width * rel_size_x;
-						float height = ci.height * rel_size_y;
+		void Location(float x, float y, float z, float xScale, float yScale)
+		{
+			if (in_rect_ || (x_ != x) || (y_ != y) || (z_ != z) || (x_scale_ != xScale) || (y_scale_ != yScale))
+			{
+				in_rect_ = false;
+				x_ = x;
+				y_ = y;
+				z_ = z;
+				x_scale_ = xScale;
+				y_scale_ = yScale;
+				dirty_ = true;
+			}
+		}
 
-						auto cmiter = cim.find(ch);
-						if (cmiter != cim.end())
-						{
-							Rect const & texRect(cmiter->second.rc);
-							Rect pos_rc(x + left, y + top, x + left + width, y + top + height);
-
-							vertices.push_back(FontVert(float3(pos_rc.left(), pos_rc.top(), sz),
-												clr32,
-												float2(texRect.left(), texRect.top())));
-							vertices.push_back(FontVert(float3(pos_rc.right(), pos_rc.top(), sz),
-												clr32,
-												float2(texRect.right(), texRect.top())));
-							vertices.push_back(FontVert(float3(pos_rc.right(), pos_rc.bottom(), sz),
-												clr32,
-												float2(texRect.right(), texRect.bottom())));
-							vertices.push_back(FontVert(float3(pos_rc.left(), pos_rc.bottom(), sz),
-												clr32,
-												float2(texRect.left(), texRect.bottom())));
-						}
-					}
+		void Location(Rect const & rc, float z, float xScale, float yScale, uint32_t align)
+		{
+			if (!in_rect_ || !(rc_ == rc) || (z_ != z) || (x_scale_ != xScale) || (y_scale_ != yScale) || (align_ != align))
+			{
+				in_rect_ = true;
+				rc_ = rc;
+				z_ = z;
+				x_scale_ = xScale;
+				y_scale_ = yScale;
+				align_ = align;
+				dirty_ = true;
+			}
+		}
 
-					x += (offset_adv.second & 0xFFFF) * rel_size_x;
-					y += (offset_adv.second >> 16) * rel_size_y;
+		bool Dirty() const
+		{
+			return dirty_ || (generation_ != font_->Generation())
+				|| ((num_pending_glyphs_ > 0) && (arrivals_ != font_->Arrivals()));
+		}
 
-					if (x > maxx)
-					{
-						maxx = x;
-					}
-				}
-				else
-				{
-					y += h;
-					x = sx;
+		uint32_t NumGlyphs() const
+		{
+			return num_glyphs_;
+		}
 
-					if (y > maxy)
-					{
-						maxy = y;
-					}
-				}
+		// Each layout binds its own mvp to the effect in OnRenderBegin
+		void ThreeDim(bool three_dim, float4x4 const & mvp)
+		{
+			if (three_dim_ != three_dim)
+			{
+				three_dim_ = three_dim;
+				technique_ = effect_->TechniqueByName(three_dim ? "Font3DTec" : "Font2DTec");
 			}
+			mvp_ = mvp;
+		}
 
-			tb_vb_sub_allocs_.push_back(tb_vb_->Alloc(static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])), &vertices[0]));
+		// Returns false if there is nothing to draw
+		bool Update()
+		{
+			font_->Flush();
 
-			uint16_t last_index = static_cast<uint16_t>(tb_vb_sub_allocs_.back().offset_ / sizeof(FontVert));
-			uint32_t const num_chars = static_cast<uint32_t>(vertices.size() / 4);
-			indices.reserve(num_chars * index_per_char);
-			for (uint32_t c = 0; c < num_chars; ++ c)
+			if (this->Dirty())
 			{
-				indices.push_back(last_index + 0);
-				indices.push_back(last_index + 1);
-				if (restart_)
-				{
-					indices.push_back(last_index + 3);
-					indices.push_back(last_index + 2);
-					indices.push_back(0xFFFF);
-				}
-				else
-				{
-					indices.push_back(last_index + 2);
-					indices.push_back(last_index + 2);
-					indices.push_back(last_index + 3);
-					indices.push_back(last_index + 0);
-				}
-				last_index += 4;
+				this->Layout();
+			}
+			else
+			{
+				font_->Touch(glyphs_);
 			}
-			tb_ib_sub_allocs_.push_back(tb_ib_->Alloc(static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]));
 
-			pos_aabb_ |= AABBox(float3(sx, sy, sz), float3(maxx, maxy, sz + 0.1f));
+			return num_glyphs_ > 0;
 		}
 
-		// ʹLRU㷨
-		/////////////////////////////////////////////////////////////////////////////////
-		void UpdateTexture(std::wstring_view text)
+		void OnRenderBegin()
 		{
-			++ tick_;
-
-			uint32_t const tex_size = dist_texture_->Width(0);
+			font_->BindParams(three_dim_, mvp_);
+		}
 
-			KFont& kl = *kfont_loader_;
-			auto& cim = char_info_map_;
+	private:
+		void Layout()
+		{
+			font_->UpdateTexture(text_);
+			font_->Flush();
+			generation_ = font_->Generation();
+			arrivals_ = font_->Arrivals();
+			dirty_ = false;
 
-			uint32_t const kfont_char_size = kl.CharSize();
+			KFont const & kl = font_->Loader();
 
-			uint32_t const num_chars_a_row = tex_size / kfont_char_size;
-			uint32_t const num_total_chars = num_chars_a_row * num_chars_a_row;
+			float const h = font_size_ * y_scale_;
+			float const rel_size = font_size_ / kl.CharSize();
+			float const rel_size_x = rel_size * x_scale_;
+			float const rel_size_y = rel_size * y_scale_;
+			uint32_t const clr32 = clr_.ABGR();
 
-			for (auto const & ch : text)
+			std::vector<std::pair<std::wstring_view, float>> lines;
 			{
-				int32_t offset = kl.CharIndex(ch);
-				if (offset != -1)
+				std::wstring_view rest = text_;
+				for (;;)
 				{
-					auto cmiter = cim.find(ch);
-					if (cmiter != cim.end())
+					size_t const pos = rest.find(L'\n');
+					std::wstring_view const line = rest.substr(0, pos);
+
+					float width = 0;
+					for (auto const & ch : line)
 					{
-						// ҵ
+						width += (kl.CharAdvance(ch) & 0xFFFF) * rel_size_x;
+					}
+					lines.emplace_back(line, width);
 
-						cmiter->second.tick = tick_;
+					if (pos == std::wstring_view::npos)
+					{
+						break;
+					}
+					rest = rest.substr(pos + 1);
+				}
+			}
+
+			std::vector<GlyphInstance> instances;
+			instances.reserve(text_.size());
+			glyphs_.clear();
+			num_pending_glyphs_ = 0;
+
+			for (size_t i = 0; i < lines.size(); ++ i)
+			{
+				float sx, sy;
+				if (!in_rect_)
+				{
+					sx = x_;
+					sy = y_ + i * h;
+				}
+				else
+				{
+					if (align_ & Font::FA_Hor_Left)
+					{
+						sx = rc_.left();
+					}
+					else if (align_ & Font::FA_Hor_Right)
+					{
+						sx = rc_.right() - lines[i].second;
 					}
 					else
 					{
-						// ҲԵ
-
-						KFont::font_info const & ci = kl.CharInfo(offset);
+						// Font::FA_Hor_Center
+						sx = (rc_.left() + rc_.right()) / 2 - lines[i].second / 2;
+					}
 
-						uint32_t width = ci.width;
-						uint32_t height = ci.height;
+					if (align_ & Font::FA_Ver_Top)
+					{
+						sy = rc_.top() + i * h;
+					}
+					else if (align_ & Font::FA_Ver_Bottom)
+					{
+						sy = rc_.bottom() - (lines.size() - i) * h;
+					}
+					else
+					{
+						// Font::FA_Ver_Middle
+						sy = (rc_.top() + rc_.bottom()) / 2 - lines.size() * h / 2 + i * h;
+					}
+				}
 
-						int2 char_pos;
-						CharInfo charInfo;
-						if (cim.size() < num_total_chars)
+				float x = sx, y = sy;
+				for (auto const & ch : lines[i].first)
+				{
+					std::pair<int32_t, uint32_t> const & offset_adv = kl.CharIndexAdvance(ch);
+					if (offset_adv.first != -1)
+					{
+						FontRenderable::CharInfo* glyph = font_->Glyph(ch);
+						if ((glyph != nullptr) && !glyph->ready)
 						{
-							// пռ
-
-							uint32_t const s = char_free_list_.front().first;
-						
-							char_pos.y() = s / num_chars_a_row;
-							char_pos.x() = s - char_pos.y() * num_chars_a_row;
-
-							char_pos.x() *= kfont_char_size;
-							char_pos.y() *= kfont_char_size;
-
-							charInfo.rc.left() = static_cast<float>(char_pos.x()) / tex_size;
-							charInfo.rc.top() = static_cast<float>(char_pos.y()) / tex_size;
-
-							++ char_free_list_.front().first;
-							if (char_free_list_.front().first == char_free_list_.front().second)
-							{
-								char_free_list_.pop_front();
-							}
+							// Left blank until the glyph is decoded
+							glyphs_.push_back(glyph);
+							++ num_pending_glyphs_;
 						}
-						else
+						else if (glyph != nullptr)
 						{
-							// ҵʹʱûʹõ
-
-							uint64_t min_tick = cim.begin()->second.tick;
-							auto min_chiter = cim.begin();
-							for (auto chiter = cim.begin(); chiter != cim.end(); ++ chiter)
-							{
-								if (chiter->second.tick < min_tick)
-								{
-									min_tick = chiter->second.tick;
-									min_chiter = chiter;
-								}
-							}
+							KFont::font_info const & ci = kl.CharInfo(offset_adv.first);
 
-							char_pos.x() = static_cast<int32_t>(min_chiter->second.rc.left() * tex_size);
-							char_pos.y() = static_cast<int32_t>(min_chiter->second.rc.top() * tex_size);
-							charInfo.rc.left() = min_chiter->second.rc.left();
-							charInfo.rc.top() = min_chiter->second.rc.top();
+							float const left = ci.left * rel_size_x;
+							float const top = ci.top * rel_size_y;
+							float const width = ci.width * rel_size_x;
+							float const height = ci.height * rel_size_y;
 
-							for (auto chiter = cim.begin(); chiter != cim.end(); ++ chiter)
+							Rect const pos_rc(x + left, y + top, x + left + width, y + top + height);
+							bool visible = true;
+							if (in_rect_)
 							{
-								if (chiter->second.tick == min_tick)
-								{
-									uint32_t const x = static_cast<int32_t>(chiter->second.rc.left() * tex_size);
-									uint32_t const y = static_cast<int32_t>(chiter->second.rc.top() * tex_size);
-									uint32_t const id = y * num_chars_a_row + x;
-									auto freeiter = char_free_list_.begin();
-									while ((freeiter != char_free_list_.end()) && (freeiter->second <= id))
-									{
-										++ freeiter;
-									}
-									char_free_list_.emplace(freeiter, id, id + 1);
-
-									cim.erase(chiter);
-									break;
-								}
+								Rect const intersect_rc = pos_rc & rc_;
+								visible = (intersect_rc.Width() > 0) && (intersect_rc.Height() > 0);
 							}
-							for (auto freeiter = char_free_list_.begin(); freeiter != char_free_list_.end();)
+							if (visible)
 							{
-								auto nextiter = freeiter;
-								++ nextiter;
-
-								if (nextiter != char_free_list_.end())
-								{
-									if (freeiter->second == nextiter->first)
-									{
-										freeiter->second = nextiter->second;
-										char_free_list_.erase(nextiter);
-									}
-									else
-									{
-										++ freeiter;
-									}
-								}
-								else
-								{
-									break;
-								}
+								GlyphInstance inst;
+								inst.pos_rc = float4(pos_rc.left(), pos_rc.top(), pos_rc.right(), pos_rc.bottom());
+								inst.tex_rc = float4(glyph->rc.left(), glyph->rc.top(), glyph->rc.right(), glyph->rc.bottom());
+								inst.clr = clr32;
+								inst.z_page = float2(z_, static_cast<float>(glyph->page));
+								instances.push_back(inst);
+
+								glyphs_.push_back(glyph);
 							}
 						}
+					}
+
+					x += (offset_adv.second & 0xFFFF) * rel_size_x;
+					y += (offset_adv.second >> 16) * rel_size_y;
+				}
+
+				AABBox const line_aabb(float3(sx, sy, z_), float3(sx + lines[i].second, sy + h, z_ + 0.1f));
+				if (0 == i)
+				{
+					pos_aabb_ = line_aabb;
+				}
+				else
+				{
+					pos_aabb_ |= line_aabb;
+				}
+			}
 
-						charInfo.rc.right()		= charInfo.rc.left() + static_cast<float>(width) / tex_size;
-						charInfo.rc.bottom()	= charInfo.rc.top() + static_cast<float>(height) / tex_size;
-						charInfo.tick			= tick_;
+			std::sort(glyphs_.begin(), glyphs_.end());
+			glyphs_.erase(std::unique(glyphs_.begin(), glyphs_.end()), glyphs_.end());
 
-						kl.GetDistanceData(&a_char_data_[0], kfont_char_size, offset);
-						dist_texture_->UpdateSubresource2D(0, 0, char_pos.x(), char_pos.y(), kfont_char_size, kfont_char_size,
-							&a_char_data_[0], kfont_char_size);
+			num_glyphs_ = static_cast<uint32_t>(instances.size());
+			if (num_glyphs_ > 0)
+			{
+				uint32_t const inst_size = static_cast<uint32_t>(instances.size() * sizeof(instances[0]));
 
-						cim.emplace(ch, charInfo);
-					}
+				GraphicsBufferPtr inst_vb = rl_->InstanceStream();
+				if (!inst_vb || (inst_vb->Size() < inst_size))
+				{
+					RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+					inst_vb = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, inst_size, nullptr);
+					rl_->BindVertexStream(inst_vb, { VertexElement(VEU_TextureCoord, 1, EF_ABGR32F),
+						VertexElement(VEU_TextureCoord, 2, EF_ABGR32F), VertexElement(VEU_Diffuse, 0, EF_ABGR8),
+						VertexElement(VEU_TextureCoord, 3, EF_GR32F) }, RenderLayout::ST_Instance);
+				}
+
+				{
+					GraphicsBuffer::Mapper mapper(*inst_vb, BA_Write_Only);
+					std::copy(instances.begin(), instances.end(), mapper.Pointer<GlyphInstance>());
 				}
+
+				rl_->VertexStreamFrequencyDivider(0, RenderLayout::ST_Geometry, num_glyphs_);
 			}
 		}
 
 	private:
-		struct CharInfo
-		{
-			Rect rc;
-			uint64_t tick;
-		};
-
 #ifdef KLAYGE_HAS_STRUCT_PACK
 	#pragma pack(push, 1)
 #endif
-		struct FontVert
+		struct GlyphInstance
 		{
-			float3 pos;
+			float4 pos_rc;
+			float4 tex_rc;
 			uint32_t clr;
-			float2 tex;
-
-			FontVert()
-			{
-			}
-			FontVert(float3 const & pos, uint32_t clr, float2 const & tex)
-				: pos(pos), clr(clr), tex(tex)
-			{
-			}
+			float2 z_page;
 		};
 #ifdef KLAYGE_HAS_STRUCT_PACK
 	#pragma pack(pop)
 #endif
 
-		bool restart_;
+		std::shared_ptr<FontRenderable> font_;
 
-		std::unordered_map<wchar_t, CharInfo> char_info_map_;
-		std::list<std::pair<uint32_t, uint32_t>> char_free_list_;
+		std::wstring text_;
+		float font_size_;
+		Color clr_;
 
-		bool three_dim_;
-
-		std::unique_ptr<TransientBuffer> tb_vb_;
-		std::unique_ptr<TransientBuffer> tb_ib_;
-		std::vector<SubAlloc> tb_vb_sub_allocs_;
-		std::vector<SubAlloc> tb_ib_sub_allocs_;
+		bool in_rect_;
+		float x_;
+		float y_;
+		Rect rc_;
+		float z_;
+		float x_scale_;
+		float y_scale_;
+		uint32_t align_;
 
-		TexturePtr		dist_texture_;
-		std::vector<uint8_t> a_char_data_;
-
-		RenderEffectParameter* half_width_height_ep_;
-		RenderEffectParameter* dpi_scale_ep_;
-		RenderEffectParameter* mvp_ep_;
-
-		std::shared_ptr<KFont> kfont_loader_;
-
-		uint64_t tick_;
+		bool three_dim_;
+		float4x4 mvp_;
+
+		bool dirty_;
+		uint64_t generation_;
+		uint64_t arrivals_;
+		std::vector<FontRenderable::CharInfo*> glyphs_;
+		uint32_t num_glyphs_;
+		uint32_t num_pending_glyphs_;
 	};
 }
 
@@ -746,6 +826,11 @@ namespace
 			return type;
 		}
 
+		std::string_view Name() const override
+		{
+			return font_desc_.res_name;
+		}
+
 		bool StateLess() const override
 		{
 			return true;
@@ -828,20 +913,110 @@ namespace
 		FontDesc font_desc_;
 		std::mutex main_thread_stage_mutex_;
 	};
+
+	void HashCombineFloats(size_t& seed, float const * first, float const * last)
+	{
+		for (; first != last; ++ first)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, first, sizeof(bits));
+			HashCombine(seed, bits);
+		}
+	}
+
+	void HashCombineFloats(size_t& seed, std::initializer_list<float> values)
+	{
+		HashCombineFloats(seed, values.begin(), values.end());
+	}
 }
 
 namespace KlayGE
 {
+	TextLayout::TextLayout(std::shared_ptr<TextLayoutRenderable> const & renderable, uint32_t fso_attrib)
+			: renderable_(renderable),
+				layout_obj_(MakeSharedPtr<SceneObjectHelper>(renderable, fso_attrib))
+	{
+	}
+
+	void TextLayout::Text(std::wstring_view text)
+	{
+		renderable_->Text(text);
+	}
+
+	std::wstring const & TextLayout::Text() const
+	{
+		return renderable_->Text();
+	}
+
+	void TextLayout::FontSize(float font_size)
+	{
+		renderable_->FontSize(font_size);
+	}
+
+	float TextLayout::FontSize() const
+	{
+		return renderable_->FontSize();
+	}
+
+	void TextLayout::TextColor(Color const & clr)
+	{
+		renderable_->TextColor(clr);
+	}
+
+	Color const & TextLayout::TextColor() const
+	{
+		return renderable_->TextColor();
+	}
+
+	void TextLayout::Location(float x, float y, float z, float xScale, float yScale)
+	{
+		renderable_->Location(x, y, z, xScale, yScale);
+	}
+
+	void TextLayout::Location(Rect const & rc, float z, float xScale, float yScale, uint32_t align)
+	{
+		renderable_->Location(rc, z, xScale, yScale, align);
+	}
+
+	bool TextLayout::Dirty() const
+	{
+		return renderable_->Dirty();
+	}
+
+	uint32_t TextLayout::NumGlyphs() const
+	{
+		return renderable_->NumGlyphs();
+	}
+
+	void TextLayout::Render()
+	{
+		renderable_->ThreeDim(false, float4x4::Identity());
+		if (renderable_->Update())
+		{
+			layout_obj_->AddToSceneManager();
+		}
+	}
+
+	void TextLayout::Render(float4x4 const & mvp)
+	{
+		renderable_->ThreeDim(true, mvp);
+		if (renderable_->Update())
+		{
+			layout_obj_->AddToSceneManager();
+		}
+	}
+
+
 	// 캯
 	/////////////////////////////////////////////////////////////////////////////////
 	Font::Font(std::shared_ptr<FontRenderable> const & fr)
-			: font_renderable_(fr)
+			: font_renderable_(fr), last_purge_frame_(0)
 	{
 		fso_attrib_ = SceneObject::SOA_Overlay;
 	}
 
 	Font::Font(std::shared_ptr<FontRenderable> const & fr, uint32_t flags)
-			: font_renderable_(fr)
+			: font_renderable_(fr), last_purge_frame_(0)
 	{
 		fso_attrib_ = SceneObject::SOA_Overlay;
 		if (flags & Font::FS_Cullable)
@@ -880,9 +1055,17 @@ namespace KlayGE
 	{
 		if (!text.empty())
 		{
-			SceneObjectHelperPtr font_obj = MakeSharedPtr<SceneObjectHelper>(font_renderable_, fso_attrib_);
-			font_renderable_->AddText2D(x, y, z, xScale, yScale, clr, text, font_size);
-			font_obj->AddToSceneManager();
+			size_t key = 0;
+			HashCombine(key, 0);
+			HashCombineFloats(key, { x, y, z, xScale, yScale, font_size });
+			HashCombine(key, clr.ABGR());
+
+			TextLayout& layout = this->ImmediateLayout(key);
+			layout.Text(text);
+			layout.FontSize(font_size);
+			layout.TextColor(clr);
+			layout.Location(x, y, z, xScale, yScale);
+			layout.Render();
 		}
 	}
 
@@ -894,9 +1077,18 @@ namespace KlayGE
 	{
 		if (!text.empty())
 		{
-			SceneObjectHelperPtr font_obj = MakeSharedPtr<SceneObjectHelper>(font_renderable_, fso_attrib_);
-			font_renderable_->AddText2D(rc, z, xScale, yScale, clr, text, font_size, align);
-			font_obj->AddToSceneManager();
+			size_t key = 0;
+			HashCombine(key, 1);
+			HashCombineFloats(key, { rc.left(), rc.top(), rc.right(), rc.bottom(), z, xScale, yScale, font_size });
+			HashCombine(key, clr.ABGR());
+			HashCombine(key, align);
+
+			TextLayout& layout = this->ImmediateLayout(key);
+			layout.Text(text);
+			layout.FontSize(font_size);
+			layout.TextColor(clr);
+			layout.Location(rc, z, xScale, yScale, align);
+			layout.Render();
 		}
 	}
 
@@ -906,10 +1098,77 @@ namespace KlayGE
 	{
 		if (!text.empty())
 		{
-			SceneObjectHelperPtr font_obj = MakeSharedPtr<SceneObjectHelper>(font_renderable_, fso_attrib_);
-			font_renderable_->AddText3D(mvp, clr, text, font_size);
-			font_obj->AddToSceneManager();
+			size_t key = 0;
+			HashCombine(key, 2);
+			HashCombineFloats(key, mvp.begin(), mvp.end());
+			HashCombineFloats(key, { font_size });
+			HashCombine(key, clr.ABGR());
+
+			TextLayout& layout = this->ImmediateLayout(key);
+			layout.Text(text);
+			layout.FontSize(font_size);
+			layout.TextColor(clr);
+			layout.Location(0, 0, 0, 1, 1);
+			layout.Render(mvp);
+		}
+	}
+
+	void Font::Prefetch(std::wstring_view text)
+	{
+		font_renderable_->UpdateTexture(text);
+	}
+
+	void Font::WaitForGlyphs()
+	{
+		font_renderable_->WaitForGlyphs();
+	}
+
+	Font::GlyphCacheStatistics Font::GlyphCacheStats() const
+	{
+		return font_renderable_->Stats();
+	}
+
+	TextLayoutPtr Font::MakeTextLayout()
+	{
+		return MakeSharedPtr<TextLayout>(MakeSharedPtr<TextLayoutRenderable>(font_renderable_), fso_attrib_);
+	}
+
+	TextLayout& Font::ImmediateLayout(size_t key)
+	{
+		uint32_t const frame = Context::Instance().AppInstance().TotalNumFrames();
+		if (frame != last_purge_frame_)
+		{
+			for (auto iter = immediate_layouts_.begin(); iter != immediate_layouts_.end();)
+			{
+				if (iter->second.second + 1 < frame)
+				{
+					iter = immediate_layouts_.erase(iter);
+				}
+				else
+				{
+					++ iter;
+				}
+			}
+			immediate_key_hits_.clear();
+			last_purge_frame_ = frame;
+		}
+
+		// Keys don't include the text, a counter or a clock at the same place reuses its layout and only the glyphs
+		//  are laid out again. Calls with the same key in one frame are told apart by their order in the frame, so
+		//  each of them gets the same layout in the next frame.
+		uint32_t const ordinal = immediate_key_hits_[key] ++;
+		if (ordinal > 0)
+		{
+			HashCombine(key, ordinal);
+		}
+
+		auto& entry = immediate_layouts_[key];
+		if (!entry.first)
+		{
+			entry.first = this->MakeTextLayout();
 		}
+		entry.second = frame;
+		return *entry.first;
 	}
 
 
@@ -73,6 +73,11 @@ namespace KlayGE
 			return type;
 		}
 
+		std::string_view Name() const override
+		{
+			return imposter_desc_.res_name;
+		}
+
 		bool StateLess() const override
 		{
 			return true;
@@ -17,8 +17,10 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderEffect.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <cstring>
+#include <unordered_set>
 #include <boost/assert.hpp>
 #if defined(KLAYGE_COMPILER_CLANGC2)
 #pragma clang diagnostic push
@@ -124,7 +126,10 @@ namespace KlayGE
 		: root_(MakeSharedPtr<quadtree_node>()),
 			num_tiles_(num_tiles), tile_size_(tile_size), format_(format),
 			texel_size_(NumFormatBytes(format)),
-			decode_tick_(0), tile_tick_(0)
+			decoded_block_budget_(DEFAULT_DECODED_BLOCK_BUDGET), num_block_hits_(0), num_block_misses_(0),
+			next_tile_slot_(0), tile_budget_(0), num_running_tasks_(0),
+			num_hits_(0), num_misses_(0), num_evictions_(0),
+			num_latency_samples_(0), total_latency_(0), max_latency_(0)
 	{
 		BOOST_ASSERT(num_tiles_ <= MAX_NUM_TILES);
 		BOOST_ASSERT(tile_size_ <= MAX_TILE_SIZE);
@@ -185,6 +190,24 @@ namespace KlayGE
 		}
 	}
 
+	JudaTexture::~JudaTexture()
+	{
+		{
+			std::lock_guard<std::mutex> lock(tile_queue_mutex_);
+			for (auto const id : tile_request_queue_)
+			{
+				pending_tiles_.erase(id);
+			}
+			tile_request_queue_.clear();
+		}
+
+		auto& ts = Context::Instance().TaskScheduler();
+		for (auto const & task : pending_tasks_)
+		{
+			ts.wait(task);
+		}
+	}
+
 	uint32_t JudaTexture::EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const
 	{
 		BOOST_ASSERT(level <= MAX_TREE_LEVEL);
@@ -454,15 +477,13 @@ namespace KlayGE
 
 	void JudaTexture::DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps)
 	{
-		++ decode_tick_;
-
 		uint32_t const full_tile_bytes = cache_tile_size_ * cache_tile_size_ * texel_size_;
 		uint32_t target_level = this->ShuffLevel(shuff);
 
 		quadtree_node_ptr node = root_;
 		if (0 == target_level)
 		{
-			std::memcpy(&data[0][0], this->RetriveATile(root_->data_index), full_tile_bytes);
+			std::memcpy(&data[0][0], this->RetriveATile(root_->data_index)->data(), full_tile_bytes);
 		}
 		else
 		{
@@ -489,6 +510,10 @@ namespace KlayGE
 				start_sub_tile_y = (start_sub_tile_y << 1) + by;
 			}
 
+			// Holds the blocks in use, so they can't be freed by an eviction from another task
+			std::shared_ptr<std::vector<uint8_t>> root_block;
+			std::shared_ptr<std::vector<uint8_t>> node_block;
+
 			std::vector<uint8_t> tile_data;
 			std::vector<uint8_t> temp;
 
@@ -515,7 +540,8 @@ namespace KlayGE
 						uint8_t const * src;
 						if (1 == ll_b)
 						{
-							src = this->RetriveATile(root_->data_index);
+							root_block = this->RetriveATile(root_->data_index);
+							src = root_block->data();
 						}
 						else
 						{
@@ -539,7 +565,8 @@ namespace KlayGE
 						{
 							uint32_t start_x = (start_sub_tile_x >> shift) * used_w * 2;
 							uint32_t start_y = (start_sub_tile_y >> shift) * used_h * 2;
-							uint8_t const * start_src = this->RetriveATile(node->data_index) + (start_y * tile_size_ + start_x) * texel_size_;
+							node_block = this->RetriveATile(node->data_index);
+							uint8_t const * start_src = node_block->data() + (start_y * tile_size_ + start_x) * texel_size_;
 							uint8_t* dst = &temp[0];
 							for (size_t y = 0; y < used_h * 2; ++ y)
 							{
@@ -616,71 +643,74 @@ namespace KlayGE
 		return ret_attr;
 	}
 
-	uint8_t* JudaTexture::RetriveATile(uint32_t data_index)
+	std::shared_ptr<std::vector<uint8_t>> JudaTexture::RetriveATile(uint32_t data_index)
 	{
 		if (data_blocks_.empty())
 		{
-			auto iter = decoded_block_cache_.find(data_index);
-			if (iter != decoded_block_cache_.end())
-			{
-				iter->second.tick = decode_tick_;
-			}
-			else
 			{
-				if (decoded_block_cache_.size() >= 64)
-				{
-					auto min_iter = decoded_block_cache_.begin();
-					uint64_t min_tick = min_iter->second.tick;
-					for (auto dbiter = decoded_block_cache_.begin();
-						dbiter != decoded_block_cache_.end(); ++ dbiter)
-					{
-						if (dbiter->second.tick < min_tick)
-						{
-							min_tick = dbiter->second.tick;
-							min_iter = dbiter;
-						}
-					}
+				std::lock_guard<std::mutex> lock(decoded_block_mutex_);
 
-					for (auto dbiter = decoded_block_cache_.begin();
-						dbiter != decoded_block_cache_.end();)
-					{
-						if (dbiter->second.tick == min_tick)
-						{
-							dbiter = decoded_block_cache_.erase(dbiter);
-						}
-						else
-						{
-							++ dbiter;
-						}
-					}
+				auto iter = decoded_block_cache_.find(data_index);
+				if (iter != decoded_block_cache_.end())
+				{
+					decoded_block_lru_.splice(decoded_block_lru_.begin(), decoded_block_lru_, iter->second.lru_iter);
+					++ num_block_hits_;
+					return iter->second.data;
 				}
 
-				uint32_t const full_tile_bytes = tile_size_ * tile_size_ * texel_size_;
-				std::shared_ptr<std::vector<uint8_t>> data = MakeSharedPtr<std::vector<uint8_t>>(full_tile_bytes);
-				if (data_index != EMPTY_DATA_INDEX)
+				++ num_block_misses_;
+			}
+
+			// Decodes without holding the lock. If two tasks miss the same block, the first one inserted is kept.
+			uint32_t const full_tile_bytes = tile_size_ * tile_size_ * texel_size_;
+			std::shared_ptr<std::vector<uint8_t>> data = MakeSharedPtr<std::vector<uint8_t>>(full_tile_bytes);
+			if (data_index != EMPTY_DATA_INDEX)
+			{
+				std::vector<uint8_t> comed_data;
 				{
+					std::lock_guard<std::mutex> lock(input_file_mutex_);
+
 					uint64_t offsets[2];
 					input_file_->seekg(data_blocks_offset_ + data_index * sizeof(uint64_t), std::ios_base::beg);
 					input_file_->read(offsets, sizeof(offsets));
 					uint32_t const comed_len = static_cast<uint32_t>(offsets[1] - offsets[0]);
-					std::vector<uint8_t> comed_data(comed_len);
+					comed_data.resize(comed_len);
 					input_file_->seekg(offsets[0], std::ios_base::beg);
 					input_file_->read(&comed_data[0], comed_len);
-					lzma_dec_.Decode(&(*data)[0], &comed_data[0], comed_len, full_tile_bytes);
-				}
-				else
-				{
-					memset(&(*data)[0], 0, full_tile_bytes);
 				}
 
-				iter = decoded_block_cache_.emplace(data_index, DecodedBlockInfo(data, decode_tick_)).first;
+				LZMACodec lzma_dec;
+				lzma_dec.Decode(&(*data)[0], &comed_data[0], comed_data.size(), full_tile_bytes);
 			}
+			else
+			{
+				memset(&(*data)[0], 0, full_tile_bytes);
+			}
+
+			std::lock_guard<std::mutex> lock(decoded_block_mutex_);
 
-			return &(*iter->second.data)[0];
+			auto iter = decoded_block_cache_.find(data_index);
+			if (iter != decoded_block_cache_.end())
+			{
+				decoded_block_lru_.splice(decoded_block_lru_.begin(), decoded_block_lru_, iter->second.lru_iter);
+				return iter->second.data;
+			}
+
+			while (decoded_block_cache_.size() >= decoded_block_budget_)
+			{
+				decoded_block_cache_.erase(decoded_block_lru_.back());
+				decoded_block_lru_.pop_back();
+			}
+
+			decoded_block_lru_.push_front(data_index);
+			decoded_block_cache_.emplace(data_index, DecodedBlockInfo{ data, decoded_block_lru_.begin() });
+
+			return data;
 		}
 		else
 		{
-			return &data_blocks_[data_index][0];
+			// Owned by data_blocks_
+			return std::shared_ptr<std::vector<uint8_t>>(std::shared_ptr<std::vector<uint8_t>>(), &data_blocks_[data_index]);
 		}
 	}
 
@@ -1210,7 +1240,27 @@ namespace KlayGE
 
 			tex_indirect_ = rf.MakeTexture2D(num_tiles_, num_tiles_, 1, 1, EF_ABGR8, 1, 0, EAH_GPU_Read);
 
-			tile_free_list_.emplace_back(0, pages);
+			tile_budget_ = pages;
+		}
+	}
+
+	void JudaTexture::CacheBudgets(uint32_t decoded_blocks, uint32_t cache_tiles)
+	{
+		if (decoded_blocks > 0)
+		{
+			std::lock_guard<std::mutex> lock(decoded_block_mutex_);
+
+			decoded_block_budget_ = decoded_blocks;
+			while (decoded_block_cache_.size() > decoded_block_budget_)
+			{
+				decoded_block_cache_.erase(decoded_block_lru_.back());
+				decoded_block_lru_.pop_back();
+			}
+		}
+		if (cache_tiles > 0)
+		{
+			// The cache shrinks as new tiles come in
+			tile_budget_ = cache_tiles;
 		}
 	}
 
@@ -1258,7 +1308,169 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(tex_cache_ || !tex_cache_array_.empty());
 
-		++ tile_tick_;
+		this->FlushTiles();
+
+		double const now = timer_.current_time();
+		std::vector<uint32_t> new_requests;
+		for (auto const id : tile_ids)
+		{
+			auto tmiter = tile_info_map_.find(id);
+			if (tmiter != tile_info_map_.end())
+			{
+				// Exists in cache
+
+				tile_lru_.splice(tile_lru_.begin(), tile_lru_, tmiter->second.lru_iter);
+				++ num_hits_;
+			}
+			else if (pending_tiles_.find(id) == pending_tiles_.end())
+			{
+				pending_tiles_.emplace(id, now);
+				new_requests.push_back(id);
+				++ num_misses_;
+			}
+		}
+
+		uint32_t num_queued;
+		{
+			std::lock_guard<std::mutex> lock(tile_queue_mutex_);
+
+			// Tiles scrolled out of view before a task picked them up are not worth decoding anymore
+			if (!tile_request_queue_.empty())
+			{
+				std::unordered_set<uint32_t> const visible_ids(tile_ids.begin(), tile_ids.end());
+				tile_request_queue_.erase(std::remove_if(tile_request_queue_.begin(), tile_request_queue_.end(),
+					[this, &visible_ids](uint32_t id)
+					{
+						if (visible_ids.find(id) == visible_ids.end())
+						{
+							pending_tiles_.erase(id);
+							return true;
+						}
+						return false;
+					}), tile_request_queue_.end());
+			}
+			tile_request_queue_.insert(tile_request_queue_.end(), new_requests.begin(), new_requests.end());
+
+			num_queued = static_cast<uint32_t>(tile_request_queue_.size());
+		}
+
+		auto& ts = Context::Instance().TaskScheduler();
+		if (ts.num_workers() > 0)
+		{
+			pending_tasks_.erase(std::remove_if(pending_tasks_.begin(), pending_tasks_.end(),
+				[&ts](task_scheduler::task_handle const & task)
+				{
+					return ts.is_done(task);
+				}), pending_tasks_.end());
+
+			// Every task drains the queue until it's empty, no need for more of them than workers
+			uint32_t const num_tasks = std::min(ts.num_workers(), (num_queued + TILES_PER_TASK - 1) / TILES_PER_TASK);
+			uint32_t num_new_tasks = 0;
+			{
+				std::lock_guard<std::mutex> lock(tile_queue_mutex_);
+				if (num_running_tasks_ < num_tasks)
+				{
+					num_new_tasks = num_tasks - num_running_tasks_;
+					num_running_tasks_ = num_tasks;
+				}
+			}
+			for (uint32_t i = 0; i < num_new_tasks; ++ i)
+			{
+				pending_tasks_.push_back(ts.schedule([this]
+					{
+						// The codecs keep states while encoding, each task needs its own
+						TexCompressionPtr codec;
+						if (tex_codec_)
+						{
+							codec = tex_codec_->Clone();
+						}
+						this->DecodeQueuedTiles(codec.get());
+					}));
+			}
+		}
+		else if (num_queued > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(tile_queue_mutex_);
+				++ num_running_tasks_;
+			}
+			this->DecodeQueuedTiles(tex_codec_.get());
+			this->FlushTiles();
+		}
+	}
+
+	void JudaTexture::WaitForTiles()
+	{
+		auto& ts = Context::Instance().TaskScheduler();
+		for (auto const & task : pending_tasks_)
+		{
+			ts.wait(task);
+		}
+		pending_tasks_.clear();
+
+		this->FlushTiles();
+	}
+
+	JudaTexture::CacheStatistics JudaTexture::CacheStats() const
+	{
+		CacheStatistics stats;
+		stats.num_hits = num_hits_;
+		stats.num_misses = num_misses_;
+		stats.num_evictions = num_evictions_;
+		{
+			std::lock_guard<std::mutex> lock(decoded_block_mutex_);
+			stats.num_block_hits = num_block_hits_;
+			stats.num_block_misses = num_block_misses_;
+			stats.num_decoded_blocks = static_cast<uint32_t>(decoded_block_cache_.size());
+		}
+		stats.num_cached_tiles = static_cast<uint32_t>(tile_info_map_.size());
+		stats.num_pending_tiles = static_cast<uint32_t>(pending_tiles_.size());
+		stats.avg_latency = (num_latency_samples_ > 0) ? total_latency_ / num_latency_samples_ : 0;
+		stats.max_latency = max_latency_;
+		return stats;
+	}
+
+	void JudaTexture::DecodeQueuedTiles(TexCompression* codec)
+	{
+		std::vector<uint32_t> tile_ids;
+		std::vector<BuiltTile> tiles;
+		for (;;)
+		{
+			{
+				std::lock_guard<std::mutex> lock(tile_queue_mutex_);
+
+				for (auto& tile : tiles)
+				{
+					built_tiles_.push_back(std::move(tile));
+				}
+				tiles.clear();
+
+				if (tile_request_queue_.empty())
+				{
+					-- num_running_tasks_;
+					break;
+				}
+
+				uint32_t const n = std::min(static_cast<uint32_t>(tile_request_queue_.size()), TILES_PER_TASK);
+				tile_ids.assign(tile_request_queue_.begin(), tile_request_queue_.begin() + n);
+				tile_request_queue_.erase(tile_request_queue_.begin(), tile_request_queue_.begin() + n);
+			}
+
+			this->BuildTiles(tiles, tile_ids, codec);
+		}
+	}
+
+	void JudaTexture::FlushTiles()
+	{
+		std::vector<BuiltTile> tiles;
+		{
+			std::lock_guard<std::mutex> lock(tile_queue_mutex_);
+			tiles.swap(built_tiles_);
+		}
+		if (tiles.empty())
+		{
+			return;
+		}
 
 		uint32_t const tex_width = tex_cache_ ? tex_cache_->Width(0) : tex_cache_array_[0]->Width(0);
 		uint32_t const tex_height = tex_cache_ ? tex_cache_->Height(0) : tex_cache_array_[0]->Height(0);
@@ -1268,130 +1480,214 @@ namespace KlayGE
 		uint32_t const num_cache_tiles_a_row = tex_width / tile_with_border_size;
 		uint32_t const num_cache_tiles_a_layer = num_cache_tiles_a_row * tex_height / tile_with_border_size;
 		uint32_t const num_cache_total_tiles = num_cache_tiles_a_layer * tex_layer;
+		uint32_t const capacity = std::max(std::min(tile_budget_, num_cache_total_tiles), 1U);
 
-		std::unordered_map<uint32_t, uint32_t> neighbor_id_map;
-		std::vector<uint32_t> all_neighbor_ids;
-		std::vector<uint32_t> neighbor_ids;
-		std::vector<uint32_t> tile_attrs;
-		std::vector<bool> in_same_image;
 		auto& tim = tile_info_map_;
-		for (size_t i = 0; i < tile_ids.size(); ++ i)
+		double const now = timer_.current_time();
+		for (auto const & tile : tiles)
 		{
-			auto tmiter = tim.find(tile_ids[i]);
-			if (tmiter != tim.end())
+			auto const piter = pending_tiles_.find(tile.tile_id);
+			if (piter != pending_tiles_.end())
 			{
-				// Exists in cache
+				double const latency = now - piter->second;
+				total_latency_ += latency;
+				max_latency_ = std::max(max_latency_, latency);
+				++ num_latency_samples_;
 
-				tmiter->second.tick = tile_tick_;
+				pending_tiles_.erase(piter);
+			}
+
+			if (tim.find(tile.tile_id) != tim.end())
+			{
+				continue;
+			}
+
+			while (tim.size() >= capacity)
+			{
+				// Reuses the tile not used for the longest time
+
+				auto const tileiter = tim.find(tile_lru_.back());
+				tile_free_slots_.push_back(tileiter->second.z * num_cache_tiles_a_layer
+					+ tileiter->second.y * num_cache_tiles_a_row + tileiter->second.x);
+				tim.erase(tileiter);
+				tile_lru_.pop_back();
+				++ num_evictions_;
+			}
+
+			uint32_t s;
+			if (tile_free_slots_.empty())
+			{
+				s = next_tile_slot_;
+				++ next_tile_slot_;
 			}
 			else
 			{
-				uint32_t level, tile_x, tile_y;
-				this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
+				s = tile_free_slots_.back();
+				tile_free_slots_.pop_back();
+			}
 
-				std::array<uint32_t, 9> new_tile_id_with_neighbors;
-				new_tile_id_with_neighbors.fill(0xFFFFFFFF);
-				new_tile_id_with_neighbors[0] = tile_ids[i];
+			TileInfo tile_info;
+			tile_info.z = s / num_cache_tiles_a_layer;
+			tile_info.y = (s - tile_info.z * num_cache_tiles_a_layer) / num_cache_tiles_a_row;
+			tile_info.x = s - tile_info.z * num_cache_tiles_a_layer - tile_info.y * num_cache_tiles_a_row;
 
-				std::array<bool, 9> new_in_same_image;
-				new_in_same_image.fill(false);
-				new_in_same_image[0] = true;
+			TexturePtr target_tex;
+			uint32_t target_array_index;
+			if (tex_cache_)
+			{
+				target_tex = tex_cache_;
+				target_array_index = tile_info.z;
+			}
+			else
+			{
+				target_tex = tex_cache_array_[tile_info.z];
+				target_array_index = 0;
+			}
 
-				uint32_t attr = this->DecodeAAttr(this->Pos2Shuff(level, tile_x, tile_y));
-				tile_attrs.push_back(attr);
-				if (attr != 0xFFFFFFFF)
-				{
-					std::array<int32_t, 9> new_tile_id_x;
-					std::array<int32_t, 9> new_tile_id_y;
+			uint32_t mip_tile_with_border_size = tile_with_border_size;
+			for (uint32_t l = 0; l < tile.mip_data.size(); ++ l)
+			{
+				target_tex->UpdateSubresource2D(target_array_index, l,
+					tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
+					mip_tile_with_border_size, mip_tile_with_border_size,
+					&tile.mip_data[l][0], tile.mip_row_pitches[l]);
 
-					int32_t left = tile_x - 1;
-					int32_t right = tile_x + 1;
-					int32_t up = tile_y - 1;
-					int32_t down = tile_y + 1;
+				mip_tile_with_border_size /= 2;
+			}
 
-					ImageEntry const & entry = image_entries_[attr];
-					if (TAM_Wrap == (entry.addr_u_v & 0xF))
-					{
-						left = entry.x + (left - entry.x + entry.w) % entry.w;
-						right = entry.x + (right - entry.x + entry.w) % entry.w;
-					}
-					if (TAM_Wrap == ((entry.addr_u_v >> 4) & 0xF))
-					{
-						up = entry.y + (up - entry.y + entry.h) % entry.h;
-						down = entry.y + (down - entry.y + entry.h) % entry.h;
-					}
+			uint8_t const a_tile_indirect[] =
+			{
+				static_cast<uint8_t>(tile_info.x),
+				static_cast<uint8_t>(tile_info.y),
+				static_cast<uint8_t>(tile_info.z),
+				0
+			};
+			uint32_t level, tile_x, tile_y;
+			this->DecodeTileID(level, tile_x, tile_y, tile.tile_id);
+			tex_indirect_->UpdateSubresource2D(0, 0, tile_x, tile_y, 1, 1, a_tile_indirect, sizeof(a_tile_indirect));
 
-					new_tile_id_x[1] = left;
-					new_tile_id_y[1] = up;
-					new_tile_id_x[2] = tile_x;
-					new_tile_id_y[2] = up;
-					new_tile_id_x[3] = right;
-					new_tile_id_y[3] = up;
-
-					new_tile_id_x[4] = left;
-					new_tile_id_y[4] = tile_y;
-					new_tile_id_x[5] = right;
-					new_tile_id_y[5] = tile_y;
-
-					new_tile_id_x[6] = left;
-					new_tile_id_y[6] = down;
-					new_tile_id_x[7] = tile_x;
-					new_tile_id_y[7] = down;
-					new_tile_id_x[8] = right;
-					new_tile_id_y[8] = down;
-
-					for (int j = 1; j < 9; ++ j)
+			tile_lru_.push_front(tile.tile_id);
+			tile_info.lru_iter = tile_lru_.begin();
+			tim.emplace(tile.tile_id, tile_info);
+		}
+	}
+
+	void JudaTexture::BuildTiles(std::vector<BuiltTile>& tiles, std::vector<uint32_t> const & tile_ids, TexCompression* codec)
+	{
+		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
+
+		std::unordered_map<uint32_t, uint32_t> neighbor_id_map;
+		std::vector<uint32_t> all_neighbor_ids;
+		std::vector<uint32_t> neighbor_ids;
+		std::vector<uint32_t> tile_attrs;
+		std::vector<bool> in_same_image;
+		for (size_t i = 0; i < tile_ids.size(); ++ i)
+		{
+			uint32_t level, tile_x, tile_y;
+			this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
+
+			std::array<uint32_t, 9> new_tile_id_with_neighbors;
+			new_tile_id_with_neighbors.fill(0xFFFFFFFF);
+			new_tile_id_with_neighbors[0] = tile_ids[i];
+
+			std::array<bool, 9> new_in_same_image;
+			new_in_same_image.fill(false);
+			new_in_same_image[0] = true;
+
+			uint32_t attr = this->DecodeAAttr(this->Pos2Shuff(level, tile_x, tile_y));
+			tile_attrs.push_back(attr);
+			if (attr != 0xFFFFFFFF)
+			{
+				std::array<int32_t, 9> new_tile_id_x;
+				std::array<int32_t, 9> new_tile_id_y;
+
+				int32_t left = tile_x - 1;
+				int32_t right = tile_x + 1;
+				int32_t up = tile_y - 1;
+				int32_t down = tile_y + 1;
+
+				ImageEntry const & entry = image_entries_[attr];
+				if (TAM_Wrap == (entry.addr_u_v & 0xF))
+				{
+					left = entry.x + (left - entry.x + entry.w) % entry.w;
+					right = entry.x + (right - entry.x + entry.w) % entry.w;
+				}
+				if (TAM_Wrap == ((entry.addr_u_v >> 4) & 0xF))
+				{
+					up = entry.y + (up - entry.y + entry.h) % entry.h;
+					down = entry.y + (down - entry.y + entry.h) % entry.h;
+				}
+
+				new_tile_id_x[1] = left;
+				new_tile_id_y[1] = up;
+				new_tile_id_x[2] = tile_x;
+				new_tile_id_y[2] = up;
+				new_tile_id_x[3] = right;
+				new_tile_id_y[3] = up;
+
+				new_tile_id_x[4] = left;
+				new_tile_id_y[4] = tile_y;
+				new_tile_id_x[5] = right;
+				new_tile_id_y[5] = tile_y;
+
+				new_tile_id_x[6] = left;
+				new_tile_id_y[6] = down;
+				new_tile_id_x[7] = tile_x;
+				new_tile_id_y[7] = down;
+				new_tile_id_x[8] = right;
+				new_tile_id_y[8] = down;
+
+				for (int j = 1; j < 9; ++ j)
+				{
+					if ((new_tile_id_x[j] >= 0) && (new_tile_id_y[j] >= 0)
+						&& (new_tile_id_x[j] < static_cast<int32_t>(num_tiles_) - 1)
+						&& (new_tile_id_y[j] < static_cast<int32_t>(num_tiles_) - 1))
 					{
-						if ((new_tile_id_x[j] >= 0) && (new_tile_id_y[j] >= 0)
-							&& (new_tile_id_x[j] < static_cast<int32_t>(num_tiles_) - 1)
-							&& (new_tile_id_y[j] < static_cast<int32_t>(num_tiles_) - 1))
+						new_tile_id_with_neighbors[j] = this->EncodeTileID(level, new_tile_id_x[j], new_tile_id_y[j]);
+						if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
 						{
-							new_tile_id_with_neighbors[j] = this->EncodeTileID(level, new_tile_id_x[j], new_tile_id_y[j]);
-							if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
+							if (attr == this->DecodeAAttr(this->Pos2Shuff(level, new_tile_id_x[j], new_tile_id_y[j])))
 							{
-								if (attr == this->DecodeAAttr(this->Pos2Shuff(level, new_tile_id_x[j], new_tile_id_y[j])))
-								{
-									new_in_same_image[j] = true;
-								}
+								new_in_same_image[j] = true;
 							}
 						}
-						else
-						{
-							new_tile_id_with_neighbors[j] = 0xFFFFFFFF;
-						}
+					}
+					else
+					{
+						new_tile_id_with_neighbors[j] = 0xFFFFFFFF;
 					}
 				}
+			}
 
-				for (size_t j = 0; j < new_tile_id_with_neighbors.size(); ++ j)
+			for (size_t j = 0; j < new_tile_id_with_neighbors.size(); ++ j)
+			{
+				if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
 				{
-					if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
+					if (neighbor_id_map.find(new_tile_id_with_neighbors[j]) == neighbor_id_map.end())
 					{
-						if (neighbor_id_map.find(new_tile_id_with_neighbors[j]) == neighbor_id_map.end())
-						{
-							neighbor_id_map.emplace(new_tile_id_with_neighbors[j], static_cast<uint32_t>(neighbor_ids.size()));
-							neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
-						}
+						neighbor_id_map.emplace(new_tile_id_with_neighbors[j], static_cast<uint32_t>(neighbor_ids.size()));
+						neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
 					}
-					all_neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
-					in_same_image.push_back(new_in_same_image[j]);
 				}
+				all_neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
+				in_same_image.push_back(new_in_same_image[j]);
 			}
 		}
 
-		uint32_t mipmaps = tex_cache_->NumMipMaps();
+		TexturePtr const & cache_tex = tex_cache_ ? tex_cache_ : tex_cache_array_[0];
+		uint32_t const mipmaps = cache_tex->NumMipMaps();
+		ElementFormat const format = cache_tex->Format();
 		std::vector<std::vector<uint8_t>> neighbor_data;
 		this->DecodeTiles(neighbor_data, neighbor_ids, mipmaps);
 
-		TileInfo tile_info;
-		tile_info.tick = tile_tick_;
 		for (size_t i = 0; i < all_neighbor_ids.size(); i += 9)
 		{
-			tile_info.attr = tile_attrs[i / 9];
+			uint32_t const attr = tile_attrs[i / 9];
 			uint8_t border_clr[4];
 			TexAddressingMode addr_u, addr_v;
-			if (tile_info.attr != 0xFFFFFFFF)
+			if (attr != 0xFFFFFFFF)
 			{
-				ImageEntry const & entry = image_entries_[tile_info.attr];
+				ImageEntry const & entry = image_entries_[attr];
 				addr_u = static_cast<TexAddressingMode>(entry.addr_u_v & 0xF);
 				addr_v = static_cast<TexAddressingMode>((entry.addr_u_v >> 4) & 0xF);
 				texel_op_.from_float4(border_clr, &entry.border_clr.r());
@@ -1403,76 +1699,10 @@ namespace KlayGE
 				border_clr[0] = border_clr[1] = border_clr[2] = border_clr[3] = 0;
 			}
 
-			if (tile_info_map_.size() < num_cache_total_tiles)
-			{
-				// Still has space in cache
-
-				uint32_t const s = tile_free_list_.front().first;
-				tile_info.z = s / num_cache_tiles_a_layer;
-				tile_info.y = (s - tile_info.z * num_cache_tiles_a_layer) / num_cache_tiles_a_row;
-				tile_info.x = s - tile_info.z * num_cache_tiles_a_layer - tile_info.y * num_cache_tiles_a_row;
-
-				++ tile_free_list_.front().first;
-				if (tile_free_list_.front().first == tile_free_list_.front().second)
-				{
-					tile_free_list_.pop_front();
-				}
-			}
-			else
-			{
-				// Find tiles that are not used for the longest time
-
-				uint64_t min_tick = tim.begin()->second.tick;
-				auto min_tileiter = tim.begin();
-				for (auto tileiter = tim.begin(); tileiter != tim.end(); ++ tileiter)
-				{
-					if (tileiter->second.tick < min_tick)
-					{
-						min_tick = tileiter->second.tick;
-						min_tileiter = tileiter;
-					}
-				}
-
-				tile_info.x = min_tileiter->second.x;
-				tile_info.y = min_tileiter->second.y;
-				tile_info.z = min_tileiter->second.z;
-
-				for (auto tileiter = tim.begin(); tileiter != tim.end();)
-				{
-					if (tileiter->second.tick == min_tick)
-					{
-						uint32_t const id = tileiter->second.z * num_cache_tiles_a_layer + tileiter->second.y * num_cache_tiles_a_row + tileiter->second.x;
-						auto freeiter = tile_free_list_.begin();
-						while ((freeiter != tile_free_list_.end()) && (freeiter->second <= id))
-						{
-							++ freeiter;
-						}
-						tile_free_list_.emplace(freeiter, id, id + 1);
-
-						tileiter = tim.erase(tileiter);
-					}
-					else
-					{
-						 ++ tileiter;
-					}
-				}
-				for (auto freeiter = tile_free_list_.begin(); freeiter != tile_free_list_.end() - 1;)
-				{
-					auto nextiter = freeiter;
-					++ nextiter;
-
-					if (freeiter->second == nextiter->first)
-					{
-						freeiter->second = nextiter->second;
-						freeiter = tile_free_list_.erase(nextiter);
-						-- freeiter;
-					}
-					else
-					{
-						++ freeiter;
-					}
-				}
-			}
+			BuiltTile built;
+			built.tile_id = all_neighbor_ids[i];
+			built.mip_data.resize(mipmaps);
+			built.mip_row_pitches.resize(mipmaps);
 
 			std::array<uint32_t, 9> index_with_neighbors = { { 0 } };
 			for (size_t j = 0; j < index_with_neighbors.size(); ++ j)
@@ -1534,7 +1764,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -1647,7 +1877,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_tile_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_tile_size * mip_border_size);
@@ -1757,7 +1987,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -1871,7 +2101,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_tile_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_tile_size);
@@ -1984,7 +2214,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_tile_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_tile_size);
@@ -2098,7 +2328,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -2211,7 +2441,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_tile_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_tile_size * mip_border_size);
@@ -2321,7 +2551,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -2426,33 +2656,10 @@ namespace KlayGE
 					}
 				}
 
-				ElementFormat format;
-				if (tex_cache_)
-				{
-					format = tex_cache_->Format();
-				}
-				else
-				{
-					format = tex_cache_array_[tile_info.z]->Format();
-				}
-
-				TexturePtr target_tex;
-				uint32_t target_array_index;
-				if (tex_cache_)
-				{
-					target_tex = tex_cache_;
-					target_array_index = tile_info.z;
-				}
-				else
-				{
-					target_tex = tex_cache_array_[tile_info.z];
-					target_array_index = 0;
-				}
-
 				if (IsCompressedFormat(format))
 				{
-					uint32_t const block_width = tex_codec_->BlockWidth();
-					uint32_t const block_height = tex_codec_->BlockHeight();
+					uint32_t const block_width = codec->BlockWidth();
+					uint32_t const block_height = codec->BlockHeight();
 					uint32_t const block_bytes = NumFormatBytes(format) * 4;
 					uint32_t const bc_row_pitch = (mip_tile_with_border_size + block_width - 1) / block_width * block_bytes;
 					uint32_t const bc_slice_pitch = (mip_tile_with_border_size + block_height - 1) / block_height * bc_row_pitch;
@@ -2531,21 +2738,17 @@ namespace KlayGE
 							KFL_UNREACHABLE("Not supported element format");
 						}
 
-						tex_codec_->EncodeMem(mip_tile_with_border_size, mip_tile_with_border_size,
+						codec->EncodeMem(mip_tile_with_border_size, mip_tile_with_border_size,
 							&bc[0], bc_row_pitch, bc_slice_pitch, p_argb, row_pitch, slice_pitch, TCM_Quality);
 					}
 
-					target_tex->UpdateSubresource2D(target_array_index, l,
-						tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
-						mip_tile_with_border_size, mip_tile_with_border_size,
-						&bc[0], bc_row_pitch);
+					built.mip_data[l].swap(bc);
+					built.mip_row_pitches[l] = bc_row_pitch;
 				}
 				else
 				{
-					target_tex->UpdateSubresource2D(target_array_index, l,
-						tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
-						mip_tile_with_border_size, mip_tile_with_border_size,
-						&tex_a_tile_data[0], mip_tile_with_border_size * texel_size_);
+					built.mip_data[l].swap(tex_a_tile_data);
+					built.mip_row_pitches[l] = mip_tile_with_border_size * texel_size_;
 				}
 
 				mip_tile_size /= 2;
@@ -2553,18 +2756,7 @@ namespace KlayGE
 				mip_border_size /= 2;
 			}
 
-			uint8_t const a_tile_indirect[] =
-			{
-				static_cast<uint8_t>(tile_info.x),
-				static_cast<uint8_t>(tile_info.y),
-				static_cast<uint8_t>(tile_info.z),
-				0
-			};
-			uint32_t level, tile_x, tile_y;
-			this->DecodeTileID(level, tile_x, tile_y, all_neighbor_ids[i]);
-			tex_indirect_->UpdateSubresource2D(0, 0, tile_x, tile_y, 1, 1, a_tile_indirect, sizeof(a_tile_indirect));
-
-			tim.emplace(all_neighbor_ids[i], tile_info);
+			tiles.push_back(std::move(built));
 		}
 	}
 }
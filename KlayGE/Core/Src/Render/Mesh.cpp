@@ -30,6 +30,8 @@
 #include <KlayGE/Camera.hpp>
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/LZMACodec.hpp>
+#include <KlayGE/LZ4Codec.hpp>
+#include <KFL/MappedFile.hpp>
 #include <KlayGE/Light.hpp>
 #include <KlayGE/RenderMaterial.hpp>
 #include <KFL/Hash.hpp>
@@ -48,7 +50,50 @@ namespace
 {
 	using namespace KlayGE;
 
-	uint32_t const MODEL_BIN_VERSION = 15;
+	uint32_t const MODEL_BIN_VERSION = 16;
+
+	// Since version 16, vertex and index streams are stored out of the LZMA compressed data, each one aligned in the file,
+	//  so the file can be mapped and the streams handed to GraphicsBuffer in place
+	uint32_t const MODEL_BIN_STREAM_ALIGNMENT = 16;
+
+	enum ModelBinStreamCodec
+	{
+		MBSC_None = 0,
+		MBSC_LZ4
+	};
+
+	struct ModelBinStreamDesc
+	{
+		uint64_t offset;
+		uint64_t len;
+		uint64_t original_len;
+		uint32_t codec;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(ModelBinStreamDesc) == 32, "sizeof(ModelBinStreamDesc) must be 32");
+
+	// Vertex streams followed by the index stream. A stream points into the file when it's stored uncompressed and needs no
+	//  conversion, otherwise into a decoded copy.
+	struct ModelBinStreams
+	{
+		std::shared_ptr<MappedFile> mapped_file;
+		// Used when the file can't be mapped, e.g. it's inside a package
+		std::vector<uint8_t> file_data;
+
+		std::vector<uint8_t const *> data;
+		std::vector<uint32_t> sizes;
+		std::vector<std::vector<uint8_t>> owned_data;
+	};
+
+	void LoadModelBin(std::string const & meshml_name, std::vector<RenderMaterialPtr>& mtls,
+		std::vector<VertexElement>& merged_ves, char& all_is_index_16_bit, ModelBinStreams& streams,
+		std::vector<std::string>& mesh_names, std::vector<int32_t>& mtl_ids, std::vector<uint32_t>& mesh_lods,
+		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs,
+		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
+		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_base_indices,
+		std::vector<Joint>& joints, std::shared_ptr<AnimationActionsType>& actions,
+		std::shared_ptr<KeyFramesType>& kfs, uint32_t& num_frames, uint32_t& frame_rate,
+		std::vector<std::shared_ptr<AABBKeyFrames>>& frame_pos_bbs);
 
 	class RenderModelLoadingDesc : public ResLoadingDesc
 	{
@@ -79,8 +124,7 @@ namespace
 
 				std::vector<VertexElement> merged_ves;
 				char all_is_index_16_bit;
-				std::vector<std::vector<uint8_t>> merged_buff;
-				std::vector<uint8_t> merged_indices;
+				ModelBinStreams streams;
 				std::vector<GraphicsBufferPtr> merged_vbs;
 				GraphicsBufferPtr merged_ib;
 
@@ -117,6 +161,11 @@ namespace
 			return type;
 		}
 
+		std::string_view Name() const override
+		{
+			return model_desc_.res_name;
+		}
+
 		bool StateLess() const override
 		{
 			return false;
@@ -148,9 +197,8 @@ namespace
 			std::vector<uint32_t> mesh_base_vertices;
 			std::vector<uint32_t> mesh_num_indices;
 			std::vector<uint32_t> mesh_start_indices;
-			LoadModel(model_desc_.res_name, model_desc_.model_data->mtls, model_desc_.model_data->merged_ves,
-				model_desc_.model_data->all_is_index_16_bit,
-				model_desc_.model_data->merged_buff, model_desc_.model_data->merged_indices,
+			LoadModelBin(model_desc_.res_name, model_desc_.model_data->mtls, model_desc_.model_data->merged_ves,
+				model_desc_.model_data->all_is_index_16_bit, model_desc_.model_data->streams,
 				mesh_names, mtl_ids, mesh_lods,
 				pos_bbs, tc_bbs,
 				mesh_num_vertices, mesh_base_vertices,
@@ -326,14 +374,15 @@ namespace
 
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
-			model_desc_.model_data->merged_vbs.resize(model_desc_.model_data->merged_buff.size());
-			for (size_t i = 0; i < model_desc_.model_data->merged_buff.size(); ++ i)
+			auto const & streams = model_desc_.model_data->streams;
+			model_desc_.model_data->merged_vbs.resize(model_desc_.model_data->merged_ves.size());
+			for (size_t i = 0; i < model_desc_.model_data->merged_ves.size(); ++ i)
 			{
 				model_desc_.model_data->merged_vbs[i] = rf.MakeDelayCreationVertexBuffer(BU_Static, model_desc_.access_hint,
-					static_cast<uint32_t>(model_desc_.model_data->merged_buff[i].size()));
+					streams.sizes[i]);
 			}
 			model_desc_.model_data->merged_ib = rf.MakeDelayCreationIndexBuffer(BU_Static, model_desc_.access_hint,
-				static_cast<uint32_t>(model_desc_.model_data->merged_indices.size()));
+				streams.sizes.back());
 
 			std::vector<StaticMeshPtr> meshes(model_desc_.model_data->meshes.size());
 			for (uint32_t mesh_index = 0; mesh_index < model_desc_.model_data->meshes.size(); ++ mesh_index)
@@ -352,7 +401,7 @@ namespace
 				mesh->NumLods(lods);
 				for (uint32_t lod = 0; lod < lods; ++ lod)
 				{
-					for (uint32_t ve_index = 0; ve_index < model_desc_.model_data->merged_buff.size(); ++ ve_index)
+					for (uint32_t ve_index = 0; ve_index < model_desc_.model_data->merged_ves.size(); ++ ve_index)
 					{
 						mesh->AddVertexStream(lod, model_desc_.model_data->merged_vbs[ve_index], model_desc_.model_data->merged_ves[ve_index]);
 					}
@@ -409,11 +458,12 @@ namespace
 			{
 				this->FillModel();
 
-				for (size_t i = 0; i < model_desc_.model_data->merged_buff.size(); ++ i)
+				auto const & streams = model_desc_.model_data->streams;
+				for (size_t i = 0; i < model_desc_.model_data->merged_ves.size(); ++ i)
 				{
-					model_desc_.model_data->merged_vbs[i]->CreateHWResource(&model_desc_.model_data->merged_buff[i][0]);
+					model_desc_.model_data->merged_vbs[i]->CreateHWResource(streams.data[i]);
 				}
-				model_desc_.model_data->merged_ib->CreateHWResource(&model_desc_.model_data->merged_indices[0]);
+				model_desc_.model_data->merged_ib->CreateHWResource(streams.data.back());
 
 				this->AddsSubPath();
 
@@ -1073,10 +1123,23 @@ namespace KlayGE
 		KFL_UNUSED(jit);
 #endif
 	}
+}
 
-	void LoadModel(std::string const & meshml_name, std::vector<RenderMaterialPtr>& mtls,
-		std::vector<VertexElement>& merged_ves, char& all_is_index_16_bit,
-		std::vector<std::vector<uint8_t>>& merged_buff, std::vector<uint8_t>& merged_indices,
+namespace
+{
+	uint8_t* MakeModelBinStreamWritable(ModelBinStreams& streams, size_t index)
+	{
+		auto& owned = streams.owned_data[index];
+		if (owned.empty())
+		{
+			owned.assign(streams.data[index], streams.data[index] + streams.sizes[index]);
+			streams.data[index] = owned.data();
+		}
+		return owned.data();
+	}
+
+	void LoadModelBin(std::string const & meshml_name, std::vector<RenderMaterialPtr>& mtls,
+		std::vector<VertexElement>& merged_ves, char& all_is_index_16_bit, ModelBinStreams& streams,
 		std::vector<std::string>& mesh_names, std::vector<int32_t>& mtl_ids, std::vector<uint32_t>& mesh_lods,
 		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs,
 		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
@@ -1085,10 +1148,10 @@ namespace KlayGE
 		std::shared_ptr<KeyFramesType>& kfs, uint32_t& num_frames, uint32_t& frame_rate,
 		std::vector<std::shared_ptr<AABBKeyFrames>>& frame_pos_bbs)
 	{
-		ResIdentifierPtr lzma_file;
+		std::string bin_name;
 		if (meshml_name.rfind(jit_ext_name) + jit_ext_name.size() == meshml_name.size())
 		{
-			lzma_file = ResLoader::Instance().Open(meshml_name);
+			bin_name = meshml_name;
 		}
 		else
 		{
@@ -1110,30 +1173,81 @@ namespace KlayGE
 			{
 				no_packing_name = full_meshml_name;
 			}
-			lzma_file = ResLoader::Instance().Open(no_packing_name + jit_ext_name);
+			bin_name = no_packing_name + jit_ext_name;
 		}
+
+		uint8_t const * file_begin;
+		uint64_t file_size;
+		{
+			std::string const full_bin_name = ResLoader::Instance().Locate(bin_name);
+			streams.mapped_file = MakeSharedPtr<MappedFile>();
+			if (!full_bin_name.empty() && streams.mapped_file->Map(full_bin_name))
+			{
+				file_begin = static_cast<uint8_t const *>(streams.mapped_file->Data());
+				file_size = streams.mapped_file->Size();
+			}
+			else
+			{
+				streams.mapped_file.reset();
+
+				ResIdentifierPtr file = ResLoader::Instance().Open(bin_name);
+				file->seekg(0, std::ios_base::end);
+				streams.file_data.resize(static_cast<size_t>(file->tellg()));
+				file->seekg(0, std::ios_base::beg);
+				file->read(streams.file_data.data(), streams.file_data.size());
+
+				file_begin = streams.file_data.data();
+				file_size = streams.file_data.size();
+			}
+		}
+		uint8_t const * p = file_begin;
+
 		uint32_t fourcc;
-		lzma_file->read(&fourcc, sizeof(fourcc));
+		std::memcpy(&fourcc, p, sizeof(fourcc));
+		p += sizeof(fourcc);
 		fourcc = LE2Native(fourcc);
 		BOOST_ASSERT((fourcc == MakeFourCC<'K', 'L', 'M', ' '>::value));
 
 		uint32_t ver;
-		lzma_file->read(&ver, sizeof(ver));
+		std::memcpy(&ver, p, sizeof(ver));
+		p += sizeof(ver);
 		ver = LE2Native(ver);
 		BOOST_ASSERT(MODEL_BIN_VERSION == ver);
 
-		std::shared_ptr<std::stringstream> ss = MakeSharedPtr<std::stringstream>();
-
 		uint64_t original_len, len;
-		lzma_file->read(&original_len, sizeof(original_len));
+		std::memcpy(&original_len, p, sizeof(original_len));
+		p += sizeof(original_len);
 		original_len = LE2Native(original_len);
-		lzma_file->read(&len, sizeof(len));
+		std::memcpy(&len, p, sizeof(len));
+		p += sizeof(len);
 		len = LE2Native(len);
 
+		uint32_t num_streams;
+		std::memcpy(&num_streams, p, sizeof(num_streams));
+		p += sizeof(num_streams);
+		num_streams = LE2Native(num_streams);
+		p += sizeof(uint32_t);
+
+		std::vector<ModelBinStreamDesc> stream_descs(num_streams);
+		for (uint32_t i = 0; i < num_streams; ++ i)
+		{
+			ModelBinStreamDesc& desc = stream_descs[i];
+			std::memcpy(&desc, p, sizeof(desc));
+			p += sizeof(desc);
+			desc.offset = LE2Native(desc.offset);
+			desc.len = LE2Native(desc.len);
+			desc.original_len = LE2Native(desc.original_len);
+			desc.codec = LE2Native(desc.codec);
+			BOOST_ASSERT(desc.offset + desc.len <= file_size);
+		}
+		KFL_UNUSED(file_size);
+
+		std::shared_ptr<std::stringstream> ss = MakeSharedPtr<std::stringstream>();
+
 		LZMACodec lzma;
-		lzma.Decode(*ss, lzma_file, len, original_len);
+		lzma.Decode(*ss, p, len, original_len);
 
-		ResIdentifierPtr decoded = MakeSharedPtr<ResIdentifier>(lzma_file->ResName(), lzma_file->Timestamp(), ss);
+		ResIdentifierPtr decoded = MakeSharedPtr<ResIdentifier>(bin_name, 0, ss);
 
 		uint32_t num_mtls;
 		decoded->read(&num_mtls, sizeof(num_mtls));
@@ -1249,18 +1363,38 @@ namespace KlayGE
 
 		int const index_elem_size = all_is_index_16_bit ? 2 : 4;
 
+		BOOST_ASSERT(num_streams == merged_ves.size() + 1);
+		streams.data.resize(num_streams);
+		streams.sizes.resize(num_streams);
+		streams.owned_data.resize(num_streams);
+		for (uint32_t i = 0; i < num_streams; ++ i)
+		{
+			ModelBinStreamDesc const & desc = stream_descs[i];
+			uint8_t const * stream_begin = file_begin + desc.offset;
+			streams.sizes[i] = static_cast<uint32_t>(desc.original_len);
+			if (MBSC_LZ4 == desc.codec)
+			{
+				LZ4Codec lz4;
+				lz4.Decode(streams.owned_data[i], stream_begin, desc.len, desc.original_len);
+				streams.data[i] = streams.owned_data[i].data();
+			}
+			else
+			{
+				BOOST_ASSERT(MBSC_None == desc.codec);
+				streams.data[i] = stream_begin;
+			}
+		}
+
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
-		merged_buff.resize(merged_ves.size());
-		for (size_t i = 0; i < merged_buff.size(); ++ i)
+		for (size_t i = 0; i < merged_ves.size(); ++ i)
 		{
-			merged_buff[i].resize(all_num_vertices * merged_ves[i].element_size());
-			decoded->read(&merged_buff[i][0], merged_buff[i].size() * sizeof(merged_buff[i][0]));
+			BOOST_ASSERT(streams.sizes[i] == all_num_vertices * merged_ves[i].element_size());
 
 			if ((EF_A2BGR10 == merged_ves[i].format) && !rf.RenderEngineInstance().DeviceCaps().vertex_format_support(EF_A2BGR10))
 			{
 				merged_ves[i].format = EF_ARGB8;
 
-				uint32_t* p = reinterpret_cast<uint32_t*>(&merged_buff[i][0]);
+				uint32_t* p = reinterpret_cast<uint32_t*>(MakeModelBinStreamWritable(streams, i));
 				for (uint32_t j = 0; j < all_num_vertices; ++ j)
 				{
 					float x = ((p[j] >>  0) & 0x3FF) / 1023.0f;
@@ -1280,7 +1414,7 @@ namespace KlayGE
 
 				merged_ves[i].format = EF_ABGR8;
 
-				uint32_t* p = reinterpret_cast<uint32_t*>(&merged_buff[i][0]);
+				uint32_t* p = reinterpret_cast<uint32_t*>(MakeModelBinStreamWritable(streams, i));
 				for (uint32_t j = 0; j < all_num_vertices; ++ j)
 				{
 					float x = ((p[j] >> 16) & 0xFF) / 255.0f;
@@ -1295,8 +1429,9 @@ namespace KlayGE
 				}
 			}
 		}
-		merged_indices.resize(all_num_indices * index_elem_size);
-		decoded->read(&merged_indices[0], merged_indices.size() * sizeof(merged_indices[0]));
+		BOOST_ASSERT(streams.sizes.back() == all_num_indices * index_elem_size);
+		KFL_UNUSED(all_num_indices);
+		KFL_UNUSED(index_elem_size);
 
 		mesh_names.resize(num_meshes);
 		mtl_ids.resize(num_meshes);
@@ -1504,6 +1639,34 @@ namespace KlayGE
 			}
 		}
 	}
+}
+
+namespace KlayGE
+{
+	void LoadModel(std::string const & meshml_name, std::vector<RenderMaterialPtr>& mtls,
+		std::vector<VertexElement>& merged_ves, char& all_is_index_16_bit,
+		std::vector<std::vector<uint8_t>>& merged_buff, std::vector<uint8_t>& merged_indices,
+		std::vector<std::string>& mesh_names, std::vector<int32_t>& mtl_ids, std::vector<uint32_t>& mesh_lods,
+		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs,
+		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
+		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_base_indices,
+		std::vector<Joint>& joints, std::shared_ptr<AnimationActionsType>& actions,
+		std::shared_ptr<KeyFramesType>& kfs, uint32_t& num_frames, uint32_t& frame_rate,
+		std::vector<std::shared_ptr<AABBKeyFrames>>& frame_pos_bbs)
+	{
+		ModelBinStreams streams;
+		LoadModelBin(meshml_name, mtls, merged_ves, all_is_index_16_bit, streams,
+			mesh_names, mtl_ids, mesh_lods, pos_bbs, tc_bbs,
+			mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_base_indices,
+			joints, actions, kfs, num_frames, frame_rate, frame_pos_bbs);
+
+		merged_buff.resize(merged_ves.size());
+		for (size_t i = 0; i < merged_buff.size(); ++ i)
+		{
+			merged_buff[i].assign(streams.data[i], streams.data[i] + streams.sizes[i]);
+		}
+		merged_indices.assign(streams.data.back(), streams.data.back() + streams.sizes.back());
+	}
 
 	RenderModelPtr SyncLoadModel(std::string const & meshml_name, uint32_t access_hint,
 		std::function<RenderModelPtr(std::wstring const &)> CreateModelFactoryFunc,
@@ -1926,9 +2089,7 @@ namespace KlayGE
 		std::vector<AABBox> const & pos_bbs, std::vector<AABBox> const & tc_bbs,
 		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
 		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_start_indices,
-		std::vector<VertexElement> const & merged_ves,
-		std::vector<std::vector<uint8_t>> const & merged_vertices, std::vector<uint8_t> const & merged_indices,
-		char is_index_16_bit, std::ostream& os)
+		std::vector<VertexElement> const & merged_ves, char is_index_16_bit, std::ostream& os)
 	{
 		uint32_t num_merged_ves = Native2LE(static_cast<uint32_t>(merged_ves.size()));
 		os.write(reinterpret_cast<char*>(&num_merged_ves), sizeof(num_merged_ves));
@@ -1946,12 +2107,6 @@ namespace KlayGE
 		os.write(reinterpret_cast<char*>(&num_indices), sizeof(num_indices));
 		os.write(&is_index_16_bit, sizeof(is_index_16_bit));
 
-		for (size_t i = 0; i < merged_vertices.size(); ++ i)
-		{
-			os.write(reinterpret_cast<char const *>(&merged_vertices[i][0]), merged_vertices[i].size() * sizeof(merged_vertices[i][0]));
-		}
-		os.write(reinterpret_cast<char const *>(&merged_indices[0]), merged_indices.size() * sizeof(merged_indices[0]));
-
 		uint32_t mesh_lod_index = 0;
 		for (uint32_t mesh_index = 0; mesh_index < mesh_names.size(); ++ mesh_index)
 		{
@@ -2104,7 +2259,7 @@ namespace KlayGE
 		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
 		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_base_indices,
 		std::vector<Joint> const & joints, std::shared_ptr<AnimationActionsType> const & actions,
-		std::shared_ptr<KeyFramesType> const & kfs, uint32_t num_frames, uint32_t frame_rate)
+		std::shared_ptr<KeyFramesType> const & kfs, uint32_t num_frames, uint32_t frame_rate, bool compress_streams)
 	{
 		std::ostringstream ss;
 
@@ -2134,7 +2289,7 @@ namespace KlayGE
 		{
 			WriteMeshesChunk(mesh_names, mtl_ids, mesh_lods, pos_bbs, tc_bbs,
 				mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_base_indices,
-				merged_ves, merged_buffs, merged_indices, all_is_index_16_bit, ss);
+				merged_ves, all_is_index_16_bit, ss);
 		}
 
 		if (!joints.empty())
@@ -2175,19 +2330,89 @@ namespace KlayGE
 		uint32_t ver = Native2LE(MODEL_BIN_VERSION);
 		ofs.write(reinterpret_cast<char*>(&ver), sizeof(ver));
 
-		uint64_t original_len = Native2LE(static_cast<uint64_t>(ss.str().size()));
-		ofs.write(reinterpret_cast<char*>(&original_len), sizeof(original_len));
+		std::string const meta = ss.str();
+		std::vector<uint8_t> encoded_meta;
+		LZMACodec lzma;
+		lzma.Encode(encoded_meta, meta.c_str(), meta.size());
 
-		std::ofstream::pos_type p = ofs.tellp();
-		uint64_t len = 0;
+		uint64_t original_len = Native2LE(static_cast<uint64_t>(meta.size()));
+		ofs.write(reinterpret_cast<char*>(&original_len), sizeof(original_len));
+		uint64_t len = Native2LE(static_cast<uint64_t>(encoded_meta.size()));
 		ofs.write(reinterpret_cast<char*>(&len), sizeof(len));
 
-		LZMACodec lzma;
-		len = lzma.Encode(ofs, ss.str().c_str(), ss.str().size());
+		std::vector<uint8_t const *> stream_data;
+		std::vector<uint64_t> stream_sizes;
+		for (auto const & buff : merged_buffs)
+		{
+			stream_data.push_back(buff.data());
+			stream_sizes.push_back(buff.size());
+		}
+		stream_data.push_back(merged_indices.data());
+		stream_sizes.push_back(merged_indices.size());
+
+		uint32_t const num_streams = static_cast<uint32_t>(stream_data.size());
+		uint32_t tmp = Native2LE(num_streams);
+		ofs.write(reinterpret_cast<char*>(&tmp), sizeof(tmp));
+		tmp = 0;
+		ofs.write(reinterpret_cast<char*>(&tmp), sizeof(tmp));
+
+		// Streams are kept uncompressed unless asked, and only if compression actually saves space
+		std::vector<std::vector<uint8_t>> encoded_streams(num_streams);
+		std::vector<ModelBinStreamDesc> stream_descs(num_streams);
+		uint64_t offset = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2
+			+ num_streams * sizeof(ModelBinStreamDesc) + encoded_meta.size();
+		for (uint32_t i = 0; i < num_streams; ++ i)
+		{
+			ModelBinStreamDesc& desc = stream_descs[i];
+			desc.original_len = stream_sizes[i];
+			desc.len = stream_sizes[i];
+			desc.codec = MBSC_None;
+			desc.reserved = 0;
+			if (compress_streams && (stream_sizes[i] > 0))
+			{
+				LZ4Codec lz4;
+				lz4.Encode(encoded_streams[i], stream_data[i], stream_sizes[i]);
+				if (encoded_streams[i].size() < stream_sizes[i])
+				{
+					desc.len = encoded_streams[i].size();
+					desc.codec = MBSC_LZ4;
+				}
+				else
+				{
+					encoded_streams[i].clear();
+				}
+			}
 
-		ofs.seekp(p, std::ios_base::beg);
-		len = Native2LE(len);
-		ofs.write(reinterpret_cast<char*>(&len), sizeof(len));
+			offset = (offset + MODEL_BIN_STREAM_ALIGNMENT - 1) & ~static_cast<uint64_t>(MODEL_BIN_STREAM_ALIGNMENT - 1);
+			desc.offset = offset;
+			offset += desc.len;
+
+			ModelBinStreamDesc le_desc = desc;
+			le_desc.offset = Native2LE(le_desc.offset);
+			le_desc.len = Native2LE(le_desc.len);
+			le_desc.original_len = Native2LE(le_desc.original_len);
+			le_desc.codec = Native2LE(le_desc.codec);
+			ofs.write(reinterpret_cast<char*>(&le_desc), sizeof(le_desc));
+		}
+
+		ofs.write(reinterpret_cast<char const *>(encoded_meta.data()), encoded_meta.size());
+
+		for (uint32_t i = 0; i < num_streams; ++ i)
+		{
+			uint64_t const pos = static_cast<uint64_t>(ofs.tellp());
+			BOOST_ASSERT(pos <= stream_descs[i].offset);
+			char const padding[MODEL_BIN_STREAM_ALIGNMENT] = { 0 };
+			ofs.write(padding, static_cast<std::streamsize>(stream_descs[i].offset - pos));
+
+			if (MBSC_LZ4 == stream_descs[i].codec)
+			{
+				ofs.write(reinterpret_cast<char const *>(encoded_streams[i].data()), encoded_streams[i].size());
+			}
+			else
+			{
+				ofs.write(reinterpret_cast<char const *>(stream_data[i]), stream_sizes[i]);
+			}
+		}
 	}
 
 	void SaveModel(std::string const & meshml_name, std::vector<RenderMaterialPtr> const & mtls,
@@ -2198,14 +2423,14 @@ namespace KlayGE
 		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
 		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_base_indices,
 		std::vector<Joint> const & joints, std::shared_ptr<AnimationActionsType> const & actions,
-		std::shared_ptr<KeyFramesType> const & kfs, uint32_t num_frames, uint32_t frame_rate)
+		std::shared_ptr<KeyFramesType> const & kfs, uint32_t num_frames, uint32_t frame_rate, bool compress_streams)
 	{
 		if (meshml_name.find(jit_ext_name) != std::string::npos)
 		{
 			SaveModelToJIT(meshml_name, mtls, merged_ves, all_is_index_16_bit, merged_buffs, merged_indices,
 				mesh_names, mtl_ids, mesh_lods, pos_bbs, tc_bbs, mesh_num_vertices, mesh_base_vertices,
 				mesh_num_indices, mesh_base_indices, joints, actions,
-				kfs, num_frames, frame_rate);
+				kfs, num_frames, frame_rate, compress_streams);
 		}
 		else
 		{
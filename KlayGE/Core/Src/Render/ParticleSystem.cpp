@@ -41,9 +41,17 @@
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/RadixSort.hpp>
+#include <KFL/TaskScheduler.hpp>
 
 #include <fstream>
 
+#if defined(KLAYGE_AVX_SUPPORT)
+#include <immintrin.h>
+#elif defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
 #if defined(KLAYGE_COMPILER_CLANGC2)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-variable" // Ignore unused variable (mpl_assertion_in_line_xxx) in boost
@@ -70,6 +78,171 @@ namespace
 
 	uint32_t const NUM_PARTICLES = 4096;
 
+#if defined(KLAYGE_AVX_SUPPORT)
+	uint32_t const PARTICLE_BATCH = 8;
+	typedef __m256 ParticleVec;
+
+	ParticleVec VecLoad(float const * p)
+	{
+		return _mm256_loadu_ps(p);
+	}
+	void VecStore(float* p, ParticleVec v)
+	{
+		_mm256_storeu_ps(p, v);
+	}
+	ParticleVec VecSet1(float f)
+	{
+		return _mm256_set1_ps(f);
+	}
+	ParticleVec VecAdd(ParticleVec a, ParticleVec b)
+	{
+		return _mm256_add_ps(a, b);
+	}
+	ParticleVec VecSub(ParticleVec a, ParticleVec b)
+	{
+		return _mm256_sub_ps(a, b);
+	}
+	ParticleVec VecMul(ParticleVec a, ParticleVec b)
+	{
+		return _mm256_mul_ps(a, b);
+	}
+	ParticleVec VecGreater(ParticleVec a, ParticleVec b)
+	{
+		return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+	}
+	ParticleVec VecSelect(ParticleVec mask, ParticleVec a, ParticleVec b)
+	{
+		return _mm256_blendv_ps(b, a, mask);
+	}
+#elif defined(KLAYGE_SSE_SUPPORT)
+	uint32_t const PARTICLE_BATCH = 4;
+	typedef __m128 ParticleVec;
+
+	ParticleVec VecLoad(float const * p)
+	{
+		return _mm_loadu_ps(p);
+	}
+	void VecStore(float* p, ParticleVec v)
+	{
+		_mm_storeu_ps(p, v);
+	}
+	ParticleVec VecSet1(float f)
+	{
+		return _mm_set1_ps(f);
+	}
+	ParticleVec VecAdd(ParticleVec a, ParticleVec b)
+	{
+		return _mm_add_ps(a, b);
+	}
+	ParticleVec VecSub(ParticleVec a, ParticleVec b)
+	{
+		return _mm_sub_ps(a, b);
+	}
+	ParticleVec VecMul(ParticleVec a, ParticleVec b)
+	{
+		return _mm_mul_ps(a, b);
+	}
+	ParticleVec VecGreater(ParticleVec a, ParticleVec b)
+	{
+		return _mm_cmpgt_ps(a, b);
+	}
+	ParticleVec VecSelect(ParticleVec mask, ParticleVec a, ParticleVec b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+#else
+	uint32_t const PARTICLE_BATCH = 1;
+	typedef float ParticleVec;
+
+	ParticleVec VecLoad(float const * p)
+	{
+		return *p;
+	}
+	void VecStore(float* p, ParticleVec v)
+	{
+		*p = v;
+	}
+	ParticleVec VecSet1(float f)
+	{
+		return f;
+	}
+	ParticleVec VecAdd(ParticleVec a, ParticleVec b)
+	{
+		return a + b;
+	}
+	ParticleVec VecSub(ParticleVec a, ParticleVec b)
+	{
+		return a - b;
+	}
+	ParticleVec VecMul(ParticleVec a, ParticleVec b)
+	{
+		return a * b;
+	}
+	ParticleVec VecGreater(ParticleVec a, ParticleVec b)
+	{
+		return (a > b) ? 1.0f : 0.0f;
+	}
+	ParticleVec VecSelect(ParticleVec mask, ParticleVec a, ParticleVec b)
+	{
+		return (mask != 0) ? a : b;
+	}
+#endif
+
+	// Multiple of PARTICLE_BATCH, so spans given to the updaters start on a batch
+	uint32_t const PARTICLE_GRAIN = 4096;
+	uint32_t const PARTICLE_PARALLEL_THRESHOLD = 4 * PARTICLE_GRAIN;
+	uint32_t const POLYLINE_CURVE_SAMPLES = 256;
+
+	// Calls kernel(span, i) on every batch of PARTICLE_BATCH particles of the span. A partial batch at the end goes
+	//  through a local copy padded with dead particles.
+	template <typename Kernel>
+	void ForEachParticleBatch(ParticleSpan const & span, Kernel const & kernel)
+	{
+		uint32_t const num_full = span.num / PARTICLE_BATCH * PARTICLE_BATCH;
+		for (uint32_t i = 0; i < num_full; i += PARTICLE_BATCH)
+		{
+			kernel(span, i);
+		}
+
+		uint32_t const num_rest = span.num - num_full;
+		if (num_rest > 0)
+		{
+			std::array<std::array<float, PARTICLE_BATCH>, 11> tail;
+			std::array<float*, 11> src_ptrs = { span.pos_x, span.pos_y, span.pos_z, span.vel_x, span.vel_y, span.vel_z,
+				span.life, span.spin, span.size, span.alpha, span.init_life };
+			for (size_t a = 0; a < tail.size(); ++ a)
+			{
+				tail[a].fill(0);
+				std::copy(src_ptrs[a] + num_full, src_ptrs[a] + span.num, tail[a].begin());
+			}
+
+			ParticleSpan const tail_span = { tail[0].data(), tail[1].data(), tail[2].data(), tail[3].data(),
+				tail[4].data(), tail[5].data(), tail[6].data(), tail[7].data(), tail[8].data(), tail[9].data(),
+				tail[10].data(), PARTICLE_BATCH };
+			kernel(tail_span, 0);
+
+			for (size_t a = 0; a < tail.size(); ++ a)
+			{
+				std::copy(tail[a].begin(), tail[a].begin() + num_rest, src_ptrs[a] + num_full);
+			}
+		}
+	}
+
+	float EvalPolyline(std::vector<float2> const & polyline, float pos)
+	{
+		float ret = polyline.back().y();
+		for (auto iter = polyline.begin(); iter != polyline.end() - 1; ++ iter)
+		{
+			if ((iter + 1)->x() >= pos)
+			{
+				float const s = (pos - iter->x()) / ((iter + 1)->x() - iter->x());
+				ret = MathLib::lerp(iter->y(), (iter + 1)->y(), s);
+				break;
+			}
+		}
+		return ret;
+	}
+
 	class ParticleSystemLoadingDesc : public ResLoadingDesc
 	{
 	private:
@@ -120,6 +293,11 @@ namespace
 			return type;
 		}
 
+		std::string_view Name() const override
+		{
+			return ps_desc_.res_name;
+		}
+
 		bool StateLess() const override
 		{
 			return false;
@@ -604,6 +782,38 @@ namespace KlayGE
 	{
 	}
 
+	void ParticleUpdater::Update(ParticleSpan const & span, float elapse_time)
+	{
+		for (uint32_t i = 0; i < span.num; ++ i)
+		{
+			if (span.life[i] > 0)
+			{
+				Particle par;
+				par.pos = float3(span.pos_x[i], span.pos_y[i], span.pos_z[i]);
+				par.vel = float3(span.vel_x[i], span.vel_y[i], span.vel_z[i]);
+				par.life = span.life[i];
+				par.spin = span.spin[i];
+				par.size = span.size[i];
+				par.alpha = span.alpha[i];
+				par.init_life = span.init_life[i];
+
+				this->Update(par, elapse_time);
+
+				span.pos_x[i] = par.pos.x();
+				span.pos_y[i] = par.pos.y();
+				span.pos_z[i] = par.pos.z();
+				span.vel_x[i] = par.vel.x();
+				span.vel_y[i] = par.vel.y();
+				span.vel_z[i] = par.vel.z();
+				span.life[i] = par.life;
+				span.spin[i] = par.spin;
+				span.size[i] = par.size;
+				span.alpha[i] = par.alpha;
+				span.init_life[i] = par.init_life;
+			}
+		}
+	}
+
 	void ParticleUpdater::DoClone(ParticleUpdaterPtr const & rhs)
 	{
 		rhs->ps_ = ps_;
@@ -612,9 +822,16 @@ namespace KlayGE
 
 	ParticleSystem::ParticleSystem(uint32_t max_num_particles)
 		: SceneObjectHelper(SOA_Moveable | SOA_NotCastShadow),
-			particles_(max_num_particles),
+			max_num_particles_(max_num_particles),
 			gravity_(0.5f), force_(0, 0, 0), media_density_(0.0f)
 	{
+		uint32_t const padded_num = (max_num_particles + PARTICLE_GRAIN - 1) / PARTICLE_GRAIN * PARTICLE_GRAIN;
+		for (auto& attrib : particle_attribs_)
+		{
+			attrib.resize(padded_num);
+		}
+		particle_alive_.resize(padded_num);
+
 		this->ClearParticles();
 
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
@@ -730,81 +947,203 @@ namespace KlayGE
 		return actived_particles_[i].first;
 	}
 
+	Particle ParticleSystem::GetParticle(uint32_t i) const
+	{
+		BOOST_ASSERT(i < max_num_particles_);
+
+		Particle par;
+		par.pos = float3(particle_attribs_[PA_PosX][i], particle_attribs_[PA_PosY][i], particle_attribs_[PA_PosZ][i]);
+		par.vel = float3(particle_attribs_[PA_VelX][i], particle_attribs_[PA_VelY][i], particle_attribs_[PA_VelZ][i]);
+		par.life = particle_attribs_[PA_Life][i];
+		par.spin = particle_attribs_[PA_Spin][i];
+		par.size = particle_attribs_[PA_Size][i];
+		par.alpha = particle_attribs_[PA_Alpha][i];
+		par.init_life = particle_attribs_[PA_InitLife][i];
+		return par;
+	}
+
+	void ParticleSystem::WriteParticle(uint32_t i, Particle const & par)
+	{
+		particle_attribs_[PA_PosX][i] = par.pos.x();
+		particle_attribs_[PA_PosY][i] = par.pos.y();
+		particle_attribs_[PA_PosZ][i] = par.pos.z();
+		particle_attribs_[PA_VelX][i] = par.vel.x();
+		particle_attribs_[PA_VelY][i] = par.vel.y();
+		particle_attribs_[PA_VelZ][i] = par.vel.z();
+		particle_attribs_[PA_Life][i] = par.life;
+		particle_attribs_[PA_Spin][i] = par.spin;
+		particle_attribs_[PA_Size][i] = par.size;
+		particle_attribs_[PA_Alpha][i] = par.alpha;
+		particle_attribs_[PA_InitLife][i] = par.init_life;
+	}
+
+	ParticleSpan ParticleSystem::MakeSpan(uint32_t begin, uint32_t end)
+	{
+		ParticleSpan span;
+		span.pos_x = &particle_attribs_[PA_PosX][begin];
+		span.pos_y = &particle_attribs_[PA_PosY][begin];
+		span.pos_z = &particle_attribs_[PA_PosZ][begin];
+		span.vel_x = &particle_attribs_[PA_VelX][begin];
+		span.vel_y = &particle_attribs_[PA_VelY][begin];
+		span.vel_z = &particle_attribs_[PA_VelZ][begin];
+		span.life = &particle_attribs_[PA_Life][begin];
+		span.spin = &particle_attribs_[PA_Spin][begin];
+		span.size = &particle_attribs_[PA_Size][begin];
+		span.alpha = &particle_attribs_[PA_Alpha][begin];
+		span.init_life = &particle_attribs_[PA_InitLife][begin];
+		span.num = end - begin;
+		return span;
+	}
+
 	void ParticleSystem::ClearParticles()
 	{
-		for (auto& particle : particles_)
+		for (auto& attrib : particle_attribs_)
 		{
-			particle.life = 0;
+			std::fill(attrib.begin(), attrib.end(), 0.0f);
+		}
+		std::fill(particle_alive_.begin(), particle_alive_.end(), static_cast<uint8_t>(0));
+
+		// Popped from the back, so the particles are emitted from index 0 up
+		free_particles_.resize(max_num_particles_);
+		for (uint32_t i = 0; i < max_num_particles_; ++ i)
+		{
+			free_particles_[i] = max_num_particles_ - 1 - i;
 		}
 	}
 
 	void ParticleSystem::UpdateParticlesNoLock(float elapsed_time, std::vector<std::pair<uint32_t, float>>& actived_particles)
 	{
-		auto emitter_iter = emitters_.begin();
-		uint32_t new_particle = (*emitter_iter)->Update(elapsed_time);
+		task_scheduler& ts = Context::Instance().TaskScheduler();
+		uint32_t const padded_num = static_cast<uint32_t>(particle_alive_.size());
 
-		float4x4 const & view_mat = Context::Instance().AppInstance().ActiveCamera().ViewMatrix();
-
-		actived_particles.clear();
-
-		float3 min_bb(+1e10f, +1e10f, +1e10f);
-		float3 max_bb(-1e10f, -1e10f, -1e10f);
+		bool parallel = (padded_num >= PARTICLE_PARALLEL_THRESHOLD);
+		for (auto const & updater : updaters_)
+		{
+			parallel &= updater->ParallelUpdate();
+		}
 
-		for (uint32_t i = 0; i < particles_.size(); ++ i)
+		// Live particles first, dead ones are skipped by the updaters
+		auto update_particles = [this, elapsed_time](uint32_t begin, uint32_t end)
+		{
+			ParticleSpan const span = this->MakeSpan(begin, end);
+			for (auto const & updater : updaters_)
+			{
+				updater->Update(span, elapsed_time);
+			}
+		};
+		if (parallel)
+		{
+			ts.parallel_for(0, padded_num, PARTICLE_GRAIN, update_particles);
+		}
+		else
 		{
-			Particle& particle = particles_[i];
+			update_particles(0, padded_num);
+		}
 
-			if (particle.life > 0)
+		// New particles take the slots of the ones died before this frame, as before
+		for (auto const & emitter : emitters_)
+		{
+			uint32_t new_particle = emitter->Update(elapsed_time);
+			for (; (new_particle > 0) && !free_particles_.empty(); -- new_particle)
 			{
+				uint32_t const index = free_particles_.back();
+				free_particles_.pop_back();
+
+				Particle par = {};
+				emitter->Emit(par);
+				this->WriteParticle(index, par);
+				particle_alive_[index] = 1;
+
+				ParticleSpan const span = this->MakeSpan(index, index + 1);
 				for (auto const & updater : updaters_)
 				{
-					updater->Update(particle, elapsed_time);
+					updater->Update(span, 0);
 				}
 			}
-			else
+		}
+
+		// Collects the live particles with their depth, and the ones died this frame, per chunk
+		struct ScanChunk
+		{
+			std::vector<std::pair<uint32_t, float>> actives;
+			std::vector<uint32_t> deads;
+			float3 min_bb;
+			float3 max_bb;
+		};
+		std::vector<ScanChunk> chunks((padded_num + PARTICLE_GRAIN - 1) / PARTICLE_GRAIN);
+
+		float4x4 const & view_mat = Context::Instance().AppInstance().ActiveCamera().ViewMatrix();
+		auto scan_particles = [this, &chunks, &view_mat](uint32_t begin, uint32_t end)
+		{
+			float const * pos_x = particle_attribs_[PA_PosX].data();
+			float const * pos_y = particle_attribs_[PA_PosY].data();
+			float const * pos_z = particle_attribs_[PA_PosZ].data();
+			float const * life = particle_attribs_[PA_Life].data();
+
+			for (uint32_t c = begin / PARTICLE_GRAIN; c < (end + PARTICLE_GRAIN - 1) / PARTICLE_GRAIN; ++ c)
 			{
-				if (new_particle > 0)
-				{
-					(*emitter_iter)->Emit(particle);
-					for (auto const & updater : updaters_)
-					{
-						updater->Update(particle, 0);
-					}
-					-- new_particle;
-				}
-				else
+				ScanChunk& chunk = chunks[c];
+				chunk.min_bb = float3(+1e10f, +1e10f, +1e10f);
+				chunk.max_bb = float3(-1e10f, -1e10f, -1e10f);
+
+				uint32_t const chunk_end = std::min((c + 1) * PARTICLE_GRAIN, end);
+				for (uint32_t i = c * PARTICLE_GRAIN; i < chunk_end; ++ i)
 				{
-					if (emitter_iter != emitters_.end())
+					if (particle_alive_[i])
 					{
-						++ emitter_iter;
-						if (emitter_iter != emitters_.end())
+						if (life[i] > 0)
+						{
+							float3 const pos(pos_x[i], pos_y[i], pos_z[i]);
+							float p_to_v = (pos.x() * view_mat(0, 2) + pos.y() * view_mat(1, 2) + pos.z() * view_mat(2, 2) + view_mat(3, 2))
+								/ (pos.x() * view_mat(0, 3) + pos.y() * view_mat(1, 3) + pos.z() * view_mat(2, 3) + view_mat(3, 3));
+
+							chunk.actives.emplace_back(i, p_to_v);
+
+							chunk.min_bb = MathLib::minimize(chunk.min_bb, pos);
+							chunk.max_bb = MathLib::maximize(chunk.max_bb, pos);
+						}
+						else
 						{
-							new_particle = (*emitter_iter)->Update(elapsed_time);
+							particle_alive_[i] = 0;
+							chunk.deads.push_back(i);
 						}
 					}
 				}
 			}
+		};
+		if (parallel)
+		{
+			ts.parallel_for(0, padded_num, PARTICLE_GRAIN, scan_particles);
+		}
+		else
+		{
+			scan_particles(0, padded_num);
+		}
 
-			if (particle.life > 0)
-			{
-				float3 const & pos = particle.pos;
-				float p_to_v = (pos.x() * view_mat(0, 2) + pos.y() * view_mat(1, 2) + pos.z() * view_mat(2, 2) + view_mat(3, 2))
-					/ (pos.x() * view_mat(0, 3) + pos.y() * view_mat(1, 3) + pos.z() * view_mat(2, 3) + view_mat(3, 3));
+		actived_particles.clear();
 
-				actived_particles.emplace_back(i, p_to_v);
+		float3 min_bb(+1e10f, +1e10f, +1e10f);
+		float3 max_bb(-1e10f, -1e10f, -1e10f);
+		for (auto const & chunk : chunks)
+		{
+			actived_particles.insert(actived_particles.end(), chunk.actives.begin(), chunk.actives.end());
+			free_particles_.insert(free_particles_.end(), chunk.deads.begin(), chunk.deads.end());
 
-				min_bb = MathLib::minimize(min_bb, pos);
-				max_bb = MathLib::maximize(min_bb, pos);
-			}
+			min_bb = MathLib::minimize(min_bb, chunk.min_bb);
+			max_bb = MathLib::maximize(max_bb, chunk.max_bb);
 		}
 
 		if (!actived_particles.empty())
 		{
-			std::sort(actived_particles.begin(), actived_particles.end(),
-				[](std::pair<uint32_t, float> const & lhs, std::pair<uint32_t, float> const & rhs)
+			// Back to front
+			actived_particles_sort_buff_.resize(actived_particles.size());
+			RadixSort(actived_particles.data(), actived_particles_sort_buff_.data(),
+				static_cast<uint32_t>(actived_particles.size()),
+				[](std::pair<uint32_t, float> const & par)
 				{
-					return lhs.second > rhs.second;
-				});
+					return ~RadixSortKey(par.second);
+				},
+				parallel ? &ts : nullptr);
 
 			checked_pointer_cast<RenderParticles>(renderable_)->PosBound(AABBox(min_bb, max_bb));
 		}
@@ -861,13 +1200,16 @@ namespace KlayGE
 				ParticleInstance* instance_data = mapper.Pointer<ParticleInstance>();
 				for (uint32_t i = 0; i < num_active_particles; ++ i, ++ instance_data)
 				{
-					Particle const & par = particles_[actived_particles[i].first];
-					instance_data->pos = par.pos;
-					instance_data->life = par.life;
-					instance_data->spin = par.spin;
-					instance_data->size = par.size;
-					instance_data->life_factor = (par.init_life - par.life) / par.init_life;
-					instance_data->alpha = par.alpha;
+					uint32_t const index = actived_particles[i].first;
+					float const life = particle_attribs_[PA_Life][index];
+					float const init_life = particle_attribs_[PA_InitLife][index];
+					instance_data->pos = float3(particle_attribs_[PA_PosX][index], particle_attribs_[PA_PosY][index],
+						particle_attribs_[PA_PosZ][index]);
+					instance_data->life = life;
+					instance_data->spin = particle_attribs_[PA_Spin][index];
+					instance_data->size = particle_attribs_[PA_Size][index];
+					instance_data->life_factor = (init_life - life) / init_life;
+					instance_data->alpha = particle_attribs_[PA_Alpha][index];
 				}
 			}
 		}
@@ -1178,38 +1520,9 @@ namespace KlayGE
 
 		float pos = (par.init_life - par.life) / par.init_life;
 
-		float cur_size = size_over_life_.back().y();
-		for (auto iter = size_over_life_.begin(); iter != size_over_life_.end() - 1; ++ iter)
-		{
-			if ((iter + 1)->x() >= pos)
-			{
-				float const s = (pos - iter->x()) / ((iter + 1)->x() - iter->x());
-				cur_size = MathLib::lerp(iter->y(), (iter + 1)->y(), s);
-				break;
-			}
-		}
-
-		float cur_mass = mass_over_life_.back().y();
-		for (auto iter = mass_over_life_.begin(); iter != mass_over_life_.end() - 1; ++ iter)
-		{
-			if ((iter + 1)->x() >= pos)
-			{
-				float const s = (pos - iter->x()) / ((iter + 1)->x() - iter->x());
-				cur_mass = MathLib::lerp(iter->y(), (iter + 1)->y(), s);
-				break;
-			}
-		}
-
-		float cur_alpha = opacity_over_life_.back().y();
-		for (auto iter = opacity_over_life_.begin(); iter != opacity_over_life_.end() - 1; ++ iter)
-		{
-			if ((iter + 1)->x() >= pos)
-			{
-				float const s = (pos - iter->x()) / ((iter + 1)->x() - iter->x());
-				cur_alpha = MathLib::lerp(iter->y(), (iter + 1)->y(), s);
-				break;
-			}
-		}
+		float cur_size = EvalPolyline(size_over_life_, pos);
+		float cur_mass = EvalPolyline(mass_over_life_, pos);
+		float cur_alpha = EvalPolyline(opacity_over_life_, pos);
 
 		ParticleSystemPtr ps = ps_.lock();
 		float buoyancy = 4.0f / 3 * PI * MathLib::cube(cur_size) * ps->MediaDensity() * ps->Gravity();
@@ -1221,4 +1534,113 @@ namespace KlayGE
 		par.size = cur_size;
 		par.alpha = cur_alpha;
 	}
+
+	std::shared_ptr<std::vector<PolylineParticleUpdater::CurveSample>> PolylineParticleUpdater::BakedCurves()
+	{
+		std::lock_guard<std::mutex> lock(update_mutex_);
+
+		if (!baked_curves_)
+		{
+			BOOST_ASSERT(!size_over_life_.empty());
+			BOOST_ASSERT(!mass_over_life_.empty());
+			BOOST_ASSERT(!opacity_over_life_.empty());
+
+			auto curves = MakeSharedPtr<std::vector<CurveSample>>(POLYLINE_CURVE_SAMPLES);
+			for (uint32_t i = 0; i < POLYLINE_CURVE_SAMPLES; ++ i)
+			{
+				float const pos = static_cast<float>(i) / (POLYLINE_CURVE_SAMPLES - 1);
+				float const size = EvalPolyline(size_over_life_, pos);
+				float const inv_mass = 1 / EvalPolyline(mass_over_life_, pos);
+
+				CurveSample& sample = (*curves)[i];
+				sample.size = size;
+				sample.inv_mass = inv_mass;
+				sample.size3_inv_mass = MathLib::cube(size) * inv_mass;
+				sample.alpha = EvalPolyline(opacity_over_life_, pos);
+			}
+			baked_curves_ = curves;
+		}
+
+		return baked_curves_;
+	}
+
+	void PolylineParticleUpdater::Update(ParticleSpan const & span, float elapse_time)
+	{
+		// Holding the curves keeps them alive even if a setter runs in the meantime
+		auto const curves = this->BakedCurves();
+		CurveSample const * samples = curves->data();
+
+		ParticleSystemPtr ps = ps_.lock();
+		float3 const & force = ps->Force();
+		float const gravity = ps->Gravity();
+		// Same as the per particle Update, with the mass and the buoyancy coming from the curves:
+		//  accel = force / mass + (0, 4 / 3 * PI * size^3 * density * gravity / mass - gravity, 0)
+		float const buoyancy_scale = 4.0f / 3 * PI * ps->MediaDensity() * gravity;
+
+		ParticleVec const dt = VecSet1(elapse_time);
+		ParticleVec const zero = VecSet1(0);
+		ParticleVec const force_x = VecSet1(force.x());
+		ParticleVec const force_y = VecSet1(force.y());
+		ParticleVec const force_z = VecSet1(force.z());
+		ParticleVec const gravity_v = VecSet1(gravity);
+		ParticleVec const buoyancy_scale_v = VecSet1(buoyancy_scale);
+		ParticleVec const spin_step = VecSet1(0.001f);
+
+		ForEachParticleBatch(span, [&](ParticleSpan const & batch, uint32_t i)
+			{
+				// Curve lookups stay scalar, there's no gather before AVX2
+				float sizes[PARTICLE_BATCH];
+				float inv_masses[PARTICLE_BATCH];
+				float size3_inv_masses[PARTICLE_BATCH];
+				float alphas[PARTICLE_BATCH];
+				for (uint32_t j = 0; j < PARTICLE_BATCH; ++ j)
+				{
+					float const life = batch.life[i + j];
+					float const init_life = batch.init_life[i + j];
+					float const pos = (init_life > 0) ? MathLib::clamp((init_life - life) / init_life, 0.0f, 1.0f) : 0;
+					float const fi = pos * (POLYLINE_CURVE_SAMPLES - 1);
+					uint32_t const index = std::min(static_cast<uint32_t>(fi), POLYLINE_CURVE_SAMPLES - 2);
+					float const s = fi - index;
+
+					CurveSample const & s0 = samples[index];
+					CurveSample const & s1 = samples[index + 1];
+					sizes[j] = MathLib::lerp(s0.size, s1.size, s);
+					inv_masses[j] = MathLib::lerp(s0.inv_mass, s1.inv_mass, s);
+					size3_inv_masses[j] = MathLib::lerp(s0.size3_inv_mass, s1.size3_inv_mass, s);
+					alphas[j] = MathLib::lerp(s0.alpha, s1.alpha, s);
+				}
+
+				ParticleVec const life = VecLoad(batch.life + i);
+				ParticleVec const alive = VecGreater(life, zero);
+
+				ParticleVec const inv_mass = VecLoad(inv_masses);
+				ParticleVec const accel_x = VecMul(force_x, inv_mass);
+				ParticleVec const accel_y = VecSub(VecAdd(VecMul(force_y, inv_mass),
+					VecMul(buoyancy_scale_v, VecLoad(size3_inv_masses))), gravity_v);
+				ParticleVec const accel_z = VecMul(force_z, inv_mass);
+
+				ParticleVec const vel_x = VecLoad(batch.vel_x + i);
+				ParticleVec const vel_y = VecLoad(batch.vel_y + i);
+				ParticleVec const vel_z = VecLoad(batch.vel_z + i);
+				ParticleVec const new_vel_x = VecAdd(vel_x, VecMul(accel_x, dt));
+				ParticleVec const new_vel_y = VecAdd(vel_y, VecMul(accel_y, dt));
+				ParticleVec const new_vel_z = VecAdd(vel_z, VecMul(accel_z, dt));
+				VecStore(batch.vel_x + i, VecSelect(alive, new_vel_x, vel_x));
+				VecStore(batch.vel_y + i, VecSelect(alive, new_vel_y, vel_y));
+				VecStore(batch.vel_z + i, VecSelect(alive, new_vel_z, vel_z));
+
+				ParticleVec const pos_x = VecLoad(batch.pos_x + i);
+				ParticleVec const pos_y = VecLoad(batch.pos_y + i);
+				ParticleVec const pos_z = VecLoad(batch.pos_z + i);
+				VecStore(batch.pos_x + i, VecSelect(alive, VecAdd(pos_x, VecMul(new_vel_x, dt)), pos_x));
+				VecStore(batch.pos_y + i, VecSelect(alive, VecAdd(pos_y, VecMul(new_vel_y, dt)), pos_y));
+				VecStore(batch.pos_z + i, VecSelect(alive, VecAdd(pos_z, VecMul(new_vel_z, dt)), pos_z));
+
+				VecStore(batch.life + i, VecSelect(alive, VecSub(life, dt), life));
+				ParticleVec const spin = VecLoad(batch.spin + i);
+				VecStore(batch.spin + i, VecSelect(alive, VecAdd(spin, spin_step), spin));
+				VecStore(batch.size + i, VecSelect(alive, VecLoad(sizes), VecLoad(batch.size + i)));
+				VecStore(batch.alpha + i, VecSelect(alive, VecLoad(alphas), VecLoad(batch.alpha + i)));
+			});
+	}
 }
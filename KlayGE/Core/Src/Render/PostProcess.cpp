@@ -33,6 +33,7 @@
 #include <KlayGE/ResLoader.hpp>
 #include <KlayGE/Camera.hpp>
 #include <KFL/Hash.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 
 #include <cstring>
 
@@ -83,6 +84,11 @@ namespace
 			return type;
 		}
 
+		std::string_view Name() const override
+		{
+			return pp_desc_.res_name;
+		}
+
 		bool StateLess() const override
 		{
 			return false;
@@ -796,6 +802,8 @@ namespace KlayGE
 
 	void PostProcess::Apply()
 	{
+		KLAYGE_PERF_ZONE("PostProcess::Apply");
+
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 		if (cs_based_)
 		{
@@ -1270,6 +1278,8 @@ namespace KlayGE
 
 	void PostProcessChain::Apply()
 	{
+		KLAYGE_PERF_ZONE("PostProcessChain::Apply");
+
 		for (auto const & pp : pp_chain_)
 		{
 			pp->Apply();
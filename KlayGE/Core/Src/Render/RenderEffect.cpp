@@ -54,11 +54,16 @@
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/RenderStateObject.hpp>
 #include <KlayGE/ShaderObject.hpp>
+#include <KlayGE/TransientBuffer.hpp>
 #include <KFL/XMLDom.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/TaskScheduler.hpp>
+#include <KFL/Timer.hpp>
 #include <KFL/CXX17/filesystem.hpp>
 
 #include <fstream>
+#include <sstream>
+#include <unordered_map>
 
 #include <boost/assert.hpp>
 #if defined(KLAYGE_COMPILER_CLANGC2)
@@ -81,13 +86,58 @@
 
 #include <KlayGE/RenderEffect.hpp>
 
+#include "ShaderCache.hpp"
+
 namespace
 {
 	using namespace KlayGE;
 
-	uint32_t const KFX_VERSION = 0x0140;
+	uint32_t const KFX_VERSION = 0x0143;
+
+	// Native shader blocks are in a ShaderCache next to the fxml, a .kfx only has their keys. A .kfx for platforms
+	//  that can't rebuild effects has the blocks inline instead.
+	std::string ShaderBlockName(RenderEffect const & effect, ShaderCache::Key const & key)
+	{
+		std::filesystem::path const cache_dir = std::filesystem::path(effect.ResName()).parent_path() / "ShaderCache";
+		return ShaderCache::BlobName(cache_dir.string(), key, "shader");
+	}
+
+	void ReadShaderBlockKey(ResIdentifier& res, ShaderCache::Key& key)
+	{
+		uint64_t tmp[3];
+		res.read(tmp, sizeof(tmp));
+		key.name_hash = LE2Native(tmp[0]);
+		key.check_hash = LE2Native(tmp[1]);
+		key.size = LE2Native(tmp[2]);
+	}
 
 #if KLAYGE_IS_DEV_PLATFORM
+	// Set by FXMLJIT on NullRender when building for a platform that isn't a dev platform
+	bool InlineShaderBlocks()
+	{
+		bool inline_blocks = false;
+		Context::Instance().RenderFactoryInstance().RenderEngineInstance().GetCustomAttrib("INLINE_SHADER_BLOCKS",
+			&inline_blocks);
+		return inline_blocks;
+	}
+
+	void WriteShaderBlockKey(std::ostream& os, ShaderCache::Key const & key)
+	{
+		uint64_t const tmp[] = { Native2LE(key.name_hash), Native2LE(key.check_hash), Native2LE(key.size) };
+		os.write(reinterpret_cast<char const *>(tmp), sizeof(tmp));
+	}
+
+	std::string ShaderBlock(ShaderObject& shader_obj, ShaderObject::ShaderType type, ShaderCache::Key& key)
+	{
+		std::ostringstream block_os(std::ios_base::binary | std::ios_base::out);
+		shader_obj.StreamOut(block_os, type);
+		std::string block = block_os.str();
+
+		key = ShaderCache::Key();
+		key.Append(block.data(), block.size());
+		return block;
+	}
+
 	ArrayRef<std::pair<char const *, size_t>> GetTypeDefines()
 	{
 #define NAME_AND_HASH(name) std::make_pair(name, CT_HASH(name))
@@ -2470,6 +2520,11 @@ namespace KlayGE
 			return type;
 		}
 
+		std::string_view Name() const override
+		{
+			return effect_desc_.res_name.empty() ? std::string_view() : std::string_view(effect_desc_.res_name[0]);
+		}
+
 		bool StateLess() const override
 		{
 			return false;
@@ -3054,6 +3109,150 @@ namespace KlayGE
 			techniques_.push_back(MakeUniquePtr<RenderTechnique>());
 			techniques_.back()->Load(effect, node, index);
 		}
+
+		this->CompileShaders(effect);
+	}
+
+	void RenderEffectTemplate::CompileShaders(RenderEffect& effect)
+	{
+		struct PassToCompile
+		{
+			RenderPass* pass;
+			uint32_t tech_index;
+			uint32_t pass_index;
+			// The passes owning the shaders this one shares
+			std::vector<size_t> owners;
+		};
+
+		std::vector<PassToCompile> passes;
+		std::unordered_map<RenderPass const *, size_t> pass_to_compile_indices;
+		uint32_t num_compiled_stages = 0;
+		uint32_t num_shared_stages = 0;
+		for (uint32_t tech_index = 0; tech_index < techniques_.size(); ++ tech_index)
+		{
+			auto const & tech = *techniques_[tech_index];
+			for (uint32_t pass_index = 0; pass_index < tech.NumPasses(); ++ pass_index)
+			{
+				auto& pass = *tech.passes_[pass_index];
+
+				// Techniques inheriting with the same macros share the pass objects
+				if (pass_to_compile_indices.find(&pass) != pass_to_compile_indices.end())
+				{
+					continue;
+				}
+
+				PassToCompile ptc;
+				ptc.pass = &pass;
+				ptc.tech_index = tech_index;
+				ptc.pass_index = pass_index;
+				for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
+				{
+					ShaderDesc const & sd = effect.GetShaderDesc(pass.shader_desc_ids_[type]);
+					if (!sd.func_name.empty())
+					{
+						if (sd.tech_pass_type != (tech_index << 16) + (pass_index << 8) + type)
+						{
+							auto const & owner_pass = techniques_[sd.tech_pass_type >> 16]->Pass((sd.tech_pass_type >> 8) & 0xFF);
+							auto iter = pass_to_compile_indices.find(&owner_pass);
+							BOOST_ASSERT(iter != pass_to_compile_indices.end());
+							ptc.owners.push_back(iter->second);
+
+							++ num_shared_stages;
+						}
+						else
+						{
+							++ num_compiled_stages;
+						}
+					}
+				}
+
+				pass_to_compile_indices.emplace(&pass, passes.size());
+				passes.push_back(std::move(ptc));
+			}
+		}
+
+		if (passes.empty())
+		{
+			return;
+		}
+
+		Timer timer;
+
+		bool const concurrent = passes[0].pass->GetShaderObject(effect)->ConcurrentAttachSupport();
+		if (concurrent)
+		{
+			// Every pass attaches its stages in order on its own shader object, after the owners of its shared shaders.
+			//  So the compiled shaders, and the .kfx, are the same as compiling them one by one.
+			auto& ts = Context::Instance().TaskScheduler();
+
+			std::vector<task_scheduler::task_handle> tasks(passes.size());
+			for (size_t i = 0; i < passes.size(); ++ i)
+			{
+				PassToCompile const * ptc = &passes[i];
+				auto const func = [&effect, ptc]
+					{
+						ptc->pass->CompileShaders(effect, ptc->tech_index, ptc->pass_index);
+					};
+
+				if (ptc->owners.empty())
+				{
+					tasks[i] = ts.schedule(func);
+				}
+				else
+				{
+					std::vector<task_scheduler::task_handle> antecedents;
+					for (auto owner : ptc->owners)
+					{
+						antecedents.push_back(tasks[owner]);
+					}
+					tasks[i] = ts.when_all(antecedents, func);
+				}
+			}
+
+			// The tasks refer to passes, all of them have to finish before an exception leaves
+			std::exception_ptr exception;
+			for (auto const & task : tasks)
+			{
+				try
+				{
+					ts.wait(task);
+				}
+				catch (...)
+				{
+					if (!exception)
+					{
+						exception = std::current_exception();
+					}
+				}
+			}
+			if (exception)
+			{
+				std::rethrow_exception(exception);
+			}
+
+			// Linking binds the constant buffers shared by the whole effect, it stays serial
+			for (auto const & ptc : passes)
+			{
+				ptc.pass->LinkShaders(effect);
+			}
+		}
+		else
+		{
+			for (auto const & ptc : passes)
+			{
+				ptc.pass->CompileShaders(effect, ptc.tech_index, ptc.pass_index);
+				ptc.pass->LinkShaders(effect);
+			}
+		}
+
+		for (auto const & tech : techniques_)
+		{
+			tech->UpdateShaderStates(effect);
+		}
+
+		LogInfo("%s: %u shader stages compiled, %u shared, in %u passes. %f s%s", res_name_.c_str(),
+			num_compiled_stages, num_shared_stages, static_cast<uint32_t>(passes.size()), timer.elapsed(),
+			concurrent ? " in parallel" : "");
 	}
 #endif
 
@@ -3197,6 +3396,10 @@ namespace KlayGE
 				{
 					uint64_t timestamp;
 					source->read(&timestamp, sizeof(timestamp));
+
+					// Either way can be loaded, only FXMLJIT cares
+					uint8_t inline_blocks;
+					source->read(&inline_blocks, sizeof(inline_blocks));
 #if KLAYGE_IS_DEV_PLATFORM
 					timestamp = LE2Native(timestamp);
 					if (timestamp_ <= timestamp)
@@ -3338,6 +3541,10 @@ namespace KlayGE
 		uint64_t timestamp = Native2LE(timestamp_);
 		os.write(reinterpret_cast<char const *>(&timestamp), sizeof(timestamp));
 
+		bool const inline_blocks = InlineShaderBlocks();
+		uint8_t const inline_blocks_flag = inline_blocks ? 1 : 0;
+		os.write(reinterpret_cast<char const *>(&inline_blocks_flag), sizeof(inline_blocks_flag));
+
 		{
 			uint16_t num_macros = 0;
 			for (uint32_t i = 0; i < macros_.size(); ++ i)
@@ -3437,6 +3644,33 @@ namespace KlayGE
 				techniques_[i]->StreamOut(effect, os, i);
 			}
 		}
+
+		// Footer with the keys of the native shader blocks in ShaderCache and their count, for tools that copy or
+		//  prune the blocks without loading the effect
+		{
+			uint32_t num_blocks = 0;
+			for (uint32_t i = 0; (i < techniques_.size()) && !inline_blocks; ++ i)
+			{
+				for (uint32_t j = 0; j < techniques_[i]->NumPasses(); ++ j)
+				{
+					RenderPass const & pass = techniques_[i]->Pass(j);
+					for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
+					{
+						ShaderDesc const & sd = effect.GetShaderDesc(pass.shader_desc_ids_[type]);
+						if (!sd.func_name.empty() && (sd.tech_pass_type == (i << 16) + (j << 8) + type))
+						{
+							ShaderCache::Key key;
+							ShaderBlock(*pass.GetShaderObject(effect), static_cast<ShaderObject::ShaderType>(type), key);
+							WriteShaderBlockKey(os, key);
+							++ num_blocks;
+						}
+					}
+				}
+			}
+
+			num_blocks = Native2LE(num_blocks);
+			os.write(reinterpret_cast<char const *>(&num_blocks), sizeof(num_blocks));
+		}
 	}
 #endif
 
@@ -3864,9 +4098,6 @@ namespace KlayGE
 
 		if (!node->FirstNode("pass") && parent_tech)
 		{
-			is_validate_ = parent_tech->is_validate_;
-			has_discard_ = parent_tech->has_discard_;
-			has_tessellation_ = parent_tech->has_tessellation_;
 			transparent_ = parent_tech->transparent_;
 			weight_ = parent_tech->weight_;
 
@@ -3884,16 +4115,11 @@ namespace KlayGE
 					auto inherit_pass = parent_tech->passes_[index].get();
 
 					pass->Load(effect, tech_index, index, inherit_pass);
-					is_validate_ &= pass->Validate();
 				}
 			}
 		}
 		else
 		{
-			is_validate_ = true;
-
-			has_discard_ = false;
-			has_tessellation_ = false;
 			transparent_ = false;
 			if (parent_tech)
 			{
@@ -3918,8 +4144,6 @@ namespace KlayGE
 
 				pass->Load(effect, pass_node, tech_index, index, inherit_pass);
 
-				is_validate_ &= pass->Validate();
-
 				for (XMLNodePtr state_node = pass_node->FirstNode("state"); state_node; state_node = state_node->NextSibling("state"))
 				{
 					++ weight_;
@@ -3934,9 +4158,6 @@ namespace KlayGE
 						}
 					}
 				}
-
-				has_discard_ |= pass->GetShaderObject(effect)->HasDiscard();
-				has_tessellation_ |= pass->GetShaderObject(effect)->HasTessellation();
 			}
 			if (transparent_)
 			{
@@ -3944,6 +4165,22 @@ namespace KlayGE
 			}
 		}
 	}
+
+	void RenderTechnique::UpdateShaderStates(RenderEffect const & effect)
+	{
+		is_validate_ = true;
+
+		has_discard_ = false;
+		has_tessellation_ = false;
+
+		for (auto const & pass : passes_)
+		{
+			is_validate_ &= pass->Validate();
+
+			has_discard_ |= pass->GetShaderObject(effect)->HasDiscard();
+			has_tessellation_ |= pass->GetShaderObject(effect)->HasTessellation();
+		}
+	}
 #endif
 
 	bool RenderTechnique::StreamIn(RenderEffect& effect, ResIdentifierPtr const & res, uint32_t tech_index)
@@ -4507,33 +4744,17 @@ namespace KlayGE
 		auto& rf = Context::Instance().RenderFactoryInstance();
 		render_state_obj_ = rf.MakeRenderStateObject(rs_desc, dss_desc, bs_desc);
 
-		auto const & shader_obj = this->GetShaderObject(effect);
-
+		// The first pass using a shader owns it, the later ones share its compiled code
 		for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
 		{
 			ShaderDesc& sd = effect.GetShaderDesc(shader_desc_ids_[type]);
-			if (!sd.func_name.empty())
+			if (!sd.func_name.empty() && (0xFFFFFFFF == sd.tech_pass_type))
 			{
-				if (sd.tech_pass_type != 0xFFFFFFFF)
-				{
-					auto const & tech = *effect.TechniqueByIndex(sd.tech_pass_type >> 16);
-					auto const & pass = tech.Pass((sd.tech_pass_type >> 8) & 0xFF);
-					shader_obj->AttachShader(static_cast<ShaderObject::ShaderType>(type),
-						effect, tech, pass, pass.GetShaderObject(effect));
-				}
-				else
-				{
-					auto const & tech = *effect.TechniqueByIndex(tech_index);
-					shader_obj->AttachShader(static_cast<ShaderObject::ShaderType>(type),
-						effect, tech, *this, shader_desc_ids_);
-					sd.tech_pass_type = (tech_index << 16) + (pass_index << 8) + type;
-				}
+				sd.tech_pass_type = (tech_index << 16) + (pass_index << 8) + type;
 			}
 		}
 
-		shader_obj->LinkShaders(effect);
-
-		is_validate_ = shader_obj->Validate();
+		is_validate_ = false;
 	}
 
 	void RenderPass::Load(RenderEffect& effect,
@@ -4566,7 +4787,6 @@ namespace KlayGE
 		}
 
 		shader_obj_index_ = effect.AddShaderObject();
-		auto const & shader_obj = this->GetShaderObject(effect);
 
 		shader_desc_ids_.fill(0);
 
@@ -4580,13 +4800,41 @@ namespace KlayGE
 				sd.macros_hash = macros_hash;
 				sd.tech_pass_type = (tech_index << 16) + (pass_index << 8) + type;
 				shader_desc_ids_[type] = effect.AddShaderDesc(sd);
-				
-				auto const & tech = *effect.TechniqueByIndex(tech_index);
-				shader_obj->AttachShader(static_cast<ShaderObject::ShaderType>(type),
-					effect, tech, *this, shader_desc_ids_);
 			}
 		}
 
+		is_validate_ = false;
+	}
+
+	void RenderPass::CompileShaders(RenderEffect& effect, uint32_t tech_index, uint32_t pass_index)
+	{
+		auto const & shader_obj = this->GetShaderObject(effect);
+
+		for (int type = 0; type < ShaderObject::ST_NumShaderTypes; ++ type)
+		{
+			ShaderDesc const & sd = effect.GetShaderDesc(shader_desc_ids_[type]);
+			if (!sd.func_name.empty())
+			{
+				if (sd.tech_pass_type != (tech_index << 16) + (pass_index << 8) + type)
+				{
+					auto const & tech = *effect.TechniqueByIndex(sd.tech_pass_type >> 16);
+					auto const & pass = tech.Pass((sd.tech_pass_type >> 8) & 0xFF);
+					shader_obj->AttachShader(static_cast<ShaderObject::ShaderType>(type),
+						effect, tech, pass, pass.GetShaderObject(effect));
+				}
+				else
+				{
+					auto const & tech = *effect.TechniqueByIndex(tech_index);
+					shader_obj->AttachShader(static_cast<ShaderObject::ShaderType>(type),
+						effect, tech, *this, shader_desc_ids_);
+				}
+			}
+		}
+	}
+
+	void RenderPass::LinkShaders(RenderEffect& effect)
+	{
+		auto const & shader_obj = this->GetShaderObject(effect);
 		shader_obj->LinkShaders(effect);
 
 		is_validate_ = shader_obj->Validate();
@@ -4705,8 +4953,30 @@ namespace KlayGE
 				}
 				else
 				{
-					this_native_accepted = shader_obj->StreamIn(res, static_cast<ShaderObject::ShaderType>(type),
-						effect, shader_desc_ids_);
+					ShaderCache::Key key;
+					ReadShaderBlockKey(*res, key);
+
+					uint32_t inline_size;
+					res->read(&inline_size, sizeof(inline_size));
+					inline_size = LE2Native(inline_size);
+
+					std::string const block_name = ShaderBlockName(effect, key);
+					std::vector<uint8_t> block;
+					if (inline_size > 0)
+					{
+						block.resize(inline_size);
+						res->read(block.data(), inline_size);
+					}
+					if ((inline_size > 0) || ShaderCache::Load(block_name, key, block))
+					{
+						auto block_res = MakeSharedPtr<ResIdentifier>(block_name, 0,
+							MakeSharedPtr<std::istringstream>(std::string(block.begin(), block.end())));
+						this_native_accepted = shader_obj->StreamIn(block_res, st, effect, shader_desc_ids_);
+					}
+					else
+					{
+						this_native_accepted = false;
+					}
 				}
 
 				native_accepted &= this_native_accepted;
@@ -4816,7 +5086,24 @@ namespace KlayGE
 			{
 				if (sd.tech_pass_type == (tech_index << 16) + (pass_index << 8) + type)
 				{
-					this->GetShaderObject(effect)->StreamOut(os, static_cast<ShaderObject::ShaderType>(type));
+					ShaderCache::Key key;
+					std::string const block = ShaderBlock(*this->GetShaderObject(effect),
+						static_cast<ShaderObject::ShaderType>(type), key);
+					WriteShaderBlockKey(os, key);
+
+					uint32_t inline_size = 0;
+					if (InlineShaderBlocks())
+					{
+						inline_size = static_cast<uint32_t>(block.size());
+					}
+					else
+					{
+						ShaderCache::Save(ShaderBlockName(effect, key), key, block.data(), block.size());
+					}
+
+					uint32_t const tmp = Native2LE(inline_size);
+					os.write(reinterpret_cast<char const *>(&tmp), sizeof(tmp));
+					os.write(block.data(), inline_size);
 				}
 			}
 		}
@@ -4919,16 +5206,53 @@ namespace KlayGE
 			}
 		}
 
-		dirty_ = true;
+		this->Dirty(true);
 	}
 
 	void RenderEffectConstantBuffer::Update()
 	{
 		if (dirty_)
 		{
-			hw_buff_->UpdateSubresource(0, static_cast<uint32_t>(buff_.size()), &buff_[0]);
+			RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+			RenderDeviceCaps const & caps = re.DeviceCaps();
+
+			uint32_t const size = static_cast<uint32_t>(buff_.size());
+			uint32_t begin;
+			uint32_t end;
+			if (caps.partial_cbuffer_update_support)
+			{
+				// Partial updates of D3D11.1 work in 16-byte units
+				begin = std::min(dirty_begin_ & ~15U, size);
+				end = std::min((dirty_end_ + 15U) & ~15U, size);
+			}
+			else
+			{
+				begin = 0;
+				end = size;
+			}
+
+			if (begin < end)
+			{
+				// Null backends have no hardware buffers, only the counters are updated
+				if (hw_buff_)
+				{
+					if (re.CBufferRingMode())
+					{
+						TransientBuffer& ring = re.CBufferRing();
+						SubAlloc const alloc = ring.Alloc(end - begin, &buff_[begin]);
+						ring.EnsureDataReady();
+						ring.GetBuffer()->CopyToSubBuffer(*hw_buff_, begin, alloc.offset_, alloc.length_);
+					}
+					else
+					{
+						hw_buff_->UpdateSubresource(begin, end - begin, &buff_[begin]);
+					}
+				}
+
+				re.CBufferUpdated(end - begin, size - (end - begin));
+			}
 
-			dirty_ = false;
+			this->Dirty(false);
 		}
 	}
 
@@ -5861,7 +6185,7 @@ namespace KlayGE
 				target[i] = MathLib::transpose(value[i]);
 			}
 
-			data_.cbuff_desc.cbuff->Dirty(true);
+			data_.cbuff_desc.cbuff->Dirty(data_.cbuff_desc.offset, size_ * static_cast<uint32_t>(sizeof(float4x4)));
 		}
 		else
 		{
@@ -55,6 +55,7 @@
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/Window.hpp>
 #include <KlayGE/PerfProfiler.hpp>
+#include <KlayGE/TransientBuffer.hpp>
 
 #if defined(KLAYGE_COMPILER_CLANGC2)
 #pragma clang diagnostic push
@@ -74,6 +75,8 @@ namespace KlayGE
 	RenderEngine::RenderEngine()
 		: num_primitives_just_rendered_(0), num_vertices_just_rendered_(0),
 			num_draws_just_called_(0), num_dispatches_just_called_(0),
+			num_cbuff_updates_just_called_(0), num_cbuff_bytes_just_uploaded_(0), num_cbuff_bytes_just_skipped_(0),
+			cbuff_ring_mode_(false),
 			default_fov_(PI / 4), default_render_width_scale_(1), default_render_height_scale_(1),
 			stereo_method_(STM_None), stereo_separation_(0),
 			fb_stage_(0), force_line_mode_(false)
@@ -113,6 +116,10 @@ namespace KlayGE
 
 	void RenderEngine::EndFrame()
 	{
+		if (cbuff_ring_)
+		{
+			cbuff_ring_->OnPresent();
+		}
 	}
 
 	void RenderEngine::UpdateGPUTimestampsFrequency()
@@ -735,6 +742,49 @@ namespace KlayGE
 		return ret;
 	}
 
+	uint32_t RenderEngine::NumCBufferUpdatesJustCalled()
+	{
+		uint32_t const ret = num_cbuff_updates_just_called_;
+		num_cbuff_updates_just_called_ = 0;
+		return ret;
+	}
+
+	uint64_t RenderEngine::NumCBufferBytesJustUploaded()
+	{
+		uint64_t const ret = num_cbuff_bytes_just_uploaded_;
+		num_cbuff_bytes_just_uploaded_ = 0;
+		return ret;
+	}
+
+	uint64_t RenderEngine::NumCBufferBytesJustSkipped()
+	{
+		uint64_t const ret = num_cbuff_bytes_just_skipped_;
+		num_cbuff_bytes_just_skipped_ = 0;
+		return ret;
+	}
+
+	void RenderEngine::CBufferUpdated(uint32_t uploaded_bytes, uint32_t skipped_bytes)
+	{
+		++ num_cbuff_updates_just_called_;
+		num_cbuff_bytes_just_uploaded_ += uploaded_bytes;
+		num_cbuff_bytes_just_skipped_ += skipped_bytes;
+	}
+
+	void RenderEngine::CBufferRingMode(bool ring)
+	{
+		RenderDeviceCaps const & caps = this->DeviceCaps();
+		cbuff_ring_mode_ = ring && caps.no_overwrite_support && caps.partial_cbuffer_update_support;
+	}
+
+	TransientBuffer& RenderEngine::CBufferRing()
+	{
+		if (!cbuff_ring_)
+		{
+			cbuff_ring_ = MakeUniquePtr<TransientBuffer>(256 * 1024, TransientBuffer::BF_Vertex, TransientBuffer::AM_Ring);
+		}
+		return *cbuff_ring_;
+	}
+
 	// ȡȾ豸
 	/////////////////////////////////////////////////////////////////////////////////
 	RenderDeviceCaps const & RenderEngine::DeviceCaps() const
@@ -943,6 +993,8 @@ namespace KlayGE
 
 	void RenderEngine::PostProcess(bool skip)
 	{
+		KLAYGE_PERF_ZONE("RenderEngine::PostProcess");
+
 		if (pp_chain_dirty_)
 		{
 			this->AssemblePostProcessChain();
@@ -1121,10 +1173,16 @@ namespace KlayGE
 	{
 		if (Context::Instance().AppInstance().MainWnd()->Active())
 		{
-			Context::Instance().SceneManagerInstance().Update();
+			{
+				KLAYGE_PERF_ZONE("Frame");
+				Context::Instance().SceneManagerInstance().Update();
+			}
 
+			// Zones are attributed to frames in shipping builds too
+			PerfProfiler& profiler = PerfProfiler::Instance();
+			profiler.EndFrame();
 #ifndef KLAYGE_SHIP
-			PerfProfiler::Instance().CollectData();
+			profiler.CollectData();
 #endif
 		}
 	}
@@ -1498,6 +1556,7 @@ namespace KlayGE
 		smaa_blend_tex_.reset();
 
 		so_buffers_.reset();
+		cbuff_ring_.reset();
 
 		cur_rs_obj_.reset();
 		cur_line_rs_obj_.reset();
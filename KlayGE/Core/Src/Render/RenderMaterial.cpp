@@ -128,6 +128,11 @@ namespace
 			return type;
 		}
 
+		std::string_view Name() const override
+		{
+			return mtl_desc_.res_name;
+		}
+
 		bool StateLess() const override
 		{
 			return true;
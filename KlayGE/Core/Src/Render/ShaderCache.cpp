@@ -0,0 +1,244 @@
+/**
+* @file ShaderCache.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <fstream>
+#include <random>
+#include <tuple>
+
+#include "ShaderCache.hpp"
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const BLOB_VERSION = 1;
+
+	struct BlobHeader
+	{
+		uint32_t fourcc;
+		uint32_t version;
+		uint64_t name_hash;
+		uint64_t check_hash;
+		uint64_t size;
+	};
+	static_assert(sizeof(BlobHeader) == 32, "BlobHeader has no padding");
+}
+
+namespace KlayGE
+{
+	ShaderCache::Key::Key()
+		: name_hash(0xCBF29CE484222325ULL), check_hash(0x84222325CBF29CE4ULL), size(0)
+	{
+	}
+
+	ShaderCache::Key& ShaderCache::Key::Append(void const * data, size_t data_size)
+	{
+		// 64-bit FNV-1a names the blob, the check is a multiply-xorshift hash unrelated to it
+		uint8_t const * p = static_cast<uint8_t const *>(data);
+		uint64_t name = name_hash;
+		uint64_t check = check_hash;
+		for (size_t i = 0; i < data_size; ++ i)
+		{
+			name ^= p[i];
+			name *= 0x100000001B3ULL;
+
+			check = (check + p[i]) * 0x9E3779B97F4A7C15ULL;
+			check ^= check >> 29;
+		}
+		name_hash = name;
+		check_hash = check;
+		size += data_size;
+		return *this;
+	}
+
+	ShaderCache::Key& ShaderCache::Key::Append(std::string const & str)
+	{
+		return this->Append(str.c_str(), str.size() + 1);
+	}
+
+	bool ShaderCache::Key::operator==(Key const & rhs) const
+	{
+		return (name_hash == rhs.name_hash) && (check_hash == rhs.check_hash) && (size == rhs.size);
+	}
+
+	std::string ShaderCache::BlobName(std::string const & dir, Key const & key, char const * ext)
+	{
+		static char const HEX_DIGITS[] = "0123456789abcdef";
+
+		std::string name = dir;
+		if (!name.empty() && (name.back() != '/') && (name.back() != '\\'))
+		{
+			name += '/';
+		}
+		for (int shift = 60; shift >= 0; shift -= 4)
+		{
+			name += HEX_DIGITS[(key.name_hash >> shift) & 0xF];
+		}
+		name += '.';
+		name += ext;
+		return name;
+	}
+
+	bool ShaderCache::Load(std::string const & name, Key const & key, std::vector<uint8_t>& blob)
+	{
+		ResIdentifierPtr res = ResLoader::Instance().Open(name);
+		if (!res)
+		{
+			return false;
+		}
+
+		res->seekg(0, std::ios_base::end);
+		size_t const file_size = static_cast<size_t>(res->tellg());
+		res->seekg(0, std::ios_base::beg);
+		if (file_size < sizeof(BlobHeader))
+		{
+			return false;
+		}
+
+		BlobHeader header;
+		res->read(&header, sizeof(header));
+		Key stored;
+		stored.name_hash = LE2Native(header.name_hash);
+		stored.check_hash = LE2Native(header.check_hash);
+		stored.size = LE2Native(header.size);
+		if ((LE2Native(header.fourcc) != MakeFourCC<'K', 'S', 'C', 'B'>::value) || (LE2Native(header.version) != BLOB_VERSION)
+			|| !(stored == key))
+		{
+			return false;
+		}
+
+		blob.resize(file_size - sizeof(BlobHeader));
+		res->read(blob.data(), blob.size());
+		return static_cast<bool>(*res);
+	}
+
+#if KLAYGE_IS_DEV_PLATFORM
+	void ShaderCache::Save(std::string const & name, Key const & key, void const * data, size_t size)
+	{
+		std::filesystem::path const path(name);
+
+		std::error_code ec;
+		if (std::filesystem::exists(path, ec))
+		{
+			// Touched, so Trim and the pruning in FXMLJIT see it as recently used
+#if defined(KLAYGE_CXX17_LIBRARY_FILESYSTEM_SUPPORT) || defined(KLAYGE_TS_LIBRARY_FILESYSTEM_SUPPORT)
+			std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+#else
+			std::filesystem::last_write_time(path, std::time(nullptr), ec);
+#endif
+			return;
+		}
+		if (path.has_parent_path())
+		{
+			std::filesystem::create_directories(path.parent_path(), ec);
+		}
+
+		BlobHeader header;
+		header.fourcc = Native2LE(MakeFourCC<'K', 'S', 'C', 'B'>::value);
+		header.version = Native2LE(BLOB_VERSION);
+		header.name_hash = Native2LE(key.name_hash);
+		header.check_hash = Native2LE(key.check_hash);
+		header.size = Native2LE(key.size);
+
+		// Written to a temporary file and renamed, so a reader never sees a partial blob. Several FXMLJIT processes can
+		//  produce the same blob at the same time, the suffix has to be unique across processes.
+		static std::atomic<uint32_t> save_id{std::random_device()()};
+		std::filesystem::path tmp_path = path;
+		tmp_path += ".tmp" + std::to_string(save_id.fetch_add(1));
+		{
+			std::ofstream ofs(tmp_path.string().c_str(), std::ios_base::binary | std::ios_base::out);
+			ofs.write(reinterpret_cast<char const *>(&header), sizeof(header));
+			ofs.write(static_cast<char const *>(data), size);
+			if (!ofs)
+			{
+				ofs.close();
+				std::filesystem::remove(tmp_path, ec);
+				return;
+			}
+		}
+
+		std::filesystem::rename(tmp_path, path, ec);
+		if (ec)
+		{
+			// Lost the race, the existing one is identical
+			std::filesystem::remove(tmp_path, ec);
+		}
+	}
+
+	void ShaderCache::Trim(std::string const & dir, char const * ext, uint64_t max_size)
+	{
+		std::error_code ec;
+		std::string const dot_ext = std::string(".") + ext;
+
+		typedef decltype(std::filesystem::last_write_time(std::filesystem::path())) file_time_type;
+		std::vector<std::tuple<file_time_type, uint64_t, std::filesystem::path>> blobs;
+		uint64_t total_size = 0;
+		for (std::filesystem::directory_iterator iter(dir, ec), end; !ec && (iter != end); iter.increment(ec))
+		{
+			std::filesystem::path const & path = iter->path();
+			if (path.extension() == dot_ext)
+			{
+				uint64_t const size = std::filesystem::file_size(path, ec);
+				auto const time = std::filesystem::last_write_time(path, ec);
+				if (!ec)
+				{
+					blobs.emplace_back(time, size, path);
+					total_size += size;
+				}
+			}
+		}
+
+		if (total_size > max_size)
+		{
+			// Oldest first. A blob deleted under another process is just a miss there.
+			std::sort(blobs.begin(), blobs.end());
+			for (auto const & blob : blobs)
+			{
+				if (total_size <= max_size)
+				{
+					break;
+				}
+				if (std::filesystem::remove(std::get<2>(blob), ec))
+				{
+					total_size -= std::get<1>(blob);
+				}
+			}
+		}
+	}
+#endif
+}
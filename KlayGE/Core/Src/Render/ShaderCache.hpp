@@ -0,0 +1,79 @@
+/**
+* @file ShaderCache.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+
+#ifndef _SHADERCACHE_HPP
+#define _SHADERCACHE_HPP
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace KlayGE
+{
+	// Content addressed store of shader blobs, one file per blob, named after a 64-bit key. The key of a blob is the hash
+	//  of its content, or of everything that goes into producing it, so the same blob is stored only once no matter how
+	//  many effects use it.
+	class ShaderCache
+	{
+	public:
+		// Two independent 64-bit hashes and the length of everything hashed. The first one names the blob, all of them
+		//  are in the blob header and checked on load, so a collision of the names is a miss rather than a wrong blob.
+		struct Key
+		{
+			uint64_t name_hash;
+			uint64_t check_hash;
+			uint64_t size;
+
+			Key();
+
+			Key& Append(void const * data, size_t size);
+			// The terminating 0 is hashed too, so the boundaries of chained strings can't move
+			Key& Append(std::string const & str);
+
+			bool operator==(Key const & rhs) const;
+		};
+
+		static std::string BlobName(std::string const & dir, Key const & key, char const * ext);
+
+		// Goes through ResLoader, so the blobs can live in packages as well. Fails if the header doesn't match the key.
+		static bool Load(std::string const & name, Key const & key, std::vector<uint8_t>& blob);
+#if KLAYGE_IS_DEV_PLATFORM
+		// Only updates the time of an existing blob, it has the same content. Safe to call from several threads or
+		//  processes.
+		static void Save(std::string const & name, Key const & key, void const * data, size_t size);
+		// Deletes the least recently written blobs with the extension until the rest fit in max_size bytes
+		static void Trim(std::string const & dir, char const * ext, uint64_t max_size);
+#endif
+	};
+}
+
+#endif		// _SHADERCACHE_HPP
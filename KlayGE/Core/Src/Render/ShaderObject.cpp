@@ -19,6 +19,8 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/ResLoader.hpp>
 
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <map>
@@ -36,6 +38,8 @@
 
 #include <KlayGE/ShaderObject.hpp>
 
+#include "ShaderCache.hpp"
+
 #if KLAYGE_IS_DEV_PLATFORM
 
 #ifdef KLAYGE_PLATFORM_WINDOWS
@@ -83,6 +87,8 @@ namespace
 {
 	using namespace KlayGE;
 
+	uint64_t const MAX_DXBC_CACHE_SIZE = 256 * 1024 * 1024;
+
 	class D3DCompilerLoader
 	{
 	public:
@@ -132,7 +138,10 @@ namespace
 			}
 			return hr;
 #else
-			std::string mark = boost::lexical_cast<std::string>(static_cast<void const *>(src_data.c_str()));
+			// Passes of an effect can be compiled concurrently, with the same source and entry point
+			static std::atomic<uint32_t> compile_id(0);
+			std::string mark = boost::lexical_cast<std::string>(static_cast<void const *>(src_data.c_str()))
+				+ '_' + boost::lexical_cast<std::string>(compile_id ++);
 			std::string compile_input_file = entry_point + mark + "Input.tmp";
 			std::string compile_output_file = entry_point + mark + "Output.tmp";
 
@@ -170,15 +179,14 @@ namespace
 #ifdef KLAYGE_PLATFORM_WINDOWS
 			ss << d3dcompiler_wrapper_name << ".exe";
 #else
-			static bool first = true;
-			if (first)
-			{
-				ss << WINE_PATH << "wineserver -p";
-				system(ss.str().c_str());
-				// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
-				first = false;
-				ss.str(std::string());
-			}
+			static std::once_flag wineserver_flag;
+			std::call_once(wineserver_flag, []
+				{
+					std::ostringstream wineserver_ss;
+					wineserver_ss << WINE_PATH << "wineserver -p";
+					system(wineserver_ss.str().c_str());
+					// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
+				});
 			d3dcompiler_wrapper_name += ".exe.so";
 			std::string wrapper_path = ResLoader::Instance().Locate(d3dcompiler_wrapper_name);
 			ss << WINE_PATH << "wine " << wrapper_path;
@@ -301,6 +309,12 @@ namespace KlayGE
 	{
 	}
 
+	bool ShaderObject::ConcurrentAttachSupport() const
+	{
+		RenderEngine const & re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		return re.DeviceCaps().multithread_res_creating_support;
+	}
+
 #if KLAYGE_IS_DEV_PLATFORM
 	std::vector<uint8_t> ShaderObject::CompileToDXBC(ShaderType type, RenderEffect const & effect,
 			RenderTechnique const & tech, RenderPass const & pass,
@@ -427,9 +441,45 @@ namespace KlayGE
 			macros.push_back(macro_end);
 		}
 
+		// Identical compiles are common across effects and across rebuilds, the results are kept in a machine local
+		//  ShaderCache keyed by everything the compiler sees
+		ShaderCache::Key key;
+		key.Append(hlsl_shader_text);
+		for (auto const & macro : macros)
+		{
+			if (macro.Name != nullptr)
+			{
+				key.Append(macro.Name);
+				key.Append(macro.Definition);
+			}
+		}
+		key.Append(func_name);
+		key.Append(shader_profile);
+		uint32_t const le_flags = Native2LE(flags);
+		key.Append(&le_flags, sizeof(le_flags));
+		key.Append(std::string(re.NativeShaderPlatformName()));
+
+		std::string const cache_dir = ResLoader::Instance().LocalFolder() + "ShaderCache";
+		std::string const cache_name = ShaderCache::BlobName(cache_dir, key, "dxbc");
+		if (ShaderCache::Load(cache_name, key, code) && !code.empty())
+		{
+			return code;
+		}
+
 		D3DCompilerLoader::Instance().D3DCompile(hlsl_shader_text, &macros[0],
 			func_name, shader_profile,
 			flags, 0, code, err_msg);
+		if (!code.empty())
+		{
+			ShaderCache::Save(cache_name, key, code.data(), code.size());
+
+			// Nothing else removes stale compiles, the cache is kept under a budget once per run
+			static std::once_flag trim_flag;
+			std::call_once(trim_flag, [&cache_dir]
+				{
+					ShaderCache::Trim(cache_dir, "dxbc", MAX_DXBC_CACHE_SIZE);
+				});
+		}
 		if (!err_msg.empty())
 		{
 			LogError("Error when compiling %s:", func_name);
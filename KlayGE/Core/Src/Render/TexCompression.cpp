@@ -32,6 +32,7 @@
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/Texture.hpp>
+#include <KFL/TaskScheduler.hpp>
 
 #include <vector>
 #include <cstring>
@@ -48,12 +49,60 @@ namespace KlayGE
 		KFL_UNUSED(out_slice_pitch);
 		KFL_UNUSED(in_slice_pitch);
 
+		uint32_t const num_block_rows = (height + block_height_ - 1) / block_height_;
+		if (this->ParallelizeBlockRows(num_block_rows))
+		{
+			Context::Instance().TaskScheduler().parallel_for(0, num_block_rows, 0,
+				[this, width, height, output, out_row_pitch, input, in_row_pitch, method](uint32_t begin, uint32_t end)
+				{
+					TexCompressionPtr codec = this->Clone();
+					codec->EncodeBlockRows(begin, end, width, height, output, out_row_pitch, input, in_row_pitch, method);
+				});
+		}
+		else
+		{
+			this->EncodeBlockRows(0, num_block_rows, width, height, output, out_row_pitch, input, in_row_pitch, method);
+		}
+	}
+
+	void TexCompression::DecodeMem(uint32_t width, uint32_t height,
+		void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
+		void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch)
+	{
+		KFL_UNUSED(out_slice_pitch);
+		KFL_UNUSED(in_slice_pitch);
+
+		uint32_t const num_block_rows = (height + block_height_ - 1) / block_height_;
+		if (this->ParallelizeBlockRows(num_block_rows))
+		{
+			Context::Instance().TaskScheduler().parallel_for(0, num_block_rows, 0,
+				[this, width, height, output, out_row_pitch, input, in_row_pitch](uint32_t begin, uint32_t end)
+				{
+					TexCompressionPtr codec = this->Clone();
+					codec->DecodeBlockRows(begin, end, width, height, output, out_row_pitch, input, in_row_pitch);
+				});
+		}
+		else
+		{
+			this->DecodeBlockRows(0, num_block_rows, width, height, output, out_row_pitch, input, in_row_pitch);
+		}
+	}
+
+	bool TexCompression::ParallelizeBlockRows(uint32_t num_block_rows) const
+	{
+		return parallel_ && (num_block_rows > 1) && (Context::Instance().TaskScheduler().num_workers() > 0);
+	}
+
+	void TexCompression::EncodeBlockRows(uint32_t block_row_begin, uint32_t block_row_end, uint32_t width, uint32_t height,
+		void* output, uint32_t out_row_pitch, void const * input, uint32_t in_row_pitch,
+		TexCompressionMethod method)
+	{
 		uint32_t const elem_size = NumFormatBytes(decoded_fmt_);
 
 		uint8_t const * src = static_cast<uint8_t const *>(input);
 
 		std::vector<uint8_t> uncompressed(block_width_ * block_height_ * elem_size);
-		for (uint32_t y_base = 0; y_base < height; y_base += block_height_)
+		for (uint32_t y_base = block_row_begin * block_height_; y_base < block_row_end * block_height_; y_base += block_height_)
 		{
 			uint8_t* dst = static_cast<uint8_t*>(output) + (y_base / block_height_) * out_row_pitch;
 
@@ -83,24 +132,30 @@ namespace KlayGE
 		}
 	}
 
-	void TexCompression::DecodeMem(uint32_t width, uint32_t height,
-		void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
-		void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch)
+	void TexCompression::DecodeBlockRows(uint32_t block_row_begin, uint32_t block_row_end, uint32_t width, uint32_t height,
+		void* output, uint32_t out_row_pitch, void const * input, uint32_t in_row_pitch)
 	{
-		KFL_UNUSED(out_slice_pitch);
-		KFL_UNUSED(in_slice_pitch);
-
 		uint32_t const elem_size = NumFormatBytes(decoded_fmt_);
 
 		uint8_t * dst = static_cast<uint8_t*>(output);
 
 		std::vector<uint8_t> uncompressed(block_width_ * block_height_ * elem_size);
-		for (uint32_t y_base = 0; y_base < height; y_base += block_height_)
+		for (uint32_t y_base = block_row_begin * block_height_; y_base < block_row_end * block_height_; y_base += block_height_)
 		{
 			uint8_t const * src = static_cast<uint8_t const *>(input) + in_row_pitch * (y_base / block_height_);
 
 			uint32_t const block_h = std::min(block_height_, height - y_base);
-			for (uint32_t x_base = 0; x_base < width; x_base += block_width_)
+			uint32_t x_base = 0;
+			if (block_h == block_height_)
+			{
+				uint32_t const num_full_blocks = width / block_width_;
+				this->DecodeBlockRow(dst + y_base * out_row_pitch, out_row_pitch, src, num_full_blocks);
+				src += num_full_blocks * block_bytes_;
+				x_base = num_full_blocks * block_width_;
+			}
+
+			// Blocks across the right or bottom edge
+			for (; x_base < width; x_base += block_width_)
 			{
 				uint32_t const block_w = std::min(block_width_, width - x_base);
 
@@ -119,6 +174,28 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompression::DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks)
+	{
+		uint32_t const elem_size = NumFormatBytes(decoded_fmt_);
+		uint32_t const block_row_bytes = block_width_ * elem_size;
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+
+		std::vector<uint8_t> uncompressed(block_width_ * block_height_ * elem_size);
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			this->DecodeBlock(&uncompressed[0], src);
+			src += block_bytes_;
+
+			for (uint32_t y = 0; y < block_height_; ++ y)
+			{
+				memcpy(dst + y * out_row_pitch, &uncompressed[y * block_row_bytes], block_row_bytes);
+			}
+			dst += block_row_bytes;
+		}
+	}
+
 	void TexCompression::EncodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex, TexCompressionMethod method)
 	{
 		uint32_t width = in_tex->Width(0);
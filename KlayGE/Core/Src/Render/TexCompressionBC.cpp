@@ -37,6 +37,8 @@
 #include <KlayGE/Texture.hpp>
 #include <KFL/Half.hpp>
 
+#include <algorithm>
+#include <limits>
 #include <vector>
 #include <cstring>
 #include <boost/assert.hpp>
@@ -46,6 +48,7 @@
 
 #include <KlayGE/TexCompressionBC.hpp>
 #include "../Base/TableGen/Tables.hpp"
+#include "TexCompressionSIMD.hpp"
 
 namespace
 {
@@ -301,6 +304,25 @@ namespace
 		return h;
 	}
 
+	int F162Int(half const & h, bool signed_fmt)
+	{
+		uint16_t const input = *(reinterpret_cast<uint16_t const *>(&h));
+		int out = input & 0x7FFF;
+		if (out > 0x7C00)
+		{
+			// NaN
+			return 0;
+		}
+		out = std::min(out, 0x7BFF);
+
+		if (input & 0x8000)
+		{
+			// Negative values are out of the range of unsigned BC6H
+			out = signed_fmt ? -out : 0;
+		}
+		return out;
+	}
+
 	void ToF16(Vector_T<half, 4>& f16, int3 const & clr, bool signed_fmt)
 	{
 		f16.x() = Int2F16(clr.x(), signed_fmt);
@@ -331,6 +353,93 @@ namespace
 		}
 	}
 
+	// Fits a line through the pixels of a region by PCA. The end points are the extents of the pixels on the line.
+	//  Returns the sum of squared distances from the pixels to the line, a cheap estimation of the error.
+	float FitBC6Line(int3 const * pixels, uint32_t partitions, uint32_t shape, uint32_t region, bool signed_fmt,
+		std::pair<int3, int3>& end_pts)
+	{
+		float3 points[16];
+		uint32_t num_points = 0;
+		float3 mean(0, 0, 0);
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			if (GetPartition(partitions, shape, i) == region)
+			{
+				points[num_points] = float3(static_cast<float>(pixels[i].x()),
+					static_cast<float>(pixels[i].y()), static_cast<float>(pixels[i].z()));
+				mean += points[num_points];
+				++ num_points;
+			}
+		}
+		BOOST_ASSERT(num_points > 0);
+		mean /= static_cast<float>(num_points);
+
+		float cov[6] = { 0, 0, 0, 0, 0, 0 };
+		float total_dist_sq = 0;
+		float3 axis(0, 0, 0);
+		for (uint32_t i = 0; i < num_points; ++ i)
+		{
+			float3 const d = points[i] - mean;
+			cov[0] += d.x() * d.x();
+			cov[1] += d.x() * d.y();
+			cov[2] += d.x() * d.z();
+			cov[3] += d.y() * d.y();
+			cov[4] += d.y() * d.z();
+			cov[5] += d.z() * d.z();
+
+			// Starts the power iteration from the farthest pixel, it's never perpendicular to the principal axis
+			float const dist_sq = MathLib::length_sq(d);
+			if (dist_sq > MathLib::length_sq(axis))
+			{
+				axis = d;
+			}
+			total_dist_sq += dist_sq;
+		}
+
+		float t_min = 0;
+		float t_max = 0;
+		float error = 0;
+		if (MathLib::length_sq(axis) > 0)
+		{
+			axis = MathLib::normalize(axis);
+			for (int iter = 0; iter < 4; ++ iter)
+			{
+				float3 const new_axis(cov[0] * axis.x() + cov[1] * axis.y() + cov[2] * axis.z(),
+					cov[1] * axis.x() + cov[3] * axis.y() + cov[4] * axis.z(),
+					cov[2] * axis.x() + cov[4] * axis.y() + cov[5] * axis.z());
+				float const len_sq = MathLib::length_sq(new_axis);
+				if (len_sq <= 0)
+				{
+					break;
+				}
+				axis = new_axis / sqrt(len_sq);
+			}
+
+			float proj_sq = 0;
+			t_min = t_max = MathLib::dot(points[0] - mean, axis);
+			for (uint32_t i = 0; i < num_points; ++ i)
+			{
+				float const t = MathLib::dot(points[i] - mean, axis);
+				t_min = std::min(t_min, t);
+				t_max = std::max(t_max, t);
+				proj_sq += t * t;
+			}
+			error = std::max(total_dist_sq - proj_sq, 0.0f);
+		}
+
+		int const min_val = signed_fmt ? -0x7BFF : 0;
+		int const max_val = 0x7BFF;
+		float3 const p0 = mean + axis * t_min;
+		float3 const p1 = mean + axis * t_max;
+		for (int ch = 0; ch < 3; ++ ch)
+		{
+			end_pts.first[ch] = MathLib::clamp(static_cast<int>(floor(p0[ch] + 0.5f)), min_val, max_val);
+			end_pts.second[ch] = MathLib::clamp(static_cast<int>(floor(p1[ch] + 0.5f)), min_val, max_val);
+		}
+
+		return error;
+	}
+
 	bool Bsf32(uint32_t& index, uint32_t v)
 	{
 #ifdef KLAYGE_COMPILER_MSVC
@@ -878,6 +987,71 @@ namespace
 			KFL_UNREACHABLE("Invalid rotation mode");
 		}
 	}
+
+	// Gathers bits 0, 2, 4, ..., 30
+	uint16_t CompactEveryOtherBit(uint32_t v)
+	{
+		v &= 0x55555555;
+		v = (v | (v >> 1)) & 0x33333333;
+		v = (v | (v >> 2)) & 0x0F0F0F0F;
+		v = (v | (v >> 4)) & 0x00FF00FF;
+		v = (v | (v >> 8)) & 0x0000FFFF;
+		return static_cast<uint16_t>(v);
+	}
+
+	// Gathers bits 0, 3, 6, ..., 21
+	uint32_t CompactEveryThirdBit(uint32_t v)
+	{
+		v &= 0x249249;
+		v = (v | (v >> 2)) & 0x0C30C3;
+		v = (v | (v >> 4)) & 0x00F00F;
+		v = (v | (v >> 8)) & 0x0000FF;
+		return v;
+	}
+
+	void BC1IndexPlanes(PalettedBlock& block, BC1Block const & bc1)
+	{
+		uint32_t const bitmap = bc1.bitmap[0] | (bc1.bitmap[1] << 16);
+		block.index_planes[0] = CompactEveryOtherBit(bitmap);
+		block.index_planes[1] = CompactEveryOtherBit(bitmap >> 1);
+		block.index_planes[2] = 0;
+	}
+
+	void BC4IndexPlanes(PalettedBlock& block, BC4Block const & bc4)
+	{
+		block.index_planes.fill(0);
+		for (int i = 0; i < 2; ++ i)
+		{
+			uint32_t alpha32 = (bc4.bitmap[i * 3 + 2] << 16) | (bc4.bitmap[i * 3 + 1] << 8) | (bc4.bitmap[i * 3 + 0] << 0);
+			for (int n = 0; n < 3; ++ n)
+			{
+				block.index_planes[n] |= static_cast<uint16_t>(CompactEveryThirdBit(alpha32 >> n) << (i * 8));
+			}
+		}
+	}
+
+	void BC1PalettedBlock(PalettedBlock& block, TexCompressionBC1 const & codec, BC1Block const & bc1)
+	{
+		std::array<ARGBColor32, 4> clr;
+		codec.DecodeBC1Palette(&clr[0], bc1);
+		for (size_t i = 0; i < clr.size(); ++ i)
+		{
+			block.palette[i] = clr[i].ARGB();
+			block.palette[i + 4] = 0;
+		}
+		BC1IndexPlanes(block, bc1);
+	}
+
+	void BC4PalettedBlock(PalettedBlock& block, TexCompressionBC4 const & codec, BC4Block const & bc4)
+	{
+		std::array<uint8_t, 8> alpha;
+		codec.DecodeBC4Palette(&alpha[0], bc4);
+		for (size_t i = 0; i < alpha.size(); ++ i)
+		{
+			block.palette[i] = alpha[i];
+		}
+		BC4IndexPlanes(block, bc4);
+	}
 }
 
 namespace KlayGE
@@ -892,6 +1066,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_ARGB8;
 	}
 
+	TexCompressionPtr TexCompressionBC1::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionBC1>();
+	}
+
 	void TexCompressionBC1::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -926,10 +1105,47 @@ namespace KlayGE
 		ARGBColor32* argb = static_cast<ARGBColor32*>(output);
 		BC1Block const & bc1 = *static_cast<BC1Block const *>(input);
 
+		std::array<ARGBColor32, 4> clr;
+		this->DecodeBC1Palette(&clr[0], bc1);
+
+		for (int i = 0; i < 2; ++ i)
+		{
+			for (int j = 0; j < 8; ++ j)
+			{
+				argb[i * 8 + j] = clr[(bc1.bitmap[i] >> (j * 2)) & 0x3];
+			}
+		}
+	}
+
+	void TexCompressionBC1::DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		BC1Block const * bc1 = static_cast<BC1Block const *>(input);
+
+		std::array<PalettedBlock, PALETTED_BLOCK_BATCH> blocks;
+		while (num_blocks > 0)
+		{
+			uint32_t const n = std::min(num_blocks, PALETTED_BLOCK_BATCH);
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				BC1PalettedBlock(blocks[i], *this, bc1[i]);
+			}
+			DecodePalettedBlocksARGB8(dst, out_row_pitch, &blocks[0], n);
+
+			dst += n * 4 * sizeof(ARGBColor32);
+			bc1 += n;
+			num_blocks -= n;
+		}
+	}
+
+	void TexCompressionBC1::DecodeBC1Palette(ARGBColor32* clr, BC1Block const & bc1) const
+	{
 		ARGBColor32 max_clr = this->RGB565To888(bc1.clr_0);
 		ARGBColor32 min_clr = this->RGB565To888(bc1.clr_1);
 
-		std::array<ARGBColor32, 4> clr;
 		clr[0] = max_clr;
 		clr[1] = min_clr;
 		if (bc1.clr_0 > bc1.clr_1)
@@ -951,14 +1167,6 @@ namespace KlayGE
 			clr[2].a() = 255;
 			clr[3] = ARGBColor32(0, 0, 0, 0);
 		}
-
-		for (int i = 0; i < 2; ++ i)
-		{
-			for (int j = 0; j < 8; ++ j)
-			{
-				argb[i * 8 + j] = clr[(bc1.bitmap[i] >> (j * 2)) & 0x3];
-			}
-		}
 	}
 
 	ARGBColor32 TexCompressionBC1::RGB565To888(uint16_t rgb) const
@@ -1382,6 +1590,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_ARGB8;
 	}
 
+	TexCompressionPtr TexCompressionBC2::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionBC2>();
+	}
+
 	void TexCompressionBC2::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -1436,6 +1649,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_ARGB8;
 	}
 
+	TexCompressionPtr TexCompressionBC3::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionBC3>();
+	}
+
 	void TexCompressionBC3::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -1476,6 +1694,32 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC3::DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		BC3Block const * bc3 = static_cast<BC3Block const *>(input);
+
+		std::array<PalettedBlock, PALETTED_BLOCK_BATCH> color_blocks;
+		std::array<PalettedBlock, PALETTED_BLOCK_BATCH> alpha_blocks;
+		while (num_blocks > 0)
+		{
+			uint32_t const n = std::min(num_blocks, PALETTED_BLOCK_BATCH);
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				BC1PalettedBlock(color_blocks[i], bc1_codec_, bc3[i].bc1);
+				BC4PalettedBlock(alpha_blocks[i], bc4_codec_, bc3[i].alpha);
+			}
+			DecodePalettedBlocksARGB8(dst, out_row_pitch, &color_blocks[0], &alpha_blocks[0], n);
+
+			dst += n * 4 * sizeof(ARGBColor32);
+			bc3 += n;
+			num_blocks -= n;
+		}
+	}
+
 
 	TexCompressionBC4::TexCompressionBC4()
 	{
@@ -1485,6 +1729,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_R8;
 	}
 
+	TexCompressionPtr TexCompressionBC4::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionBC4>();
+	}
+
 	// Alpha block compression (this is easy for a change)
 	void TexCompressionBC4::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
@@ -1552,6 +1801,44 @@ namespace KlayGE
 		BC4Block const & bc4 = *static_cast<BC4Block const *>(input);
 
 		std::array<uint8_t, 8> alpha;
+		this->DecodeBC4Palette(&alpha[0], bc4);
+
+		for (int i = 0; i < 2; ++ i)
+		{
+			uint32_t alpha32 = (bc4.bitmap[i * 3 + 2] << 16) | (bc4.bitmap[i * 3 + 1] << 8) | (bc4.bitmap[i * 3 + 0] << 0);
+			for (int j = 0; j < 8; ++ j)
+			{
+				alpha_block[i * 8 + j] = alpha[(alpha32 >> (j * 3)) & 0x7];
+			}
+		}
+	}
+
+	void TexCompressionBC4::DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		BC4Block const * bc4 = static_cast<BC4Block const *>(input);
+
+		std::array<PalettedBlock, PALETTED_BLOCK_BATCH> blocks;
+		while (num_blocks > 0)
+		{
+			uint32_t const n = std::min(num_blocks, PALETTED_BLOCK_BATCH);
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				BC4PalettedBlock(blocks[i], *this, bc4[i]);
+			}
+			DecodePalettedBlocksR8(dst, out_row_pitch, &blocks[0], n);
+
+			dst += n * 4 * sizeof(uint8_t);
+			bc4 += n;
+			num_blocks -= n;
+		}
+	}
+
+	void TexCompressionBC4::DecodeBC4Palette(uint8_t* alpha, BC4Block const & bc4) const
+	{
 		float falpha0 = bc4.alpha_0 / 255.0f;
 		float falpha1 = bc4.alpha_1 / 255.0f;
 		alpha[0] = bc4.alpha_0;
@@ -1574,15 +1861,6 @@ namespace KlayGE
 			alpha[6] = 0;
 			alpha[7] = 255;
 		}
-
-		for (int i = 0; i < 2; ++ i)
-		{
-			uint32_t alpha32 = (bc4.bitmap[i * 3 + 2] << 16) | (bc4.bitmap[i * 3 + 1] << 8) | (bc4.bitmap[i * 3 + 0] << 0);
-			for (int j = 0; j < 8; ++ j)
-			{
-				alpha_block[i * 8 + j] = alpha[(alpha32 >> (j * 3)) & 0x7];
-			}
-		}
 	}
 
 
@@ -1594,6 +1872,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_GR8;
 	}
 
+	TexCompressionPtr TexCompressionBC5::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionBC5>();
+	}
+
 	void TexCompressionBC5::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -1633,6 +1916,32 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC5::DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		BC5Block const * bc5 = static_cast<BC5Block const *>(input);
+
+		std::array<PalettedBlock, PALETTED_BLOCK_BATCH> r_blocks;
+		std::array<PalettedBlock, PALETTED_BLOCK_BATCH> g_blocks;
+		while (num_blocks > 0)
+		{
+			uint32_t const n = std::min(num_blocks, PALETTED_BLOCK_BATCH);
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				BC4PalettedBlock(r_blocks[i], bc4_codec_, bc5[i].red);
+				BC4PalettedBlock(g_blocks[i], bc4_codec_, bc5[i].green);
+			}
+			DecodePalettedBlocksGR8(dst, out_row_pitch, &r_blocks[0], &g_blocks[0], n);
+
+			dst += n * 4 * sizeof(uint16_t);
+			bc5 += n;
+			num_blocks -= n;
+		}
+	}
+
 
 	// BC6H Compression
 	TexCompressionBC6U::ModeDescriptor const TexCompressionBC6U::mode_desc_[14][82] =
@@ -1897,13 +2206,14 @@ namespace KlayGE
 		decoded_fmt_ = EF_ABGR16F;
 	}
 
-	void TexCompressionBC6U::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	TexCompressionPtr TexCompressionBC6U::Clone() const
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
+		return MakeSharedPtr<TexCompressionBC6U>();
+	}
 
-		// TODO
+	void TexCompressionBC6U::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		this->EncodeBC6Internal(output, input, method, false);
 	}
 
 	void TexCompressionBC6U::DecodeBlock(void* output, void const * input)
@@ -1911,6 +2221,202 @@ namespace KlayGE
 		this->DecodeBC6Internal(output, input, false);
 	}
 
+	// Every mode is tried on the shapes where a line per region fits the pixels best. TCM_Speed takes the best shape only,
+	//  TCM_Balanced the best 4, and TCM_Quality all of them. Then the quantized end points of the best candidates are
+	//  moved one step at a time as long as the error drops.
+	void TexCompressionBC6U::EncodeBC6Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		struct Candidate
+		{
+			uint64_t error;
+			uint32_t mode_index;
+			uint32_t shape;
+			EndPointsType q_end_pts;
+			uint8_t indices[16];
+		};
+
+		uint32_t num_shapes;
+		uint32_t num_refines;
+		switch (method)
+		{
+		case TCM_Speed:
+			num_shapes = 1;
+			num_refines = 0;
+			break;
+
+		case TCM_Balanced:
+			num_shapes = 4;
+			num_refines = 1;
+			break;
+
+		case TCM_Quality:
+		default:
+			num_shapes = BC6_MAX_SHAPES;
+			num_refines = 4;
+			break;
+		}
+		uint32_t const MAX_REFINE_PASSES = 8;
+
+		Vector_T<half, 4> const * abgr = static_cast<Vector_T<half, 4> const *>(input);
+		int3 pixels[16];
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			pixels[i] = int3(F162Int(abgr[i].x(), signed_fmt), F162Int(abgr[i].y(), signed_fmt),
+				F162Int(abgr[i].z(), signed_fmt));
+		}
+
+		std::pair<int3, int3> one_region_end_pts;
+		FitBC6Line(pixels, 1, 0, 0, signed_fmt, one_region_end_pts);
+
+		std::array<std::pair<float, uint32_t>, BC6_MAX_SHAPES> shape_errors;
+		std::array<EndPointsType, BC6_MAX_SHAPES> two_region_end_pts;
+		for (uint32_t shape = 0; shape < BC6_MAX_SHAPES; ++ shape)
+		{
+			shape_errors[shape].first = FitBC6Line(pixels, 2, shape, 0, signed_fmt, two_region_end_pts[shape][0])
+				+ FitBC6Line(pixels, 2, shape, 1, signed_fmt, two_region_end_pts[shape][1]);
+			shape_errors[shape].second = shape;
+		}
+		std::partial_sort(shape_errors.begin(), shape_errors.begin() + num_shapes, shape_errors.end());
+
+		// The best candidates, sorted by error
+		std::array<Candidate, 4> candidates;
+		uint32_t const num_candidates = std::max(num_refines, 1U);
+		BOOST_ASSERT(num_candidates <= candidates.size());
+		for (uint32_t c = 0; c < num_candidates; ++ c)
+		{
+			candidates[c].error = std::numeric_limits<uint64_t>::max();
+		}
+
+		auto try_candidate = [this, &candidates, num_candidates, &pixels, signed_fmt](uint32_t mode_index, uint32_t shape,
+			std::pair<int3, int3> const * end_pts)
+		{
+			ModeInfo const & info = mode_info_[mode_index];
+			ARGBColor32 const & prec = info.rgba_prec[0][0];
+			uint8_t const precs[] = { prec.r(), prec.g(), prec.b() };
+
+			Candidate cand;
+			cand.mode_index = mode_index;
+			cand.shape = shape;
+			for (uint32_t p = 0; p < info.partitions; ++ p)
+			{
+				for (int ch = 0; ch < 3; ++ ch)
+				{
+					cand.q_end_pts[p].first[ch] = this->Quantize(end_pts[p].first[ch], precs[ch], signed_fmt);
+					cand.q_end_pts[p].second[ch] = this->Quantize(end_pts[p].second[ch], precs[ch], signed_fmt);
+				}
+			}
+			cand.error = this->QuantizedError(info, shape, pixels, cand.q_end_pts, cand.indices, signed_fmt);
+			if ((cand.error < candidates[num_candidates - 1].error)
+				&& this->FixUpEndPoints(info, shape, cand.q_end_pts, cand.indices))
+			{
+				uint32_t pos = num_candidates - 1;
+				while ((pos > 0) && (cand.error < candidates[pos - 1].error))
+				{
+					candidates[pos] = candidates[pos - 1];
+					-- pos;
+				}
+				candidates[pos] = cand;
+			}
+		};
+
+		for (uint32_t mode_index = 0; mode_index < std::size(mode_info_); ++ mode_index)
+		{
+			if (1 == mode_info_[mode_index].partitions)
+			{
+				try_candidate(mode_index, 0, &one_region_end_pts);
+			}
+		}
+		for (uint32_t s = 0; s < num_shapes; ++ s)
+		{
+			// The line fitting error is about the lower bound of a shape's error, the rest of the shapes can't do better
+			if (shape_errors[s].first >= candidates[0].error)
+			{
+				break;
+			}
+
+			uint32_t const shape = shape_errors[s].second;
+			for (uint32_t mode_index = 0; mode_index < std::size(mode_info_); ++ mode_index)
+			{
+				if (2 == mode_info_[mode_index].partitions)
+				{
+					try_candidate(mode_index, shape, &two_region_end_pts[shape][0]);
+				}
+			}
+		}
+
+		Candidate best = candidates[0];
+		BOOST_ASSERT(best.error != std::numeric_limits<uint64_t>::max());
+		for (uint32_t c = 0; c < num_refines; ++ c)
+		{
+			Candidate cand = candidates[c];
+			if (std::numeric_limits<uint64_t>::max() == cand.error)
+			{
+				break;
+			}
+
+			ModeInfo const & info = mode_info_[cand.mode_index];
+			ARGBColor32 const & prec = info.rgba_prec[0][0];
+			uint8_t const precs[] = { prec.r(), prec.g(), prec.b() };
+
+			bool improved = true;
+			for (uint32_t pass = 0; improved && (pass < MAX_REFINE_PASSES) && (cand.error > 0); ++ pass)
+			{
+				improved = false;
+				for (uint32_t p = 0; p < info.partitions; ++ p)
+				{
+					for (int e = 0; e < 2; ++ e)
+					{
+						for (int ch = 0; ch < 3; ++ ch)
+						{
+							int q_min;
+							int q_max;
+							if (signed_fmt)
+							{
+								q_max = (precs[ch] >= 16) ? 0x7FFF : (1 << (precs[ch] - 1)) - 1;
+								q_min = -q_max;
+							}
+							else
+							{
+								q_max = (precs[ch] >= 16) ? 0xFFFF : (1 << precs[ch]) - 1;
+								q_min = 0;
+							}
+
+							for (int step = -1; step <= 1; step += 2)
+							{
+								Candidate trial = cand;
+								int& comp = (0 == e) ? trial.q_end_pts[p].first[ch] : trial.q_end_pts[p].second[ch];
+								comp += step;
+								if ((comp < q_min) || (comp > q_max))
+								{
+									continue;
+								}
+
+								trial.error = this->QuantizedError(info, trial.shape, pixels, trial.q_end_pts,
+									trial.indices, signed_fmt);
+								if ((trial.error < cand.error)
+									&& this->FixUpEndPoints(info, trial.shape, trial.q_end_pts, trial.indices))
+								{
+									cand = trial;
+									improved = true;
+								}
+							}
+						}
+					}
+				}
+			}
+
+			if (cand.error < best.error)
+			{
+				best = cand;
+			}
+		}
+
+		this->WriteBC6Block(output, best.mode_index, best.shape, best.q_end_pts, best.indices);
+	}
+
 	void TexCompressionBC6U::DecodeBC6Internal(void* output, void const * input, bool signed_fmt)
 	{
 		BOOST_ASSERT(output);
@@ -2070,6 +2576,50 @@ namespace KlayGE
 		}
 	}
 
+	// The inverse of FinishUnquantize(Unquantize(q)). Each quantized value covers an equal range of unquantized values.
+	int TexCompressionBC6U::Quantize(int comp, uint8_t bits_per_comp, bool signed_fmt)
+	{
+		int q;
+		if (signed_fmt)
+		{
+			int s = 0;
+			if (comp < 0)
+			{
+				s = 1;
+				comp = -comp;
+			}
+
+			int const unq = std::min((comp * 32 + 15) / 31, 0x7FFF);
+			if (bits_per_comp >= 16)
+			{
+				q = unq;
+			}
+			else
+			{
+				q = std::min(unq >> (16 - bits_per_comp), (1 << (bits_per_comp - 1)) - 1);
+			}
+
+			if (s)
+			{
+				q = -q;
+			}
+		}
+		else
+		{
+			int const unq = std::min((comp * 64 + 15) / 31, 0xFFFF);
+			if (bits_per_comp >= 15)
+			{
+				q = unq;
+			}
+			else
+			{
+				q = std::min(unq >> (16 - bits_per_comp), (1 << bits_per_comp) - 1);
+			}
+		}
+
+		return q;
+	}
+
 	int TexCompressionBC6U::Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt)
 	{
 		int unq = 0;
@@ -2142,6 +2692,188 @@ namespace KlayGE
 		}
 	}
 
+	// Decodes the palettes exactly like DecodeBC6Internal, picks the closest palette entry for every pixel
+	uint64_t TexCompressionBC6U::QuantizedError(ModeInfo const & info, uint32_t shape, int3 const * pixels,
+		EndPointsType const & q_end_pts, uint8_t* indices, bool signed_fmt)
+	{
+		uint32_t const num_indices = 1U << info.index_prec;
+		int const * weights = BC67_PREC_WEIGHTS[info.index_prec - 2];
+		ARGBColor32 const & prec = info.rgba_prec[0][0];
+		uint8_t const precs[] = { prec.r(), prec.g(), prec.b() };
+
+		int3 palettes[BC6_MAX_REGIONS][BC6_MAX_INDICES];
+		for (uint32_t p = 0; p < info.partitions; ++ p)
+		{
+			for (int ch = 0; ch < 3; ++ ch)
+			{
+				int const unq_0 = this->Unquantize(q_end_pts[p].first[ch], precs[ch], signed_fmt);
+				int const unq_1 = this->Unquantize(q_end_pts[p].second[ch], precs[ch], signed_fmt);
+				for (uint32_t k = 0; k < num_indices; ++ k)
+				{
+					palettes[p][k][ch] = this->FinishUnquantize((unq_0 * (BC6_WEIGHT_MAX - weights[k])
+						+ unq_1 * weights[k] + BC6_WEIGHT_ROUND) >> BC6_WEIGHT_SHIFT, signed_fmt);
+				}
+			}
+		}
+
+		uint64_t total_error = 0;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			int3 const * palette = palettes[GetPartition(info.partitions, shape, i)];
+
+			uint64_t best_error = std::numeric_limits<uint64_t>::max();
+			for (uint32_t k = 0; k < num_indices; ++ k)
+			{
+				int64_t const dr = pixels[i].x() - palette[k].x();
+				int64_t const dg = pixels[i].y() - palette[k].y();
+				int64_t const db = pixels[i].z() - palette[k].z();
+				uint64_t const error = dr * dr + dg * dg + db * db;
+				if (error < best_error)
+				{
+					best_error = error;
+					indices[i] = static_cast<uint8_t>(k);
+				}
+			}
+			total_error += best_error;
+		}
+
+		return total_error;
+	}
+
+	// The MSB of the index at each region's fix-up offset isn't stored, and has to be 0. Swaps the end points of the
+	//  regions violating that. Returns false if the transformed end points can't be represented in the mode.
+	bool TexCompressionBC6U::FixUpEndPoints(ModeInfo const & info, uint32_t shape, EndPointsType& q_end_pts, uint8_t* indices)
+	{
+		uint8_t const num_indices = static_cast<uint8_t>(1U << info.index_prec);
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			if (IsFixUpOffset(info.partitions, shape, i) && (indices[i] >= num_indices / 2))
+			{
+				uint32_t const region = GetPartition(info.partitions, shape, i);
+				std::swap(q_end_pts[region].first, q_end_pts[region].second);
+				for (uint32_t j = 0; j < 16; ++ j)
+				{
+					if (GetPartition(info.partitions, shape, j) == region)
+					{
+						indices[j] = num_indices - 1 - indices[j];
+					}
+				}
+			}
+		}
+
+		if (info.transformed)
+		{
+			auto fits = [](int3 const & delta, ARGBColor32 const & prec)
+			{
+				uint8_t const precs[] = { prec.r(), prec.g(), prec.b() };
+				for (int ch = 0; ch < 3; ++ ch)
+				{
+					int const max_delta = (1 << (precs[ch] - 1)) - 1;
+					if ((delta[ch] < -max_delta - 1) || (delta[ch] > max_delta))
+					{
+						return false;
+					}
+				}
+				return true;
+			};
+
+			int3 const & base = q_end_pts[0].first;
+			if (!fits(q_end_pts[0].second - base, info.rgba_prec[0][1]))
+			{
+				return false;
+			}
+			if ((info.partitions > 1) && (!fits(q_end_pts[1].first - base, info.rgba_prec[1][0])
+				|| !fits(q_end_pts[1].second - base, info.rgba_prec[1][1])))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void TexCompressionBC6U::WriteBC6Block(void* output, uint32_t mode_index, uint32_t shape,
+		EndPointsType const & q_end_pts, uint8_t const * indices)
+	{
+		ModeInfo const & info = mode_info_[mode_index];
+		ModeDescriptor const * desc = mode_desc_[mode_index];
+
+		EndPointsType end_pts = q_end_pts;
+		if (info.transformed)
+		{
+			end_pts[0].second -= q_end_pts[0].first;
+			end_pts[1].first -= q_end_pts[0].first;
+			end_pts[1].second -= q_end_pts[0].first;
+		}
+
+		memset(output, 0, block_bytes_);
+
+		size_t start_bit = 0;
+		size_t const header_bits = info.partitions > 1 ? 82 : 65;
+		while (start_bit < header_bits)
+		{
+			int val;
+			switch (desc[start_bit].field)
+			{
+			case M:
+				val = info.mode;
+				break;
+			case D:
+				val = shape;
+				break;
+			case RW:
+				val = end_pts[0].first.x();
+				break;
+			case RX:
+				val = end_pts[0].second.x();
+				break;
+			case RY:
+				val = end_pts[1].first.x();
+				break;
+			case RZ:
+				val = end_pts[1].second.x();
+				break;
+			case GW:
+				val = end_pts[0].first.y();
+				break;
+			case GX:
+				val = end_pts[0].second.y();
+				break;
+			case GY:
+				val = end_pts[1].first.y();
+				break;
+			case GZ:
+				val = end_pts[1].second.y();
+				break;
+			case BW:
+				val = end_pts[0].first.z();
+				break;
+			case BX:
+				val = end_pts[0].second.z();
+				break;
+			case BY:
+				val = end_pts[1].first.z();
+				break;
+			case BZ:
+				val = end_pts[1].second.z();
+				break;
+
+			default:
+				val = 0;
+				break;
+			}
+
+			WriteBit(output, start_bit, static_cast<uint8_t>((val >> desc[start_bit].bit) & 1));
+		}
+
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			size_t const num_bits = IsFixUpOffset(info.partitions, shape, i) ? info.index_prec - 1 : info.index_prec;
+			WriteBits(output, start_bit, num_bits, indices[i]);
+		}
+		BOOST_ASSERT(128 == start_bit);
+	}
+
 
 	TexCompressionBC6S::TexCompressionBC6S()
 	{
@@ -2151,13 +2883,14 @@ namespace KlayGE
 		decoded_fmt_ = EF_ABGR16F;
 	}
 
-	void TexCompressionBC6S::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	TexCompressionPtr TexCompressionBC6S::Clone() const
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
+		return MakeSharedPtr<TexCompressionBC6S>();
+	}
 
-		// TODO
+	void TexCompressionBC6S::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		bc6u_codec_.EncodeBC6Internal(output, input, method, true);
 	}
 
 	void TexCompressionBC6S::DecodeBlock(void* output, void const * input)
@@ -2196,6 +2929,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_ARGB8;
 	}
 
+	TexCompressionPtr TexCompressionBC7::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionBC7>();
+	}
+
 	void TexCompressionBC7::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
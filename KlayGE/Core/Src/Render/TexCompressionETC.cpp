@@ -35,12 +35,14 @@
 #include <KFL/Color.hpp>
 #include <KlayGE/Texture.hpp>
 
+#include <array>
 #include <vector>
 #include <cstring>
 #include <boost/assert.hpp>
 
 #include <KlayGE/TexCompressionETC.hpp>
 #include "../Base/TableGen/Tables.hpp"
+#include "TexCompressionSIMD.hpp"
 
 namespace
 {
@@ -501,6 +503,141 @@ namespace
 
 		return cur_ind;
 	}
+
+	// The selector bits are stored column major and byte swapped, bit (x * 4 + y) ^ 8 belongs to texel (x, y). Moves it
+	//  to bit y * 4 + x.
+	uint16_t ETCIndexPlane(uint16_t bits)
+	{
+		uint32_t v = ((bits >> 8) | (bits << 8)) & 0xFFFF;
+
+		// Transposes the 4x4 bit matrix
+		uint32_t t = (v ^ (v >> 3)) & 0x0A0A;
+		v ^= t ^ (t << 3);
+		t = (v ^ (v >> 6)) & 0x00CC;
+		v ^= t ^ (t << 6);
+
+		return static_cast<uint16_t>(v);
+	}
+
+	void ETC1PalettedBlock(PalettedBlock& block, TexCompressionETC1 const & codec, ETC1Block const & etc1,
+		bool differential, bool alpha)
+	{
+		std::array<ARGBColor32, 8> clr;
+		if (differential)
+		{
+			codec.DecodeETCDifferentialModePalette(&clr[0], etc1, alpha);
+		}
+		else
+		{
+			codec.DecodeETCIndividualModePalette(&clr[0], etc1);
+		}
+		for (size_t i = 0; i < clr.size(); ++ i)
+		{
+			block.palette[i] = clr[i].ARGB();
+		}
+
+		// Sub-block 1 is the bottom half when flipped, the right half otherwise
+		block.index_planes[0] = ETCIndexPlane(etc1.lsb);
+		block.index_planes[1] = ETCIndexPlane(etc1.msb);
+		block.index_planes[2] = (etc1.cw_diff_flip & 0x1) ? 0xFF00 : 0xCCCC;
+	}
+
+	void ETC2THPalettedBlock(PalettedBlock& block, ARGBColor32 const * clr, uint16_t msb, uint16_t lsb)
+	{
+		for (size_t i = 0; i < 4; ++ i)
+		{
+			block.palette[i] = clr[i].ARGB();
+			block.palette[i + 4] = clr[i].ARGB();
+		}
+
+		block.index_planes[0] = ETCIndexPlane(lsb);
+		block.index_planes[1] = ETCIndexPlane(msb);
+		block.index_planes[2] = 0;
+	}
+
+	// Returns false for the planar mode, it has no palette
+	bool ETC2PalettedBlock(PalettedBlock& block, TexCompressionETC1 const & etc1_codec, TexCompressionETC2RGB8 const & etc2_codec,
+		ETC2Block const & etc2, bool differential, bool alpha)
+	{
+		if (differential)
+		{
+			int const dr = etc2.etc1.r & 0x7;
+			int const r = (etc2.etc1.r >> 3) - (dr & 0x4) + (dr & 0x3);
+			int const dg = etc2.etc1.g & 0x7;
+			int const g = (etc2.etc1.g >> 3) - (dg & 0x4) + (dg & 0x3);
+			int const db = etc2.etc1.b & 0x7;
+			int const b = (etc2.etc1.b >> 3) - (db & 0x4) + (db & 0x3);
+
+			std::array<ARGBColor32, 4> clr;
+			if (r & 0xFFE0)
+			{
+				etc2_codec.DecodeETCTModePalette(&clr[0], etc2.etc2_t_mode, alpha);
+				ETC2THPalettedBlock(block, &clr[0], etc2.etc2_t_mode.msb, etc2.etc2_t_mode.lsb);
+			}
+			else if (g & 0xFFE0)
+			{
+				etc2_codec.DecodeETCHModePalette(&clr[0], etc2.etc2_h_mode, alpha);
+				ETC2THPalettedBlock(block, &clr[0], etc2.etc2_h_mode.msb, etc2.etc2_h_mode.lsb);
+			}
+			else if (b & 0xFFE0)
+			{
+				return false;
+			}
+			else
+			{
+				ETC1PalettedBlock(block, etc1_codec, etc2.etc1, true, alpha);
+			}
+		}
+		else
+		{
+			ETC1PalettedBlock(block, etc1_codec, etc2.etc1, false, false);
+		}
+
+		return true;
+	}
+
+	// to_paletted fills a PalettedBlock and returns true, or returns false for the planar mode, which has no palette
+	//  and is decoded by decode_planar into a scratch block instead
+	template <typename BlockType, typename ToPalettedFunc, typename DecodePlanarFunc>
+	void DecodeETCBlockRow(uint8_t* output, uint32_t out_row_pitch, BlockType const * input, uint32_t num_blocks,
+		ToPalettedFunc const & to_paletted, DecodePlanarFunc const & decode_planar)
+	{
+		uint32_t const block_row_bytes = 4 * sizeof(ARGBColor32);
+
+		std::array<PalettedBlock, PALETTED_BLOCK_BATCH> blocks;
+		uint32_t num_pending = 0;
+		uint8_t* pending_dst = output;
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			if (to_paletted(blocks[num_pending], input[i]))
+			{
+				++ num_pending;
+			}
+			else
+			{
+				DecodePalettedBlocksARGB8(pending_dst, out_row_pitch, &blocks[0], num_pending);
+				pending_dst += num_pending * block_row_bytes;
+				num_pending = 0;
+
+				std::array<ARGBColor32, 16> argb;
+				decode_planar(&argb[0], input[i]);
+				for (uint32_t y = 0; y < 4; ++ y)
+				{
+					std::memcpy(pending_dst + y * out_row_pitch, &argb[y * 4], block_row_bytes);
+				}
+				pending_dst += block_row_bytes;
+			}
+
+			if (num_pending == blocks.size())
+			{
+				DecodePalettedBlocksARGB8(pending_dst, out_row_pitch, &blocks[0], num_pending);
+				pending_dst += num_pending * block_row_bytes;
+				num_pending = 0;
+			}
+		}
+
+		DecodePalettedBlocksARGB8(pending_dst, out_row_pitch, &blocks[0], num_pending);
+	}
 }
 
 namespace KlayGE
@@ -653,6 +790,11 @@ namespace KlayGE
 		sorted_luma_indices_ = nullptr;
 	}
 
+	TexCompressionPtr TexCompressionETC1::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionETC1>();
+	}
+
 	void TexCompressionETC1::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -959,10 +1101,50 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionETC1::DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		DecodeETCBlockRow(static_cast<uint8_t*>(output), out_row_pitch, static_cast<ETC1Block const *>(input), num_blocks,
+			[this](PalettedBlock& block, ETC1Block const & etc1)
+			{
+				ETC1PalettedBlock(block, *this, etc1, (etc1.cw_diff_flip & 0x2) != 0, false);
+				return true;
+			},
+			[](ARGBColor32* argb, ETC1Block const & etc1)
+			{
+				KFL_UNUSED(argb);
+				KFL_UNUSED(etc1);
+			});
+	}
+
 	void TexCompressionETC1::DecodeETCIndividualModeInternal(ARGBColor32* argb, ETC1Block const & etc1) const
 	{
 		BOOST_ASSERT(argb);
 
+		std::array<ARGBColor32, 8> modified_clr;
+		this->DecodeETCIndividualModePalette(&modified_clr[0], etc1);
+
+		bool const flip = etc1.cw_diff_flip & 0x1;
+		for (int x = 0; x < 4; ++ x)
+		{
+			for (int y = 0; y < 4; ++ y)
+			{
+				int sub_block = ((flip ? y : x) >> 1);
+				int bit_index = (x * 4 + y) ^ 0x8;
+				int msb = (etc1.msb >> bit_index) & 0x1;
+				int lsb = (etc1.lsb >> bit_index) & 0x1;
+				int pixel_index = msb * 2 + lsb;
+				argb[y * 4 + x] = modified_clr[sub_block * 4 + pixel_index];
+			}
+		}
+	}
+
+	void TexCompressionETC1::DecodeETCIndividualModePalette(ARGBColor32* clr, ETC1Block const & etc1) const
+	{
+		BOOST_ASSERT(clr);
+
 		int r1 = etc1.r >> 4;
 		int r2 = etc1.r & 0xF;
 		int g1 = etc1.g >> 4;
@@ -978,17 +1160,24 @@ namespace KlayGE
 		base_clr[1][1] = Extend4To8Bits(g2);
 		base_clr[1][2] = Extend4To8Bits(b2);
 
-		ARGBColor32 modified_clr[2][4];
 		for (int sub = 0; sub < 2; ++ sub)
 		{
 			int const cw = (etc1.cw_diff_flip >> (2 + (!sub * 3))) & 0x7;
 			for (int mod = 0; mod < 4; ++ mod)
 			{
 				int const modifier = GetModifier(cw, mod);
-				modified_clr[sub][selector_index_to_etc1[mod]] = From4Ints(255, base_clr[sub][0] + modifier,
+				clr[sub * 4 + selector_index_to_etc1[mod]] = From4Ints(255, base_clr[sub][0] + modifier,
 					base_clr[sub][1] + modifier, base_clr[sub][2] + modifier);
 			}
 		}
+	}
+
+	void TexCompressionETC1::DecodeETCDifferentialModeInternal(ARGBColor32* argb, ETC1Block const & etc1, bool alpha) const
+	{
+		BOOST_ASSERT(argb);
+
+		std::array<ARGBColor32, 8> modified_clr;
+		this->DecodeETCDifferentialModePalette(&modified_clr[0], etc1, alpha);
 
 		bool const flip = etc1.cw_diff_flip & 0x1;
 		for (int x = 0; x < 4; ++ x)
@@ -1000,14 +1189,14 @@ namespace KlayGE
 				int msb = (etc1.msb >> bit_index) & 0x1;
 				int lsb = (etc1.lsb >> bit_index) & 0x1;
 				int pixel_index = msb * 2 + lsb;
-				argb[y * 4 + x] = modified_clr[sub_block][pixel_index];
+				argb[y * 4 + x] = modified_clr[sub_block * 4 + pixel_index];
 			}
 		}
 	}
 
-	void TexCompressionETC1::DecodeETCDifferentialModeInternal(ARGBColor32* argb, ETC1Block const & etc1, bool alpha) const
+	void TexCompressionETC1::DecodeETCDifferentialModePalette(ARGBColor32* clr, ETC1Block const & etc1, bool alpha) const
 	{
-		BOOST_ASSERT(argb);
+		BOOST_ASSERT(clr);
 
 		int const r = etc1.r >> 3;
 		int const dr = etc1.r & 0x7;
@@ -1024,7 +1213,6 @@ namespace KlayGE
 		base_clr[1][1] = Extend5To8Bits(g - (dg & 0x4) + (dg & 0x3));
 		base_clr[1][2] = Extend5To8Bits(b - (db & 0x4) + (db & 0x3));
 
-		ARGBColor32 modified_clr[2][4];
 		for (int sub = 0; sub < 2; ++ sub)
 		{
 			int const cw = (etc1.cw_diff_flip >> (2 + (!sub * 3))) & 0x7;
@@ -1039,29 +1227,14 @@ namespace KlayGE
 				{
 					modifier = GetModifier(cw, mod);
 				}
-				modified_clr[sub][selector_index_to_etc1[mod]] = From4Ints(255, base_clr[sub][0] + modifier,
+				clr[sub * 4 + selector_index_to_etc1[mod]] = From4Ints(255, base_clr[sub][0] + modifier,
 					base_clr[sub][1] + modifier, base_clr[sub][2] + modifier);
 			}
-		}
 
-		bool const flip = etc1.cw_diff_flip & 0x1;
-		for (int x = 0; x < 4; ++ x)
-		{
-			for (int y = 0; y < 4; ++ y)
+			// Index 2 is transparent black in the punch-through mode
+			if (alpha)
 			{
-				int sub_block = ((flip ? y : x) >> 1);
-				int bit_index = (x * 4 + y) ^ 0x8;
-				int msb = (etc1.msb >> bit_index) & 0x1;
-				int lsb = (etc1.lsb >> bit_index) & 0x1;
-				int pixel_index = msb * 2 + lsb;
-				if (alpha && (2 == pixel_index))
-				{
-					argb[y * 4 + x] = ARGBColor32(0, 0, 0, 0);
-				}
-				else
-				{
-					argb[y * 4 + x] = modified_clr[sub_block][pixel_index];
-				}
+				clr[sub * 4 + 2] = ARGBColor32(0, 0, 0, 0);
 			}
 		}
 	}
@@ -1842,6 +2015,11 @@ namespace KlayGE
 		etc1_codec_ = MakeSharedPtr<TexCompressionETC1>();
 	}
 
+	TexCompressionPtr TexCompressionETC2RGB8::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionETC2RGB8>();
+	}
+
 	void TexCompressionETC2RGB8::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		KFL_UNUSED(output);
@@ -1891,10 +2069,46 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionETC2RGB8::DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		DecodeETCBlockRow(static_cast<uint8_t*>(output), out_row_pitch, static_cast<ETC2Block const *>(input), num_blocks,
+			[this](PalettedBlock& block, ETC2Block const & etc2)
+			{
+				return ETC2PalettedBlock(block, *etc1_codec_, *this, etc2, (etc2.etc1.cw_diff_flip & 0x2) != 0, false);
+			},
+			[this](ARGBColor32* argb, ETC2Block const & etc2)
+			{
+				this->DecodeETCPlanarModeInternal(argb, etc2.etc2_planar_mode);
+			});
+	}
+
 	void TexCompressionETC2RGB8::DecodeETCTModeInternal(ARGBColor32* argb, ETC2TModeBlock const & etc2, bool alpha)
 	{
 		BOOST_ASSERT(argb);
 
+		std::array<ARGBColor32, 4> modified_clr;
+		this->DecodeETCTModePalette(&modified_clr[0], etc2, alpha);
+
+		for (int x = 0; x < 4; ++ x)
+		{
+			for (int y = 0; y < 4; ++ y)
+			{
+				int bit_index = (x * 4 + y) ^ 0x8;
+				int msb = (etc2.msb >> bit_index) & 0x1;
+				int lsb = (etc2.lsb >> bit_index) & 0x1;
+				int pixel_index = msb * 2 + lsb;
+				argb[y * 4 + x] = modified_clr[pixel_index];
+			}
+		}
+	}
+
+	void TexCompressionETC2RGB8::DecodeETCTModePalette(ARGBColor32* clr, ETC2TModeBlock const & etc2, bool alpha) const
+	{
+		BOOST_ASSERT(clr);
+
 		static int const distance_table[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
 
 		int const r1 = ((etc2.r1 >> 1) & 0xC) | (etc2.r1 & 0x3);
@@ -1921,13 +2135,24 @@ namespace KlayGE
 		};
 
 		int const distance = distance_table[da | db];
-		ARGBColor32 const modified_clr[] =
+		clr[0] = From4Ints(255, base_clr1[0], base_clr1[1], base_clr1[2]);
+		clr[1] = From4Ints(255, base_clr2[0] + distance, base_clr2[1] + distance, base_clr2[2] + distance);
+		clr[2] = From4Ints(255, base_clr2[0], base_clr2[1], base_clr2[2]);
+		clr[3] = From4Ints(255, base_clr2[0] - distance, base_clr2[1] - distance, base_clr2[2] - distance);
+
+		// Index 2 is transparent black in the punch-through mode
+		if (alpha)
 		{
-			From4Ints(255, base_clr1[0], base_clr1[1], base_clr1[2]),
-			From4Ints(255, base_clr2[0] + distance, base_clr2[1] + distance, base_clr2[2] + distance),
-			From4Ints(255, base_clr2[0], base_clr2[1], base_clr2[2]),
-			From4Ints(255, base_clr2[0] - distance, base_clr2[1] - distance, base_clr2[2] - distance)
-		};
+			clr[2] = ARGBColor32(0, 0, 0, 0);
+		}
+	}
+
+	void TexCompressionETC2RGB8::DecodeETCHModeInternal(ARGBColor32* argb, ETC2HModeBlock const & etc2, bool alpha)
+	{
+		BOOST_ASSERT(argb);
+
+		std::array<ARGBColor32, 4> modified_clr;
+		this->DecodeETCHModePalette(&modified_clr[0], etc2, alpha);
 
 		for (int x = 0; x < 4; ++ x)
 		{
@@ -1937,21 +2162,14 @@ namespace KlayGE
 				int msb = (etc2.msb >> bit_index) & 0x1;
 				int lsb = (etc2.lsb >> bit_index) & 0x1;
 				int pixel_index = msb * 2 + lsb;
-				if (alpha && (2 == pixel_index))
-				{
-					argb[y * 4 + x] = ARGBColor32(0, 0, 0, 0);
-				}
-				else
-				{
-					argb[y * 4 + x] = modified_clr[pixel_index];
-				}
+				argb[y * 4 + x] = modified_clr[pixel_index];
 			}
 		}
 	}
 
-	void TexCompressionETC2RGB8::DecodeETCHModeInternal(ARGBColor32* argb, ETC2HModeBlock const & etc2, bool alpha)
+	void TexCompressionETC2RGB8::DecodeETCHModePalette(ARGBColor32* clr, ETC2HModeBlock const & etc2, bool alpha) const
 	{
-		BOOST_ASSERT(argb);
+		BOOST_ASSERT(clr);
 
 		static int const distance_table[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
 
@@ -1981,31 +2199,15 @@ namespace KlayGE
 		int const ordering = ARGBColor32(0, base_clr1[0], base_clr1[1], base_clr1[2]).ARGB()
 			>= ARGBColor32(0, base_clr2[0], base_clr2[1], base_clr2[2]).ARGB();
 		int distance = distance_table[da | (db << 1) | ordering];
-		ARGBColor32 const modified_clr[] =
-		{
-			From4Ints(255, base_clr1[0] + distance, base_clr1[1] + distance, base_clr1[2] + distance),
-			From4Ints(255, base_clr1[0] - distance, base_clr1[1] - distance, base_clr1[2] - distance),
-			From4Ints(255, base_clr2[0] + distance, base_clr2[1] + distance, base_clr2[2] + distance),
-			From4Ints(255, base_clr2[0] - distance, base_clr2[1] - distance, base_clr2[2] - distance)
-		};
+		clr[0] = From4Ints(255, base_clr1[0] + distance, base_clr1[1] + distance, base_clr1[2] + distance);
+		clr[1] = From4Ints(255, base_clr1[0] - distance, base_clr1[1] - distance, base_clr1[2] - distance);
+		clr[2] = From4Ints(255, base_clr2[0] + distance, base_clr2[1] + distance, base_clr2[2] + distance);
+		clr[3] = From4Ints(255, base_clr2[0] - distance, base_clr2[1] - distance, base_clr2[2] - distance);
 
-		for (int x = 0; x < 4; ++ x)
+		// Index 2 is transparent black in the punch-through mode
+		if (alpha)
 		{
-			for (int y = 0; y < 4; ++ y)
-			{
-				int bit_index = (x * 4 + y) ^ 0x8;
-				int msb = (etc2.msb >> bit_index) & 0x1;
-				int lsb = (etc2.lsb >> bit_index) & 0x1;
-				int pixel_index = msb * 2 + lsb;
-				if (alpha && (2 == pixel_index))
-				{
-					argb[y * 4 + x] = ARGBColor32(0, 0, 0, 0);
-				}
-				else
-				{
-					argb[y * 4 + x] = modified_clr[pixel_index];
-				}
-			}
+			clr[2] = ARGBColor32(0, 0, 0, 0);
 		}
 	}
 
@@ -2066,6 +2268,11 @@ namespace KlayGE
 		etc2_rgb8_codec_ = MakeSharedPtr<TexCompressionETC2RGB8>();
 	}
 
+	TexCompressionPtr TexCompressionETC2RGB8A1::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionETC2RGB8A1>();
+	}
+
 	void TexCompressionETC2RGB8A1::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		KFL_UNUSED(output);
@@ -2108,4 +2315,21 @@ namespace KlayGE
 			etc1_codec_->DecodeETCDifferentialModeInternal(argb, etc2.etc1, !op);
 		}
 	}
+
+	void TexCompressionETC2RGB8A1::DecodeBlockRow(void* output, uint32_t out_row_pitch, void const * input, uint32_t num_blocks)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		// The opaque bit takes the place of the diff bit, all blocks are in the differential based modes
+		DecodeETCBlockRow(static_cast<uint8_t*>(output), out_row_pitch, static_cast<ETC2Block const *>(input), num_blocks,
+			[this](PalettedBlock& block, ETC2Block const & etc2)
+			{
+				return ETC2PalettedBlock(block, *etc1_codec_, *etc2_rgb8_codec_, etc2, true, !(etc2.etc1.cw_diff_flip & 0x2));
+			},
+			[this](ARGBColor32* argb, ETC2Block const & etc2)
+			{
+				etc2_rgb8_codec_->DecodeETCPlanarModeInternal(argb, etc2.etc2_planar_mode);
+			});
+	}
 }
@@ -0,0 +1,400 @@
+/**
+* @file TexCompressionSIMD.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/iterator.hpp>
+#include <KFL/CpuInfo.hpp>
+
+#include <cstring>
+
+#if defined(KLAYGE_SSE2_SUPPORT) && (defined(KLAYGE_CPU_X86) || defined(KLAYGE_CPU_X64))
+	#define TEXCOMPRESSION_SSE2_PATH
+	#include <emmintrin.h>
+
+	// The AVX2 path is built into every x86 binary and only runs on CPUs that have it, GCC and Clang need the
+	//  instruction set enabled per function for that.
+	#define TEXCOMPRESSION_AVX2_PATH
+	#include <immintrin.h>
+	#if defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)
+		#define TEXCOMPRESSION_AVX2_FUNC __attribute__((target("avx2")))
+	#else
+		#define TEXCOMPRESSION_AVX2_FUNC
+	#endif
+#endif
+
+#include "TexCompressionSIMD.hpp"
+
+namespace
+{
+	using namespace KlayGE;
+
+	enum DecoderPath
+	{
+		DP_Scalar,
+		DP_SSE2,
+		DP_AVX2
+	};
+
+	DecoderPath SelectDecoderPath()
+	{
+		static DecoderPath const path = []
+			{
+				DecoderPath ret = DP_Scalar;
+#ifdef TEXCOMPRESSION_SSE2_PATH
+				CPUInfo cpu;
+				if (cpu.IsFeatureSupport(CPUInfo::CF_SSE2))
+				{
+					ret = DP_SSE2;
+				}
+#ifdef TEXCOMPRESSION_AVX2_PATH
+				if (cpu.IsFeatureSupport(CPUInfo::CF_AVX) && cpu.IsFeatureSupport(CPUInfo::CF_AVX2))
+				{
+					ret = DP_AVX2;
+				}
+#endif
+#endif
+				return ret;
+			}();
+		return path;
+	}
+
+	uint32_t LookupTexel(PalettedBlock const & block, uint32_t texel)
+	{
+		uint32_t const index = ((block.index_planes[0] >> texel) & 0x1)
+			| (((block.index_planes[1] >> texel) & 0x1) << 1)
+			| (((block.index_planes[2] >> texel) & 0x1) << 2);
+		return block.palette[index];
+	}
+
+#ifdef TEXCOMPRESSION_SSE2_PATH
+	// m ? b : a
+	__m128i Select(__m128i m, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_andnot_si128(m, a), _mm_and_si128(m, b));
+	}
+
+	// Looks up 4 texels at a time with compare masks, SSE2 has no variable shift or shuffle
+	class PaletteLookupSSE2
+	{
+	public:
+		explicit PaletteLookupSSE2(PalettedBlock const & block)
+			: index_planes_(block.index_planes)
+		{
+			for (size_t i = 0; i < std::size(palette_); ++ i)
+			{
+				palette_[i] = _mm_set1_epi32(block.palette[i]);
+			}
+		}
+
+		__m128i Row(uint32_t y) const
+		{
+			__m128i const bits = _mm_set_epi32(8, 4, 2, 1);
+			uint32_t const shift = y * 4;
+
+			__m128i const m0 = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(index_planes_[0] >> shift), bits), bits);
+			__m128i const m1 = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(index_planes_[1] >> shift), bits), bits);
+			__m128i ret = Select(m1, Select(m0, palette_[0], palette_[1]), Select(m0, palette_[2], palette_[3]));
+			if (index_planes_[2] != 0)
+			{
+				__m128i const m2 = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(index_planes_[2] >> shift), bits), bits);
+				__m128i const upper = Select(m1, Select(m0, palette_[4], palette_[5]), Select(m0, palette_[6], palette_[7]));
+				ret = Select(m2, ret, upper);
+			}
+			return ret;
+		}
+
+	private:
+		__m128i palette_[8];
+		std::array<uint16_t, 3> index_planes_;
+	};
+#endif
+
+	struct ARGB8Format
+	{
+		static uint32_t const TEXEL_BYTES = 4;
+
+		static void Store(uint8_t* dst, uint32_t argb)
+		{
+			std::memcpy(dst, &argb, sizeof(argb));
+		}
+#ifdef TEXCOMPRESSION_SSE2_PATH
+		static void Store(uint8_t* dst, __m128i argb)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), argb);
+		}
+#endif
+	};
+
+	struct ARGB8AlphaFormat
+	{
+		static uint32_t const TEXEL_BYTES = 4;
+
+		static void Store(uint8_t* dst, uint32_t argb, uint32_t alpha)
+		{
+			uint32_t const texel = (argb & 0x00FFFFFF) | (alpha << 24);
+			std::memcpy(dst, &texel, sizeof(texel));
+		}
+#ifdef TEXCOMPRESSION_SSE2_PATH
+		static void Store(uint8_t* dst, __m128i argb, __m128i alpha)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+				_mm_or_si128(_mm_and_si128(argb, _mm_set1_epi32(0x00FFFFFF)), _mm_slli_epi32(alpha, 24)));
+		}
+#endif
+	};
+
+	struct R8Format
+	{
+		static uint32_t const TEXEL_BYTES = 1;
+
+		static void Store(uint8_t* dst, uint32_t r)
+		{
+			*dst = static_cast<uint8_t>(r);
+		}
+#ifdef TEXCOMPRESSION_SSE2_PATH
+		static void Store(uint8_t* dst, __m128i r)
+		{
+			__m128i const r16 = _mm_packs_epi32(r, r);
+			int const r8 = _mm_cvtsi128_si32(_mm_packus_epi16(r16, r16));
+			std::memcpy(dst, &r8, sizeof(r8));
+		}
+#endif
+	};
+
+	struct GR8Format
+	{
+		static uint32_t const TEXEL_BYTES = 2;
+
+		static void Store(uint8_t* dst, uint32_t r, uint32_t g)
+		{
+			uint16_t const texel = static_cast<uint16_t>(r | (g << 8));
+			std::memcpy(dst, &texel, sizeof(texel));
+		}
+#ifdef TEXCOMPRESSION_SSE2_PATH
+		static void Store(uint8_t* dst, __m128i r, __m128i g)
+		{
+			// Sign extends the 16-bit texels first, so the saturating pack keeps them intact
+			__m128i gr = _mm_or_si128(r, _mm_slli_epi32(g, 8));
+			gr = _mm_srai_epi32(_mm_slli_epi32(gr, 16), 16);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packs_epi32(gr, gr));
+		}
+#endif
+	};
+
+	template <typename Format>
+	void DecodeBlocksScalar(uint8_t* output, uint32_t out_row_pitch, uint32_t num_blocks, PalettedBlock const * blocks)
+	{
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			for (uint32_t y = 0; y < 4; ++ y)
+			{
+				uint8_t* dst = output + y * out_row_pitch + i * 4 * Format::TEXEL_BYTES;
+				for (uint32_t x = 0; x < 4; ++ x)
+				{
+					Format::Store(dst + x * Format::TEXEL_BYTES, LookupTexel(blocks[i], y * 4 + x));
+				}
+			}
+		}
+	}
+
+	template <typename Format>
+	void DecodeBlocksScalar(uint8_t* output, uint32_t out_row_pitch, uint32_t num_blocks,
+		PalettedBlock const * blocks0, PalettedBlock const * blocks1)
+	{
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			for (uint32_t y = 0; y < 4; ++ y)
+			{
+				uint8_t* dst = output + y * out_row_pitch + i * 4 * Format::TEXEL_BYTES;
+				for (uint32_t x = 0; x < 4; ++ x)
+				{
+					uint32_t const texel = y * 4 + x;
+					Format::Store(dst + x * Format::TEXEL_BYTES, LookupTexel(blocks0[i], texel), LookupTexel(blocks1[i], texel));
+				}
+			}
+		}
+	}
+
+#ifdef TEXCOMPRESSION_SSE2_PATH
+	template <typename Format>
+	void DecodeBlocksSSE2(uint8_t* output, uint32_t out_row_pitch, uint32_t num_blocks, PalettedBlock const * blocks)
+	{
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			PaletteLookupSSE2 const lookup(blocks[i]);
+			for (uint32_t y = 0; y < 4; ++ y)
+			{
+				Format::Store(output + y * out_row_pitch + i * 4 * Format::TEXEL_BYTES, lookup.Row(y));
+			}
+		}
+	}
+
+	template <typename Format>
+	void DecodeBlocksSSE2(uint8_t* output, uint32_t out_row_pitch, uint32_t num_blocks,
+		PalettedBlock const * blocks0, PalettedBlock const * blocks1)
+	{
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			PaletteLookupSSE2 const lookup0(blocks0[i]);
+			PaletteLookupSSE2 const lookup1(blocks1[i]);
+			for (uint32_t y = 0; y < 4; ++ y)
+			{
+				Format::Store(output + y * out_row_pitch + i * 4 * Format::TEXEL_BYTES, lookup0.Row(y), lookup1.Row(y));
+			}
+		}
+	}
+#endif
+
+#ifdef TEXCOMPRESSION_AVX2_PATH
+	// Looks up 2 rows at a time, the 3-bit indices go straight into a cross-lane permute of the 8-entry palette
+	TEXCOMPRESSION_AVX2_FUNC __m256i LookupTwoRowsAVX2(__m256i palette, std::array<uint16_t, 3> const & index_planes, uint32_t y)
+	{
+		uint32_t const shift = y * 4;
+		uint32_t const bits = ((index_planes[0] >> shift) & 0xFF)
+			| (((index_planes[1] >> shift) & 0xFF) << 8)
+			| (((index_planes[2] >> shift) & 0xFF) << 16);
+
+		__m256i const t = _mm256_srlv_epi32(_mm256_set1_epi32(bits), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+		__m256i const index = _mm256_or_si256(_mm256_and_si256(t, _mm256_set1_epi32(0x1)),
+			_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(t, 7), _mm256_set1_epi32(0x2)),
+				_mm256_and_si256(_mm256_srli_epi32(t, 14), _mm256_set1_epi32(0x4))));
+		return _mm256_permutevar8x32_epi32(palette, index);
+	}
+
+	template <typename Format>
+	TEXCOMPRESSION_AVX2_FUNC void DecodeBlocksAVX2(uint8_t* output, uint32_t out_row_pitch, uint32_t num_blocks,
+		PalettedBlock const * blocks)
+	{
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			__m256i const palette = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(blocks[i].palette.data()));
+			uint8_t* dst = output + i * 4 * Format::TEXEL_BYTES;
+			for (uint32_t y = 0; y < 4; y += 2)
+			{
+				__m256i const texels = LookupTwoRowsAVX2(palette, blocks[i].index_planes, y);
+				Format::Store(dst + y * out_row_pitch, _mm256_castsi256_si128(texels));
+				Format::Store(dst + (y + 1) * out_row_pitch, _mm256_extracti128_si256(texels, 1));
+			}
+		}
+	}
+
+	template <typename Format>
+	TEXCOMPRESSION_AVX2_FUNC void DecodeBlocksAVX2(uint8_t* output, uint32_t out_row_pitch, uint32_t num_blocks,
+		PalettedBlock const * blocks0, PalettedBlock const * blocks1)
+	{
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			__m256i const palette0 = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(blocks0[i].palette.data()));
+			__m256i const palette1 = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(blocks1[i].palette.data()));
+			uint8_t* dst = output + i * 4 * Format::TEXEL_BYTES;
+			for (uint32_t y = 0; y < 4; y += 2)
+			{
+				__m256i const texels0 = LookupTwoRowsAVX2(palette0, blocks0[i].index_planes, y);
+				__m256i const texels1 = LookupTwoRowsAVX2(palette1, blocks1[i].index_planes, y);
+				Format::Store(dst + y * out_row_pitch, _mm256_castsi256_si128(texels0), _mm256_castsi256_si128(texels1));
+				Format::Store(dst + (y + 1) * out_row_pitch, _mm256_extracti128_si256(texels0, 1),
+					_mm256_extracti128_si256(texels1, 1));
+			}
+		}
+	}
+#endif
+
+	template <typename Format>
+	void DecodeBlocks(void* output, uint32_t out_row_pitch, uint32_t num_blocks, PalettedBlock const * blocks)
+	{
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		switch (SelectDecoderPath())
+		{
+#ifdef TEXCOMPRESSION_AVX2_PATH
+		case DP_AVX2:
+			DecodeBlocksAVX2<Format>(dst, out_row_pitch, num_blocks, blocks);
+			break;
+#endif
+#ifdef TEXCOMPRESSION_SSE2_PATH
+		case DP_SSE2:
+			DecodeBlocksSSE2<Format>(dst, out_row_pitch, num_blocks, blocks);
+			break;
+#endif
+
+		default:
+			DecodeBlocksScalar<Format>(dst, out_row_pitch, num_blocks, blocks);
+			break;
+		}
+	}
+
+	template <typename Format>
+	void DecodeBlocks(void* output, uint32_t out_row_pitch, uint32_t num_blocks,
+		PalettedBlock const * blocks0, PalettedBlock const * blocks1)
+	{
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		switch (SelectDecoderPath())
+		{
+#ifdef TEXCOMPRESSION_AVX2_PATH
+		case DP_AVX2:
+			DecodeBlocksAVX2<Format>(dst, out_row_pitch, num_blocks, blocks0, blocks1);
+			break;
+#endif
+#ifdef TEXCOMPRESSION_SSE2_PATH
+		case DP_SSE2:
+			DecodeBlocksSSE2<Format>(dst, out_row_pitch, num_blocks, blocks0, blocks1);
+			break;
+#endif
+
+		default:
+			DecodeBlocksScalar<Format>(dst, out_row_pitch, num_blocks, blocks0, blocks1);
+			break;
+		}
+	}
+}
+
+namespace KlayGE
+{
+	void DecodePalettedBlocksARGB8(void* output, uint32_t out_row_pitch, PalettedBlock const * blocks, uint32_t num_blocks)
+	{
+		DecodeBlocks<ARGB8Format>(output, out_row_pitch, num_blocks, blocks);
+	}
+
+	void DecodePalettedBlocksARGB8(void* output, uint32_t out_row_pitch, PalettedBlock const * color_blocks,
+		PalettedBlock const * alpha_blocks, uint32_t num_blocks)
+	{
+		DecodeBlocks<ARGB8AlphaFormat>(output, out_row_pitch, num_blocks, color_blocks, alpha_blocks);
+	}
+
+	void DecodePalettedBlocksR8(void* output, uint32_t out_row_pitch, PalettedBlock const * blocks, uint32_t num_blocks)
+	{
+		DecodeBlocks<R8Format>(output, out_row_pitch, num_blocks, blocks);
+	}
+
+	void DecodePalettedBlocksGR8(void* output, uint32_t out_row_pitch, PalettedBlock const * r_blocks,
+		PalettedBlock const * g_blocks, uint32_t num_blocks)
+	{
+		DecodeBlocks<GR8Format>(output, out_row_pitch, num_blocks, r_blocks, g_blocks);
+	}
+}
@@ -0,0 +1,66 @@
+/**
+* @file TexCompressionSIMD.hpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#ifndef _TEXCOMPRESSIONSIMD_HPP
+#define _TEXCOMPRESSIONSIMD_HPP
+
+#pragma once
+
+#include <array>
+
+namespace KlayGE
+{
+	// A decoded 4x4 block of the palette based formats (BC1-BC5, ETC1, most of ETC2). The codecs build the palettes with
+	//  their scalar code, so the batch decoders are bit exact with DecodeBlock, and only the index expansion is vectorized.
+	struct PalettedBlock
+	{
+		std::array<uint32_t, 8> palette;
+		// Bit y * 4 + x of index_planes[n] is bit n of the palette index of texel (x, y)
+		std::array<uint16_t, 3> index_planes;
+	};
+
+	// Number of blocks the codecs prepare on the stack for one call to the batch decoders
+	uint32_t const PALETTED_BLOCK_BATCH = 32;
+
+	// Each of them writes num_blocks consecutive blocks of one block row, block i goes to the 4x4 texels at
+	//  output + i * 4 texels. They pick the AVX2, SSE2 or scalar path at runtime with CPUInfo.
+
+	// Palettes are ARGB8
+	void DecodePalettedBlocksARGB8(void* output, uint32_t out_row_pitch, PalettedBlock const * blocks, uint32_t num_blocks);
+	// RGB from color_blocks, alpha from the low 8 bits of alpha_blocks' palettes
+	void DecodePalettedBlocksARGB8(void* output, uint32_t out_row_pitch, PalettedBlock const * color_blocks,
+		PalettedBlock const * alpha_blocks, uint32_t num_blocks);
+	// Palettes are in the low 8 bits
+	void DecodePalettedBlocksR8(void* output, uint32_t out_row_pitch, PalettedBlock const * blocks, uint32_t num_blocks);
+	void DecodePalettedBlocksGR8(void* output, uint32_t out_row_pitch, PalettedBlock const * r_blocks,
+		PalettedBlock const * g_blocks, uint32_t num_blocks);
+}
+
+#endif		// _TEXCOMPRESSIONSIMD_HPP
@@ -1114,6 +1114,11 @@ namespace
 			return type;
 		}
 
+		std::string_view Name() const override
+		{
+			return tex_desc_.res_name;
+		}
+
 		bool StateLess() const override
 		{
 			return true;
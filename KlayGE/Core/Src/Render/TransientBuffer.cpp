@@ -35,13 +35,18 @@
 #include <KlayGE/App3D.hpp>
 
 #include <cstring>
+#include <thread>
 
 #include <KlayGE/TransientBuffer.hpp>
 
 namespace KlayGE
 {
-	TransientBuffer::TransientBuffer(uint32_t size_in_byte, TransientBuffer::BindFlag bind_flag)
-		: bind_flag_(bind_flag)
+	TransientBuffer::TransientBuffer(uint32_t size_in_byte, TransientBuffer::BindFlag bind_flag,
+			TransientBuffer::AllocMode alloc_mode)
+		: bind_flag_(bind_flag), alloc_mode_(alloc_mode),
+			ring_size_(size_in_byte), ring_head_(0), ring_tail_(0), ring_uploaded_(0), ring_fence_index_(0),
+			ring_upload_all_(false), ring_writers_(0), ring_growing_(false),
+			frame_bytes_(0), bytes_per_frame_(0), num_wrap_stalls_(0)
 	{
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 		RenderEngine const & re = rf.RenderEngineInstance();
@@ -61,11 +66,21 @@ namespace KlayGE
 			valid_max_ = 0;
 		}
 
-		SubAlloc alloc(0, size_in_byte);
-		free_list_.push_back(alloc);
-
 		App3DFramework const & app = Context::Instance().AppInstance();
-		retired_frames_.push_back(RetiredFrame(app.TotalNumFrames() + 1));
+		stats_frame_id_ = app.TotalNumFrames();
+
+		if (AM_Ring == alloc_mode_)
+		{
+			simulate_buffer_.resize(buffer_->Size());
+			ring_fences_.assign(num_pre_frames_, 0);
+		}
+		else
+		{
+			SubAlloc alloc(0, size_in_byte);
+			free_list_.push_back(alloc);
+
+			retired_frames_.push_back(RetiredFrame(app.TotalNumFrames() + 1));
+		}
 	}
 
 	GraphicsBufferPtr TransientBuffer::DoCreateBuffer(TransientBuffer::BindFlag bind_flag, uint32_t size_in_byte)
@@ -90,6 +105,27 @@ namespace KlayGE
 
 	SubAlloc TransientBuffer::Alloc(uint32_t size_in_byte, void const * data)
 	{
+		if (AM_Ring == alloc_mode_)
+		{
+			// A grower waits for ring_writers_ to drop to 0 after raising ring_growing_, and writers check the flag after
+			//  raising the count. Both are sequentially consistent, so one of them always sees the other.
+			++ ring_writers_;
+			uint32_t offset;
+			if (!ring_growing_ && this->RingTryAlloc(size_in_byte, offset))
+			{
+				memcpy(&simulate_buffer_[offset], data, size_in_byte);
+				-- ring_writers_;
+
+				frame_bytes_ += size_in_byte;
+				return SubAlloc(offset, size_in_byte);
+			}
+			-- ring_writers_;
+
+			return this->RingAllocSlow(size_in_byte, data);
+		}
+
+		frame_bytes_ += size_in_byte;
+
 		SubAlloc ret;
 
 		// Use first fit method to find a free sub alloc
@@ -163,8 +199,84 @@ namespace KlayGE
 		return ret;
 	}
 
+	bool TransientBuffer::RingTryAlloc(uint32_t size_in_byte, uint32_t& offset)
+	{
+		uint64_t head = ring_head_;
+		uint64_t start;
+		uint64_t new_head;
+		do
+		{
+			// Allocs never straddle the end of the buffer, the rest of it is skipped instead
+			start = head;
+			uint32_t const pos = static_cast<uint32_t>(start % ring_size_);
+			if (pos + size_in_byte > ring_size_)
+			{
+				start += ring_size_ - pos;
+			}
+			new_head = start + size_in_byte;
+
+			if (new_head - ring_tail_ > ring_size_)
+			{
+				return false;
+			}
+		} while (!ring_head_.compare_exchange_weak(head, new_head));
+
+		offset = static_cast<uint32_t>(start % ring_size_);
+		return true;
+	}
+
+	SubAlloc TransientBuffer::RingAllocSlow(uint32_t size_in_byte, void const * data)
+	{
+		std::lock_guard<std::mutex> lock(ring_grow_mutex_);
+
+		ring_growing_ = true;
+		while (ring_writers_ > 0)
+		{
+			std::this_thread::yield();
+		}
+
+		// Could have been grown by another thread in the meantime
+		uint32_t offset;
+		if (!this->RingTryAlloc(size_in_byte, offset))
+		{
+			// The rest of the ring is still used by the frames in flight. Instead of waiting for them, switch to a larger
+			//  buffer. Allocs of this frame keep their offsets, so only [old_size, new_size) is free until this frame retires.
+			++ num_wrap_stalls_;
+
+			uint32_t const old_size = ring_size_;
+			uint32_t const new_size = std::max(old_size * 2, old_size + size_in_byte);
+			simulate_buffer_.resize(new_size);
+
+			uint64_t const base = (ring_head_ / new_size + 1) * new_size;
+			ring_size_ = new_size;
+			ring_head_ = base + old_size;
+			ring_tail_ = base;
+			for (auto& fence : ring_fences_)
+			{
+				fence = base;
+			}
+			ring_upload_all_ = true;
+
+			bool const succeeded = this->RingTryAlloc(size_in_byte, offset);
+			BOOST_ASSERT(succeeded);
+			KFL_UNUSED(succeeded);
+		}
+
+		memcpy(&simulate_buffer_[offset], data, size_in_byte);
+		frame_bytes_ += size_in_byte;
+
+		ring_growing_ = false;
+
+		return SubAlloc(offset, size_in_byte);
+	}
+
 	void TransientBuffer::Dealloc(SubAlloc const & alloc)
 	{
+		if (AM_Ring == alloc_mode_)
+		{
+			return;
+		}
+
 		if ((alloc.length_ > 0) && !retired_frames_.empty())
 		{
 			RetiredFrame& frame = retired_frames_.back();
@@ -186,7 +298,31 @@ namespace KlayGE
 
 	void TransientBuffer::OnPresent()
 	{
-		if (!retired_frames_.empty())
+		App3DFramework const & app = Context::Instance().AppInstance();
+		uint32_t const cur_frame_id = app.TotalNumFrames();
+		bool const new_frame = (cur_frame_id != stats_frame_id_);
+		if (new_frame)
+		{
+			bytes_per_frame_ = frame_bytes_.exchange(0);
+			stats_frame_id_ = cur_frame_id;
+		}
+
+		if (AM_Ring == alloc_mode_)
+		{
+			// OnPresent can be called several times a frame, only the first one retires a frame
+			uint32_t const num_fences = static_cast<uint32_t>(ring_fences_.size());
+			if (new_frame)
+			{
+				ring_tail_ = ring_fences_[ring_fence_index_];
+				ring_fences_[ring_fence_index_] = ring_head_;
+				ring_fence_index_ = (ring_fence_index_ + 1) % num_fences;
+			}
+			else
+			{
+				ring_fences_[(ring_fence_index_ + num_fences - 1) % num_fences] = ring_head_;
+			}
+		}
+		else if (!retired_frames_.empty())
 		{
 			App3DFramework const & app = Context::Instance().AppInstance();
 			uint32_t const frame_id = app.TotalNumFrames();
@@ -282,9 +418,69 @@ namespace KlayGE
 		}
 	}
 
+	void TransientBuffer::RingUpload()
+	{
+		uint64_t const head = ring_head_;
+
+		if (buffer_->Size() != ring_size_)
+		{
+			buffer_ = this->DoCreateBuffer(bind_flag_, ring_size_);
+			ring_upload_all_ = true;
+		}
+
+		if (ring_upload_all_ || (head - ring_uploaded_ >= ring_size_))
+		{
+			GraphicsBuffer::Mapper mapper(*buffer_, BA_Write_Only);
+			memcpy(mapper.Pointer<uint8_t>(), &simulate_buffer_[0], ring_size_);
+		}
+		else if (head != ring_uploaded_)
+		{
+			uint32_t const begin = static_cast<uint32_t>(ring_uploaded_ % ring_size_);
+			uint32_t const end = static_cast<uint32_t>(head % ring_size_);
+			if (use_no_overwrite_)
+			{
+				GraphicsBuffer::Mapper mapper(*buffer_, BA_Write_No_Overwrite);
+				uint8_t* buffer_data = mapper.Pointer<uint8_t>();
+				if (begin < end)
+				{
+					memcpy(buffer_data + begin, &simulate_buffer_[begin], end - begin);
+				}
+				else
+				{
+					memcpy(buffer_data + begin, &simulate_buffer_[begin], ring_size_ - begin);
+					memcpy(buffer_data, &simulate_buffer_[0], end);
+				}
+			}
+			else
+			{
+				// Without no-overwrite maps only the new range goes up, as sub-range updates. A write-only map would
+				//  have to rewrite the whole ring.
+				if (begin < end)
+				{
+					buffer_->UpdateSubresource(begin, end - begin, &simulate_buffer_[begin]);
+				}
+				else
+				{
+					buffer_->UpdateSubresource(begin, ring_size_ - begin, &simulate_buffer_[begin]);
+					if (end > 0)
+					{
+						buffer_->UpdateSubresource(0, end, &simulate_buffer_[0]);
+					}
+				}
+			}
+		}
+
+		ring_uploaded_ = head;
+		ring_upload_all_ = false;
+	}
+
 	void TransientBuffer::EnsureDataReady()
 	{
-		if (!use_no_overwrite_)
+		if (AM_Ring == alloc_mode_)
+		{
+			this->RingUpload();
+		}
+		else if (!use_no_overwrite_)
 		{
 			GraphicsBuffer::Mapper mapper(*buffer_, BA_Write_Only);
 			memcpy(mapper.Pointer<uint8_t>() + valid_min_, &simulate_buffer_[valid_min_],
@@ -53,13 +53,150 @@
 #include <KlayGE/InputFactory.hpp>
 #include <KlayGE/FrameBuffer.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/RadixSort.hpp>
+#include <KFL/TaskScheduler.hpp>
 
 #include <map>
 #include <algorithm>
 
+#if defined(KLAYGE_AVX_SUPPORT)
+#include <immintrin.h>
+#elif defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
 #include <KlayGE/SceneManager.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+#if defined(KLAYGE_AVX_SUPPORT)
+	uint32_t const CULLING_BATCH = 8;
+#elif defined(KLAYGE_SSE_SUPPORT)
+	uint32_t const CULLING_BATCH = 4;
+#else
+	uint32_t const CULLING_BATCH = 1;
+#endif
+	uint32_t const CULLING_GRAIN = 1024;
+	uint8_t const CULLING_SMALL_OBJ_PASS = 1UL << 7;
+
+	// The object ClipSceneParallel is culling on this thread. SceneManager::AABBVisible returns the batch result
+	//  for its box instead of testing it again.
+	thread_local SceneManager const * batch_culling_sm = nullptr;
+	thread_local uint32_t batch_culling_index = 0;
+
+	// Same test as MathLib::intersect_aabb_frustum, on CULLING_BATCH boxes at once. begin must be a multiple of
+	//  CULLING_BATCH, and the arrays must be padded to a multiple of it.
+	void IntersectAABBFrustumBatch(Frustum const & frustum, uint32_t begin, uint32_t end,
+		float const * min_x, float const * min_y, float const * min_z,
+		float const * max_x, float const * max_y, float const * max_z,
+		uint8_t* results)
+	{
+		BOOST_ASSERT(0 == begin % CULLING_BATCH);
+
+		// The vertex farthest along the plane normal (v0) and its diagonal opposite (v1) pick one array per axis
+		std::array<float const *, 3> v0_ptrs[6];
+		std::array<float const *, 3> v1_ptrs[6];
+		for (int p = 0; p < 6; ++ p)
+		{
+			Plane const & plane = frustum.FrustumPlane(p);
+			v0_ptrs[p][0] = (plane.a() < 0) ? min_x : max_x;
+			v0_ptrs[p][1] = (plane.b() < 0) ? min_y : max_y;
+			v0_ptrs[p][2] = (plane.c() < 0) ? min_z : max_z;
+			v1_ptrs[p][0] = (plane.a() < 0) ? max_x : min_x;
+			v1_ptrs[p][1] = (plane.b() < 0) ? max_y : min_y;
+			v1_ptrs[p][2] = (plane.c() < 0) ? max_z : min_z;
+		}
+
+		for (uint32_t i = begin; i < end; i += CULLING_BATCH)
+		{
+			uint32_t outside_mask = 0;
+			uint32_t intersect_mask = 0;
+
+#if defined(KLAYGE_AVX_SUPPORT)
+			__m256 const zero = _mm256_setzero_ps();
+			__m256 outside = zero;
+			__m256 intersect = zero;
+			for (int p = 0; p < 6; ++ p)
+			{
+				Plane const & plane = frustum.FrustumPlane(p);
+				__m256 const a = _mm256_set1_ps(plane.a());
+				__m256 const b = _mm256_set1_ps(plane.b());
+				__m256 const c = _mm256_set1_ps(plane.c());
+				__m256 const d = _mm256_set1_ps(plane.d());
+
+				__m256 const dist0 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(a, _mm256_loadu_ps(v0_ptrs[p][0] + i)), _mm256_mul_ps(b, _mm256_loadu_ps(v0_ptrs[p][1] + i))),
+					_mm256_mul_ps(c, _mm256_loadu_ps(v0_ptrs[p][2] + i))), d);
+				__m256 const dist1 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(a, _mm256_loadu_ps(v1_ptrs[p][0] + i)), _mm256_mul_ps(b, _mm256_loadu_ps(v1_ptrs[p][1] + i))),
+					_mm256_mul_ps(c, _mm256_loadu_ps(v1_ptrs[p][2] + i))), d);
+
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist0, zero, _CMP_LT_OQ));
+				intersect = _mm256_or_ps(intersect, _mm256_cmp_ps(dist1, zero, _CMP_LT_OQ));
+			}
+			outside_mask = _mm256_movemask_ps(outside);
+			intersect_mask = _mm256_movemask_ps(intersect);
+#elif defined(KLAYGE_SSE_SUPPORT)
+			__m128 const zero = _mm_setzero_ps();
+			__m128 outside = zero;
+			__m128 intersect = zero;
+			for (int p = 0; p < 6; ++ p)
+			{
+				Plane const & plane = frustum.FrustumPlane(p);
+				__m128 const a = _mm_set1_ps(plane.a());
+				__m128 const b = _mm_set1_ps(plane.b());
+				__m128 const c = _mm_set1_ps(plane.c());
+				__m128 const d = _mm_set1_ps(plane.d());
+
+				__m128 const dist0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(a, _mm_loadu_ps(v0_ptrs[p][0] + i)), _mm_mul_ps(b, _mm_loadu_ps(v0_ptrs[p][1] + i))),
+					_mm_mul_ps(c, _mm_loadu_ps(v0_ptrs[p][2] + i))), d);
+				__m128 const dist1 = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(a, _mm_loadu_ps(v1_ptrs[p][0] + i)), _mm_mul_ps(b, _mm_loadu_ps(v1_ptrs[p][1] + i))),
+					_mm_mul_ps(c, _mm_loadu_ps(v1_ptrs[p][2] + i))), d);
+
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(dist0, zero));
+				intersect = _mm_or_ps(intersect, _mm_cmplt_ps(dist1, zero));
+			}
+			outside_mask = _mm_movemask_ps(outside);
+			intersect_mask = _mm_movemask_ps(intersect);
+#else
+			for (int p = 0; p < 6; ++ p)
+			{
+				Plane const & plane = frustum.FrustumPlane(p);
+				float const dist0 = plane.a() * v0_ptrs[p][0][i] + plane.b() * v0_ptrs[p][1][i]
+					+ plane.c() * v0_ptrs[p][2][i] + plane.d();
+				float const dist1 = plane.a() * v1_ptrs[p][0][i] + plane.b() * v1_ptrs[p][1][i]
+					+ plane.c() * v1_ptrs[p][2][i] + plane.d();
+				outside_mask |= (dist0 < 0) ? 1 : 0;
+				intersect_mask |= (dist1 < 0) ? 1 : 0;
+			}
+#endif
+
+			uint32_t const num_lanes = std::min(CULLING_BATCH, end - i);
+			for (uint32_t j = 0; j < num_lanes; ++ j)
+			{
+				if (outside_mask & (1UL << j))
+				{
+					results[i + j] = BO_No;
+				}
+				else if (intersect_mask & (1UL << j))
+				{
+					results[i + j] = BO_Partial;
+				}
+				else
+				{
+					results[i + j] = BO_Yes;
+				}
+			}
+		}
+	}
+}
+
 namespace KlayGE
 {
 	// 캯
@@ -68,10 +205,17 @@ namespace KlayGE
 		: frustum_(nullptr),
 			small_obj_threshold_(0),
 			update_elapse_(1.0f / 60),
+			parallel_culling_(true),
 			num_objects_rendered_(0), num_renderables_rendered_(0),
 			num_primitives_rendered_(0), num_vertices_rendered_(0),
 			num_draw_calls_(0), num_dispatch_calls_(0),
-			quit_(false), deferred_mode_(false)
+			num_tech_changes_(0), num_mtl_changes_(0),
+			frame_tech_changes_(0), frame_mtl_changes_(0),
+			parallel_sub_thread_update_(true),
+			last_sub_thread_update_time_(-1), next_sub_thread_update_time_(0),
+			sub_thread_app_time_(0), main_thread_stall_time_(0),
+			main_thread_id_(std::this_thread::get_id()),
+			deferred_mode_(false)
 	{
 	}
 
@@ -79,8 +223,11 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	SceneManager::~SceneManager()
 	{
-		quit_ = true;
-		(*update_thread_)();
+		if (sub_thread_update_group_)
+		{
+			sub_thread_update_group_->wait();
+			sub_thread_update_group_.reset();
+		}
 
 		this->ClearLight();
 		this->ClearCamera();
@@ -109,8 +256,61 @@ namespace KlayGE
 
 	// ü
 	/////////////////////////////////////////////////////////////////////////////////
+	void SceneManager::ParallelCulling(bool parallel)
+	{
+		parallel_culling_ = parallel;
+	}
+
+	bool SceneManager::ParallelCulling() const
+	{
+		return parallel_culling_;
+	}
+
+	void SceneManager::ParallelSubThreadUpdate(bool parallel)
+	{
+		parallel_sub_thread_update_ = parallel;
+	}
+
+	bool SceneManager::ParallelSubThreadUpdate() const
+	{
+		return parallel_sub_thread_update_;
+	}
+
+	void SceneManager::GetCustomAttrib(std::string_view name, void* value) const
+	{
+		KFL_UNUSED(name);
+		KFL_UNUSED(value);
+	}
+
+	void SceneManager::SetCustomAttrib(std::string_view name, void* value)
+	{
+		KFL_UNUSED(name);
+		KFL_UNUSED(value);
+	}
+
+	void SceneManager::CullingFrustum(Frustum const & frustum)
+	{
+		frustum_ = &frustum;
+	}
+
 	void SceneManager::ClipScene()
 	{
+		KLAYGE_PERF_ZONE("SceneManager::ClipScene");
+
+		if (parallel_culling_)
+		{
+			this->ClipSceneParallel();
+		}
+		else
+		{
+			this->ClipSceneSerial();
+		}
+	}
+
+	void SceneManager::ClipSceneSerial()
+	{
+		this->UpdateTransforms();
+
 		App3DFramework& app = Context::Instance().AppInstance();
 		Camera& camera = app.ActiveCamera();
 
@@ -135,11 +335,6 @@ namespace KlayGE
 				visible = this->VisibleTestFromParent(so, camera.ForwardVec(), camera.EyePos(), view_proj);
 				if (BO_Partial == visible)
 				{
-					if (attr & SceneObject::SOA_Moveable)
-					{
-						so->UpdateAbsModelMatrix();
-					}
-
 					if (attr & SceneObject::SOA_Cullable)
 					{
 						if (small_obj_threshold_ > 0)
@@ -174,6 +369,189 @@ namespace KlayGE
 		}
 	}
 
+	void SceneManager::ClipSceneParallel()
+	{
+		this->UpdateTransforms();
+
+		App3DFramework& app = Context::Instance().AppInstance();
+		Camera& camera = app.ActiveCamera();
+
+		float4x4 view_proj = camera.ViewProjMatrix();
+		auto drl = Context::Instance().DeferredRenderingLayerInstance();
+		if (drl)
+		{
+			int32_t cas_index = drl->CurrCascadeIndex();
+			if (cas_index >= 0)
+			{
+				view_proj *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
+			}
+		}
+
+		uint32_t const num_objs = static_cast<uint32_t>(scene_objs_.size());
+		uint32_t const num_padded = (num_objs + CULLING_BATCH - 1) / CULLING_BATCH * CULLING_BATCH;
+		cull_min_x_.resize(num_padded, 0);
+		cull_min_y_.resize(num_padded, 0);
+		cull_min_z_.resize(num_padded, 0);
+		cull_max_x_.resize(num_padded, 0);
+		cull_max_y_.resize(num_padded, 0);
+		cull_max_z_.resize(num_padded, 0);
+		cull_flags_.resize(num_padded, 0);
+		cull_results_.resize(num_padded, BO_No);
+
+		task_scheduler& ts = Context::Instance().TaskScheduler();
+
+		auto mirror_aabb = [this](uint32_t index, AABBox const & aabb)
+		{
+			cull_min_x_[index] = aabb.Min().x();
+			cull_min_y_[index] = aabb.Min().y();
+			cull_min_z_[index] = aabb.Min().z();
+			cull_max_x_[index] = aabb.Max().x();
+			cull_max_y_[index] = aabb.Max().y();
+			cull_max_z_[index] = aabb.Max().z();
+		};
+
+		ts.parallel_for(0, num_objs, CULLING_GRAIN, [this, &mirror_aabb](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; ++ i)
+				{
+					SceneObject* so = scene_objs_[i].get();
+					uint32_t const attr = so->Attrib();
+					uint8_t flags = 0;
+					if (so->Visible())
+					{
+						flags |= CF_Visible;
+					}
+					if (attr & SceneObject::SOA_Cullable)
+					{
+						flags |= CF_Cullable;
+					}
+					if (attr & SceneObject::SOA_Moveable)
+					{
+						flags |= CF_Moveable;
+					}
+					if (so->Parent())
+					{
+						flags |= CF_HasParent;
+					}
+					cull_flags_[i] = flags;
+
+					if ((CF_Visible | CF_Cullable) == (flags & (CF_Visible | CF_Cullable)))
+					{
+						mirror_aabb(i, so->PosBoundWS());
+					}
+				}
+			});
+
+		bool const omni_dir = camera.OmniDirectionalMode();
+		float3 const view_dir = camera.ForwardVec();
+		float3 const eye_pos = camera.EyePos();
+		ts.parallel_for(0, num_padded / CULLING_BATCH, std::max(CULLING_GRAIN / CULLING_BATCH, 1U),
+			[this, num_objs, omni_dir, &view_dir, &eye_pos, &view_proj](uint32_t begin, uint32_t end)
+			{
+				this->CullObjects(begin * CULLING_BATCH, std::min(end * CULLING_BATCH, num_objs),
+					omni_dir, view_dir, eye_pos, view_proj);
+			});
+
+		// Parents always precede their children in scene_objs_, so their marks are final by now
+		for (uint32_t i = 0; i < num_objs; ++ i)
+		{
+			uint8_t const flags = cull_flags_[i];
+			if (flags & CF_HasParent)
+			{
+				SceneObject* so = scene_objs_[i].get();
+				BoundOverlap visible;
+				if (flags & CF_Visible)
+				{
+					uint8_t const result = cull_results_[i];
+					BoundOverlap const parent_bo = so->Parent()->VisibleMark();
+					if ((BO_No == parent_bo) || !(result & CULLING_SMALL_OBJ_PASS))
+					{
+						visible = BO_No;
+					}
+					else if (BO_Partial == parent_bo)
+					{
+						visible = static_cast<BoundOverlap>(result & ~CULLING_SMALL_OBJ_PASS);
+					}
+					else
+					{
+						visible = parent_bo;
+					}
+				}
+				else
+				{
+					visible = BO_No;
+				}
+
+				so->VisibleMark(visible);
+			}
+		}
+	}
+
+	void SceneManager::CullObjects(uint32_t begin, uint32_t end, bool omni_dir, float3 const & view_dir,
+		float3 const & eye_pos, float4x4 const & view_proj)
+	{
+		if (!omni_dir && frustum_)
+		{
+			IntersectAABBFrustumBatch(*frustum_, begin, end,
+				cull_min_x_.data(), cull_min_y_.data(), cull_min_z_.data(),
+				cull_max_x_.data(), cull_max_y_.data(), cull_max_z_.data(),
+				cull_results_.data());
+		}
+
+		batch_culling_sm = this;
+		for (uint32_t i = begin; i < end; ++ i)
+		{
+			uint8_t const flags = cull_flags_[i];
+
+			BoundOverlap visible;
+			bool small_obj_pass = true;
+			if (flags & CF_Visible)
+			{
+				if (flags & CF_Cullable)
+				{
+					AABBox const aabb(float3(cull_min_x_[i], cull_min_y_[i], cull_min_z_[i]),
+						float3(cull_max_x_[i], cull_max_y_[i], cull_max_z_[i]));
+					if (small_obj_threshold_ > 0)
+					{
+						small_obj_pass = (MathLib::ortho_area(view_dir, aabb) > small_obj_threshold_)
+							&& (MathLib::perspective_area(eye_pos, view_proj, aabb) > small_obj_threshold_);
+					}
+
+					if (!small_obj_pass)
+					{
+						visible = BO_No;
+					}
+					else if (!omni_dir)
+					{
+						// Overrides of AABBVisible see every box, as in ClipSceneSerial
+						batch_culling_index = i;
+						visible = this->AABBVisible(aabb);
+					}
+					else
+					{
+						visible = BO_Yes;
+					}
+				}
+				else
+				{
+					visible = BO_Yes;
+				}
+			}
+			else
+			{
+				visible = BO_No;
+			}
+
+			cull_results_[i] = static_cast<uint8_t>(visible | (small_obj_pass ? CULLING_SMALL_OBJ_PASS : 0));
+
+			if (!(flags & CF_HasParent))
+			{
+				scene_objs_[i]->VisibleMark(visible);
+			}
+		}
+		batch_culling_sm = nullptr;
+	}
+
 	void SceneManager::AddCamera(CameraPtr const & camera)
 	{
 		cameras_.push_back(camera);
@@ -187,7 +565,6 @@ namespace KlayGE
 
 	std::vector<CameraPtr>::iterator SceneManager::DelCamera(std::vector<CameraPtr>::iterator iter)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
 		return cameras_.erase(iter);
 	}
 
@@ -219,7 +596,6 @@ namespace KlayGE
 
 	std::vector<LightSourcePtr>::iterator SceneManager::DelLight(std::vector<LightSourcePtr>::iterator iter)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
 		return lights_.erase(iter);
 	}
 
@@ -242,8 +618,15 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::AddSceneObject(SceneObjectPtr const & obj)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		this->AddSceneObjectLocked(obj);
+		if (std::this_thread::get_id() == main_thread_id_)
+		{
+			this->AddSceneObjectLocked(obj);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(scene_obj_cmd_mutex_);
+			scene_obj_cmds_.push_back({ obj, true });
+		}
 	}
 
 	void SceneManager::AddSceneObjectLocked(SceneObjectPtr const & obj)
@@ -260,6 +643,7 @@ namespace KlayGE
 		}
 		else
 		{
+			obj->AttachTransform(&transforms_);
 			if ((attr & SceneObject::SOA_Cullable)
 				&& !(attr & SceneObject::SOA_Moveable))
 			{
@@ -275,8 +659,15 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::DelSceneObject(SceneObjectPtr const & obj)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
-		this->DelSceneObjectLocked(obj);
+		if (std::this_thread::get_id() == main_thread_id_)
+		{
+			this->DelSceneObjectLocked(obj);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(scene_obj_cmd_mutex_);
+			scene_obj_cmds_.push_back({ obj, false });
+		}
 	}
 
 	void SceneManager::DelSceneObjectLocked(SceneObjectPtr const & obj)
@@ -293,13 +684,13 @@ namespace KlayGE
 
 	std::vector<SceneObjectPtr>::iterator SceneManager::DelSceneObject(std::vector<SceneObjectPtr>::iterator iter)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
 		return this->DelSceneObjectLocked(iter);
 	}
 
 	std::vector<SceneObjectPtr>::iterator SceneManager::DelSceneObjectLocked(std::vector<SceneObjectPtr>::iterator iter)
 	{
 		this->OnDelSceneObject(iter);
+		(*iter)->DetachTransform();
 		return scene_objs_.erase(iter);
 	}
 
@@ -355,22 +746,10 @@ namespace KlayGE
 
 			if (add)
 			{
-				RenderTechnique const * obj_tech = obj->GetRenderTechnique();
-				BOOST_ASSERT(obj_tech);
-				bool found = false;
-				for (auto& items : render_queue_)
-				{
-					if (items.first == obj_tech)
-					{
-						items.second.push_back(obj);
-						found = true;
-						break;
-					}
-				}
-				if (!found)
-				{
-					render_queue_.emplace_back(obj_tech, std::vector<Renderable*>(1, obj));
-				}
+				BOOST_ASSERT(obj->GetRenderTechnique());
+
+				// Instances are added after this call, the key is built in Flush
+				render_queue_.push_back({ 0, obj });
 			}
 		}
 	}
@@ -379,6 +758,16 @@ namespace KlayGE
 	{
 		if (frustum_)
 		{
+			if (this == batch_culling_sm)
+			{
+				uint32_t const i = batch_culling_index;
+				if ((aabb.Min().x() == cull_min_x_[i]) && (aabb.Min().y() == cull_min_y_[i]) && (aabb.Min().z() == cull_min_z_[i])
+					&& (aabb.Max().x() == cull_max_x_[i]) && (aabb.Max().y() == cull_max_y_[i]) && (aabb.Max().z() == cull_max_z_[i]))
+				{
+					return static_cast<BoundOverlap>(cull_results_[i]);
+				}
+			}
+
 			return frustum_->Intersect(aabb);
 		}
 		else
@@ -450,7 +839,12 @@ namespace KlayGE
 
 	void SceneManager::ClearObject()
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		// From the back, where the nodes are deleted without moving the others
+		for (auto iter = scene_objs_.rbegin(); iter != scene_objs_.rend(); ++ iter)
+		{
+			(*iter)->DetachTransform();
+		}
+		transforms_.Clear();
 		scene_objs_.resize(0);
 		overlay_scene_objs_.resize(0);
 	}
@@ -459,6 +853,8 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::Update()
 	{
+		KLAYGE_PERF_ZONE("SceneManager::Update");
+
 		deferred_mode_ = !!Context::Instance().DeferredRenderingLayerInstance();
 
 		App3DFramework& app = Context::Instance().AppInstance();
@@ -468,17 +864,13 @@ namespace KlayGE
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 		re.BeginFrame();
 
-		this->FlushScene();
+		this->SyncSubThreadUpdate();
 
-		if (!update_thread_ && !quit_)
-		{
-			update_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
-				[this] { this->UpdateThreadFunc(); }));
-		}
+		this->FlushScene();
 
 		std::vector<SceneObjectPtr> added_scene_objs;
 		{
-			std::lock_guard<std::mutex> lock(update_mutex_);
+			KLAYGE_PERF_ZONE("SceneManager::MainThreadUpdate");
 
 			for (auto const & scene_obj : scene_objs_)
 			{
@@ -488,6 +880,8 @@ namespace KlayGE
 				}
 			}
 
+			// The overlays are added again every frame, but still get this frame's SubThreadUpdate
+			sub_thread_overlay_objs_.swap(overlay_scene_objs_);
 			overlay_scene_objs_.clear();
 			for (auto iter = lights_.begin(); iter != lights_.end();)
 			{
@@ -509,7 +903,10 @@ namespace KlayGE
 		}
 
 		FrameBuffer& fb = *re.ScreenFrameBuffer();
-		fb.SwapBuffers();
+		{
+			KLAYGE_PERF_ZONE("SwapBuffers");
+			fb.SwapBuffers();
+		}
 
 		InputEngine& ie = Context::Instance().InputFactoryInstance().InputEngineInstance();
 		ie.Update();
@@ -527,7 +924,30 @@ namespace KlayGE
 			}
 		}
 
-		fb.WaitOnSwapBuffers();
+		// Overlaps the wait on swapping buffers, and whatever the application does until the next frame
+		WindowPtr const & win = app.MainWnd();
+		if (win && win->Active())
+		{
+			double const now = sub_thread_update_timer_.current_time();
+			if (now >= next_sub_thread_update_time_)
+			{
+				if (now - next_sub_thread_update_time_ > update_elapse_)
+				{
+					next_sub_thread_update_time_ = now + update_elapse_;
+				}
+				else
+				{
+					next_sub_thread_update_time_ += update_elapse_;
+				}
+
+				this->KickSubThreadUpdate();
+			}
+		}
+
+		{
+			KLAYGE_PERF_ZONE("WaitOnSwapBuffers");
+			fb.WaitOnSwapBuffers();
+		}
 
 		re.EndFrame();
 	}
@@ -536,7 +956,7 @@ namespace KlayGE
 	/////////////////////////////////////////////////////////////////////////////////
 	void SceneManager::Flush(uint32_t urt)
 	{
-		std::lock_guard<std::mutex> lock(update_mutex_);
+		KLAYGE_PERF_ZONE("SceneManager::Flush");
 
 		urt_ = urt;
 
@@ -635,60 +1055,38 @@ namespace KlayGE
 			}
 		}
 
-		std::sort(render_queue_.begin(), render_queue_.end(),
-			[](std::pair<RenderTechnique const *, std::vector<Renderable*>> const & lhs,
-				std::pair<RenderTechnique const *, std::vector<Renderable*>> const & rhs)
-			{
-				BOOST_ASSERT(lhs.first);
-				BOOST_ASSERT(rhs.first);
+		KLAYGE_PERF_ZONE("SceneManager::RenderQueue");
 
-				return lhs.first->Weight() < rhs.first->Weight();
-			});
+		uint32_t const queue_size = static_cast<uint32_t>(render_queue_.size());
+		this->BuildRenderQueueKeys(camera);
+		render_queue_sort_buff_.resize(queue_size);
+		RadixSort(render_queue_.data(), render_queue_sort_buff_.data(), queue_size,
+			[](RenderQueueItem const & item)
+			{
+				return item.key;
+			},
+			&Context::Instance().TaskScheduler());
 
-		float4 const & view_mat_z = camera.ViewMatrix().Col(2);
-		for (auto& items : render_queue_)
+		RenderTechnique const * last_tech = nullptr;
+		RenderMaterial const * last_mtl = nullptr;
+		for (auto const & item : render_queue_)
 		{
-			if (!items.first->Transparent() && !items.first->HasDiscard() && (items.second.size() > 1))
+			RenderTechnique const * tech = item.renderable->GetRenderTechnique();
+			RenderMaterial const * mtl = item.renderable->Material().get();
+			if (tech != last_tech)
 			{
-				std::vector<std::pair<float, uint32_t>> min_depths(items.second.size());
-				for (size_t j = 0; j < min_depths.size(); ++ j)
-				{
-					Renderable const * renderable = items.second[j];
-					AABBox const & box = renderable->PosBound();
-					uint32_t const num = renderable->NumInstances();
-					float md = 1e10f;
-					for (uint32_t i = 0; i < num; ++ i)
-					{
-						float4x4 const & mat = renderable->GetInstance(i)->ModelMatrix();
-						float4 const zvec(MathLib::dot(mat.Row(0), view_mat_z),
-							MathLib::dot(mat.Row(1), view_mat_z), MathLib::dot(mat.Row(2), view_mat_z),
-							MathLib::dot(mat.Row(3), view_mat_z));
-						for (int k = 0; k < 8; ++ k)
-						{
-							float3 const v = box.Corner(k);
-							md = std::min(md, v.x() * zvec.x() + v.y() * zvec.y() + v.z() * zvec.z() + zvec.w());
-						}
-					}
-
-					min_depths[j] = std::make_pair(md, static_cast<uint32_t>(j));
-				}
-
-				std::sort(min_depths.begin(), min_depths.end());
-
-				std::vector<Renderable*> sorted_items(min_depths.size());
-				for (size_t j = 0; j < min_depths.size(); ++ j)
-				{
-					sorted_items[j] = items.second[min_depths[j].second];
-				}
-				items.second.swap(sorted_items);
+				++ frame_tech_changes_;
+				last_tech = tech;
 			}
-
-			for (auto const & item : items.second)
+			if (mtl != last_mtl)
 			{
-				item->Render();
+				++ frame_mtl_changes_;
+				last_mtl = mtl;
 			}
-			num_renderables_rendered_ += static_cast<uint32_t>(items.second.size());
+
+			item.renderable->Render();
 		}
+		num_renderables_rendered_ += queue_size;
 		render_queue_.resize(0);
 
 		num_primitives_rendered_ += re.NumPrimitivesJustRendered();
@@ -735,11 +1133,123 @@ namespace KlayGE
 		return num_dispatch_calls_;
 	}
 
+	uint32_t SceneManager::NumTechniqueChanges() const
+	{
+		return num_tech_changes_;
+	}
+
+	uint32_t SceneManager::NumMaterialChanges() const
+	{
+		return num_mtl_changes_;
+	}
+
+	float SceneManager::MainThreadStallTime() const
+	{
+		return main_thread_stall_time_;
+	}
+
+	void SceneManager::BuildRenderQueueKeys(Camera const & camera)
+	{
+		uint32_t const TECH_RANK_BITS = 13;
+		uint32_t const MTL_ID_BITS = 18;
+		uint32_t const QUEUE_KEYS_GRAIN = 256;
+
+		queue_techs_.clear();
+		queue_tech_ranks_.clear();
+		queue_mtl_ids_.clear();
+		for (auto const & item : render_queue_)
+		{
+			RenderTechnique const * tech = item.renderable->GetRenderTechnique();
+			if (queue_tech_ranks_.emplace(tech, 0).second)
+			{
+				queue_techs_.push_back(tech);
+			}
+			if (!tech->Transparent())
+			{
+				uint32_t const mtl_id = std::min(static_cast<uint32_t>(queue_mtl_ids_.size()), (1U << MTL_ID_BITS) - 1);
+				queue_mtl_ids_.emplace(item.renderable->Material().get(), mtl_id);
+			}
+		}
+
+		// Same order as sorting by weight did before, ties broken by the first appearance in the queue
+		std::stable_sort(queue_techs_.begin(), queue_techs_.end(),
+			[](RenderTechnique const * lhs, RenderTechnique const * rhs)
+			{
+				return lhs->Weight() < rhs->Weight();
+			});
+		for (size_t i = 0; i < queue_techs_.size(); ++ i)
+		{
+			queue_tech_ranks_[queue_techs_[i]] = std::min(static_cast<uint32_t>(i), (1U << TECH_RANK_BITS) - 1);
+		}
+
+		// The maps are only read from here on, so the keys can be built in parallel
+		float4 const view_mat_z = camera.ViewMatrix().Col(2);
+		auto build_keys = [this, &view_mat_z](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++ i)
+			{
+				Renderable const * renderable = render_queue_[i].renderable;
+				RenderTechnique const * tech = renderable->GetRenderTechnique();
+
+				uint64_t key = static_cast<uint64_t>(queue_tech_ranks_.find(tech)->second) << 50;
+				if (tech->Transparent())
+				{
+					// Blending depends on the submission order, keep it
+					key |= (1ULL << 63) | i;
+				}
+				else
+				{
+					key |= static_cast<uint64_t>(queue_mtl_ids_.find(renderable->Material().get())->second) << 32;
+					if (tech->HasDiscard())
+					{
+						key |= i;
+					}
+					else
+					{
+						// Front to back by the nearest corner of all instances
+						AABBox const & box = renderable->PosBound();
+						uint32_t const num = renderable->NumInstances();
+						float md = 1e10f;
+						for (uint32_t j = 0; j < num; ++ j)
+						{
+							float4x4 const & mat = renderable->GetInstance(j)->ModelMatrix();
+							float4 const zvec(MathLib::dot(mat.Row(0), view_mat_z),
+								MathLib::dot(mat.Row(1), view_mat_z), MathLib::dot(mat.Row(2), view_mat_z),
+								MathLib::dot(mat.Row(3), view_mat_z));
+							for (int k = 0; k < 8; ++ k)
+							{
+								float3 const v = box.Corner(k);
+								md = std::min(md, v.x() * zvec.x() + v.y() * zvec.y() + v.z() * zvec.z() + zvec.w());
+							}
+						}
+						key |= RadixSortKey(md);
+					}
+				}
+
+				render_queue_[i].key = key;
+			}
+		};
+
+		uint32_t const queue_size = static_cast<uint32_t>(render_queue_.size());
+		if (queue_size > QUEUE_KEYS_GRAIN)
+		{
+			Context::Instance().TaskScheduler().parallel_for(0, queue_size, QUEUE_KEYS_GRAIN, build_keys);
+		}
+		else
+		{
+			build_keys(0, queue_size);
+		}
+	}
+
 	void SceneManager::FlushScene()
 	{
+		KLAYGE_PERF_ZONE("SceneManager::FlushScene");
+
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 
 		visible_marks_map_.clear();
+		frame_tech_changes_ = 0;
+		frame_mtl_changes_ = 0;
 
 		uint32_t urt;
 		App3DFramework& app = Context::Instance().AppInstance();
@@ -775,41 +1285,136 @@ namespace KlayGE
 
 		num_draw_calls_ = re.NumDrawsJustCalled();
 		num_dispatch_calls_ = re.NumDispatchesJustCalled();
+		num_tech_changes_ = frame_tech_changes_;
+		num_mtl_changes_ = frame_mtl_changes_;
 	}
 
-	void SceneManager::UpdateThreadFunc()
+	void SceneManager::KickSubThreadUpdate()
 	{
-		Timer timer;
-		float app_time = 0;
-		while (!quit_)
+		BOOST_ASSERT(!sub_thread_update_group_);
+
+		double const now = sub_thread_update_timer_.current_time();
+		float const frame_time = (last_sub_thread_update_time_ < 0)
+			? 0 : static_cast<float>(now - last_sub_thread_update_time_);
+		last_sub_thread_update_time_ = now;
+		sub_thread_app_time_ += frame_time;
+		float const app_time = sub_thread_app_time_;
+
+		// Objects can be added and deleted while the update runs, it walks a snapshot
+		sub_thread_update_objs_.assign(scene_objs_.begin(), scene_objs_.end());
+		sub_thread_update_objs_.insert(sub_thread_update_objs_.end(),
+			sub_thread_overlay_objs_.begin(), sub_thread_overlay_objs_.end());
+		sub_thread_overlay_objs_.clear();
+
+		uint32_t const num_objs = static_cast<uint32_t>(sub_thread_update_objs_.size());
+		if (0 == num_objs)
 		{
-			float const frame_time = static_cast<float>(timer.elapsed());
-			timer.restart();
-			app_time += frame_time;
+			return;
+		}
 
-			if (Context::Instance().AppValid())
+		auto update = [this, app_time, frame_time](uint32_t begin, uint32_t end)
 			{
-				WindowPtr const & win = Context::Instance().AppInstance().MainWnd();
-				if (win && win->Active())
+				KLAYGE_PERF_ZONE("SceneManager::SubThreadUpdate");
+
+				for (uint32_t i = begin; i < end; ++ i)
 				{
-					std::lock_guard<std::mutex> lock(update_mutex_);
+					sub_thread_update_objs_[i]->RunSubThreadUpdate(app_time, frame_time);
+				}
+			};
 
-					for (auto const & scene_obj : scene_objs_)
-					{
-						scene_obj->SubThreadUpdate(app_time, frame_time);
-					}
-					for (auto const & scene_obj : overlay_scene_objs_)
+		auto& ts = Context::Instance().TaskScheduler();
+		if (ts.num_workers() > 0)
+		{
+			uint32_t grain_size;
+			if (parallel_sub_thread_update_)
+			{
+				// About 4 chunks per thread, the same as parallel_for
+				grain_size = std::max(num_objs / ((ts.num_workers() + 1) * 4), 1U);
+			}
+			else
+			{
+				grain_size = num_objs;
+			}
+
+			sub_thread_update_group_ = MakeUniquePtr<task_group>(ts);
+			for (uint32_t begin = 0; begin < num_objs; begin += grain_size)
+			{
+				uint32_t const end = std::min(begin + grain_size, num_objs);
+				sub_thread_update_group_->run([update, begin, end]
 					{
-						scene_obj->SubThreadUpdate(app_time, frame_time);
-					}
-				}
+						update(begin, end);
+					});
+			}
+		}
+		else
+		{
+			update(0, num_objs);
+		}
+	}
+
+	void SceneManager::SyncSubThreadUpdate()
+	{
+		main_thread_stall_time_ = 0;
+		if (sub_thread_update_group_)
+		{
+			KLAYGE_PERF_ZONE("SceneManager::WaitOnSubThreadUpdate");
+
+			Timer timer;
+			sub_thread_update_group_->wait();
+			sub_thread_update_group_.reset();
+			main_thread_stall_time_ = static_cast<float>(timer.elapsed());
+		}
+
+		for (auto const & scene_obj : sub_thread_update_objs_)
+		{
+			scene_obj->PublishSubThreadUpdate();
+		}
+		sub_thread_update_objs_.clear();
+
+		std::vector<SceneObjectCommand> cmds;
+		{
+			std::lock_guard<std::mutex> lock(scene_obj_cmd_mutex_);
+			cmds.swap(scene_obj_cmds_);
+		}
+		for (auto const & cmd : cmds)
+		{
+			if (cmd.add)
+			{
+				this->AddSceneObjectLocked(cmd.obj);
+			}
+			else
+			{
+				this->DelSceneObjectLocked(cmd.obj);
+			}
+		}
+	}
+
+	void SceneManager::UpdateTransforms()
+	{
+		for (auto const & obj : scene_objs_)
+		{
+			SceneObject* so = obj.get();
+			if (so->Visible() && (so->Attrib() & SceneObject::SOA_Moveable))
+			{
+				so->QueueAbsModelMatrixUpdate();
 
-				if (frame_time < update_elapse_)
+				// Hidden or static parents aren't queued by themselves, but their model matrices can still change
+				for (SceneObject* parent = so->Parent();
+					parent && !(parent->Visible() && (parent->Attrib() & SceneObject::SOA_Moveable));
+					parent = parent->Parent())
 				{
-					Sleep(static_cast<uint32_t>((update_elapse_ - frame_time) * 1000));
+					parent->QueueAbsModelMatrixUpdate();
 				}
 			}
 		}
+
+		transforms_.Update();
+
+		// Instances may share one renderable, whose model matrix is set here. Keep it serial.
+		for (auto so : transforms_.UpdatedOwners())
+		{
+			so->OnAbsModelMatrixUpdated();
+		}
 	}
 
 	BoundOverlap SceneManager::VisibleTestFromParent(SceneObject* obj, float3 const & view_dir, float3 const & eye_pos,
@@ -826,11 +1431,6 @@ namespace KlayGE
 			else
 			{
 				uint32_t const attr = obj->Attrib();
-				if (attr & SceneObject::SOA_Moveable)
-				{
-					obj->UpdateAbsModelMatrix();
-				}
-
 				if (attr & SceneObject::SOA_Cullable)
 				{
 					if (small_obj_threshold_ > 0)
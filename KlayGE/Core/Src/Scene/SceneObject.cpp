@@ -19,17 +19,26 @@
 #include <KlayGE/Context.hpp>
 #include <KFL/Math.hpp>
 #include <KlayGE/Renderable.hpp>
+#include <KlayGE/TransformHierarchy.hpp>
 
 #include <boost/assert.hpp>
 
 #include <KlayGE/SceneObject.hpp>
 
+namespace
+{
+	// Set on the threads running SubThreadUpdate
+	thread_local bool in_sub_thread_update = false;
+}
+
 namespace KlayGE
 {
 	SceneObject::SceneObject(uint32_t attrib)
 		: attrib_(attrib), parent_(nullptr), renderable_hw_res_ready_(false),
-			model_(float4x4::Identity()), abs_model_(float4x4::Identity()),
-			visible_mark_(BO_No)
+			model_(float4x4::Identity()), sub_thread_model_(float4x4::Identity()), sub_thread_model_dirty_(false),
+			abs_model_(float4x4::Identity()),
+			transform_hierarchy_(nullptr), transform_handle_(TransformHierarchy::INVALID_HANDLE),
+			spatial_handle_(0xFFFFFFFF), visible_mark_(BO_No)
 	{
 		if (!(attrib & SOA_Overlay) && (attrib & (SOA_Cullable | SOA_Moveable)))
 		{
@@ -39,6 +48,7 @@ namespace KlayGE
 
 	SceneObject::~SceneObject()
 	{
+		this->DetachTransform();
 	}
 
 	SceneObject* SceneObject::Parent() const
@@ -49,6 +59,12 @@ namespace KlayGE
 	void SceneObject::Parent(SceneObject* so)
 	{
 		parent_ = so;
+
+		if (transform_hierarchy_)
+		{
+			transform_hierarchy_->Parent(transform_handle_,
+				(so && (so->transform_hierarchy_ == transform_hierarchy_)) ? so->transform_handle_ : TransformHierarchy::INVALID_HANDLE);
+		}
 	}
 
 	uint32_t SceneObject::NumChildren() const
@@ -69,43 +85,148 @@ namespace KlayGE
 
 	void SceneObject::ModelMatrix(float4x4 const & mat)
 	{
-		model_ = mat;
+		if (in_sub_thread_update)
+		{
+			sub_thread_model_ = mat;
+			sub_thread_model_dirty_ = true;
+		}
+		else
+		{
+			model_ = mat;
+		}
 	}
 
 	float4x4 const & SceneObject::ModelMatrix() const
 	{
-		return model_;
+		if (in_sub_thread_update && sub_thread_model_dirty_)
+		{
+			return sub_thread_model_;
+		}
+		else
+		{
+			return model_;
+		}
 	}
 
 	float4x4 const & SceneObject::AbsModelMatrix() const
 	{
-		return abs_model_;
+		if (transform_hierarchy_)
+		{
+			return transform_hierarchy_->WorldMatrix(transform_handle_);
+		}
+		else
+		{
+			return abs_model_;
+		}
 	}
 
 	AABBox const & SceneObject::PosBoundWS() const
 	{
-		return *pos_aabb_ws_;
+		if (transform_hierarchy_)
+		{
+			return transform_hierarchy_->WorldBound(transform_handle_);
+		}
+		else
+		{
+			return *pos_aabb_ws_;
+		}
 	}
 
 	void SceneObject::UpdateAbsModelMatrix()
 	{
-		if (parent_)
+		if (transform_hierarchy_)
 		{
-			abs_model_ = parent_->ModelMatrix() * model_;
+			this->QueueAbsModelMatrixUpdate();
+			transform_hierarchy_->UpdateNode(transform_handle_);
+			if (renderable_)
+			{
+				renderable_->ModelMatrix(transform_hierarchy_->WorldMatrix(transform_handle_));
+			}
 		}
 		else
 		{
-			abs_model_ = model_;
+			if (parent_)
+			{
+				abs_model_ = parent_->ModelMatrix() * model_;
+			}
+			else
+			{
+				abs_model_ = model_;
+			}
+
+			if (renderable_)
+			{
+				if (pos_aabb_ws_)
+				{
+					*pos_aabb_ws_ = MathLib::transform_aabb(renderable_->PosBound(), abs_model_);
+				}
+
+				renderable_->ModelMatrix(abs_model_);
+			}
 		}
+	}
 
-		if (renderable_)
+	void SceneObject::AttachTransform(TransformHierarchy* hierarchy)
+	{
+		BOOST_ASSERT(!transform_hierarchy_);
+
+		uint32_t const parent_handle = (parent_ && (parent_->transform_hierarchy_ == hierarchy))
+			? parent_->transform_handle_ : TransformHierarchy::INVALID_HANDLE;
+		transform_hierarchy_ = hierarchy;
+		transform_handle_ = hierarchy->AddNode(this, parent_handle, model_);
+		if (renderable_ && pos_aabb_ws_)
 		{
+			hierarchy->LocalBound(transform_handle_, renderable_->PosBound());
+		}
+
+		// Children attached before their parent
+		for (auto const & child : children_)
+		{
+			if (child->transform_hierarchy_ == hierarchy)
+			{
+				hierarchy->Parent(child->transform_handle_, transform_handle_);
+			}
+		}
+	}
+
+	void SceneObject::DetachTransform()
+	{
+		if (transform_hierarchy_)
+		{
+			abs_model_ = transform_hierarchy_->WorldMatrix(transform_handle_);
 			if (pos_aabb_ws_)
 			{
-				*pos_aabb_ws_ = MathLib::transform_aabb(renderable_->PosBound(), abs_model_);
+				*pos_aabb_ws_ = transform_hierarchy_->WorldBound(transform_handle_);
 			}
 
-			renderable_->ModelMatrix(abs_model_);
+			transform_hierarchy_->DelNode(transform_handle_);
+			transform_hierarchy_ = nullptr;
+			transform_handle_ = TransformHierarchy::INVALID_HANDLE;
+		}
+	}
+
+	void SceneObject::QueueAbsModelMatrixUpdate()
+	{
+		if (transform_hierarchy_)
+		{
+			transform_hierarchy_->LocalMatrix(transform_handle_, model_);
+			if (renderable_ && pos_aabb_ws_)
+			{
+				transform_hierarchy_->LocalBound(transform_handle_, renderable_->PosBound());
+			}
+		}
+		else
+		{
+			this->UpdateAbsModelMatrix();
+		}
+	}
+
+	void SceneObject::OnAbsModelMatrixUpdated()
+	{
+		// Renderables of the other objects keep the model matrices their owners set, as before
+		if (renderable_ && (attrib_ & (SOA_Cullable | SOA_Moveable)))
+		{
+			renderable_->ModelMatrix(transform_hierarchy_->WorldMatrix(transform_handle_));
 		}
 	}
 
@@ -119,6 +240,16 @@ namespace KlayGE
 		return visible_mark_;
 	}
 
+	void SceneObject::SpatialHandle(uint32_t handle)
+	{
+		spatial_handle_ = handle;
+	}
+
+	uint32_t SceneObject::SpatialHandle() const
+	{
+		return spatial_handle_;
+	}
+
 	void SceneObject::BindSubThreadUpdateFunc(std::function<void(SceneObject&, float, float)> const & update_func)
 	{
 		sub_thread_update_func_ = update_func;
@@ -137,6 +268,23 @@ namespace KlayGE
 		}
 	}
 
+	void SceneObject::RunSubThreadUpdate(float app_time, float elapsed_time)
+	{
+		bool const nested = in_sub_thread_update;
+		in_sub_thread_update = true;
+		this->SubThreadUpdate(app_time, elapsed_time);
+		in_sub_thread_update = nested;
+	}
+
+	void SceneObject::PublishSubThreadUpdate()
+	{
+		if (sub_thread_model_dirty_)
+		{
+			model_ = sub_thread_model_;
+			sub_thread_model_dirty_ = false;
+		}
+	}
+
 	bool SceneObject::MainThreadUpdate(float app_time, float elapsed_time)
 	{
 		bool refreshed = false;
@@ -0,0 +1,369 @@
+/**
+* @file TransformHierarchy.cpp
+* @author Minmin Gong
+*
+* @section DESCRIPTION
+*
+* This source file is part of KlayGE
+* For the latest info, see http://www.klayge.org
+*
+* @section LICENSE
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published
+* by the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*
+* You may alternatively use this source under the terms of
+* the KlayGE Proprietary License (KPL). You can obtained such a license
+* from http://www.klayge.org/licensing/.
+*/
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/TransformHierarchy.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// The rows of float4x4 are contiguous, and the arrays holding them are 16-byte aligned
+	SIMDMatrixF4 LoadMatrix(float4x4 const & mat)
+	{
+		return SIMDMatrixF4(mat.begin());
+	}
+
+	void StoreMatrix(float4x4& mat, SIMDMatrixF4 const & v)
+	{
+		for (size_t i = 0; i < 4; ++ i)
+		{
+			SIMDMathLib::StoreVector4(*reinterpret_cast<float4*>(mat.begin() + i * 4), v.Row(i));
+		}
+	}
+}
+
+namespace KlayGE
+{
+	uint32_t const TransformHierarchy::INVALID_HANDLE;
+
+	TransformHierarchy::TransformHierarchy()
+		: num_deleted_(0)
+	{
+	}
+
+	uint32_t TransformHierarchy::AddNode(SceneObject* owner, uint32_t parent_handle, float4x4 const & local)
+	{
+		uint32_t handle;
+		if (free_handles_.empty())
+		{
+			handle = static_cast<uint32_t>(handle_to_index_.size());
+			handle_to_index_.push_back(INVALID_HANDLE);
+		}
+		else
+		{
+			handle = free_handles_.back();
+			free_handles_.pop_back();
+		}
+
+		uint32_t const index = static_cast<uint32_t>(parents_.size());
+		handle_to_index_[handle] = index;
+		index_to_handle_.push_back(handle);
+
+		locals_.push_back(local);
+		worlds_.push_back(local);
+		bound_centers_.push_back(float3::Zero());
+		bound_extents_.push_back(float3::Zero());
+		world_bounds_.push_back(AABBox(float3::Zero(), float3::Zero()));
+		parents_.push_back((parent_handle != INVALID_HANDLE) ? handle_to_index_[parent_handle] : INVALID_HANDLE);
+		flags_.push_back(NF_Dirty);
+		owners_.push_back(owner);
+
+		return handle;
+	}
+
+	void TransformHierarchy::DelNode(uint32_t handle)
+	{
+		BOOST_ASSERT(handle < handle_to_index_.size());
+
+		uint32_t const index = handle_to_index_[handle];
+		BOOST_ASSERT(index != INVALID_HANDLE);
+
+		flags_[index] = NF_Deleted;
+		owners_[index] = nullptr;
+		index_to_handle_[index] = INVALID_HANDLE;
+		++ num_deleted_;
+
+		// Deleting from the back, as clearing a scene does, needs no compaction. The last node has no children.
+		while (!flags_.empty() && (flags_.back() & NF_Deleted))
+		{
+			locals_.pop_back();
+			worlds_.pop_back();
+			bound_centers_.pop_back();
+			bound_extents_.pop_back();
+			world_bounds_.pop_back();
+			parents_.pop_back();
+			flags_.pop_back();
+			owners_.pop_back();
+			index_to_handle_.pop_back();
+			-- num_deleted_;
+		}
+
+		handle_to_index_[handle] = INVALID_HANDLE;
+		free_handles_.push_back(handle);
+	}
+
+	void TransformHierarchy::Clear()
+	{
+		locals_.clear();
+		worlds_.clear();
+		bound_centers_.clear();
+		bound_extents_.clear();
+		world_bounds_.clear();
+		parents_.clear();
+		flags_.clear();
+		owners_.clear();
+		handle_to_index_.clear();
+		index_to_handle_.clear();
+		free_handles_.clear();
+		num_deleted_ = 0;
+		updated_owners_.clear();
+	}
+
+	uint32_t TransformHierarchy::NumNodes() const
+	{
+		return static_cast<uint32_t>(parents_.size()) - num_deleted_;
+	}
+
+	void TransformHierarchy::Parent(uint32_t handle, uint32_t parent_handle)
+	{
+		uint32_t const index = handle_to_index_[handle];
+		uint32_t const parent = (parent_handle != INVALID_HANDLE) ? handle_to_index_[parent_handle] : INVALID_HANDLE;
+		parents_[index] = parent;
+		flags_[index] |= NF_Dirty;
+		if ((parent != INVALID_HANDLE) && (parent > index))
+		{
+			// The descendants all come after the node. Moving the subtree behind everything else, in its current order,
+			//  puts the node after its new parent and keeps every other parent before its children.
+			uint32_t const num = static_cast<uint32_t>(parents_.size());
+			std::vector<uint8_t> in_subtree(num - index, 0);
+			in_subtree[0] = 1;
+			std::vector<uint32_t> order(index);
+			for (uint32_t i = 0; i < index; ++ i)
+			{
+				order[i] = i;
+			}
+			std::vector<uint32_t> subtree(1, index);
+			for (uint32_t i = index + 1; i < num; ++ i)
+			{
+				uint32_t const p = parents_[i];
+				if ((p != INVALID_HANDLE) && (p >= index) && in_subtree[p - index])
+				{
+					in_subtree[i - index] = 1;
+					subtree.push_back(i);
+				}
+				else
+				{
+					order.push_back(i);
+				}
+			}
+			BOOST_ASSERT_MSG(!in_subtree[parent - index], "A node can't be parented to its own descendant");
+			order.insert(order.end(), subtree.begin(), subtree.end());
+
+			this->Reorder(order);
+		}
+	}
+
+	void TransformHierarchy::LocalMatrix(uint32_t handle, float4x4 const & mat)
+	{
+		uint32_t const index = handle_to_index_[handle];
+		if (!(locals_[index] == mat))
+		{
+			locals_[index] = mat;
+			flags_[index] |= NF_Dirty;
+		}
+	}
+
+	float4x4 const & TransformHierarchy::LocalMatrix(uint32_t handle) const
+	{
+		return locals_[handle_to_index_[handle]];
+	}
+
+	void TransformHierarchy::LocalBound(uint32_t handle, AABBox const & aabb)
+	{
+		uint32_t const index = handle_to_index_[handle];
+		float3 const center = aabb.Center();
+		float3 const extent = aabb.HalfSize();
+		if (!(flags_[index] & NF_HasBound) || !(bound_centers_[index] == center) || !(bound_extents_[index] == extent))
+		{
+			bound_centers_[index] = center;
+			bound_extents_[index] = extent;
+			flags_[index] |= NF_Dirty | NF_HasBound;
+		}
+	}
+
+	float4x4 const & TransformHierarchy::WorldMatrix(uint32_t handle) const
+	{
+		return worlds_[handle_to_index_[handle]];
+	}
+
+	AABBox const & TransformHierarchy::WorldBound(uint32_t handle) const
+	{
+		return world_bounds_[handle_to_index_[handle]];
+	}
+
+	void TransformHierarchy::UpdateNode(uint32_t handle)
+	{
+		this->UpdateWorld(handle_to_index_[handle]);
+	}
+
+	void TransformHierarchy::Update()
+	{
+		updated_owners_.clear();
+
+		if (num_deleted_ > 0)
+		{
+			std::vector<uint32_t> order;
+			order.reserve(parents_.size() - num_deleted_);
+			for (uint32_t i = 0; i < parents_.size(); ++ i)
+			{
+				if (!(flags_[i] & NF_Deleted))
+				{
+					order.push_back(i);
+				}
+			}
+			this->Reorder(order);
+			num_deleted_ = 0;
+		}
+
+		// Parents precede their children, so a dirty flag reaches the whole subtree in one pass
+		uint32_t const num = static_cast<uint32_t>(parents_.size());
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			uint32_t const parent = parents_[i];
+			if ((parent != INVALID_HANDLE) && (flags_[parent] & NF_Dirty))
+			{
+				flags_[i] |= NF_Dirty;
+			}
+
+			if (flags_[i] & NF_Dirty)
+			{
+				this->UpdateWorld(i);
+				updated_owners_.push_back(owners_[i]);
+			}
+		}
+
+		for (auto& flag : flags_)
+		{
+			flag &= ~NF_Dirty;
+		}
+	}
+
+	std::vector<SceneObject*> const & TransformHierarchy::UpdatedOwners() const
+	{
+		return updated_owners_;
+	}
+
+	void TransformHierarchy::UpdateWorld(uint32_t index)
+	{
+		SIMDMatrixF4 world = LoadMatrix(locals_[index]);
+		uint32_t const parent = parents_[index];
+		if ((parent != INVALID_HANDLE) && !(flags_[parent] & NF_Deleted))
+		{
+			BOOST_ASSERT(parent < index);
+			world = SIMDMathLib::Multiply(LoadMatrix(worlds_[parent]), world);
+		}
+		StoreMatrix(worlds_[index], world);
+
+		if (flags_[index] & NF_HasBound)
+		{
+			// The tight box of a transformed box: the center moves as a point, the half size takes the absolute
+			//  values of the rotation and scaling part
+			float3 const & center = bound_centers_[index];
+			float3 const & extent = bound_extents_[index];
+			SIMDVectorF4 const world_center = world.Row(0) * center.x() + world.Row(1) * center.y()
+				+ world.Row(2) * center.z() + world.Row(3);
+			SIMDVectorF4 const world_extent = SIMDMathLib::Abs(world.Row(0) * extent.x())
+				+ SIMDMathLib::Abs(world.Row(1) * extent.y()) + SIMDMathLib::Abs(world.Row(2) * extent.z());
+
+			float3 min_pt, max_pt;
+			SIMDMathLib::StoreVector3(min_pt, world_center - world_extent);
+			SIMDMathLib::StoreVector3(max_pt, world_center + world_extent);
+			world_bounds_[index] = AABBox(min_pt, max_pt);
+		}
+	}
+
+	void TransformHierarchy::Reorder(std::vector<uint32_t> const & order)
+	{
+		uint32_t const num = static_cast<uint32_t>(order.size());
+
+		std::vector<uint32_t> remap(parents_.size(), INVALID_HANDLE);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			remap[order[i]] = i;
+		}
+
+		decltype(locals_) locals(num);
+		decltype(worlds_) worlds(num);
+		decltype(bound_centers_) bound_centers(num);
+		decltype(bound_extents_) bound_extents(num);
+		decltype(world_bounds_) world_bounds(num);
+		decltype(parents_) parents(num);
+		decltype(flags_) flags(num);
+		decltype(owners_) owners(num);
+		decltype(index_to_handle_) index_to_handle(num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			uint32_t const old_index = order[i];
+
+			locals[i] = locals_[old_index];
+			worlds[i] = worlds_[old_index];
+			bound_centers[i] = bound_centers_[old_index];
+			bound_extents[i] = bound_extents_[old_index];
+			world_bounds[i] = world_bounds_[old_index];
+			owners[i] = owners_[old_index];
+
+			uint32_t parent = parents_[old_index];
+			uint8_t flag = flags_[old_index];
+			if (parent != INVALID_HANDLE)
+			{
+				parent = remap[parent];
+				if (INVALID_HANDLE == parent)
+				{
+					flag |= NF_Dirty;
+				}
+			}
+			parents[i] = parent;
+			flags[i] = flag;
+
+			uint32_t const handle = index_to_handle_[old_index];
+			index_to_handle[i] = handle;
+			if (handle != INVALID_HANDLE)
+			{
+				handle_to_index_[handle] = i;
+			}
+		}
+
+		locals_.swap(locals);
+		worlds_.swap(worlds);
+		bound_centers_.swap(bound_centers);
+		bound_extents_.swap(bound_extents);
+		world_bounds_.swap(world_bounds);
+		parents_.swap(parents);
+		flags_.swap(flags);
+		owners_.swap(owners);
+		index_to_handle_.swap(index_to_handle);
+	}
+}
@@ -25,17 +25,19 @@
 #include <KlayGE/RenderEffect.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/FrameBuffer.hpp>
+#include <KlayGE/GraphicsBuffer.hpp>
+#include <KlayGE/Texture.hpp>
 #include <KlayGE/InputFactory.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KlayGE/SceneObjectHelper.hpp>
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/Font.hpp>
-#include <KlayGE/TransientBuffer.hpp>
 #include <KFL/Hash.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/Window.hpp>
 
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 #include <mutex>
@@ -71,6 +73,13 @@ namespace
 		return ret;
 	}
 
+	// Only the textures that never change can be copied into the atlas
+	bool IsAtlasCandidate(KlayGE::TexturePtr const & texture)
+	{
+		return texture && (KlayGE::Texture::TT_2D == texture->Type()) && (1 == texture->ArraySize())
+			&& (texture->AccessHint() & KlayGE::EAH_Immutable);
+	}
+
 	enum
 	{
 		Key,
@@ -86,12 +95,33 @@ namespace KlayGE
 	std::unique_ptr<UIManager> UIManager::ui_mgr_instance_;
 
 
-	class UIRectRenderable : public RenderableHelper
+	// The retained geometry of one dialog. Quads and strings are collected while the dialog regenerates, uploaded once, and
+	//  drawn from the same buffers every frame until the dialog changes again. Quads are grouped by texture, with the
+	//  atlas a whole dialog usually ends up in one group.
+	class UIDialogRenderable : public RenderableHelper
 	{
+		struct QuadBatch
+		{
+			TexturePtr texture;
+			std::vector<UIManager::VertexFormat> vertices;
+			uint32_t first_quad;
+		};
+
+		struct StringCache
+		{
+			FontPtr font;
+			float font_size;
+			Rect rc;
+			float depth;
+			Color clr;
+			std::wstring text;
+			uint32_t align;
+		};
+
 	public:
-		UIRectRenderable(TexturePtr const & texture, RenderEffectPtr const & effect)
-			: RenderableHelper(L"UIRect"),
-				texture_(texture)
+		explicit UIDialogRenderable(RenderEffectPtr const & effect)
+			: RenderableHelper(L"UIDialog"),
+				num_quads_(0), num_strings_(0)
 		{
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
@@ -107,24 +137,9 @@ namespace KlayGE
 				rl_->TopologyType(RenderLayout::TT_TriangleList);
 			}
 
-			uint32_t const INDEX_PER_QUAD = restart_ ? 5 : 6;
-			uint32_t const INIT_NUM_QUAD = 1024;
-			tb_vb_ = MakeUniquePtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_QUAD * 4 * sizeof(UIManager::VertexFormat)), TransientBuffer::BF_Vertex);
-			tb_ib_ = MakeUniquePtr<TransientBuffer>(static_cast<uint32_t>(INIT_NUM_QUAD * INDEX_PER_QUAD * sizeof(uint16_t)), TransientBuffer::BF_Index);
-
-			rl_->BindVertexStream(tb_vb_->GetBuffer(), { VertexElement(VEU_Position, 0, EF_BGR32F),
-				VertexElement(VEU_Diffuse, 0, EF_ABGR32F), VertexElement(VEU_TextureCoord, 0, EF_GR32F) });
-			rl_->BindIndexStream(tb_ib_->GetBuffer(), EF_R16UI);
-
 			effect_ = effect;
-			if (texture)
-			{
-				technique_ = effect->TechniqueByName("UITec");
-			}
-			else
-			{
-				technique_ = effect->TechniqueByName("UITecNoTex");
-			}
+			technique_ = effect->TechniqueByName("UITec");
+			no_tex_technique_ = effect->TechniqueByName("UITecNoTex");
 
 			ui_tex_ep_ = effect->ParameterByName("ui_tex");
 			half_width_height_ep_ = effect->ParameterByName("half_width_height");
@@ -133,117 +148,180 @@ namespace KlayGE
 
 		bool Empty() const
 		{
-			return tb_ib_sub_allocs_.empty();
+			return 0 == num_quads_;
 		}
 
-		void OnRenderBegin()
+		// The vectors are kept, so regenerating a dialog of the same size allocates nothing
+		void Clear()
 		{
-			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
-
-			*ui_tex_ep_ = texture_;
-
-			RenderEngine& re = rf.RenderEngineInstance();
-			float const half_width = re.CurFrameBuffer()->Width() / 2.0f;
-			float const half_height = re.CurFrameBuffer()->Height() / 2.0f;
-
-			*half_width_height_ep_ = float2(half_width, half_height);
-			*dpi_scale_ep_ = Context::Instance().AppInstance().MainWnd()->DPIScale();
+			for (auto& batch : batches_)
+			{
+				batch.vertices.clear();
+			}
+			num_strings_ = 0;
+		}
 
-			tb_vb_->EnsureDataReady();
-			tb_ib_->EnsureDataReady();
+		void AddQuad(float3 const & offset, UIManager::VertexFormat const * vertices, TexturePtr const & texture)
+		{
+			auto iter = std::find_if(batches_.begin(), batches_.end(),
+				[&texture](QuadBatch const & batch)
+				{
+					return batch.texture == texture;
+				});
+			if (iter == batches_.end())
+			{
+				batches_.emplace_back();
+				iter = batches_.end() - 1;
+				iter->texture = texture;
+			}
 
-			rl_->SetVertexStream(0, tb_vb_->GetBuffer());
-			rl_->BindIndexStream(tb_ib_->GetBuffer(), EF_R16UI);
+			for (uint32_t i = 0; i < 4; ++ i)
+			{
+				iter->vertices.emplace_back(offset + vertices[i].pos, vertices[i].clr, vertices[i].tex);
+			}
 		}
-		
-		void OnRenderEnd()
+
+		void AddString(FontPtr const & font, float font_size, IRect const & rc, float depth, Color const & clr,
+			std::wstring const & text, uint32_t align)
 		{
-			tb_vb_->OnPresent();
-			tb_ib_->OnPresent();
+			if (num_strings_ == strings_.size())
+			{
+				strings_.emplace_back();
+			}
 
-			tb_vb_sub_allocs_.clear();
-			tb_ib_sub_allocs_.clear();
+			StringCache& sc = strings_[num_strings_];
+			sc.font = font;
+			sc.font_size = font_size;
+			sc.rc = rc;
+			sc.depth = depth;
+			sc.clr = clr;
+			sc.text = text;
+			sc.align = align;
+			++ num_strings_;
 		}
 
-		void Render()
+		// Uploads the collected quads. Batches of textures no longer used stay around empty until the next commit.
+		void Commit()
 		{
-			RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+			batches_.erase(std::remove_if(batches_.begin(), batches_.end(),
+				[](QuadBatch const & batch)
+				{
+					return batch.vertices.empty();
+				}), batches_.end());
+
+			num_quads_ = 0;
+			for (auto& batch : batches_)
+			{
+				batch.first_quad = num_quads_;
+				num_quads_ += static_cast<uint32_t>(batch.vertices.size() / 4);
+			}
+			if (0 == num_quads_)
+			{
+				return;
+			}
 
-			this->OnRenderBegin();
+			BOOST_ASSERT(num_quads_ * 4 <= 0xFFFF);
 
-			BOOST_ASSERT(tb_vb_sub_allocs_.size() == tb_ib_sub_allocs_.size());
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
+			uint32_t const vb_size = static_cast<uint32_t>(num_quads_ * 4 * sizeof(UIManager::VertexFormat));
+			if (!vb_ || (vb_->Size() < vb_size))
 			{
-				uint32_t vert_length = tb_vb_sub_allocs_[i].length_;
-				uint32_t const ind_offset = tb_ib_sub_allocs_[i].offset_;
-				uint32_t ind_length = tb_ib_sub_allocs_[i].length_;
-
-				while ((i + 1 < tb_vb_sub_allocs_.size())
-					&& (tb_vb_sub_allocs_[i].offset_ + tb_vb_sub_allocs_[i].length_ == tb_vb_sub_allocs_[i + 1].offset_)
-					&& (tb_ib_sub_allocs_[i].offset_ + tb_ib_sub_allocs_[i].length_ == tb_ib_sub_allocs_[i + 1].offset_))
+				vb_ = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, vb_size * 2, nullptr);
+				rl_->BindVertexStream(vb_, { VertexElement(VEU_Position, 0, EF_BGR32F),
+					VertexElement(VEU_Diffuse, 0, EF_ABGR32F), VertexElement(VEU_TextureCoord, 0, EF_GR32F) });
+			}
+			{
+				GraphicsBuffer::Mapper mapper(*vb_, BA_Write_Only);
+				auto* dst = mapper.Pointer<UIManager::VertexFormat>();
+				for (auto const & batch : batches_)
 				{
-					vert_length += tb_vb_sub_allocs_[i + 1].length_;
-					ind_length += tb_ib_sub_allocs_[i + 1].length_;
-					++ i;
+					dst = std::copy(batch.vertices.begin(), batch.vertices.end(), dst);
 				}
-
-				rl_->NumVertices(vert_length / sizeof(UIManager::VertexFormat));
-				rl_->StartIndexLocation(ind_offset / sizeof(uint16_t));
-				rl_->NumIndices(ind_length / sizeof(uint16_t));
-
-				re.Render(*this->GetRenderEffect(), *this->GetRenderTechnique(), *rl_);
 			}
 
-			for (size_t i = 0; i < tb_vb_sub_allocs_.size(); ++ i)
+			// The indices only depend on the number of quads, so the index buffer is only filled when it grows
+			uint32_t const index_per_quad = restart_ ? 5 : 6;
+			uint32_t const ib_size = num_quads_ * index_per_quad * sizeof(uint16_t);
+			if (!ib_ || (ib_->Size() < ib_size))
 			{
-				tb_vb_->Dealloc(tb_vb_sub_allocs_[i]);
-				tb_ib_->Dealloc(tb_ib_sub_allocs_[i]);
-			}
+				uint32_t const num_ib_quads = std::min(num_quads_ * 2, 0x10000U / 4);
+				std::vector<uint16_t> indices(num_ib_quads * index_per_quad);
+				for (uint32_t i = 0; i < num_ib_quads; ++ i)
+				{
+					uint16_t const base = static_cast<uint16_t>(i * 4);
+					uint16_t* quad_indices = &indices[i * index_per_quad];
+					quad_indices[0] = base + 0;
+					quad_indices[1] = base + 1;
+					if (restart_)
+					{
+						quad_indices[2] = base + 3;
+						quad_indices[3] = base + 2;
+						quad_indices[4] = 0xFFFF;
+					}
+					else
+					{
+						quad_indices[2] = base + 2;
+						quad_indices[3] = base + 2;
+						quad_indices[4] = base + 3;
+						quad_indices[5] = base + 0;
+					}
+				}
 
-			this->OnRenderEnd();
+				ib_ = rf.MakeIndexBuffer(BU_Static, EAH_GPU_Read | EAH_Immutable,
+					static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]);
+				rl_->BindIndexStream(ib_, EF_R16UI);
+			}
 		}
 
-		void AddQuad(std::vector<UIManager::VertexFormat> const & vertices)
+		void Render()
 		{
-			tb_vb_sub_allocs_.push_back(tb_vb_->Alloc(static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])), &vertices[0]));
-			
-			uint16_t const last_index = static_cast<uint16_t>(tb_vb_sub_allocs_.back().offset_ / sizeof(UIManager::VertexFormat));
-			std::vector<uint16_t> indices;
-			indices.resize(restart_ ? 5 : 6);
-			indices[0] = last_index + 0;
-			indices[1] = last_index + 1;
-			if (restart_)
+			RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+
+			float const half_width = re.CurFrameBuffer()->Width() / 2.0f;
+			float const half_height = re.CurFrameBuffer()->Height() / 2.0f;
+			*half_width_height_ep_ = float2(half_width, half_height);
+			*dpi_scale_ep_ = Context::Instance().AppInstance().MainWnd()->DPIScale();
+
+			uint32_t const index_per_quad = restart_ ? 5 : 6;
+			rl_->NumVertices(num_quads_ * 4);
+			for (auto const & batch : batches_)
 			{
-				indices[2] = last_index + 3;
-				indices[3] = last_index + 2;
-				indices[4] = 0xFFFF;
+				*ui_tex_ep_ = batch.texture;
+
+				rl_->StartIndexLocation(batch.first_quad * index_per_quad);
+				rl_->NumIndices(static_cast<uint32_t>(batch.vertices.size() / 4 * index_per_quad));
+
+				re.Render(*effect_, batch.texture ? *technique_ : *no_tex_technique_, *rl_);
 			}
-			else
+		}
+
+		void RenderStrings()
+		{
+			for (uint32_t i = 0; i < num_strings_; ++ i)
 			{
-				indices[2] = last_index + 2;
-				indices[3] = last_index + 2;
-				indices[4] = last_index + 3;
-				indices[5] = last_index + 0;
+				auto const & s = strings_[i];
+				s.font->RenderText(s.rc, s.depth, 1, 1, s.clr, s.text, s.font_size, s.align);
 			}
-			BOOST_ASSERT(last_index + 3 <= 0xFFFF);
-
-			tb_ib_sub_allocs_.push_back(tb_ib_->Alloc(static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]));
 		}
 
 	private:
 		bool restart_;
 
+		RenderTechnique* no_tex_technique_;
+
 		RenderEffectParameter* dpi_scale_ep_;
 		RenderEffectParameter* ui_tex_ep_;
 		RenderEffectParameter* half_width_height_ep_;
 
-		TexturePtr texture_;
+		GraphicsBufferPtr vb_;
+		GraphicsBufferPtr ib_;
+
+		std::vector<QuadBatch> batches_;
+		uint32_t num_quads_;
 
-		std::unique_ptr<TransientBuffer> tb_vb_;
-		std::unique_ptr<TransientBuffer> tb_ib_;
-		std::vector<SubAlloc> tb_vb_sub_allocs_;
-		std::vector<SubAlloc> tb_ib_sub_allocs_;
+		std::vector<StringCache> strings_;
+		uint32_t num_strings_;
 	};
 
 
@@ -298,8 +376,19 @@ namespace KlayGE
 	}
 
 
+	void UIControl::MarkDirty()
+	{
+		UIDialogPtr dialog = dialog_.lock();
+		if (dialog)
+		{
+			dialog->MarkDirty();
+		}
+	}
+
+
 	UIManager::UIManager()
-		: mouse_on_ui_(false),
+		: atlas_dirty_(false), cur_geometry_(nullptr),
+			mouse_on_ui_(false),
 			inited_(false)
 	{
 	}
@@ -773,7 +862,18 @@ namespace KlayGE
 
 	size_t UIManager::AddTexture(TexturePtr const & texture)
 	{
+		// Every dialog adds its control texture, usually the same ui.dds
+		auto iter = std::find(texture_cache_.begin(), texture_cache_.end(), texture);
+		if (iter != texture_cache_.end())
+		{
+			return iter - texture_cache_.begin();
+		}
+
 		texture_cache_.push_back(texture);
+		if (IsAtlasCandidate(texture))
+		{
+			atlas_dirty_ = true;
+		}
 		return texture_cache_.size() - 1;
 	}
 
@@ -919,33 +1019,15 @@ namespace KlayGE
 
 	void UIManager::Render()
 	{
-		for (auto& str : strings_)
+		if (atlas_dirty_)
 		{
-			str.second.clear();
+			this->BuildAtlas();
 		}
 
 		for (auto const & dialog : dialogs_)
 		{
 			dialog->Render();
 		}
-
-		for (auto const & rect : rects_)
-		{
-			if (!checked_pointer_cast<UIRectRenderable>(rect.second)->Empty())
-			{
-				SceneObjectHelperPtr ui_rect_obj
-					= MakeSharedPtr<SceneObjectHelper>(rect.second, SceneObject::SOA_Overlay);
-				ui_rect_obj->AddToSceneManager();
-			}
-		}
-		for (auto const & str : strings_)
-		{
-			auto const & font = font_cache_[str.first];
-			for (auto const & s : str.second)
-			{
-				font.first->RenderText(s.rc, s.depth, 1, 1, s.clr, s.text, font.second, s.align);
-			}
-		}
 	}
 
 	void UIManager::DrawRect(float3 const & pos, float width, float height, Color const * clrs,
@@ -964,68 +1046,175 @@ namespace KlayGE
 			texcoord = Rect(0, 0, 0, 0);
 		}
 
-		std::shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
+		VertexFormat const vertices[] =
+		{
+			VertexFormat(pos + float3(0, 0, 0), clrs[0], float2(texcoord.left(), texcoord.top())),
+			VertexFormat(pos + float3(width, 0, 0), clrs[1], float2(texcoord.right(), texcoord.top())),
+			VertexFormat(pos + float3(width, height, 0), clrs[2], float2(texcoord.right(), texcoord.bottom())),
+			VertexFormat(pos + float3(0, height, 0), clrs[3], float2(texcoord.left(), texcoord.bottom()))
+		};
+		this->DrawQuad(float3(0, 0, 0), vertices, texture);
+	}
+
+	void UIManager::DrawQuad(float3 const & offset, VertexFormat const * vertices, TexturePtr const & texture)
+	{
+		BOOST_ASSERT(cur_geometry_);
+
+		auto iter = texture ? atlas_regions_.find(texture.get()) : atlas_regions_.end();
+		if (atlas_tex_ && (!texture || (iter != atlas_regions_.end())))
 		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
+			// Untextured quads go to the atlas as well, with a negative texcoord the shader uses the vertex color only
+			float4 const region = texture ? iter->second : float4(0, 0, -1, -1);
+
+			VertexFormat remapped[4];
+			for (uint32_t i = 0; i < 4; ++ i)
+			{
+				remapped[i] = vertices[i];
+				remapped[i].tex = vertices[i].tex * float2(region.x(), region.y()) + float2(region.z(), region.w());
+			}
+			cur_geometry_->AddQuad(offset, remapped, atlas_tex_);
 		}
 		else
 		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
+			cur_geometry_->AddQuad(offset, vertices, texture);
 		}
-		BOOST_ASSERT(renderable);
+	}
 
-		std::vector<VertexFormat> vertices(4);
-		vertices[0] = VertexFormat(pos + float3(0, 0, 0),
-			clrs[0], float2(texcoord.left(), texcoord.top()));
-		vertices[1] = VertexFormat(pos + float3(width, 0, 0),
-			clrs[1], float2(texcoord.right(), texcoord.top()));
-		vertices[2] = VertexFormat(pos + float3(width, height, 0),
-			clrs[2], float2(texcoord.right(), texcoord.bottom()));
-		vertices[3] = VertexFormat(pos + float3(0, height, 0),
-			clrs[3], float2(texcoord.left(), texcoord.bottom()));
+	void UIManager::DrawString(std::wstring const & strText, uint32_t font_index,
+		IRect const & rc, float depth, Color const & clr, uint32_t align)
+	{
+		BOOST_ASSERT(cur_geometry_);
 
-		renderable->AddQuad(vertices);
+		auto const & font = font_cache_[font_index];
+		cur_geometry_->AddString(font.first, font.second, rc, depth, clr, strText, align);
 	}
 
-	void UIManager::DrawQuad(float3 const & offset, VertexFormat const * vertices, TexturePtr const & texture)
+	void UIManager::BuildAtlas()
 	{
-		std::shared_ptr<UIRectRenderable> renderable;
-		if (rects_.find(texture) == rects_.end())
+		atlas_dirty_ = false;
+		atlas_tex_.reset();
+		atlas_regions_.clear();
+
+		std::vector<TexturePtr> candidates;
+		for (auto const & tex : texture_cache_)
 		{
-			renderable = MakeSharedPtr<UIRectRenderable>(texture, effect_);
-			rects_[texture] = renderable;
+			if (IsAtlasCandidate(tex) && (candidates.empty() || (tex->Format() == candidates[0]->Format())))
+			{
+				candidates.push_back(tex);
+			}
 		}
-		else
+
+		if (candidates.size() == 1)
+		{
+			atlas_tex_ = candidates[0];
+			atlas_regions_.emplace(atlas_tex_.get(), float4(1, 1, 0, 0));
+		}
+		else if (candidates.size() > 1)
+		{
+			// Shelf packing, tallest first. Everything stays on 4 texel boundaries for the block compressed formats,
+			//  and the gap keeps the bilinear filter of one texture away from its neighbors.
+			uint32_t const GAP = 4;
+			ElementFormat const fmt = candidates[0]->Format();
+			bool const compressed = IsCompressedFormat(fmt);
+
+			std::sort(candidates.begin(), candidates.end(),
+				[](TexturePtr const & lhs, TexturePtr const & rhs)
+				{
+					return lhs->Height(0) > rhs->Height(0);
+				});
+
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+			RenderDeviceCaps const & caps = rf.RenderEngineInstance().DeviceCaps();
+
+			uint32_t area = 0;
+			uint32_t max_width = 0;
+			for (auto const & tex : candidates)
+			{
+				uint32_t const w = (tex->Width(0) + 3) & ~3U;
+				uint32_t const h = (tex->Height(0) + 3) & ~3U;
+				area += (w + GAP) * (h + GAP);
+				max_width = std::max(max_width, w);
+			}
+			uint32_t atlas_width = 1;
+			while (atlas_width * atlas_width < area)
+			{
+				atlas_width *= 2;
+			}
+			atlas_width = std::min(std::max(atlas_width, max_width), caps.max_texture_width);
+
+			std::vector<int2> positions(candidates.size(), int2(-1, -1));
+			uint32_t x = 0;
+			uint32_t y = 0;
+			uint32_t shelf_height = 0;
+			for (size_t i = 0; i < candidates.size(); ++ i)
+			{
+				uint32_t const tex_width = candidates[i]->Width(0);
+				uint32_t const tex_height = candidates[i]->Height(0);
+				uint32_t const w = (tex_width + 3) & ~3U;
+				uint32_t const h = (tex_height + 3) & ~3U;
+				if ((w > atlas_width) || (compressed && ((w != tex_width) || (h != tex_height))))
+				{
+					continue;
+				}
+
+				if (x + w > atlas_width)
+				{
+					y += shelf_height + GAP;
+					x = 0;
+					shelf_height = 0;
+				}
+				if (y + h > caps.max_texture_height)
+				{
+					continue;
+				}
+
+				positions[i] = int2(x, y);
+				x += w + GAP;
+				shelf_height = std::max(shelf_height, h);
+			}
+			uint32_t const atlas_height = (y + shelf_height + 3) & ~3U;
+
+			if (atlas_height > 0)
+			{
+				atlas_tex_ = rf.MakeTexture2D(atlas_width, atlas_height, 1, 1, fmt, 1, 0, EAH_GPU_Read);
+				float const inv_width = 1.0f / atlas_width;
+				float const inv_height = 1.0f / atlas_height;
+				for (size_t i = 0; i < candidates.size(); ++ i)
+				{
+					if (positions[i].x() >= 0)
+					{
+						auto const & tex = candidates[i];
+						uint32_t const w = tex->Width(0);
+						uint32_t const h = tex->Height(0);
+						tex->CopyToSubTexture2D(*atlas_tex_, 0, 0, positions[i].x(), positions[i].y(), w, h,
+							0, 0, 0, 0, w, h);
+						atlas_regions_.emplace(tex.get(), float4(w * inv_width, h * inv_height,
+							positions[i].x() * inv_width, positions[i].y() * inv_height));
+					}
+				}
+			}
+		}
+
+		for (auto const & dialog : dialogs_)
 		{
-			renderable = checked_pointer_cast<UIRectRenderable>(rects_[texture]);
+			dialog->MarkDirty();
 		}
-		BOOST_ASSERT(renderable);
+	}
 
-		std::vector<VertexFormat> verts(4);
-		verts[0] = VertexFormat(offset + vertices[0].pos,
-			vertices[0].clr, vertices[0].tex);
-		verts[1] = VertexFormat(offset + vertices[1].pos,
-			vertices[1].clr, vertices[1].tex);
-		verts[2] = VertexFormat(offset + vertices[2].pos,
-			vertices[2].clr, vertices[2].tex);
-		verts[3] = VertexFormat(offset + vertices[3].pos,
-			vertices[3].clr, vertices[3].tex);
+	void UIManager::BeginGeometry(UIDialogRenderable& geometry)
+	{
+		BOOST_ASSERT(!cur_geometry_);
 
-		renderable->AddQuad(verts);
+		cur_geometry_ = &geometry;
+		cur_geometry_->Clear();
 	}
 
-	void UIManager::DrawString(std::wstring const & strText, uint32_t font_index,
-		IRect const & rc, float depth, Color const & clr, uint32_t align)
+	void UIManager::EndGeometry()
 	{
-		strings_[font_index].push_back(string_cache());
-		string_cache& sc = strings_[font_index].back();
-		sc.rc = rc;
-		sc.depth = depth;
-		sc.clr = clr;
-		sc.text = strText;
-		sc.align = align;
+		BOOST_ASSERT(cur_geometry_);
+
+		cur_geometry_->Commit();
+		cur_geometry_ = nullptr;
 	}
 
 	Size_T<float> UIManager::CalcSize(std::wstring const & strText, uint32_t font_index,
@@ -1232,7 +1421,7 @@ namespace KlayGE
 					caption_height_(18),
 					top_left_clr_(0, 0, 0, 0), top_right_clr_(0, 0, 0, 0),
 					bottom_left_clr_(0, 0, 0, 0), bottom_right_clr_(0, 0, 0, 0),
-					opacity_(0.5f)
+					opacity_(0.5f), dirty_(true)
 	{
 		TexturePtr ct;
 		if (control_tex)
@@ -1259,6 +1448,7 @@ namespace KlayGE
 
 		// Add to the list
 		controls_.push_back(control);
+		dirty_ = true;
 	}
 
 	void UIDialog::InitControl(UIControl& control)
@@ -1344,6 +1534,18 @@ namespace KlayGE
 		control->SetEnabled(enabled);
 	}
 
+	bool UIDialog::Animating() const
+	{
+		for (auto const & control : controls_)
+		{
+			if (control->GetVisible() && control->Animating())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
 	void UIDialog::Render()
 	{
 		// For invisible dialog, out now.
@@ -1352,6 +1554,32 @@ namespace KlayGE
 			return;
 		}
 
+		UIManager& ui_mgr = UIManager::Instance();
+		if (!geometry_)
+		{
+			geometry_ = MakeSharedPtr<UIDialogRenderable>(ui_mgr.GetEffect());
+			geometry_obj_ = MakeSharedPtr<SceneObjectHelper>(geometry_, SceneObject::SOA_Overlay);
+		}
+
+		if (dirty_ || (!minimized_ && this->Animating()))
+		{
+			ui_mgr.BeginGeometry(*geometry_);
+			this->BuildGeometry();
+			ui_mgr.EndGeometry();
+
+			dirty_ = false;
+		}
+
+		// The overlay objects are dropped by the scene manager every frame
+		if (!geometry_->Empty())
+		{
+			geometry_obj_->AddToSceneManager();
+		}
+		geometry_->RenderStrings();
+	}
+
+	void UIDialog::BuildGeometry()
+	{
 		depth_base_ = 0.5f;
 
 		bool bBackgroundIsVisible = (top_left_clr_.a() != 0) || (top_right_clr_.a() != 0)
@@ -1497,6 +1725,7 @@ namespace KlayGE
 
 			control.OnFocusIn();
 			control_focus_ = control.shared_from_this();
+			dirty_ = true;
 		}
 	}
 
@@ -1512,6 +1741,7 @@ namespace KlayGE
 		top_right_clr_ = colorTopRight;
 		bottom_left_clr_ = colorBottomLeft;
 		bottom_right_clr_ = colorBottomRight;
+		dirty_ = true;
 	}
 
 	bool UIDialog::ContainsPoint(int2 const & pt) const
@@ -1549,6 +1779,7 @@ namespace KlayGE
 		{
 			control_focus_.lock()->OnFocusOut();
 			control_focus_.reset();
+			dirty_ = true;
 		}
 	}
 
@@ -1628,6 +1859,7 @@ namespace KlayGE
 				}
 
 				controls_.erase(controls_.begin() + i);
+				dirty_ = true;
 
 				return;
 			}
@@ -1643,6 +1875,7 @@ namespace KlayGE
 		control_mouse_over_.reset();
 
 		controls_.clear();
+		dirty_ = true;
 	}
 
 	// Device state notification
@@ -1667,6 +1900,8 @@ namespace KlayGE
 		{
 			this->FocusDefaultControl();
 		}
+
+		dirty_ = true;
 	}
 
 	// Shared resource access. Indexed fonts and textures are shared among
@@ -1679,6 +1914,7 @@ namespace KlayGE
 			fonts_.resize(index + 1, -1);
 		}
 		fonts_[index] = static_cast<int>(UIManager::Instance().AddFont(font, font_size));
+		dirty_ = true;
 	}
 
 	FontPtr const & UIDialog::GetFont(size_t index) const
@@ -1704,6 +1940,7 @@ namespace KlayGE
 				// Give focus to the default control
 				control_focus_ = control;
 				control->OnFocusIn();
+				dirty_ = true;
 
 				break;
 			}
@@ -2024,6 +2261,9 @@ namespace KlayGE
 		{
 			opacity_ = 0.5f;
 		}
+
+		// Key presses are rare enough to regenerate unconditionally
+		dirty_ = true;
 	}
 
 	void UIDialog::KeyUpHandler(uint32_t key)
@@ -2041,6 +2281,8 @@ namespace KlayGE
 		{
 			opacity_ = 0.5f;
 		}
+
+		dirty_ = true;
 	}
 
 	void UIDialog::MouseDownHandler(uint32_t buttons, int2 const & pt)
@@ -2080,6 +2322,8 @@ namespace KlayGE
 		{
 			opacity_ = 0.5f;
 		}
+
+		dirty_ = true;
 	}
 
 	void UIDialog::MouseUpHandler(uint32_t buttons, int2 const & pt)
@@ -2119,6 +2363,8 @@ namespace KlayGE
 		{
 			opacity_ = 0.5f;
 		}
+
+		dirty_ = true;
 	}
 
 	void UIDialog::MouseWheelHandler(uint32_t buttons, int2 const & pt, int32_t z_delta)
@@ -2158,11 +2404,14 @@ namespace KlayGE
 		{
 			opacity_ = 0.5f;
 		}
+
+		dirty_ = true;
 	}
 
 	void UIDialog::MouseOverHandler(uint32_t buttons, int2 const & pt)
 	{
 		int2 const local_pt = this->ToLocal(pt);
+		float const old_opacity = opacity_;
 
 		UIControlPtr control;
 		if (control_focus_.lock() && control_focus_.lock()->GetEnabled()
@@ -2177,6 +2426,8 @@ namespace KlayGE
 
 			if (control_mouse_over_.lock() != control)
 			{
+				dirty_ = true;
+
 				// Handle mouse leaving the old control
 				if (control_mouse_over_.lock())
 				{
@@ -2205,5 +2456,11 @@ namespace KlayGE
 		{
 			opacity_ = 0.5f;
 		}
+
+		// The mouse moves all the time, only regenerate if something could look different
+		if (control || (opacity_ != old_opacity))
+		{
+			dirty_ = true;
+		}
 	}
 }
@@ -126,6 +126,7 @@ namespace KlayGE
 	void UICheckBox::SetCheckedInternal(bool bChecked)
 	{
 		checked_ = bChecked;
+		this->MarkDirty();
 
 		this->OnChangedEvent()(*this);
 	}
@@ -197,6 +198,7 @@ namespace KlayGE
 	void UICheckBox::SetText(std::wstring const & strText)
 	{
 		text_ = strText;
+		this->MarkDirty();
 	}
 
 	void UICheckBox::OnHotkey()
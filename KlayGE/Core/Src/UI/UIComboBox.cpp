@@ -127,6 +127,8 @@ namespace KlayGE
 		{
 			dropdown_element->FontColor().States[UICS_Normal] = color;
 		}
+
+		this->MarkDirty();
 	}
 
 	void UIComboBox::OnFocusOut()
@@ -639,6 +641,7 @@ namespace KlayGE
 		items_.clear();
 		scroll_bar_.SetTrackRange(0, 1);
 		focused_ = selected_ = -1;
+		this->MarkDirty();
 	}
 
 	bool UIComboBox::ContainsItem(std::wstring const & strText, uint32_t iStart) const
@@ -718,6 +721,7 @@ namespace KlayGE
 		BOOST_ASSERT(index < this->GetNumItems());
 
 		focused_ = selected_ = index;
+		this->MarkDirty();
 		this->OnSelectionChangedEvent()(*this);
 	}
 
@@ -358,6 +358,7 @@ namespace KlayGE
 	{
 		BOOST_ASSERT((nCP >= 0) && (nCP <= static_cast<int>(buffer_.GetTextSize())));
 		caret_pos_ = nCP;
+		this->MarkDirty();
 
 		// Obtain the X offset of the character.
 		int nX2;
@@ -264,6 +264,7 @@ namespace KlayGE
 			// Adjust scroll bar
 			scroll_bar_.ShowItem(selected_);
 		}
+		this->MarkDirty();
 
 		this->OnSelectionEvent()(*this);
 	}
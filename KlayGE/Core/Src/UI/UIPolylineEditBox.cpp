@@ -93,6 +93,7 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(index < static_cast<int>(ctrl_points_.size()));
 		active_pt_ = index;
+		this->MarkDirty();
 	}
 	
 	int UIPolylineEditBox::ActivePoint() const
@@ -105,6 +106,7 @@ namespace KlayGE
 		active_pt_ = -1;
 		ctrl_points_.clear();
 		move_point_ = false;
+		this->MarkDirty();
 	}
 
 	int UIPolylineEditBox::AddCtrlPoint(float pos, float value)
@@ -152,21 +154,25 @@ namespace KlayGE
 		}
 
 		ctrl_points_.erase(ctrl_points_.begin() + index);
+		this->MarkDirty();
 	}
 
 	void UIPolylineEditBox::SetCtrlPoint(int index, float pos, float value)
 	{
 		ctrl_points_[index] = float2(pos, value);
+		this->MarkDirty();
 	}
 
 	void UIPolylineEditBox::SetCtrlPoints(std::vector<float2> const & ctrl_points)
 	{
 		ctrl_points_ = ctrl_points;
+		this->MarkDirty();
 	}
 
 	void UIPolylineEditBox::SetColor(Color const & clr)
 	{
 		elements_[POLYLINE_INDEX]->TextureColor().States[UICS_Normal] = clr;
+		this->MarkDirty();
 	}
 
 	size_t UIPolylineEditBox::NumCtrlPoints() const
@@ -73,6 +73,7 @@ namespace KlayGE
 	void UIProgressBar::SetValue(int value)
 	{
 		progress_ = value;
+		this->MarkDirty();
 	}
 	
 	int UIProgressBar::GetValue() const
@@ -138,6 +138,7 @@ namespace KlayGE
 		}
 
 		checked_ = bChecked;
+		this->MarkDirty();
 		this->OnChangedEvent()(*this);
 	}
 
@@ -212,6 +213,7 @@ namespace KlayGE
 	void UIRadioButton::SetText(std::wstring const & strText)
 	{
 		text_ = strText;
+		this->MarkDirty();
 	}
 
 	void UIRadioButton::OnHotkey()
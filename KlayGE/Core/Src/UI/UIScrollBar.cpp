@@ -160,6 +160,8 @@ namespace KlayGE
 			thumb_rc_.bottom() = thumb_rc_.top();
 			show_thumb_ = false;
 		}
+
+		this->MarkDirty();
 	}
 
 	// Scroll() scrolls by nDelta items.  A positive value scrolls down, while a negative
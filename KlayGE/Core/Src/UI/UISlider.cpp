@@ -216,6 +216,7 @@ namespace KlayGE
 
 		value_ = nValue;
 		this->UpdateRects();
+		this->MarkDirty();
 
 		this->OnValueChangedEvent()(*this);
 	}
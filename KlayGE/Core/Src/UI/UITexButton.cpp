@@ -234,6 +234,7 @@ namespace KlayGE
 		{
 			elements_[9]->SetTexture(static_cast<uint32_t>(tex_index_), IRect(0, 0, 1, 1));
 		}
+		this->MarkDirty();
 	}
 
 	void UITexButton::OnHotkey()
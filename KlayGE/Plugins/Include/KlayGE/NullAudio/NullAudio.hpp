@@ -37,8 +37,22 @@
 
 #include <KlayGE/Audio.hpp>
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 namespace KlayGE
 {
+	// Null audio has no device, its buffers are mixed in software by NullAudioEngine::MixOutput into interleaved
+	//  stereo float samples at this rate. Positions are ignored.
+	uint32_t constexpr NULL_AUDIO_MIX_FREQ = 44100;
+
+	// Adds the frames of src to output, resampled with the nearest sample. pos is the 16.16 fixed point read position in
+	//  src frames, it's advanced past the frames consumed. Returns the number of output frames mixed, less than
+	//  num_frames when src runs out.
+	uint32_t NullMixFrames(float* output, uint32_t num_frames, uint8_t const * src, uint32_t src_size,
+		AudioFormat format, uint32_t freq, float volume, uint64_t& pos);
+
 	class NullSoundBuffer : public SoundBuffer
 	{
 	public:
@@ -59,10 +73,24 @@ namespace KlayGE
 		float3 Direction() const override;
 		void Direction(float3 const & v) override;
 
+		void Mix(float* output, uint32_t num_frames);
+
 	private:
 		void DoReset() override;
 
 	private:
+		struct Voice
+		{
+			uint64_t pos;
+			bool loop;
+			bool playing;
+		};
+
+		std::vector<uint8_t> data_;
+		std::vector<Voice> voices_;
+		float volume_;
+		mutable std::mutex mix_mutex_;
+
 		float3 pos_;
 		float3 vel_;
 		float3 dir_;
@@ -85,12 +113,22 @@ namespace KlayGE
 		float3 Direction() const override;
 		void Direction(float3 const & v) override;
 
+		void Mix(float* output, uint32_t num_frames);
+
 	private:
 		void DoReset() override;
 		void DoPlay(bool loop) override;
 		void DoStop() override;
+		uint32_t DoServiceStream() override;
 
 	private:
+		std::atomic<bool> playing_;
+		StreamChunk curr_chunk_;
+		bool has_chunk_;
+		uint64_t chunk_pos_;
+		float volume_;
+		std::mutex mix_mutex_;
+
 		float3 pos_;
 		float3 vel_;
 		float3 dir_;
@@ -111,6 +149,8 @@ namespace KlayGE
 		void GetListenerOri(float3& face, float3& up) const override;
 		void SetListenerOri(float3 const & face, float3 const & up) override;
 
+		uint32_t MixOutput(float* output, uint32_t num_frames) override;
+
 	private:
 		void DoSuspend() override;
 		void DoResume() override;
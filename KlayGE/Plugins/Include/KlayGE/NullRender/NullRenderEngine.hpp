@@ -120,6 +120,7 @@ namespace KlayGE
 		uint8_t minor_version_;
 		bool requires_flipping_;
 		bool frag_depth_support_;
+		bool inline_shader_blocks_;
 
 		std::vector<ElementFormat> vertex_format_;
 		std::vector<ElementFormat> texture_format_;
@@ -56,6 +56,7 @@ namespace KlayGE
 		void AttachShader(ShaderType type, RenderEffect const & effect,
 			RenderTechnique const & tech, RenderPass const & pass, ShaderObjectPtr const & shared_so) override;
 		void LinkShaders(RenderEffect const & effect) override;
+		bool ConcurrentAttachSupport() const override;
 		ShaderObjectPtr Clone(RenderEffect const & effect) override;
 
 		void Bind() override;
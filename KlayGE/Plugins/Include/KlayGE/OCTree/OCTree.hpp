@@ -41,6 +41,15 @@ namespace KlayGE
 		void MaxTreeDepth(uint32_t max_tree_depth);
 		uint32_t MaxTreeDepth() const;
 
+		// Loose mode keeps every cullable root object, moveable ones included, in a loose octree. Objects are moved
+		//  between nodes incrementally when their bound leaves the loose bound of the node, instead of rebuilding.
+		void LooseMode(bool loose);
+		bool LooseMode() const;
+
+		// MAX_TREE_DEPTH (uint32_t) and LOOSE_MODE (bool), for code that only sees the SceneManager of the plugin
+		virtual void GetCustomAttrib(std::string_view name, void* value) const override;
+		virtual void SetCustomAttrib(std::string_view name, void* value) override;
+
 		virtual void ClipScene() override;
 
 		virtual BoundOverlap AABBVisible(AABBox const & aabb) const override;
@@ -64,6 +73,20 @@ namespace KlayGE
 		BoundOverlap BoundVisible(size_t index, Sphere const & sphere) const;
 		BoundOverlap BoundVisible(size_t index, Frustum const & frustum) const;
 
+		void ClipSceneLoose();
+		void ClearLooseTree();
+		void BuildLooseTree();
+		uint32_t LooseNodeIndex(AABBox const & aabb);
+		uint32_t LooseChildNode(uint32_t parent, uint32_t octant);
+		uint32_t LooseObjHandle(SceneObject* so) const;
+		void LinkLooseObj(uint32_t handle, uint32_t node);
+		void UnlinkLooseObj(uint32_t handle);
+		void AddLooseObj(SceneObject* so);
+		void DelLooseObj(SceneObject* so);
+		void RelocateLooseObj(uint32_t handle);
+		void LooseNodeVisible(uint32_t index, BoundOverlap parent_visible, float3 const & view_dir, float3 const & eye_pos,
+			float4x4 const & view_proj);
+
 	private:
 		OCTree(OCTree const & rhs);
 		OCTree& operator=(OCTree const & rhs);
@@ -84,6 +107,32 @@ namespace KlayGE
 
 		bool rebuild_tree_;
 
+		// Node 0 holds the objects outside of the root, node 1 is the root. The cell of an object is found by a Morton
+		//  code, 3 bits of octant per level, which is walked down from the root. Objects of a node form a linked list,
+		//  and the handle of an object is kept in SceneObject::SpatialHandle.
+		struct loose_node_t
+		{
+			AABBox bb;
+			uint32_t parent;
+			uint32_t children[8];
+			uint32_t first_obj;
+			uint32_t num_subtree_objs;
+			BoundOverlap visible;
+		};
+		struct loose_obj_t
+		{
+			SceneObject* so;
+			uint32_t node;
+			uint32_t prev;
+			uint32_t next;
+		};
+
+		bool loose_;
+		bool rebuild_loose_tree_;
+		std::vector<loose_node_t> loose_nodes_;
+		std::vector<loose_obj_t> loose_objs_;
+		std::vector<uint32_t> free_loose_objs_;
+
 #ifdef KLAYGE_DRAW_NODES
 		RenderablePtr node_renderable_;
 #endif
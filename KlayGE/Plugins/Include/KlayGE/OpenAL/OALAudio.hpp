@@ -107,24 +107,20 @@ namespace KlayGE
 		float3 Direction() const override;
 		void Direction(float3 const & v) override;
 
-		void LoopUpdateBuffer();
-
 	private:
 		void DoReset() override;
 		void DoPlay(bool loop) override;
 		void DoStop() override;
+		uint32_t DoServiceStream() override;
+
+		uint32_t QueueChunks();
 
 	private:
 		ALuint source_;
 		std::vector<ALuint> buffer_queue_;
+		std::vector<ALuint> free_buffers_;
 
-		bool loop_;
-
-		bool played_;
-		bool stopped_;
-		std::condition_variable play_cond_;
-		std::mutex play_mutex_;
-		joiner<void> play_thread_;
+		bool playing_;
 	};
 
 	class OALAudioEngine : public AudioEngine
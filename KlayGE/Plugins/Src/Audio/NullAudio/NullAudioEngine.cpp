@@ -29,11 +29,66 @@
  */
 
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KFL/Util.hpp>
+
+#include <algorithm>
 
 #include <KlayGE/NullAudio/NullAudio.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	template <typename SampleType, uint32_t NUM_CHANNELS>
+	uint32_t MixFrames(float* output, uint32_t num_frames, SampleType const * src, uint32_t src_frames,
+		uint64_t step, float bias, float scale, uint64_t& pos)
+	{
+		uint64_t const end = static_cast<uint64_t>(src_frames) << 16;
+
+		uint32_t i = 0;
+		for (; (i < num_frames) && (pos < end); ++ i)
+		{
+			SampleType const * frame = src + (pos >> 16) * NUM_CHANNELS;
+			output[i * 2 + 0] += (frame[0] + bias) * scale;
+			output[i * 2 + 1] += (frame[NUM_CHANNELS - 1] + bias) * scale;
+			pos += step;
+		}
+		return i;
+	}
+}
+
 namespace KlayGE
 {
+	uint32_t NullMixFrames(float* output, uint32_t num_frames, uint8_t const * src, uint32_t src_size,
+		AudioFormat format, uint32_t freq, float volume, uint64_t& pos)
+	{
+		uint64_t const step = (static_cast<uint64_t>(freq) << 16) / NULL_AUDIO_MIX_FREQ;
+
+		// 8-bit samples are unsigned
+		switch (format)
+		{
+		case AF_Mono8:
+			return MixFrames<uint8_t, 1>(output, num_frames, src, src_size,
+				step, -128.0f, volume / 128, pos);
+
+		case AF_Mono16:
+			return MixFrames<int16_t, 1>(output, num_frames, reinterpret_cast<int16_t const *>(src), src_size / 2,
+				step, 0.0f, volume / 32768, pos);
+
+		case AF_Stereo8:
+			return MixFrames<uint8_t, 2>(output, num_frames, src, src_size / 2,
+				step, -128.0f, volume / 128, pos);
+
+		case AF_Stereo16:
+			return MixFrames<int16_t, 2>(output, num_frames, reinterpret_cast<int16_t const *>(src), src_size / 4,
+				step, 0.0f, volume / 32768, pos);
+
+		default:
+			KFL_UNREACHABLE("Invalid audio format");
+		}
+	}
+
 	NullAudioEngine::NullAudioEngine()
 	{
 		this->SetListenerPos(float3(0, 0, 0));
@@ -90,4 +145,23 @@ namespace KlayGE
 		face_ = face;
 		up_ = up;
 	}
+
+	uint32_t NullAudioEngine::MixOutput(float* output, uint32_t num_frames)
+	{
+		std::fill(output, output + num_frames * 2, 0.0f);
+
+		for (auto const & ab : audio_buffs_)
+		{
+			if (ab.second->IsSound())
+			{
+				checked_cast<NullSoundBuffer*>(ab.second.get())->Mix(output, num_frames);
+			}
+			else
+			{
+				checked_cast<NullMusicBuffer*>(ab.second.get())->Mix(output, num_frames);
+			}
+		}
+
+		return num_frames;
+	}
 }
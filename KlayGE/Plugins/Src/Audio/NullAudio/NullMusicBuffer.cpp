@@ -35,9 +35,10 @@
 namespace KlayGE
 {
 	NullMusicBuffer::NullMusicBuffer(AudioDataSourcePtr const & data_source, uint32_t buffer_seconds, float volume)
-					: MusicBuffer(data_source)
+					: MusicBuffer(data_source),
+						playing_(false), has_chunk_(false), chunk_pos_(0)
 	{
-		KFL_UNUSED(buffer_seconds);
+		this->InitStream(buffer_seconds);
 
 		this->Position(float3::Zero());
 		this->Velocity(float3::Zero());
@@ -55,26 +56,82 @@ namespace KlayGE
 
 	void NullMusicBuffer::DoReset()
 	{
-		data_source_->Reset();
 	}
 
 	void NullMusicBuffer::DoPlay(bool loop)
 	{
 		KFL_UNUSED(loop);
+
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		has_chunk_ = false;
+		chunk_pos_ = 0;
+		playing_ = true;
 	}
 
 	void NullMusicBuffer::DoStop()
 	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		playing_ = false;
+		has_chunk_ = false;
+	}
+
+	uint32_t NullMusicBuffer::DoServiceStream()
+	{
+		// Consuming happens in Mix, it wakes the service up when chunks are released
+		return AudioStreamService::WAIT_INFINITE;
+	}
+
+	void NullMusicBuffer::Mix(float* output, uint32_t num_frames)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+
+		uint32_t num_released = 0;
+		while (playing_ && (num_frames > 0))
+		{
+			if (!has_chunk_)
+			{
+				if (!this->AcquireChunk(curr_chunk_))
+				{
+					// The decoder is behind, the rest is silence
+					break;
+				}
+
+				has_chunk_ = true;
+				chunk_pos_ = 0;
+			}
+
+			uint32_t const mixed = NullMixFrames(output, num_frames, curr_chunk_.data, curr_chunk_.size,
+				format_, freq_, volume_, chunk_pos_);
+			output += mixed * 2;
+			num_frames -= mixed;
+
+			if (num_frames > 0)
+			{
+				has_chunk_ = false;
+				++ num_released;
+
+				if (curr_chunk_.end_of_stream)
+				{
+					playing_ = false;
+				}
+			}
+		}
+
+		if (num_released > 0)
+		{
+			this->ReleaseChunks(num_released);
+			this->StreamService().Wakeup();
+		}
 	}
 
 	bool NullMusicBuffer::IsPlaying() const
 	{
-		return false;
+		return playing_;
 	}
 
 	void NullMusicBuffer::Volume(float vol)
 	{
-		KFL_UNUSED(vol);
+		volume_ = vol;
 	}
 
 	float3 NullMusicBuffer::Position() const
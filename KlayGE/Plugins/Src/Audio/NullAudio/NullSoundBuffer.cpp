@@ -30,14 +30,27 @@
 
 #include <KlayGE/KlayGE.hpp>
 
+#include <algorithm>
+
+#include <boost/assert.hpp>
+
 #include <KlayGE/NullAudio/NullAudio.hpp>
 
 namespace KlayGE
 {
 	NullSoundBuffer::NullSoundBuffer(AudioDataSourcePtr const & data_source, uint32_t num_sources, float volume)
-					: SoundBuffer(data_source)
+					: SoundBuffer(data_source),
+						voices_(num_sources)
 	{
-		KFL_UNUSED(num_sources);
+		data_.resize(data_source_->Size());
+		data_.resize(data_source_->Read(data_.data(), data_.size()));
+
+		for (auto& voice : voices_)
+		{
+			voice.pos = 0;
+			voice.loop = false;
+			voice.playing = false;
+		}
 
 		this->Position(float3(0, 0, 0));
 		this->Velocity(float3(0, 0, 0));
@@ -55,25 +68,76 @@ namespace KlayGE
 
 	void NullSoundBuffer::Play(bool loop)
 	{
-		KFL_UNUSED(loop);
+		BOOST_ASSERT(!voices_.empty());
+
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+
+		// A free voice, or restart the first one when all of them are busy
+		auto iter = std::find_if(voices_.begin(), voices_.end(), [](Voice const & voice) { return !voice.playing; });
+		if (iter == voices_.end())
+		{
+			iter = voices_.begin();
+		}
+
+		iter->pos = 0;
+		iter->loop = loop;
+		iter->playing = true;
 	}
 
 	void NullSoundBuffer::Stop()
 	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		for (auto& voice : voices_)
+		{
+			voice.playing = false;
+		}
 	}
 
 	void NullSoundBuffer::DoReset()
 	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		for (auto& voice : voices_)
+		{
+			voice.pos = 0;
+		}
+	}
+
+	void NullSoundBuffer::Mix(float* output, uint32_t num_frames)
+	{
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+
+		for (auto& voice : voices_)
+		{
+			float* dst = output;
+			uint32_t frames_left = num_frames;
+			bool rewound = false;
+			while (voice.playing && (frames_left > 0))
+			{
+				uint32_t const mixed = NullMixFrames(dst, frames_left, data_.data(), static_cast<uint32_t>(data_.size()),
+					format_, freq_, volume_, voice.pos);
+				dst += mixed * 2;
+				frames_left -= mixed;
+
+				if (frames_left > 0)
+				{
+					// Nothing mixed right after a rewind means there is no data at all
+					voice.playing = voice.loop && !(rewound && (0 == mixed));
+					voice.pos = 0;
+					rewound = true;
+				}
+			}
+		}
 	}
 
 	bool NullSoundBuffer::IsPlaying() const
 	{
-		return false;
+		std::lock_guard<std::mutex> lock(mix_mutex_);
+		return std::any_of(voices_.begin(), voices_.end(), [](Voice const & voice) { return voice.playing; });
 	}
 
 	void NullSoundBuffer::Volume(float vol)
 	{
-		KFL_UNUSED(vol);
+		volume_ = vol;
 	}
 
 	float3 NullSoundBuffer::Position() const
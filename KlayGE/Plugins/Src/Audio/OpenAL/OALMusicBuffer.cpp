@@ -32,18 +32,21 @@
 #include <KFL/Util.hpp>
 #include <KlayGE/AudioDataSource.hpp>
 
-#include <KlayGE/OpenAL/OALAudio.hpp>
+#include <algorithm>
 
-size_t constexpr READ_SIZE = 88200;
+#include <KlayGE/OpenAL/OALAudio.hpp>
 
 namespace KlayGE
 {
 	OALMusicBuffer::OALMusicBuffer(AudioDataSourcePtr const & data_source, uint32_t buffer_seconds, float volume)
 							: MusicBuffer(data_source),
 								buffer_queue_(buffer_seconds * BUFFERS_PER_SECOND),
-								played_(false), stopped_(true)
+								playing_(false)
 	{
+		this->InitStream(buffer_seconds);
+
 		alGenBuffers(static_cast<ALsizei>(buffer_queue_.size()), buffer_queue_.data());
+		free_buffers_ = buffer_queue_;
 
 		alGenSources(1, &source_);
 		alSourcef(source_, AL_PITCH, 1);
@@ -65,121 +68,90 @@ namespace KlayGE
 		alDeleteSources(1, &source_);
 	}
 
-	void OALMusicBuffer::LoopUpdateBuffer()
+	uint32_t OALMusicBuffer::QueueChunks()
 	{
-		std::unique_lock<std::mutex> lock(play_mutex_);
-		while (!played_)
+		ALint processed;
+		alGetSourcei(source_, AL_BUFFERS_PROCESSED, &processed);
+		while (processed > 0)
 		{
-			play_cond_.wait(lock);
+			-- processed;
+
+			ALuint buf;
+			alSourceUnqueueBuffers(source_, 1, &buf);
+			free_buffers_.push_back(buf);
 		}
-		played_ = false;
 
-		while (!stopped_)
+		ALenum const format = Convert(format_);
+		StreamChunk chunk;
+		while (!free_buffers_.empty() && this->AcquireChunk(chunk))
 		{
-			ALint processed;
-			alGetSourcei(source_, AL_BUFFERS_PROCESSED, &processed);
-			if (processed > 0)
+			if (chunk.size > 0)
 			{
-				while (processed > 0)
-				{
-					-- processed;
-
-					ALuint buf;
-					alSourceUnqueueBuffers(source_, 1, &buf);
-
-					std::vector<uint8_t> data(READ_SIZE);
-					data.resize(data_source_->Read(data.data(), data.size()));
-					if (data.empty())
-					{
-						if (loop_)
-						{
-							stopped_ = false;
-							alSourceStopv(1, &source_);
-							this->DoReset();
-							alSourcePlay(source_);
-						}
-						else
-						{
-							stopped_ = true;
-						}
-					}
-					else
-					{
-						alBufferData(buf, Convert(format_), data.data(), static_cast<ALsizei>(data.size()), freq_);
-						alSourceQueueBuffers(source_, 1, &buf);
-					}
-				}
-			}
-			else
-			{
-				Sleep(1000 / BUFFERS_PER_SECOND);
+				ALuint const buf = free_buffers_.back();
+				free_buffers_.pop_back();
+
+				alBufferData(buf, format, chunk.data, static_cast<ALsizei>(chunk.size), static_cast<ALsizei>(freq_));
+				alSourceQueueBuffers(source_, 1, &buf);
 			}
+
+			// OpenAL keeps its own copy, the chunk goes back to the decoder right away
+			this->ReleaseChunks(1);
 		}
-	}
 
-	void OALMusicBuffer::DoReset()
-	{
-		ALint queued_;
-		alGetSourcei(source_, AL_BUFFERS_QUEUED, &queued_);
-		if (queued_ > 0)
+		ALint queued;
+		alGetSourcei(source_, AL_BUFFERS_QUEUED, &queued);
+		if (0 == queued)
 		{
-			std::vector<ALuint> cur_queue(queued_);
-			alSourceUnqueueBuffers(source_, queued_, &cur_queue[0]);
+			// Everything is played, or there is nothing to play until the decoder catches up
+			return this->StreamFinished() ? AudioStreamService::WAIT_INFINITE : 1000 / BUFFERS_PER_SECOND / 2;
 		}
 
-		ALenum const format(Convert(format_));
-		std::vector<uint8_t> data(READ_SIZE);
-
-		data_source_->Reset();
-
-		ALsizei non_empty_buf = 0;
-		// Load 1 / BUFFERS_PER_SECOND second data to each buffer
-		for (auto const & buf : buffer_queue_)
+		ALint state;
+		alGetSourcei(source_, AL_SOURCE_STATE, &state);
+		if (playing_ && (state != AL_PLAYING))
 		{
-			data.resize(data_source_->Read(data.data(), data.size()));
-			if (data.empty())
-			{
-				break;
-			}
-			else
-			{
-				++ non_empty_buf;
-				alBufferData(buf, format, data.data(),
-					static_cast<ALuint>(data.size()), static_cast<ALuint>(freq_));
-			}
+			// First chunks after DoPlay, or recovering from an underrun
+			alSourcePlay(source_);
 		}
 
-		alSourceQueueBuffers(source_, non_empty_buf, buffer_queue_.data());
+		// OpenAL has no completion callbacks. Sleep until the buffer playing now is done, all queued buffers except the
+		//  last one hold a full chunk.
+		uint32_t const chunk_frames = std::max(freq_ / BUFFERS_PER_SECOND, 1U);
+		ALint offset;
+		alGetSourcei(source_, AL_SAMPLE_OFFSET, &offset);
+		uint32_t const remaining_frames = chunk_frames - static_cast<uint32_t>(offset) % chunk_frames;
+		return remaining_frames * 1000 / freq_ + 1;
+	}
+
+	uint32_t OALMusicBuffer::DoServiceStream()
+	{
+		return this->QueueChunks();
+	}
 
+	void OALMusicBuffer::DoReset()
+	{
 		alSourceRewindv(1, &source_);
 	}
 
 	void OALMusicBuffer::DoPlay(bool loop)
 	{
-		play_thread_ = Context::Instance().ThreadPool()([this] { this->LoopUpdateBuffer(); });
-
-		loop_ = loop;
-
-		stopped_ = false;
-		{
-			std::lock_guard<std::mutex> lock(play_mutex_);
-			played_ = true;
-		}
-		play_cond_.notify_one();
+		KFL_UNUSED(loop);
 
+		// Looping is done by the decoder, the source only sees one endless queue
 		alSourcei(source_, AL_LOOPING, false);
-		alSourcePlay(source_);
+
+		playing_ = true;
+		this->QueueChunks();
 	}
 
 	void OALMusicBuffer::DoStop()
 	{
-		if (!stopped_)
-		{
-			stopped_ = true;
-			play_thread_();
-		}
+		playing_ = false;
 
 		alSourceStopv(1, &source_);
+		// A stopped source has all its buffers processed, detaching the buffer removes the whole queue
+		alSourcei(source_, AL_BUFFER, 0);
+		free_buffers_ = buffer_queue_;
 	}
 
 	bool OALMusicBuffer::IsPlaying() const
@@ -47,8 +47,9 @@ namespace KlayGE
 	class MusicVoiceContext : public IXAudio2VoiceCallback
 	{
 	public:
-		MusicVoiceContext()
-			: buffer_end_event_(::CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS))
+		explicit MusicVoiceContext(AudioStreamService& stream_service)
+			: buffer_end_event_(::CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS)),
+				stream_service_(stream_service)
 		{
 		}
 		virtual ~MusicVoiceContext()
@@ -76,6 +77,7 @@ namespace KlayGE
 		STDMETHOD_(void, OnBufferEnd)(void*)
 		{
 			::SetEvent(buffer_end_event_);
+			stream_service_.Wakeup();
 		}
 		STDMETHOD_(void, OnLoopEnd)(void*)
 		{
@@ -86,18 +88,18 @@ namespace KlayGE
 
 	private:
 		HANDLE buffer_end_event_;
+		AudioStreamService& stream_service_;
 	};
 
 	XAMusicBuffer::XAMusicBuffer(AudioDataSourcePtr const & data_source, uint32_t buffer_seconds, float volume)
 					: MusicBuffer(data_source),
-						voice_call_back_(MakeUniquePtr<MusicVoiceContext>()),
-						buffer_count_(buffer_seconds * BUFFERS_PER_SECOND), curr_buffer_index_(0),
-						played_(false), stopped_(true),
+						voice_call_back_(MakeUniquePtr<MusicVoiceContext>(this->StreamService())),
+						buffer_count_(buffer_seconds * BUFFERS_PER_SECOND),
 						emitter_{}, dsp_settings_{}
 	{
+		this->InitStream(buffer_seconds);
+
 		WAVEFORMATEX wfx = WaveFormatEx(data_source);
-		audio_data_.resize(wfx.nAvgBytesPerSec * buffer_seconds);
-		buffer_size_ = wfx.nAvgBytesPerSec / BUFFERS_PER_SECOND;
 
 		auto const & ae = *checked_cast<XAAudioEngine const *>(&Context::Instance().AudioFactoryInstance().AudioEngineInstance());
 
@@ -130,58 +132,58 @@ namespace KlayGE
 		this->Stop();
 	}
 
-	void XAMusicBuffer::LoopUpdateBuffer()
+	void XAMusicBuffer::SubmitChunks()
 	{
-		std::unique_lock<std::mutex> lock(play_mutex_);
-		while (!played_)
+		XAUDIO2_VOICE_STATE state;
+		source_voice_->GetState(&state);
+
+		// XAudio2 reads straight from the ring, so a chunk is released only after its buffer ended. The only chunk that
+		//  is acquired but not submitted is an empty last one, the decoder is done by then.
+		uint32_t const num_in_flight = this->NumAcquiredChunks();
+		if (num_in_flight > state.BuffersQueued)
 		{
-			play_cond_.wait(lock);
+			this->ReleaseChunks(num_in_flight - state.BuffersQueued);
 		}
-		played_ = false;
 
-		while (!stopped_)
+		StreamChunk chunk;
+		while ((state.BuffersQueued < buffer_count_) && this->AcquireChunk(chunk))
 		{
-			XAUDIO2_VOICE_STATE state;
-			for (;;)
+			if (chunk.size > 0)
 			{
-				source_voice_->GetState(&state);
-				if (state.BuffersQueued < buffer_count_ - 1)
+				XAUDIO2_BUFFER buf{};
+				buf.AudioBytes = chunk.size;
+				buf.pAudioData = chunk.data;
+				if (chunk.end_of_stream)
 				{
-					break;
+					buf.Flags = XAUDIO2_END_OF_STREAM;
 				}
 
-				::WaitForSingleObjectEx(checked_cast<MusicVoiceContext*>(voice_call_back_.get())->GetBufferEndEvent(),
-					INFINITE, FALSE);
+				source_voice_->SubmitSourceBuffer(&buf);
+				++ state.BuffersQueued;
 			}
-
-			if (this->FillData(buffer_size_))
+			else
 			{
-				if (loop_)
-				{
-					stopped_ = false;
-					this->DoReset();
-				}
-				else
-				{
-					stopped_ = true;
-
-					HRESULT hr = source_voice_->Stop();
-					if (SUCCEEDED(hr))
-					{
-						source_voice_->FlushSourceBuffers();
-					}
-				}
+				source_voice_->Discontinuity();
 			}
 		}
 	}
 
+	uint32_t XAMusicBuffer::DoServiceStream()
+	{
+		this->SubmitChunks();
+
+		// OnBufferEnd wakes the service up
+		return AudioStreamService::WAIT_INFINITE;
+	}
+
 	void XAMusicBuffer::DoReset()
 	{
-		data_source_->Reset();
 	}
 
 	void XAMusicBuffer::DoPlay(bool loop)
 	{
+		KFL_UNUSED(loop);
+
 		auto const & ae = *checked_cast<XAAudioEngine const *>(&Context::Instance().AudioFactoryInstance().AudioEngineInstance());
 
 		ae.X3DAudioCalculate(&emitter_, X3DAUDIO_CALCULATE_MATRIX | X3DAUDIO_CALCULATE_DOPPLER, &dsp_settings_);
@@ -189,55 +191,32 @@ namespace KlayGE
 		source_voice_->SetOutputMatrix(ae.MasteringVoice(), 1, ae.MasteringVoiceChannels(), dsp_settings_.pMatrixCoefficients);
 		source_voice_->SetFrequencyRatio(dsp_settings_.DopplerFactor);
 
-		curr_buffer_index_ = 0;
-		loop_ = loop;
-
-		play_thread_ = Context::Instance().ThreadPool()([this] { this->LoopUpdateBuffer(); });
-
-		stopped_ = false;
-		{
-			std::lock_guard<std::mutex> lock(play_mutex_);
-			played_ = true;
-		}
-		play_cond_.notify_one();
+		this->SubmitChunks();
 
 		source_voice_->Start(0, 0);
 	}
 
 	void XAMusicBuffer::DoStop()
 	{
-		if (!stopped_)
-		{
-			stopped_ = true;
-			::SetEvent(checked_cast<MusicVoiceContext*>(voice_call_back_.get())->GetBufferEndEvent());
-			play_thread_();
-		}
-
 		HRESULT hr = source_voice_->Stop();
 		if (SUCCEEDED(hr))
 		{
 			hr = source_voice_->FlushSourceBuffers();
 		}
-	}
-
-	bool XAMusicBuffer::FillData(uint32_t size)
-	{
-		bool ret = false;
 
-		size_t read_size = data_source_->Read(&audio_data_[curr_buffer_index_ * buffer_size_], size);
-		XAUDIO2_BUFFER buf{};
-		buf.AudioBytes = static_cast<uint32_t>(read_size);
-		buf.pAudioData = &audio_data_[curr_buffer_index_ * buffer_size_];
-		if (curr_buffer_index_ * buffer_size_ + read_size >= data_source_->Size())
+		// The ring is rewound after stopping, wait until the voice has dropped all its references into it
+		HANDLE const buffer_end_event = checked_cast<MusicVoiceContext*>(voice_call_back_.get())->GetBufferEndEvent();
+		for (;;)
 		{
-			buf.Flags = XAUDIO2_END_OF_STREAM;
-			ret = true;
-		}
-
-		source_voice_->SubmitSourceBuffer(&buf);
-		curr_buffer_index_ = (curr_buffer_index_ + 1) % buffer_count_;
+			XAUDIO2_VOICE_STATE state;
+			source_voice_->GetState(&state);
+			if (0 == state.BuffersQueued)
+			{
+				break;
+			}
 
-		return ret;
+			::WaitForSingleObjectEx(buffer_end_event, 1000 / BUFFERS_PER_SECOND, FALSE);
+		}
 	}
 
 	bool XAMusicBuffer::IsPlaying() const
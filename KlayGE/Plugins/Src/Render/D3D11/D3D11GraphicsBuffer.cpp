@@ -292,18 +292,28 @@ namespace KlayGE
 
 	void D3D11GraphicsBuffer::UpdateSubresource(uint32_t offset, uint32_t size, void const * data)
 	{
-		D3D11_BOX* p = nullptr;
 		D3D11_BOX box;
+		box.left = offset;
+		box.top = 0;
+		box.front = 0;
+		box.right = offset + size;
+		box.bottom = 1;
+		box.back = 1;
 		if (!(bind_flags_ & D3D11_BIND_CONSTANT_BUFFER))
 		{
-			p = &box;
-			box.left = offset;
-			box.top = 0;
-			box.front = 0;
-			box.right = offset + size;
-			box.bottom = 1;
-			box.back = 1;
+			d3d_imm_ctx_->UpdateSubresource(buffer_.get(), 0, &box, data, size, size);
+		}
+		else if ((0 == offset) && (size == size_in_byte_))
+		{
+			d3d_imm_ctx_->UpdateSubresource(buffer_.get(), 0, nullptr, data, size, size);
+		}
+		else
+		{
+			// Only when partial_cbuffer_update_support is on. The range has to be aligned to 16 bytes.
+			D3D11RenderEngine const & re = *checked_cast<D3D11RenderEngine const *>(&Context::Instance().RenderFactoryInstance().RenderEngineInstance());
+			BOOST_ASSERT(re.DeviceCaps().partial_cbuffer_update_support);
+			BOOST_ASSERT((0 == (offset & 15)) && (0 == (size & 15)));
+			re.D3DDeviceImmContext1()->UpdateSubresource1(buffer_.get(), 0, &box, data, size, size, 0);
 		}
-		d3d_imm_ctx_->UpdateSubresource(buffer_.get(), 0, p, data, size, size);
 	}
 }
@@ -1059,6 +1059,16 @@ namespace KlayGE
 		caps_.independent_blend_support = true;
 		caps_.draw_indirect_support = true;
 		caps_.no_overwrite_support = true;
+		if (d3d_imm_ctx_1_)
+		{
+			D3D11_FEATURE_DATA_D3D11_OPTIONS d3d11_feature;
+			d3d_device_->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &d3d11_feature, sizeof(d3d11_feature));
+			caps_.partial_cbuffer_update_support = d3d11_feature.ConstantBufferPartialUpdate ? true : false;
+		}
+		else
+		{
+			caps_.partial_cbuffer_update_support = false;
+		}
 		if (d3d_11_runtime_sub_ver_ >= 1)
 		{
 			D3D11_FEATURE_DATA_D3D9_OPTIONS d3d11_feature;
@@ -1277,6 +1277,8 @@ namespace KlayGE
 		caps_.independent_blend_support = true;
 		caps_.draw_indirect_support = true;
 		caps_.no_overwrite_support = true;
+		// UpdateSubresource of cbuffers in upload heaps renames the whole buffer
+		caps_.partial_cbuffer_update_support = false;
 		caps_.full_npot_texture_support = true;
 		caps_.render_to_texture_array_support = true;
 		caps_.render_to_msaa_texture_support = true;
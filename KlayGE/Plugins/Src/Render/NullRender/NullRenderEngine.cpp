@@ -37,7 +37,9 @@
 namespace KlayGE
 {
 	NullRenderEngine::NullRenderEngine()
+		: inline_shader_blocks_(false)
 	{
+		this->FillRenderDeviceCaps();
 	}
 
 	NullRenderEngine::~NullRenderEngine()
@@ -90,6 +92,10 @@ namespace KlayGE
 		{
 			*static_cast<bool*>(value) = frag_depth_support_;
 		}
+		else if (CT_HASH("INLINE_SHADER_BLOCKS") == name_hash)
+		{
+			*static_cast<bool*>(value) = inline_shader_blocks_;
+		}
 	}
 
 	void NullRenderEngine::SetCustomAttrib(std::string_view name, void* value)
@@ -165,11 +171,16 @@ namespace KlayGE
 		else if (CT_HASH("DEVICE_CAPS") == name_hash)
 		{
 			caps_ = *static_cast<RenderDeviceCaps*>(value);
+			this->FillRenderDeviceCaps();
 		}
 		else if (CT_HASH("FRAG_DEPTH_SUPPORT") == name_hash)
 		{
 			frag_depth_support_ = *static_cast<bool*>(value);
 		}
+		else if (CT_HASH("INLINE_SHADER_BLOCKS") == name_hash)
+		{
+			inline_shader_blocks_ = *static_cast<bool*>(value);
+		}
 	}
 
 	void NullRenderEngine::DoBindFrameBuffer(FrameBufferPtr const & fb)
@@ -294,5 +305,8 @@ namespace KlayGE
 			{
 				return this->UAVFormatSupport(elem_fmt);
 			};
+
+		// Nothing is uploaded, but the cbuffer counters show what a partial update saves
+		caps_.partial_cbuffer_update_support = true;
 	}
 }
@@ -199,6 +199,12 @@ namespace KlayGE
 		}
 	}
 
+	bool NullShaderObject::ConcurrentAttachSupport() const
+	{
+		// Only compiles and translates, no device is involved
+		return true;
+	}
+
 	ShaderObjectPtr NullShaderObject::Clone(RenderEffect const & effect)
 	{
 		KFL_UNUSED(effect);
@@ -24,6 +24,7 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Util.hpp>
+#include <KFL/Hash.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/Vector.hpp>
 #include <KFL/Matrix.hpp>
@@ -35,6 +36,8 @@
 #include <KlayGE/DeferredRenderingLayer.hpp>
 
 #include <algorithm>
+#include <iterator>
+#include <limits>
 #include <boost/assert.hpp>
 
 #ifdef KLAYGE_DRAW_NODES
@@ -95,10 +98,32 @@ namespace
 }
 #endif
 
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+	uint32_t const OUTER_NODE = 0;
+	uint32_t const ROOT_NODE = 1;
+
+	// The loose bound of a node is twice as large as the cell it owns
+	float const LOOSE_FACTOR = 2;
+
+	// Rebuild if too many objects moved out of the root
+	uint32_t const MIN_OUTER_OBJS_TO_REBUILD = 64;
+
+	bool Contains(AABBox const & outer, AABBox const & inner)
+	{
+		return (inner.Min().x() >= outer.Min().x()) && (inner.Min().y() >= outer.Min().y()) && (inner.Min().z() >= outer.Min().z())
+			&& (inner.Max().x() <= outer.Max().x()) && (inner.Max().y() <= outer.Max().y()) && (inner.Max().z() <= outer.Max().z());
+	}
+}
+
 namespace KlayGE
 {
 	OCTree::OCTree()
-		: max_tree_depth_(4), rebuild_tree_(false)
+		: max_tree_depth_(4), rebuild_tree_(false),
+			loose_(false), rebuild_loose_tree_(true)
 	{
 	}
 
@@ -112,8 +137,71 @@ namespace KlayGE
 		return max_tree_depth_;
 	}
 
+	void OCTree::LooseMode(bool loose)
+	{
+		if (loose_ != loose)
+		{
+			loose_ = loose;
+
+			octree_.clear();
+			rebuild_tree_ = true;
+
+			this->ClearLooseTree();
+
+			if (loose_)
+			{
+				for (auto const & obj : scene_objs_)
+				{
+					if (obj->Attrib() & SceneObject::SOA_Cullable)
+					{
+						this->AddLooseObj(obj.get());
+					}
+				}
+			}
+		}
+	}
+
+	bool OCTree::LooseMode() const
+	{
+		return loose_;
+	}
+
+	void OCTree::GetCustomAttrib(std::string_view name, void* value) const
+	{
+		size_t const name_hash = HashRange(name.begin(), name.end());
+		if (CT_HASH("MAX_TREE_DEPTH") == name_hash)
+		{
+			*static_cast<uint32_t*>(value) = this->MaxTreeDepth();
+		}
+		else if (CT_HASH("LOOSE_MODE") == name_hash)
+		{
+			*static_cast<bool*>(value) = this->LooseMode();
+		}
+	}
+
+	void OCTree::SetCustomAttrib(std::string_view name, void* value)
+	{
+		size_t const name_hash = HashRange(name.begin(), name.end());
+		if (CT_HASH("MAX_TREE_DEPTH") == name_hash)
+		{
+			this->MaxTreeDepth(*static_cast<uint32_t*>(value));
+		}
+		else if (CT_HASH("LOOSE_MODE") == name_hash)
+		{
+			this->LooseMode(*static_cast<bool*>(value));
+		}
+	}
+
 	void OCTree::ClipScene()
 	{
+		if (loose_)
+		{
+			this->ClipSceneLoose();
+			return;
+		}
+
+		this->UpdateTransforms();
+
 		if (rebuild_tree_)
 		{
 			octree_.resize(1);
@@ -175,11 +263,6 @@ namespace KlayGE
 				if (obj->Visible())
 				{
 					uint32_t const attr = obj->Attrib();
-					if (attr & SceneObject::SOA_Moveable)
-					{
-						obj->UpdateAbsModelMatrix();
-					}
-
 					if (attr & SceneObject::SOA_Cullable)
 					{
 						BoundOverlap bo;
@@ -205,24 +288,27 @@ namespace KlayGE
 		}
 		else
 		{
+			// Marked again by the tree if its node is visible
+			for (auto const & obj : scene_objs_)
+			{
+				obj->VisibleMark(BO_No);
+			}
+
 			if (!octree_.empty())
 			{
 				this->MarkNodeObjs(0, false);
 			}
 
+			// Children, moveable and non-cullable objects follow their parents, in the order of scene_objs_
 			for (auto const & obj : scene_objs_)
 			{
-				if (obj->Visible())
+				uint32_t const attr = obj->Attrib();
+				if (obj->Visible()
+					&& (obj->Parent() || !(attr & SceneObject::SOA_Cullable) || (attr & SceneObject::SOA_Moveable)))
 				{
 					BoundOverlap visible = this->VisibleTestFromParent(obj.get(), camera.ForwardVec(), camera.EyePos(), view_proj);
 					if (BO_Partial == visible)
 					{
-						uint32_t const attr = obj->Attrib();
-						if (attr & SceneObject::SOA_Moveable)
-						{
-							obj->UpdateAbsModelMatrix();
-						}
-
 						if (attr & SceneObject::SOA_Cullable)
 						{
 							if (attr & SceneObject::SOA_Moveable)
@@ -231,7 +317,7 @@ namespace KlayGE
 							}
 							else
 							{
-								obj->VisibleMark(visible);
+								obj->VisibleMark(frustum_->Intersect(obj->PosBoundWS()));
 							}
 						}
 						else
@@ -254,6 +340,9 @@ namespace KlayGE
 
 	void OCTree::ClearObject()
 	{
+		// Before the objects are released
+		this->ClearLooseTree();
+
 		SceneManager::ClearObject();
 
 		octree_.clear();
@@ -263,7 +352,14 @@ namespace KlayGE
 	void OCTree::OnAddSceneObject(SceneObjectPtr const & obj)
 	{
 		uint32_t const attr = obj->Attrib();
-		if ((attr & SceneObject::SOA_Cullable)
+		if (loose_)
+		{
+			if (attr & SceneObject::SOA_Cullable)
+			{
+				this->AddLooseObj(obj.get());
+			}
+		}
+		else if ((attr & SceneObject::SOA_Cullable)
 			&& !(attr & SceneObject::SOA_Moveable))
 		{
 			rebuild_tree_ = true;
@@ -275,7 +371,14 @@ namespace KlayGE
 		BOOST_ASSERT(iter != scene_objs_.end());
 
 		uint32_t const attr = (*iter)->Attrib();
-		if ((attr & SceneObject::SOA_Cullable)
+		if (loose_)
+		{
+			if (attr & SceneObject::SOA_Cullable)
+			{
+				this->DelLooseObj(iter->get());
+			}
+		}
+		else if ((attr & SceneObject::SOA_Cullable)
 			&& !(attr & SceneObject::SOA_Moveable))
 		{
 			rebuild_tree_ = true;
@@ -418,22 +521,20 @@ namespace KlayGE
 		{
 			for (auto so : node.obj_ptrs)
 			{
-				if ((BO_No == so->VisibleMark()) && so->Visible())
+				// Children are marked after their parents by ClipScene
+				if ((BO_No == so->VisibleMark()) && so->Visible() && !so->Parent())
 				{
-					BoundOverlap visible = this->VisibleTestFromParent(so, camera.ForwardVec(), camera.EyePos(), view_proj);
-					if (BO_Partial == visible)
+					BoundOverlap visible;
+					AABBox const & aabb_ws = so->PosBoundWS();
+					if ((small_obj_threshold_ <= 0)
+						|| ((MathLib::ortho_area(camera.ForwardVec(), aabb_ws) > small_obj_threshold_)
+							&& (MathLib::perspective_area(camera.EyePos(), view_proj, aabb_ws) > small_obj_threshold_)))
 					{
-						AABBox const & aabb_ws = so->PosBoundWS();
-						if (so->Parent() || (small_obj_threshold_ <= 0)
-							|| ((MathLib::ortho_area(camera.ForwardVec(), node.bb) > small_obj_threshold_)
-								&& (MathLib::perspective_area(camera.EyePos(), view_proj, aabb_ws) > small_obj_threshold_)))
-						{
-							visible = frustum_->Intersect(aabb_ws);
-						}
-						else
-						{
-							visible = BO_No;
-						}
+						visible = frustum_->Intersect(aabb_ws);
+					}
+					else
+					{
+						visible = BO_No;
 					}
 					so->VisibleMark(visible);
 				}
@@ -714,4 +815,430 @@ namespace KlayGE
 			return BO_No;
 		}
 	}
+
+	void OCTree::ClipSceneLoose()
+	{
+		App3DFramework& app = Context::Instance().AppInstance();
+		Camera& camera = app.ActiveCamera();
+
+		if (camera.OmniDirectionalMode())
+		{
+			// Nothing is culled by the frustum in this mode
+			SceneManager::ClipScene();
+			return;
+		}
+
+		this->UpdateTransforms();
+
+		float4x4 view_proj = camera.ViewProjMatrix();
+		auto drl = Context::Instance().DeferredRenderingLayerInstance();
+		if (drl)
+		{
+			int32_t cas_index = drl->CurrCascadeIndex();
+			if (cas_index >= 0)
+			{
+				view_proj *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
+			}
+		}
+
+		if (rebuild_loose_tree_)
+		{
+			this->BuildLooseTree();
+		}
+
+		for (auto const & obj : scene_objs_)
+		{
+			SceneObject* so = obj.get();
+			uint32_t const attr = so->Attrib();
+			if (so->Visible())
+			{
+				if ((attr & SceneObject::SOA_Moveable) && (attr & SceneObject::SOA_Cullable))
+				{
+					uint32_t const handle = this->LooseObjHandle(so);
+					if (handle != INVALID_INDEX)
+					{
+						this->RelocateLooseObj(handle);
+					}
+				}
+			}
+
+			// Marked again by the tree if its node is visible
+			so->VisibleMark(BO_No);
+		}
+
+		uint32_t const num_outer_objs = loose_nodes_[OUTER_NODE].num_subtree_objs;
+		size_t const num_loose_objs = loose_objs_.size() - free_loose_objs_.size();
+		if ((num_outer_objs > MIN_OUTER_OBJS_TO_REBUILD) && (num_outer_objs * 4 > num_loose_objs))
+		{
+			this->BuildLooseTree();
+		}
+
+		float3 const & view_dir = camera.ForwardVec();
+		float3 const & eye_pos = camera.EyePos();
+
+		this->LooseNodeVisible(OUTER_NODE, BO_Partial, view_dir, eye_pos, view_proj);
+		this->LooseNodeVisible(ROOT_NODE, BO_Partial, view_dir, eye_pos, view_proj);
+
+		// Children and non-cullable objects follow their parents, in the order of scene_objs_
+		for (auto const & obj : scene_objs_)
+		{
+			SceneObject* so = obj.get();
+			uint32_t const attr = so->Attrib();
+			if (so->Visible() && (so->Parent() || !(attr & SceneObject::SOA_Cullable)))
+			{
+				BoundOverlap visible = this->VisibleTestFromParent(so, view_dir, eye_pos, view_proj);
+				if (BO_Partial == visible)
+				{
+					if (attr & SceneObject::SOA_Cullable)
+					{
+						AABBox const & aabb_ws = so->PosBoundWS();
+						if ((small_obj_threshold_ <= 0)
+							|| ((MathLib::ortho_area(view_dir, aabb_ws) > small_obj_threshold_)
+								&& (MathLib::perspective_area(eye_pos, view_proj, aabb_ws) > small_obj_threshold_)))
+						{
+							visible = frustum_->Intersect(aabb_ws);
+						}
+						else
+						{
+							visible = BO_No;
+						}
+					}
+					else
+					{
+						visible = BO_Yes;
+					}
+				}
+				so->VisibleMark(visible);
+			}
+		}
+	}
+
+	void OCTree::ClearLooseTree()
+	{
+		// The objects may be added to the tree again later
+		for (auto const & obj : loose_objs_)
+		{
+			if (obj.so)
+			{
+				obj.so->SpatialHandle(INVALID_INDEX);
+			}
+		}
+
+		loose_nodes_.clear();
+		loose_objs_.clear();
+		free_loose_objs_.clear();
+		rebuild_loose_tree_ = true;
+	}
+
+	void OCTree::BuildLooseTree()
+	{
+		AABBox bb_root(float3(0, 0, 0), float3(0, 0, 0));
+		for (auto const & obj : loose_objs_)
+		{
+			if (obj.so)
+			{
+				bb_root |= obj.so->PosBoundWS();
+			}
+		}
+		float3 const & center = bb_root.Center();
+		float3 const & extent = bb_root.HalfSize();
+		// Leaves some room for moving objects before they fall out of the root
+		float const longest_dim = std::max(std::max(extent.x(), extent.y()), extent.z()) * 1.25f * LOOSE_FACTOR;
+		float3 const new_extent(longest_dim, longest_dim, longest_dim);
+
+		loose_nodes_.resize(2);
+		for (auto& node : loose_nodes_)
+		{
+			node.parent = INVALID_INDEX;
+			std::fill(std::begin(node.children), std::end(node.children), INVALID_INDEX);
+			node.first_obj = INVALID_INDEX;
+			node.num_subtree_objs = 0;
+			node.visible = BO_No;
+		}
+		loose_nodes_[OUTER_NODE].bb = AABBox(float3(0, 0, 0), float3(0, 0, 0));
+		loose_nodes_[ROOT_NODE].bb = AABBox(center - new_extent, center + new_extent);
+
+		rebuild_loose_tree_ = false;
+
+		for (uint32_t i = 0; i < loose_objs_.size(); ++ i)
+		{
+			if (loose_objs_[i].so)
+			{
+				this->LinkLooseObj(i, this->LooseNodeIndex(loose_objs_[i].so->PosBoundWS()));
+			}
+		}
+	}
+
+	uint32_t OCTree::LooseNodeIndex(AABBox const & aabb)
+	{
+		float3 const center = aabb.Center();
+		float3 const half_size = aabb.HalfSize();
+		float const extent = std::max(std::max(half_size.x(), half_size.y()), half_size.z());
+
+		// An object belongs to the deepest cell that holds its center, and whose size is not smaller than the object.
+		//  So it's always inside the loose bound of the node.
+		float3 const root_center = loose_nodes_[ROOT_NODE].bb.Center();
+		float const root_half_size = loose_nodes_[ROOT_NODE].bb.HalfSize().x() / LOOSE_FACTOR;
+		if ((extent > root_half_size)
+			|| (MathLib::abs(center.x() - root_center.x()) > root_half_size)
+			|| (MathLib::abs(center.y() - root_center.y()) > root_half_size)
+			|| (MathLib::abs(center.z() - root_center.z()) > root_half_size))
+		{
+			return OUTER_NODE;
+		}
+
+		// The level comes from the size alone, the cell from the center quantized on that level's grid
+		uint32_t depth = 0;
+		for (float node_half_size = root_half_size; (depth < max_tree_depth_) && (extent <= node_half_size / 2);
+			node_half_size /= 2)
+		{
+			++ depth;
+		}
+
+		uint32_t const num_cells = 1UL << depth;
+		float const scale = num_cells / (root_half_size * 2);
+		float3 const cell = (center - root_center + float3(root_half_size, root_half_size, root_half_size)) * scale;
+		uint32_t const x = std::min(static_cast<uint32_t>(std::max(cell.x(), 0.0f)), num_cells - 1);
+		uint32_t const y = std::min(static_cast<uint32_t>(std::max(cell.y(), 0.0f)), num_cells - 1);
+		uint32_t const z = std::min(static_cast<uint32_t>(std::max(cell.z(), 0.0f)), num_cells - 1);
+
+		// The bits of the cell, from the top, are the octants on the way down. Missing nodes are created on the way.
+		uint32_t node = ROOT_NODE;
+		for (uint32_t level = depth; level > 0; -- level)
+		{
+			uint32_t const shift = level - 1;
+			uint32_t const octant = ((x >> shift) & 1) | (((y >> shift) & 1) << 1) | (((z >> shift) & 1) << 2);
+			node = this->LooseChildNode(node, octant);
+		}
+		return node;
+	}
+
+	uint32_t OCTree::LooseChildNode(uint32_t parent, uint32_t octant)
+	{
+		uint32_t const child = loose_nodes_[parent].children[octant];
+		if (child != INVALID_INDEX)
+		{
+			return child;
+		}
+
+		AABBox const & parent_bb = loose_nodes_[parent].bb;
+		float3 const parent_center = parent_bb.Center();
+		float const half_size = parent_bb.HalfSize().x() / LOOSE_FACTOR / 2;
+		float3 const center(parent_center.x() + ((octant & 1) ? half_size : -half_size),
+			parent_center.y() + ((octant & 2) ? half_size : -half_size),
+			parent_center.z() + ((octant & 4) ? half_size : -half_size));
+		float const loose_half_size = half_size * LOOSE_FACTOR;
+		float3 const loose_extent(loose_half_size, loose_half_size, loose_half_size);
+
+		loose_node_t node;
+		node.bb = AABBox(center - loose_extent, center + loose_extent);
+		node.parent = parent;
+		std::fill(std::begin(node.children), std::end(node.children), INVALID_INDEX);
+		node.first_obj = INVALID_INDEX;
+		node.num_subtree_objs = 0;
+		node.visible = BO_No;
+
+		uint32_t const index = static_cast<uint32_t>(loose_nodes_.size());
+		loose_nodes_.push_back(node);
+		loose_nodes_[parent].children[octant] = index;
+		return index;
+	}
+
+	uint32_t OCTree::LooseObjHandle(SceneObject* so) const
+	{
+		uint32_t const handle = so->SpatialHandle();
+		if ((handle < loose_objs_.size()) && (loose_objs_[handle].so == so))
+		{
+			return handle;
+		}
+		else
+		{
+			return INVALID_INDEX;
+		}
+	}
+
+	void OCTree::LinkLooseObj(uint32_t handle, uint32_t node)
+	{
+		loose_obj_t& obj = loose_objs_[handle];
+		obj.node = node;
+		obj.prev = INVALID_INDEX;
+		obj.next = loose_nodes_[node].first_obj;
+		if (obj.next != INVALID_INDEX)
+		{
+			loose_objs_[obj.next].prev = handle;
+		}
+		loose_nodes_[node].first_obj = handle;
+
+		for (uint32_t i = node; i != INVALID_INDEX; i = loose_nodes_[i].parent)
+		{
+			++ loose_nodes_[i].num_subtree_objs;
+		}
+	}
+
+	void OCTree::UnlinkLooseObj(uint32_t handle)
+	{
+		loose_obj_t& obj = loose_objs_[handle];
+		BOOST_ASSERT(obj.node != INVALID_INDEX);
+
+		if (obj.prev != INVALID_INDEX)
+		{
+			loose_objs_[obj.prev].next = obj.next;
+		}
+		else
+		{
+			loose_nodes_[obj.node].first_obj = obj.next;
+		}
+		if (obj.next != INVALID_INDEX)
+		{
+			loose_objs_[obj.next].prev = obj.prev;
+		}
+
+		for (uint32_t i = obj.node; i != INVALID_INDEX; i = loose_nodes_[i].parent)
+		{
+			-- loose_nodes_[i].num_subtree_objs;
+		}
+
+		obj.node = INVALID_INDEX;
+		obj.prev = INVALID_INDEX;
+		obj.next = INVALID_INDEX;
+	}
+
+	void OCTree::AddLooseObj(SceneObject* so)
+	{
+		uint32_t const existing = this->LooseObjHandle(so);
+		if (existing != INVALID_INDEX)
+		{
+			this->RelocateLooseObj(existing);
+			return;
+		}
+
+		uint32_t handle;
+		if (free_loose_objs_.empty())
+		{
+			handle = static_cast<uint32_t>(loose_objs_.size());
+			loose_objs_.emplace_back();
+		}
+		else
+		{
+			handle = free_loose_objs_.back();
+			free_loose_objs_.pop_back();
+		}
+
+		loose_obj_t& obj = loose_objs_[handle];
+		obj.so = so;
+		obj.node = INVALID_INDEX;
+		obj.prev = INVALID_INDEX;
+		obj.next = INVALID_INDEX;
+		so->SpatialHandle(handle);
+
+		if (!rebuild_loose_tree_)
+		{
+			this->LinkLooseObj(handle, this->LooseNodeIndex(so->PosBoundWS()));
+		}
+	}
+
+	void OCTree::DelLooseObj(SceneObject* so)
+	{
+		uint32_t const handle = this->LooseObjHandle(so);
+		if (handle != INVALID_INDEX)
+		{
+			if (loose_objs_[handle].node != INVALID_INDEX)
+			{
+				this->UnlinkLooseObj(handle);
+			}
+			loose_objs_[handle].so = nullptr;
+			free_loose_objs_.push_back(handle);
+			so->SpatialHandle(INVALID_INDEX);
+		}
+	}
+
+	void OCTree::RelocateLooseObj(uint32_t handle)
+	{
+		uint32_t const curr_node = loose_objs_[handle].node;
+		if (curr_node != INVALID_INDEX)
+		{
+			AABBox const & aabb = loose_objs_[handle].so->PosBoundWS();
+			if ((OUTER_NODE == curr_node) || !Contains(loose_nodes_[curr_node].bb, aabb))
+			{
+				uint32_t const new_node = this->LooseNodeIndex(aabb);
+				if (new_node != curr_node)
+				{
+					this->UnlinkLooseObj(handle);
+					this->LinkLooseObj(handle, new_node);
+				}
+			}
+		}
+	}
+
+	void OCTree::LooseNodeVisible(uint32_t index, BoundOverlap parent_visible, float3 const & view_dir, float3 const & eye_pos,
+		float4x4 const & view_proj)
+	{
+		BOOST_ASSERT(index < loose_nodes_.size());
+
+		loose_node_t& node = loose_nodes_[index];
+		if (0 == node.num_subtree_objs)
+		{
+			node.visible = BO_No;
+			return;
+		}
+
+		// Everything in a node is inside its loose bound, if the node is small, so are the objects
+		BoundOverlap vis;
+		if (OUTER_NODE == index)
+		{
+			vis = BO_Partial;
+		}
+		else if ((small_obj_threshold_ > 0)
+			&& ((MathLib::ortho_area(view_dir, node.bb) <= small_obj_threshold_)
+				|| (MathLib::perspective_area(eye_pos, view_proj, node.bb) <= small_obj_threshold_)))
+		{
+			vis = BO_No;
+		}
+		else if (BO_Yes == parent_visible)
+		{
+			vis = BO_Yes;
+		}
+		else
+		{
+			vis = frustum_->Intersect(node.bb);
+		}
+		node.visible = vis;
+
+		if (vis != BO_No)
+		{
+			for (uint32_t i = node.first_obj; i != INVALID_INDEX; i = loose_objs_[i].next)
+			{
+				SceneObject* so = loose_objs_[i].so;
+				if (so->Visible() && !so->Parent())
+				{
+					AABBox const & aabb_ws = so->PosBoundWS();
+					BoundOverlap obj_vis;
+					if ((small_obj_threshold_ > 0)
+						&& ((MathLib::ortho_area(view_dir, aabb_ws) <= small_obj_threshold_)
+							|| (MathLib::perspective_area(eye_pos, view_proj, aabb_ws) <= small_obj_threshold_)))
+					{
+						obj_vis = BO_No;
+					}
+					else if (BO_Yes == vis)
+					{
+						obj_vis = BO_Yes;
+					}
+					else
+					{
+						obj_vis = frustum_->Intersect(aabb_ws);
+					}
+					so->VisibleMark(obj_vis);
+				}
+			}
+
+			for (uint32_t j = 0; j < 8; ++ j)
+			{
+				uint32_t const child = node.children[j];
+				if (child != INVALID_INDEX)
+				{
+					this->LooseNodeVisible(child, vis, view_dir, eye_pos, view_proj);
+				}
+			}
+		}
+	}
 }
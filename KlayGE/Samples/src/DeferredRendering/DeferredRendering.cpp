@@ -458,6 +458,11 @@ void DeferredRenderingApp::DoUpdateOverlay()
 	stream << scene_mgr.NumDrawCalls() << " Draws/frame "
 		<< scene_mgr.NumDispatchCalls() << " Dispatches/frame";
 	font_->RenderText(0, 90, Color(1, 1, 1, 1), stream.str(), 16);
+
+	stream.str(L"");
+	stream << scene_mgr.NumTechniqueChanges() << " Technique changes/frame "
+		<< scene_mgr.NumMaterialChanges() << " Material changes/frame";
+	font_->RenderText(0, 108, Color(1, 1, 1, 1), stream.str(), 16);
 }
 
 uint32_t DeferredRenderingApp::DoUpdate(uint32_t pass)
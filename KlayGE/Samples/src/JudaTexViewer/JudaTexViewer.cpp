@@ -470,6 +470,17 @@ void JudaTexViewer::DoUpdateOverlay()
 	font_->RenderText(0, 0, Color(1, 1, 0, 1), L"Juda Texture Viewer", 16);
 	font_->RenderText(0, 18, Color(1, 1, 0, 1), stream.str(), 16);
 
+	JudaTexture::CacheStatistics const stats = juda_tex_->CacheStats();
+	stream.str(L"");
+	stream << "Tiles: " << stats.num_cached_tiles << " cached, " << stats.num_pending_tiles << " pending, "
+		<< stats.num_hits << " hits, " << stats.num_misses << " misses, " << stats.num_evictions << " evictions";
+	font_->RenderText(0, 36, Color(1, 1, 0, 1), stream.str(), 16);
+	stream.str(L"");
+	stream << "Blocks: " << stats.num_decoded_blocks << " decoded, " << stats.num_block_hits << " hits, "
+		<< stats.num_block_misses << " misses. Latency: " << stats.avg_latency * 1000 << " ms avg, "
+		<< stats.max_latency * 1000 << " ms max";
+	font_->RenderText(0, 54, Color(1, 1, 0, 1), stream.str(), 16);
+
 	if (tile_size_ * scale_ > 64)
 	{
 		for (uint32_t y = sy_; y < ey_; ++ y)
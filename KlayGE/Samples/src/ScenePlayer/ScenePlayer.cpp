@@ -750,6 +750,9 @@ void ScenePlayerApp::LoadScene(std::string const & name)
 
 void ScenePlayerApp::OnCreate()
 {
+	// The update scripts share one Python interpreter
+	Context::Instance().SceneManagerInstance().ParallelSubThreadUpdate(false);
+
 	this->LoadScene("DeferredRendering.kges");
 
 	font_ = SyncLoadFont("gkai00mp.kfont");
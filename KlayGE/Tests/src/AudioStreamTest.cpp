@@ -0,0 +1,166 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/Audio.hpp>
+#include <KlayGE/AudioDataSource.hpp>
+#include <KlayGE/AudioFactory.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const MIX_FREQ = 44100;
+
+	// Mono 16-bit at the mix rate, so the null mixer passes the samples through. Sample i is a ramp that never hits 0.
+	class RampSource : public AudioDataSource
+	{
+	public:
+		explicit RampSource(uint32_t num_samples)
+			: num_samples_(num_samples), pos_(0)
+		{
+			format_ = AF_Mono16;
+			freq_ = MIX_FREQ;
+		}
+
+		static int16_t Sample(uint32_t index)
+		{
+			return static_cast<int16_t>(index % 30000 + 1);
+		}
+
+		void Open(ResIdentifierPtr const & file) override
+		{
+			KFL_UNUSED(file);
+		}
+		void Close() override
+		{
+		}
+
+		size_t Size() override
+		{
+			return num_samples_ * sizeof(int16_t);
+		}
+
+		size_t Read(void* data, size_t size) override
+		{
+			int16_t* samples = static_cast<int16_t*>(data);
+			uint32_t const n = std::min(static_cast<uint32_t>(size / sizeof(int16_t)), num_samples_ - pos_);
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				samples[i] = Sample(pos_ + i);
+			}
+			pos_ += n;
+			return n * sizeof(int16_t);
+		}
+
+		void Reset() override
+		{
+			pos_ = 0;
+		}
+
+	private:
+		uint32_t num_samples_;
+		uint32_t pos_;
+	};
+
+	// A fresh null engine for each test, the mixer needs a software backend
+	AudioEngine& ResetNullAudio()
+	{
+		Context::Instance().LoadAudioFactory("NullAudio");
+		return Context::Instance().AudioFactoryInstance().AudioEngineInstance();
+	}
+}
+
+TEST(AudioStreamTest, NullMixerMatchesSource)
+{
+	AudioEngine& ae = ResetNullAudio();
+	AudioFactory& af = Context::Instance().AudioFactoryInstance();
+
+	// Shorter than the ring, everything is decoded by Play and the output is deterministic
+	uint32_t const num_samples = MIX_FREQ * 13 / 10;
+	auto music = af.MakeMusicBuffer(MakeSharedPtr<RampSource>(num_samples), 2);
+	music->Volume(1);
+	ae.AddBuffer(0, music);
+
+	music->Play();
+	EXPECT_EQ(ae.StreamService().NumStreams(), 1U);
+
+	uint32_t const BLOCK_FRAMES = 1024;
+	std::vector<float> block(BLOCK_FRAMES * 2);
+	std::vector<float> output;
+	while (music->IsPlaying())
+	{
+		ASSERT_EQ(ae.MixOutput(block.data(), BLOCK_FRAMES), BLOCK_FRAMES);
+		output.insert(output.end(), block.begin(), block.end());
+	}
+
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < num_samples; ++ i)
+	{
+		float const expected = RampSource::Sample(i) / 32768.0f;
+		if ((output[i * 2 + 0] != expected) || (output[i * 2 + 1] != expected))
+		{
+			++ mismatches;
+		}
+	}
+	EXPECT_EQ(mismatches, 0U);
+	EXPECT_TRUE(std::all_of(output.begin() + num_samples * 2, output.end(), [](float v) { return v == 0; }));
+
+	music->Stop();
+	EXPECT_EQ(ae.StreamService().NumStreams(), 0U);
+}
+
+TEST(AudioStreamTest, MixThroughput)
+{
+	AudioEngine& ae = ResetNullAudio();
+	AudioFactory& af = Context::Instance().AudioFactoryInstance();
+
+	uint32_t const NUM_STREAMS = 64;
+	for (uint32_t i = 0; i < NUM_STREAMS; ++ i)
+	{
+		auto music = af.MakeMusicBuffer(MakeSharedPtr<RampSource>(MIX_FREQ * 3 + i * 100), 2);
+		music->Volume(1.0f / NUM_STREAMS);
+		ae.AddBuffer(i, music);
+	}
+	ae.PlayAll(true);
+	EXPECT_EQ(ae.StreamService().NumStreams(), NUM_STREAMS);
+
+	uint64_t const start_passes = ae.StreamService().NumServicePasses();
+
+	uint32_t const BLOCK_FRAMES = 1024;
+	uint32_t const NUM_BLOCKS = MIX_FREQ * 30 / BLOCK_FRAMES;
+	std::vector<float> block(BLOCK_FRAMES * 2);
+	uint32_t num_silent_blocks = 0;
+
+	Timer timer;
+	for (uint32_t i = 0; i < NUM_BLOCKS; ++ i)
+	{
+		ae.MixOutput(block.data(), BLOCK_FRAMES);
+		if (block[0] == 0)
+		{
+			++ num_silent_blocks;
+		}
+	}
+	double const mix_time = timer.elapsed();
+
+	uint64_t const num_passes = ae.StreamService().NumServicePasses() - start_passes;
+
+	for (uint32_t i = 0; i < NUM_STREAMS; ++ i)
+	{
+		EXPECT_TRUE(ae.Buffer(i)->IsPlaying());
+	}
+
+	ae.StopAll();
+	EXPECT_EQ(ae.StreamService().NumStreams(), 0U);
+
+	LogInfo("Mixing %u looping streams: %f seconds of audio in %f ms, %f x realtime, %u silent blocks, %u service passes",
+		NUM_STREAMS, static_cast<double>(NUM_BLOCKS) * BLOCK_FRAMES / MIX_FREQ, mix_time * 1000,
+		static_cast<double>(NUM_BLOCKS) * BLOCK_FRAMES / MIX_FREQ / mix_time, num_silent_blocks,
+		static_cast<uint32_t>(num_passes));
+}
@@ -0,0 +1,128 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/RenderEffect.hpp>
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const CBUFF_SIZE = 4096;
+	uint32_t const NUM_DRAWS = 1000;
+	// A per-object matrix in the middle of a large cbuffer
+	uint32_t const MATRIX_OFFSET = 1024;
+
+	struct CBufferUpdateResult
+	{
+		bool partial;
+		bool ring_used;
+		uint32_t num_updates;
+		uint64_t uploaded;
+		uint64_t skipped;
+
+		uint64_t ExpectedUpload() const
+		{
+			return static_cast<uint64_t>(NUM_DRAWS) * (partial ? sizeof(float4x4) : CBUFF_SIZE);
+		}
+	};
+
+	CBufferUpdateResult UpdateCBuffer(bool ring)
+	{
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+
+		CBufferUpdateResult result;
+		result.partial = re.DeviceCaps().partial_cbuffer_update_support;
+
+		re.CBufferRingMode(ring);
+
+		RenderEffectConstantBuffer cbuff;
+		cbuff.Resize(CBUFF_SIZE);
+
+		std::vector<std::unique_ptr<RenderVariableConcrete<float4>>> vars(CBUFF_SIZE / sizeof(float4));
+		for (size_t i = 0; i < vars.size(); ++ i)
+		{
+			vars[i] = MakeUniquePtr<RenderVariableConcrete<float4>>();
+			vars[i]->BindToCBuffer(cbuff, static_cast<uint32_t>(i * sizeof(float4)), sizeof(float4));
+		}
+		cbuff.Update();
+
+		re.NumCBufferUpdatesJustCalled();
+		re.NumCBufferBytesJustUploaded();
+		re.NumCBufferBytesJustSkipped();
+
+		for (uint32_t draw = 0; draw < NUM_DRAWS; ++ draw)
+		{
+			for (uint32_t row = 0; row < 4; ++ row)
+			{
+				*vars[MATRIX_OFFSET / sizeof(float4) + row] = float4(static_cast<float>(draw), static_cast<float>(row), 0, 1);
+			}
+			cbuff.Update();
+		}
+
+		result.num_updates = re.NumCBufferUpdatesJustCalled();
+		result.uploaded = re.NumCBufferBytesJustUploaded();
+		result.skipped = re.NumCBufferBytesJustSkipped();
+
+		result.ring_used = re.CBufferRingMode();
+		re.CBufferRingMode(false);
+
+		LogInfo("%u updates of a %u-byte cbuffer%s: %llu bytes uploaded, %llu bytes skipped", result.num_updates, CBUFF_SIZE,
+			result.ring_used ? " from the ring" : "",
+			static_cast<unsigned long long>(result.uploaded), static_cast<unsigned long long>(result.skipped));
+
+		return result;
+	}
+
+	void TestCBufferUpdate(bool ring)
+	{
+		CBufferUpdateResult const result = UpdateCBuffer(ring);
+
+		EXPECT_EQ(result.num_updates, NUM_DRAWS);
+		EXPECT_EQ(result.uploaded + result.skipped, static_cast<uint64_t>(NUM_DRAWS) * CBUFF_SIZE);
+		EXPECT_EQ(result.uploaded, result.ExpectedUpload());
+	}
+
+	// Runs in a death test child, the render factory is swapped for NullRender there
+	int NullRenderCBufferUpdate()
+	{
+		Context::Instance().LoadRenderFactory("NullRender");
+		if (!Context::Instance().RenderFactoryValid())
+		{
+			return 1;
+		}
+
+		CBufferUpdateResult const result = UpdateCBuffer(false);
+		bool const pass = result.partial
+			&& (result.num_updates == NUM_DRAWS)
+			&& (result.uploaded == static_cast<uint64_t>(NUM_DRAWS) * sizeof(float4x4))
+			&& (result.skipped == static_cast<uint64_t>(NUM_DRAWS) * (CBUFF_SIZE - sizeof(float4x4)));
+		return pass ? 0 : 1;
+	}
+}
+
+TEST(CBufferUpdateTest, InPlace)
+{
+	TestCBufferUpdate(false);
+}
+
+TEST(CBufferUpdateTest, Ring)
+{
+	TestCBufferUpdate(true);
+}
+
+TEST(CBufferUpdateTest, NullRender)
+{
+	// NullRender can't create the test app's window, so it replaces the render factory in a child process only.
+	//  _Exit skips the teardown of the app that was created on the original factory.
+	EXPECT_EXIT(std::_Exit(NullRenderCBufferUpdate()), ::testing::ExitedWithCode(0), "");
+}
@@ -0,0 +1,363 @@
+#include <KlayGE/KlayGE.hpp>
+#include <DXBC2GLSL/DXBC2GLSL.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	struct SignatureElement
+	{
+		char const * semantic;
+		ShaderName system_value;
+		uint32_t reg;
+	};
+
+	uint32_t Insn(ShaderOpcode opcode, uint32_t length, uint32_t flags = 0)
+	{
+		return static_cast<uint32_t>(opcode) | flags | (length << 24);
+	}
+
+	// 4-component operand with a 1D immediate index
+	uint32_t Operand(ShaderOperandType type, ShaderOperandSelectionMode mode, uint32_t sel)
+	{
+		return SONC_4 | (mode << 2) | (sel << 4) | (type << 12) | (1UL << 20) | (SOIP_IMM32 << 22);
+	}
+
+	uint32_t const MASK_XYZW = 0xF;
+	uint32_t const SWIZZLE_XYZW = 0xE4;
+
+	uint32_t TempDst()
+	{
+		return Operand(SOT_TEMP, SOSM_MASK, MASK_XYZW);
+	}
+
+	uint32_t TempSrc()
+	{
+		return Operand(SOT_TEMP, SOSM_SWIZZLE, SWIZZLE_XYZW);
+	}
+
+	uint32_t InputSrc()
+	{
+		return Operand(SOT_INPUT, SOSM_SWIZZLE, SWIZZLE_XYZW);
+	}
+
+	// 4-component literal, followed by its values
+	uint32_t Immediate()
+	{
+		return SONC_4 | (SOT_IMMEDIATE32 << 12);
+	}
+
+	uint32_t FloatBits(float f)
+	{
+		uint32_t u;
+		std::memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+
+	void AppendChunk(std::vector<uint32_t>& chunks, std::vector<uint32_t>& offsets, uint32_t fourcc,
+		std::vector<uint32_t> const & data)
+	{
+		offsets.push_back(static_cast<uint32_t>(chunks.size() * sizeof(uint32_t)));
+		chunks.push_back(fourcc);
+		chunks.push_back(static_cast<uint32_t>(data.size() * sizeof(uint32_t)));
+		chunks.insert(chunks.end(), data.begin(), data.end());
+	}
+
+	std::vector<uint32_t> Signature(std::vector<SignatureElement> const & elements)
+	{
+		// Count, offset of the elements, 6 tokens per element, then the names
+		std::vector<uint32_t> sig = { static_cast<uint32_t>(elements.size()), 8 };
+		uint32_t name_offset = static_cast<uint32_t>((2 + elements.size() * 6) * sizeof(uint32_t));
+		std::string names;
+		for (auto const & elem : elements)
+		{
+			sig.insert(sig.end(), { name_offset + static_cast<uint32_t>(names.size()), 0,
+				static_cast<uint32_t>(elem.system_value), SRCT_FLOAT32, elem.reg, MASK_XYZW | (MASK_XYZW << 8) });
+			names += elem.semantic;
+			names += '\0';
+		}
+		names.resize((names.size() + 3) & ~3U, '\0');
+
+		size_t const base = sig.size();
+		sig.resize(base + names.size() / sizeof(uint32_t));
+		std::memcpy(&sig[base], names.data(), names.size());
+		return sig;
+	}
+
+	// A container with only the signatures and the shader chunk, which is all DXBC2GLSL needs
+	std::vector<uint32_t> Container(std::vector<SignatureElement> const & inputs, std::vector<SignatureElement> const & outputs,
+		std::vector<uint32_t> const & code)
+	{
+		std::vector<uint32_t> shader = { (ST_VS << 16) | (4 << 4), static_cast<uint32_t>(code.size() + 2) };
+		shader.insert(shader.end(), code.begin(), code.end());
+
+		std::vector<uint32_t> chunks;
+		std::vector<uint32_t> offsets;
+		AppendChunk(chunks, offsets, FOURCC_ISGN, Signature(inputs));
+		AppendChunk(chunks, offsets, FOURCC_OSGN, Signature(outputs));
+		AppendChunk(chunks, offsets, FOURCC_SHDR, shader);
+
+		uint32_t const header_size = static_cast<uint32_t>(sizeof(DXBCContainerHeader) + offsets.size() * sizeof(uint32_t));
+		std::vector<uint32_t> dxbc = { FOURCC_DXBC, 0, 0, 0, 0, 1,
+			static_cast<uint32_t>(header_size + chunks.size() * sizeof(uint32_t)), static_cast<uint32_t>(offsets.size()) };
+		for (auto offset : offsets)
+		{
+			dxbc.push_back(header_size + offset);
+		}
+		dxbc.insert(dxbc.end(), chunks.begin(), chunks.end());
+		return dxbc;
+	}
+
+	// mov o0, v0
+	std::vector<uint32_t> PassThroughVS()
+	{
+		return Container({ { "POSITION", SN_UNDEFINED, 0 } }, { { "SV_Position", SN_POSITION, 0 } },
+			{
+				Insn(SO_DCL_INPUT, 3), Operand(SOT_INPUT, SOSM_MASK, MASK_XYZW), 0,
+				Insn(SO_DCL_OUTPUT_SIV, 4), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 0, SN_POSITION,
+				Insn(SO_MOV, 5), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 0, Operand(SOT_INPUT, SOSM_SWIZZLE, SWIZZLE_XYZW), 0,
+				Insn(SO_RET, 1)
+			});
+	}
+
+	// mov o0, v0
+	// if_nz v1.x
+	//   mov o1, v1 (num_movs times)
+	//   ret
+	// endif
+	// mov o1, v0
+	// The end of the program is found through the matching endif, the ret inside the if isn't it
+	std::vector<uint32_t> EarlyReturnVS(uint32_t num_movs)
+	{
+		std::vector<uint32_t> code =
+		{
+			Insn(SO_DCL_INPUT, 3), Operand(SOT_INPUT, SOSM_MASK, MASK_XYZW), 0,
+			Insn(SO_DCL_INPUT, 3), Operand(SOT_INPUT, SOSM_MASK, MASK_XYZW), 1,
+			Insn(SO_DCL_OUTPUT_SIV, 4), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 0, SN_POSITION,
+			Insn(SO_DCL_OUTPUT, 3), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 1,
+			Insn(SO_MOV, 5), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 0, Operand(SOT_INPUT, SOSM_SWIZZLE, SWIZZLE_XYZW), 0,
+			Insn(SO_IF, 3, 1UL << 18), Operand(SOT_INPUT, SOSM_SCALAR, 0), 1
+		};
+		for (uint32_t i = 0; i < num_movs; ++ i)
+		{
+			code.insert(code.end(),
+				{ Insn(SO_MOV, 5), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 1, Operand(SOT_INPUT, SOSM_SWIZZLE, SWIZZLE_XYZW), 1 });
+		}
+		code.insert(code.end(),
+			{
+				Insn(SO_RET, 1),
+				Insn(SO_ENDIF, 1),
+				Insn(SO_MOV, 5), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 1, Operand(SOT_INPUT, SOSM_SWIZZLE, SWIZZLE_XYZW), 0,
+				Insn(SO_RET, 1)
+			});
+
+		return Container({ { "POSITION", SN_UNDEFINED, 0 }, { "TEXCOORD", SN_UNDEFINED, 1 } },
+			{ { "SV_Position", SN_POSITION, 0 }, { "TEXCOORD", SN_UNDEFINED, 1 } }, code);
+	}
+
+	// dcl_temps num_temps
+	// code
+	// ret
+	// with v0 in and o0 out
+	std::vector<uint32_t> TempsVS(uint32_t num_temps, std::vector<uint32_t> const & code)
+	{
+		std::vector<uint32_t> all_code =
+		{
+			Insn(SO_DCL_INPUT, 3), Operand(SOT_INPUT, SOSM_MASK, MASK_XYZW), 0,
+			Insn(SO_DCL_OUTPUT_SIV, 4), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 0, SN_POSITION,
+			Insn(SO_DCL_TEMPS, 2), num_temps
+		};
+		all_code.insert(all_code.end(), code.begin(), code.end());
+		all_code.push_back(Insn(SO_RET, 1));
+
+		return Container({ { "POSITION", SN_UNDEFINED, 0 } }, { { "SV_Position", SN_POSITION, 0 } }, all_code);
+	}
+
+	struct OptimizedProgram
+	{
+		std::shared_ptr<DXBCContainer> dxbc;
+		std::shared_ptr<ShaderProgram> program;
+		ShaderOptimizeStats stats;
+	};
+
+	OptimizedProgram Optimize(std::vector<uint32_t> const & dxbc)
+	{
+		OptimizedProgram ret;
+		ret.dxbc = DXBCParse(dxbc.data());
+		ret.program = ShaderParse(*ret.dxbc);
+		ret.stats = ShaderOptimize(*ret.program);
+		return ret;
+	}
+
+	uint32_t DeclaredTemps(ShaderProgram const & program)
+	{
+		for (auto const & dcl : program.dcls)
+		{
+			if (SO_DCL_TEMPS == dcl->opcode)
+			{
+				return dcl->num;
+			}
+		}
+		return 0;
+	}
+
+	std::string ToGLSL(DXBC2GLSL::DXBC2GLSL& dxbc2glsl, std::vector<uint32_t> const & dxbc, GLSLVersion version)
+	{
+		dxbc2glsl.FeedDXBC(dxbc.data(), false, true, STP_Undefined, STOP_Undefined, version);
+		return dxbc2glsl.GLSLString();
+	}
+
+	void TestReuse(GLSLVersion version)
+	{
+		std::vector<uint32_t> const shaders[] = { EarlyReturnVS(1), EarlyReturnVS(3), PassThroughVS(), EarlyReturnVS(1) };
+
+		std::vector<std::string> fresh_glsls;
+		for (auto const & shader : shaders)
+		{
+			DXBC2GLSL::DXBC2GLSL dxbc2glsl;
+			fresh_glsls.push_back(ToGLSL(dxbc2glsl, shader, version));
+			EXPECT_FALSE(fresh_glsls.back().empty());
+		}
+
+		// Nothing of the previous shader may leak into the next one
+		DXBC2GLSL::DXBC2GLSL reused;
+		for (size_t i = 0; i < std::size(shaders); ++ i)
+		{
+			EXPECT_EQ(fresh_glsls[i], ToGLSL(reused, shaders[i], version));
+		}
+	}
+}
+
+TEST(DXBC2GLSLTest, ReuseGL)
+{
+	TestReuse(GSV_330);
+}
+
+TEST(DXBC2GLSLTest, ReuseGLES)
+{
+	TestReuse(GSV_300_ES);
+}
+
+TEST(DXBC2GLSLTest, OptimizeRules)
+{
+	EXPECT_TRUE(DXBC2GLSL::DXBC2GLSL::DefaultRules(GSV_300_ES) & GSR_Optimize);
+	EXPECT_TRUE(DXBC2GLSL::DXBC2GLSL::DefaultRules(GSV_100_ES) & GSR_Optimize);
+	EXPECT_FALSE(DXBC2GLSL::DXBC2GLSL::DefaultRules(GSV_330) & GSR_Optimize);
+}
+
+TEST(DXBC2GLSLTest, OptimizeMovPropagation)
+{
+	// mov r0, v0
+	// mul r1, r0, r0
+	// mov o0, r1
+	auto const opt = Optimize(TempsVS(2,
+		{
+			Insn(SO_MOV, 5), TempDst(), 0, InputSrc(), 0,
+			Insn(SO_MUL, 7), TempDst(), 1, TempSrc(), 0, TempSrc(), 0,
+			Insn(SO_MOV, 5), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 0, TempSrc(), 1
+		}));
+
+	// mul r0, v0, v0
+	// mov o0, r0
+	auto const & insns = opt.program->insns;
+	ASSERT_EQ(3U, insns.size());
+	EXPECT_EQ(SO_MUL, insns[0]->opcode);
+	EXPECT_EQ(SOT_INPUT, insns[0]->ops[1]->type);
+	EXPECT_EQ(SOT_INPUT, insns[0]->ops[2]->type);
+	EXPECT_EQ(SO_MOV, insns[1]->opcode);
+	EXPECT_EQ(SOT_TEMP, insns[1]->ops[1]->type);
+	EXPECT_EQ(SO_RET, insns[2]->opcode);
+	EXPECT_EQ(1U, opt.stats.num_temps_after);
+}
+
+TEST(DXBC2GLSLTest, OptimizeDeadTemps)
+{
+	// mul r0, v0, v0 (never read)
+	// add r1, v0, v0 (overwritten before read)
+	// mul r1, v0, v0
+	// mov o0, r1
+	auto const opt = Optimize(TempsVS(2,
+		{
+			Insn(SO_MUL, 7), TempDst(), 0, InputSrc(), 0, InputSrc(), 0,
+			Insn(SO_ADD, 7), TempDst(), 1, InputSrc(), 0, InputSrc(), 0,
+			Insn(SO_MUL, 7), TempDst(), 1, InputSrc(), 0, InputSrc(), 0,
+			Insn(SO_MOV, 5), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 0, TempSrc(), 1
+		}));
+
+	auto const & insns = opt.program->insns;
+	ASSERT_EQ(3U, insns.size());
+	EXPECT_EQ(SO_MUL, insns[0]->opcode);
+	EXPECT_EQ(SO_MOV, insns[1]->opcode);
+	EXPECT_EQ(SO_RET, insns[2]->opcode);
+	EXPECT_EQ(5U, opt.stats.num_insns_before);
+	EXPECT_EQ(3U, opt.stats.num_insns_after);
+	EXPECT_EQ(1U, DeclaredTemps(*opt.program));
+}
+
+TEST(DXBC2GLSLTest, OptimizeLiteralFolding)
+{
+	// add r0, l(1, 2, 3, 4), l(0.5, 0.5, 0.5, 0.5)
+	// mov o0, r0
+	auto const opt = Optimize(TempsVS(1,
+		{
+			Insn(SO_ADD, 13), TempDst(), 0,
+				Immediate(), FloatBits(1), FloatBits(2), FloatBits(3), FloatBits(4),
+				Immediate(), FloatBits(0.5f), FloatBits(0.5f), FloatBits(0.5f), FloatBits(0.5f),
+			Insn(SO_MOV, 5), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 0, TempSrc(), 0
+		}));
+
+	// mov o0, l(1.5, 2.5, 3.5, 4.5)
+	auto const & insns = opt.program->insns;
+	ASSERT_EQ(2U, insns.size());
+	EXPECT_EQ(SO_MOV, insns[0]->opcode);
+	EXPECT_EQ(SOT_OUTPUT, insns[0]->ops[0]->type);
+	ASSERT_EQ(SOT_IMMEDIATE32, insns[0]->ops[1]->type);
+	for (uint32_t c = 0; c < 4; ++ c)
+	{
+		EXPECT_EQ(c + 1.5f, insns[0]->ops[1]->imm_values[c].f32);
+	}
+	EXPECT_EQ(0U, opt.stats.num_temps_after);
+}
+
+TEST(DXBC2GLSLTest, OptimizeTempRenumbering)
+{
+	// mul r7, v0, v0
+	// add r3, r7, v0
+	// mov o0, r3
+	auto const dxbc = TempsVS(8,
+		{
+			Insn(SO_MUL, 7), TempDst(), 7, InputSrc(), 0, InputSrc(), 0,
+			Insn(SO_ADD, 7), TempDst(), 3, TempSrc(), 7, InputSrc(), 0,
+			Insn(SO_MOV, 5), Operand(SOT_OUTPUT, SOSM_MASK, MASK_XYZW), 0, TempSrc(), 3
+		});
+	auto const opt = Optimize(dxbc);
+
+	// Numbered in the order of first use
+	auto const & insns = opt.program->insns;
+	ASSERT_EQ(4U, insns.size());
+	EXPECT_EQ(0, insns[0]->ops[0]->indices[0].disp);
+	EXPECT_EQ(1, insns[1]->ops[0]->indices[0].disp);
+	EXPECT_EQ(0, insns[1]->ops[1]->indices[0].disp);
+	EXPECT_EQ(1, insns[2]->ops[1]->indices[0].disp);
+	EXPECT_EQ(8U, opt.stats.num_temps_before);
+	EXPECT_EQ(2U, opt.stats.num_temps_after);
+	EXPECT_EQ(2U, DeclaredTemps(*opt.program));
+
+	// Fewer temps declared in the GLSL
+	uint32_t const rules = DXBC2GLSL::DXBC2GLSL::DefaultRules(GSV_300_ES);
+	DXBC2GLSL::DXBC2GLSL dxbc2glsl;
+	dxbc2glsl.FeedDXBC(dxbc.data(), false, true, STP_Undefined, STOP_Undefined, GSV_300_ES, rules);
+	std::string const optimized = dxbc2glsl.GLSLString();
+	EXPECT_NE(std::string::npos, optimized.find("tf1;"));
+	EXPECT_EQ(std::string::npos, optimized.find("tf2;"));
+
+	dxbc2glsl.FeedDXBC(dxbc.data(), false, true, STP_Undefined, STOP_Undefined, GSV_300_ES, rules & ~GSR_Optimize);
+	EXPECT_NE(std::string::npos, dxbc2glsl.GLSLString().find("tf7;"));
+}
@@ -1,14 +1,18 @@
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/iterator.hpp>
 #include <KFL/ErrorHandling.hpp>
 #include <KlayGE/TexCompressionBC.hpp>
 #include <KlayGE/TexCompressionETC.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/Half.hpp>
+#include <KFL/Log.hpp>
+#include <KFL/Timer.hpp>
 
 #include <vector>
 #include <string>
 #include <iostream>
+#include <random>
 
 #include "KlayGETests.hpp"
 
@@ -293,7 +297,368 @@ TEST(EncodeDecodeTexTest, EncodeDecodeBC7ARGB)
 	TestEncodeDecodeTex("leaf_v3_green_tex.dds", "", EF_BC7, 11.0f);
 }
 
+TEST(EncodeDecodeTexTest, EncodeDecodeBC6U)
+{
+	TestEncodeDecodeTex("memorial.dds", "", EF_BC6, 0.1f);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeBC6S)
+{
+	TestEncodeDecodeTex("uffizi_probe.dds", "", EF_SIGNED_BC6, 0.1f);
+}
+
 TEST(EncodeDecodeTexTest, EncodeDecodeETC1)
 {
 	TestEncodeDecodeTex("Lenna.dds", "", EF_ETC1, 4.8f);
 }
+
+// Encodes a synthetic HDR image with every TexCompressionMethod, logs the PSNR and the throughput of each.
+//  The PSNR is measured on the bit patterns of the halfs, the roughly logarithmic space BC6H encoders minimize errors in.
+void TestBC6Methods(std::string const & name, TexCompressionPtr const & codec, bool signed_fmt)
+{
+	auto half_bits = [](half h)
+	{
+		uint16_t const bits = *reinterpret_cast<uint16_t const *>(&h);
+		return (bits & 0x8000) ? -static_cast<int>(bits & 0x7FFF) : static_cast<int>(bits);
+	};
+
+	uint32_t const WIDTH = 256;
+	uint32_t const HEIGHT = 256;
+
+	std::mt19937 gen(0xBC6);
+	std::uniform_real_distribution<float> noise(-0.02f, 0.02f);
+
+	// Smooth gradients over 16 stops of exposure, plus some noise
+	std::vector<Vector_T<half, 4>> pixels(WIDTH * HEIGHT);
+	for (uint32_t y = 0; y < HEIGHT; ++ y)
+	{
+		for (uint32_t x = 0; x < WIDTH; ++ x)
+		{
+			float const exposure = pow(2.0f, static_cast<float>(x) / WIDTH * 16 - 8);
+			float3 clr(0.5f + 0.5f * sin(y * 0.05f), 0.5f + 0.5f * cos(x * 0.03f + y * 0.02f), static_cast<float>(y) / HEIGHT);
+			if (signed_fmt && ((x / 32 + y / 32) & 1))
+			{
+				clr = -clr;
+			}
+			for (uint32_t ch = 0; ch < 3; ++ ch)
+			{
+				clr[ch] = (clr[ch] + noise(gen)) * exposure;
+				if (!signed_fmt)
+				{
+					clr[ch] = std::max(clr[ch], 0.0f);
+				}
+			}
+			pixels[y * WIDTH + x] = Vector_T<half, 4>(half(clr.x()), half(clr.y()), half(clr.z()), half(1.0f));
+		}
+	}
+
+	uint32_t const pixel_size = sizeof(pixels[0]);
+	uint32_t const block_row_pitch = WIDTH / 4 * codec->BlockBytes();
+	std::vector<uint8_t> blocks(block_row_pitch * HEIGHT / 4);
+	std::vector<Vector_T<half, 4>> restored(pixels.size());
+
+	TexCompressionMethod const methods[] = { TCM_Speed, TCM_Balanced, TCM_Quality };
+	char const * method_names[] = { "speed", "balanced", "quality" };
+	float psnrs[3];
+	for (size_t m = 0; m < std::size(methods); ++ m)
+	{
+		Timer timer;
+		codec->EncodeMem(WIDTH, HEIGHT, &blocks[0], block_row_pitch, block_row_pitch * HEIGHT / 4,
+			&pixels[0], WIDTH * pixel_size, WIDTH * HEIGHT * pixel_size, methods[m]);
+		double const time = timer.elapsed();
+
+		codec->DecodeMem(WIDTH, HEIGHT, &restored[0], WIDTH * pixel_size, WIDTH * HEIGHT * pixel_size,
+			&blocks[0], block_row_pitch, block_row_pitch * HEIGHT / 4);
+
+		double mse = 0;
+		for (size_t i = 0; i < pixels.size(); ++ i)
+		{
+			for (uint32_t ch = 0; ch < 3; ++ ch)
+			{
+				double const diff = half_bits(pixels[i][ch]) - half_bits(restored[i][ch]);
+				mse += diff * diff;
+			}
+		}
+		mse /= pixels.size() * 3;
+		psnrs[m] = static_cast<float>(10 * log10(0x7BFF * 0x7BFF / mse));
+
+		LogInfo("Encoding %s (%s): PSNR %f dB, %f MPixel/s", name.c_str(), method_names[m], psnrs[m],
+			WIDTH * HEIGHT / time / 1e6);
+	}
+
+	EXPECT_GT(psnrs[0], 38.0f);
+	EXPECT_GE(psnrs[2] + 0.01f, psnrs[0]);
+}
+
+TEST(EncodeDecodeTexTest, MethodsBC6U)
+{
+	TestBC6Methods("BC6U", MakeSharedPtr<TexCompressionBC6U>(), false);
+}
+
+TEST(EncodeDecodeTexTest, MethodsBC6S)
+{
+	TestBC6Methods("BC6S", MakeSharedPtr<TexCompressionBC6S>(), true);
+}
+
+// Compares the serial and parallel paths of EncodeMem/DecodeMem on a synthetic image, and logs the throughput of both
+void TestTexCompressionThroughput(std::string const & name, TexCompressionPtr const & codec, bool encode)
+{
+	uint32_t const WIDTH = 512;
+	uint32_t const HEIGHT = 512;
+	int const NUM_ITERATIONS = 3;
+
+	uint32_t const pixel_size = NumFormatBytes(codec->DecodedFormat());
+	uint32_t const blocks_x = (WIDTH + codec->BlockWidth() - 1) / codec->BlockWidth();
+	uint32_t const blocks_y = (HEIGHT + codec->BlockHeight() - 1) / codec->BlockHeight();
+	uint32_t const block_row_pitch = blocks_x * codec->BlockBytes();
+
+	std::mt19937 gen(0x7E8C);
+	std::uniform_int_distribution<int> noise(-8, 8);
+
+	std::vector<uint8_t> pixels(WIDTH * HEIGHT * pixel_size);
+	for (uint32_t y = 0; y < HEIGHT; ++ y)
+	{
+		for (uint32_t x = 0; x < WIDTH; ++ x)
+		{
+			uint8_t* pixel = &pixels[(y * WIDTH + x) * pixel_size];
+			for (uint32_t ch = 0; ch < 4; ++ ch)
+			{
+				int const value = MathLib::clamp(static_cast<int>((x * (ch + 1) + y * (4 - ch)) / 5 % 256) + noise(gen), 0, 255);
+				if (EF_ABGR16F == codec->DecodedFormat())
+				{
+					reinterpret_cast<half*>(pixel)[ch] = half(value / 64.0f);
+				}
+				else
+				{
+					pixel[ch] = static_cast<uint8_t>(value);
+				}
+			}
+		}
+	}
+
+	std::vector<uint8_t> serial_blocks(block_row_pitch * blocks_y);
+	std::vector<uint8_t> parallel_blocks(serial_blocks.size());
+	if (encode)
+	{
+		Timer timer;
+		codec->Parallel(false);
+		for (int i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			codec->EncodeMem(WIDTH, HEIGHT, &serial_blocks[0], block_row_pitch, block_row_pitch * blocks_y,
+				&pixels[0], WIDTH * pixel_size, WIDTH * HEIGHT * pixel_size, TCM_Balanced);
+		}
+		double const serial_time = timer.elapsed() / NUM_ITERATIONS;
+
+		timer.restart();
+		codec->Parallel(true);
+		for (int i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			codec->EncodeMem(WIDTH, HEIGHT, &parallel_blocks[0], block_row_pitch, block_row_pitch * blocks_y,
+				&pixels[0], WIDTH * pixel_size, WIDTH * HEIGHT * pixel_size, TCM_Balanced);
+		}
+		double const parallel_time = timer.elapsed() / NUM_ITERATIONS;
+
+		EXPECT_TRUE(serial_blocks == parallel_blocks);
+
+		LogInfo("Encoding %s: serial %f MPixel/s, parallel %f MPixel/s", name.c_str(),
+			WIDTH * HEIGHT / serial_time / 1e6, WIDTH * HEIGHT / parallel_time / 1e6);
+	}
+	else
+	{
+		// No encoder yet, decode arbitrary blocks. Decoders have to cope with reserved modes anyway.
+		std::uniform_int_distribution<int> byte_dist(0, 255);
+		for (auto& b : serial_blocks)
+		{
+			b = static_cast<uint8_t>(byte_dist(gen));
+		}
+	}
+
+	std::vector<uint8_t> serial_pixels(pixels.size());
+	std::vector<uint8_t> parallel_pixels(pixels.size());
+
+	Timer timer;
+	codec->Parallel(false);
+	for (int i = 0; i < NUM_ITERATIONS; ++ i)
+	{
+		codec->DecodeMem(WIDTH, HEIGHT, &serial_pixels[0], WIDTH * pixel_size, WIDTH * HEIGHT * pixel_size,
+			&serial_blocks[0], block_row_pitch, block_row_pitch * blocks_y);
+	}
+	double const serial_time = timer.elapsed() / NUM_ITERATIONS;
+
+	timer.restart();
+	codec->Parallel(true);
+	for (int i = 0; i < NUM_ITERATIONS; ++ i)
+	{
+		codec->DecodeMem(WIDTH, HEIGHT, &parallel_pixels[0], WIDTH * pixel_size, WIDTH * HEIGHT * pixel_size,
+			&serial_blocks[0], block_row_pitch, block_row_pitch * blocks_y);
+	}
+	double const parallel_time = timer.elapsed() / NUM_ITERATIONS;
+
+	EXPECT_TRUE(serial_pixels == parallel_pixels);
+
+	LogInfo("Decoding %s: serial %f MPixel/s, parallel %f MPixel/s", name.c_str(),
+		WIDTH * HEIGHT / serial_time / 1e6, WIDTH * HEIGHT / parallel_time / 1e6);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputBC1)
+{
+	TestTexCompressionThroughput("BC1", MakeSharedPtr<TexCompressionBC1>(), true);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputBC2)
+{
+	TestTexCompressionThroughput("BC2", MakeSharedPtr<TexCompressionBC2>(), true);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputBC3)
+{
+	TestTexCompressionThroughput("BC3", MakeSharedPtr<TexCompressionBC3>(), true);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputBC4)
+{
+	TestTexCompressionThroughput("BC4", MakeSharedPtr<TexCompressionBC4>(), true);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputBC5)
+{
+	TestTexCompressionThroughput("BC5", MakeSharedPtr<TexCompressionBC5>(), true);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputBC6U)
+{
+	TestTexCompressionThroughput("BC6U", MakeSharedPtr<TexCompressionBC6U>(), true);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputBC6S)
+{
+	TestTexCompressionThroughput("BC6S", MakeSharedPtr<TexCompressionBC6S>(), true);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputBC7)
+{
+	TestTexCompressionThroughput("BC7", MakeSharedPtr<TexCompressionBC7>(), true);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputETC1)
+{
+	TestTexCompressionThroughput("ETC1", MakeSharedPtr<TexCompressionETC1>(), true);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputETC2RGB8)
+{
+	TestTexCompressionThroughput("ETC2RGB8", MakeSharedPtr<TexCompressionETC2RGB8>(), false);
+}
+
+TEST(EncodeDecodeTexTest, ThroughputETC2RGB8A1)
+{
+	TestTexCompressionThroughput("ETC2RGB8A1", MakeSharedPtr<TexCompressionETC2RGB8A1>(), false);
+}
+
+// DecodeMem goes through the batch decoders of DecodeBlockRow, they have to match DecodeBlock texel by texel. The odd
+//  size puts partial blocks on the right and bottom edges, which still use DecodeBlock.
+void TestBatchDecode(std::string const & name, TexCompressionPtr const & codec)
+{
+	uint32_t const WIDTH = 510;
+	uint32_t const HEIGHT = 509;
+	int const NUM_ITERATIONS = 3;
+
+	uint32_t const pixel_size = NumFormatBytes(codec->DecodedFormat());
+	uint32_t const block_width = codec->BlockWidth();
+	uint32_t const block_height = codec->BlockHeight();
+	uint32_t const block_bytes = codec->BlockBytes();
+	uint32_t const blocks_x = (WIDTH + block_width - 1) / block_width;
+	uint32_t const blocks_y = (HEIGHT + block_height - 1) / block_height;
+	uint32_t const block_row_pitch = blocks_x * block_bytes;
+	// Padded, the decoders must not write past the row
+	uint32_t const row_pitch = WIDTH * pixel_size + 16;
+
+	// Arbitrary blocks cover all the modes, including the reserved ones
+	std::mt19937 gen(0xBA7C);
+	std::uniform_int_distribution<int> byte_dist(0, 255);
+	std::vector<uint8_t> blocks(block_row_pitch * blocks_y);
+	for (auto& b : blocks)
+	{
+		b = static_cast<uint8_t>(byte_dist(gen));
+	}
+
+	std::vector<uint8_t> expected(row_pitch * HEIGHT, 0xCD);
+	std::vector<uint8_t> decoded_block(block_width * block_height * pixel_size);
+
+	Timer timer;
+	for (int i = 0; i < NUM_ITERATIONS; ++ i)
+	{
+		for (uint32_t by = 0; by < blocks_y; ++ by)
+		{
+			for (uint32_t bx = 0; bx < blocks_x; ++ bx)
+			{
+				codec->DecodeBlock(&decoded_block[0], &blocks[by * block_row_pitch + bx * block_bytes]);
+				for (uint32_t y = 0; y < block_height; ++ y)
+				{
+					for (uint32_t x = 0; x < block_width; ++ x)
+					{
+						uint32_t const px = bx * block_width + x;
+						uint32_t const py = by * block_height + y;
+						if ((px < WIDTH) && (py < HEIGHT))
+						{
+							memcpy(&expected[py * row_pitch + px * pixel_size],
+								&decoded_block[(y * block_width + x) * pixel_size], pixel_size);
+						}
+					}
+				}
+			}
+		}
+	}
+	double const block_time = timer.elapsed() / NUM_ITERATIONS;
+
+	std::vector<uint8_t> batch(expected.size(), 0xCD);
+
+	timer.restart();
+	codec->Parallel(false);
+	for (int i = 0; i < NUM_ITERATIONS; ++ i)
+	{
+		codec->DecodeMem(WIDTH, HEIGHT, &batch[0], row_pitch, row_pitch * HEIGHT,
+			&blocks[0], block_row_pitch, block_row_pitch * blocks_y);
+	}
+	double const batch_time = timer.elapsed() / NUM_ITERATIONS;
+
+	EXPECT_TRUE(expected == batch);
+
+	LogInfo("Decoding %s: per block %f MPixel/s, batch %f MPixel/s", name.c_str(),
+		WIDTH * HEIGHT / block_time / 1e6, WIDTH * HEIGHT / batch_time / 1e6);
+}
+
+TEST(EncodeDecodeTexTest, BatchDecodeBC1)
+{
+	TestBatchDecode("BC1", MakeSharedPtr<TexCompressionBC1>());
+}
+
+TEST(EncodeDecodeTexTest, BatchDecodeBC3)
+{
+	TestBatchDecode("BC3", MakeSharedPtr<TexCompressionBC3>());
+}
+
+TEST(EncodeDecodeTexTest, BatchDecodeBC4)
+{
+	TestBatchDecode("BC4", MakeSharedPtr<TexCompressionBC4>());
+}
+
+TEST(EncodeDecodeTexTest, BatchDecodeBC5)
+{
+	TestBatchDecode("BC5", MakeSharedPtr<TexCompressionBC5>());
+}
+
+TEST(EncodeDecodeTexTest, BatchDecodeETC1)
+{
+	TestBatchDecode("ETC1", MakeSharedPtr<TexCompressionETC1>());
+}
+
+TEST(EncodeDecodeTexTest, BatchDecodeETC2RGB8)
+{
+	TestBatchDecode("ETC2RGB8", MakeSharedPtr<TexCompressionETC2RGB8>());
+}
+
+TEST(EncodeDecodeTexTest, BatchDecodeETC2RGB8A1)
+{
+	TestBatchDecode("ETC2RGB8A1", MakeSharedPtr<TexCompressionETC2RGB8A1>());
+}
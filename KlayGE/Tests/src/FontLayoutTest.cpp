@@ -0,0 +1,140 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/Font.hpp>
+
+#include <string>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	std::wstring const SCOREBOARD = L"Player 1    12345\nPlayer 2    67890\nPlayer 3    13579";
+}
+
+TEST(FontLayoutTest, Invalidation)
+{
+	FontPtr font = SyncLoadFont("gkai00mp.kfont");
+	ASSERT_TRUE(font);
+
+	TextLayoutPtr layout = font->MakeTextLayout();
+	layout->Text(L"Score");
+	layout->FontSize(16);
+	layout->Location(10, 10, 0.5f, 1, 1);
+	EXPECT_TRUE(layout->Dirty());
+
+	font->Prefetch(L"Score:0123456789");
+	font->WaitForGlyphs();
+
+	layout->Render();
+	EXPECT_FALSE(layout->Dirty());
+	EXPECT_EQ(layout->NumGlyphs(), 5U);
+
+	// Setting the same values keeps the layout
+	layout->Text(L"Score");
+	layout->FontSize(16);
+	layout->Location(10, 10, 0.5f, 1, 1);
+	EXPECT_FALSE(layout->Dirty());
+
+	layout->Text(L"Score:100");
+	EXPECT_TRUE(layout->Dirty());
+	layout->Render();
+	EXPECT_FALSE(layout->Dirty());
+	EXPECT_EQ(layout->NumGlyphs(), 9U);
+
+	layout->FontSize(24);
+	EXPECT_TRUE(layout->Dirty());
+	layout->Render();
+	EXPECT_FALSE(layout->Dirty());
+
+	// Glyphs outside of the rectangle are dropped
+	layout->Location(Rect(0, 0, 30, 30), 0.5f, 1, 1, Font::FA_Hor_Left | Font::FA_Ver_Top);
+	layout->Render();
+	EXPECT_LT(layout->NumGlyphs(), 9U);
+
+	Context::Instance().SceneManagerInstance().ClearObject();
+}
+
+TEST(FontLayoutTest, AsyncGlyphs)
+{
+	FontPtr font = SyncLoadFont("gkai00mp.kfont");
+	ASSERT_TRUE(font);
+
+	// CJK characters unlikely to be requested by the other tests
+	std::wstring const text = L"\x6C49\x5B57\x7F13\x5B58\x6D4B\x8BD5";
+
+	Font::GlyphCacheStatistics const before = font->GlyphCacheStats();
+
+	TextLayoutPtr layout = font->MakeTextLayout();
+	layout->Text(text);
+	layout->FontSize(16);
+	layout->Render();
+
+	Font::GlyphCacheStatistics const requested = font->GlyphCacheStats();
+	EXPECT_EQ(requested.num_misses - before.num_misses, text.size());
+	EXPECT_EQ(requested.num_cached - before.num_cached, text.size());
+
+	// Until they are decoded the glyphs are left blank, the layout is redone once they arrive
+	font->WaitForGlyphs();
+	EXPECT_EQ(font->GlyphCacheStats().num_pending, 0U);
+	layout->Render();
+	EXPECT_EQ(layout->NumGlyphs(), text.size());
+	EXPECT_FALSE(layout->Dirty());
+
+	font->Prefetch(text);
+	Font::GlyphCacheStatistics const after = font->GlyphCacheStats();
+	EXPECT_EQ(after.num_misses, requested.num_misses);
+	EXPECT_GE(after.num_hits - requested.num_hits, text.size());
+	EXPECT_EQ(after.num_evictions, before.num_evictions);
+
+	Context::Instance().SceneManagerInstance().ClearObject();
+}
+
+TEST(FontLayoutTest, RenderTime)
+{
+	FontPtr font = SyncLoadFont("gkai00mp.kfont");
+	ASSERT_TRUE(font);
+	font->Prefetch(SCOREBOARD);
+	font->WaitForGlyphs();
+
+	int const NUM_ITERATIONS = 1000;
+
+	TextLayoutPtr layout = font->MakeTextLayout();
+	layout->Text(SCOREBOARD);
+	layout->FontSize(16);
+	layout->Location(10, 10, 0.5f, 1, 1);
+
+	Timer timer;
+	for (int i = 0; i < NUM_ITERATIONS; ++ i)
+	{
+		// Forces the layout to be redone, as every call did before there were layouts
+		layout->FontSize((i & 1) ? 16.0f : 17.0f);
+		layout->Render();
+	}
+	double const relayout_time = timer.elapsed() / NUM_ITERATIONS;
+	Context::Instance().SceneManagerInstance().ClearObject();
+
+	timer.restart();
+	for (int i = 0; i < NUM_ITERATIONS; ++ i)
+	{
+		layout->Render();
+	}
+	double const cached_time = timer.elapsed() / NUM_ITERATIONS;
+	Context::Instance().SceneManagerInstance().ClearObject();
+
+	timer.restart();
+	for (int i = 0; i < NUM_ITERATIONS; ++ i)
+	{
+		font->RenderText(10, 10, 0.5f, 1, 1, Color(1, 1, 1, 1), SCOREBOARD, 16);
+	}
+	double const immediate_time = timer.elapsed() / NUM_ITERATIONS;
+	Context::Instance().SceneManagerInstance().ClearObject();
+
+	LogInfo("Rendering a %u character string: laid out every call %f ms, cached layout %f ms, RenderText %f ms",
+		static_cast<uint32_t>(SCOREBOARD.size()), relayout_time * 1000, cached_time * 1000, immediate_time * 1000);
+}
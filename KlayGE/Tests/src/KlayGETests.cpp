@@ -3,6 +3,11 @@
 #include <KlayGE/ResLoader.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/Texture.hpp>
+#include <KlayGE/RenderableHelper.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+#include <KFL/Timer.hpp>
+
+#include <random>
 
 #include "KlayGETests.hpp"
 
@@ -175,6 +180,56 @@ namespace KlayGE
 
 		return match;
 	}
+
+	RenderablePtr MakeTestBox()
+	{
+		return MakeSharedPtr<RenderableTriBox>(MathLib::convert_to_obbox(AABBox(float3(-1, -1, -1), float3(1, 1, 1))),
+			Color(1, 1, 1, 1));
+	}
+
+	std::vector<SceneObjectPtr> MakeTestSceneObjects(uint32_t num_objs, uint32_t num_children_per_parent)
+	{
+		std::mt19937 gen(0x5CE7E);
+		std::uniform_real_distribution<float> pos_dist(-500, 500);
+		std::uniform_real_distribution<float> scale_dist(0.1f, 4);
+
+		RenderablePtr const box = MakeTestBox();
+
+		std::vector<SceneObjectPtr> objs(num_objs);
+		SceneObject* parent = nullptr;
+		for (uint32_t i = 0; i < num_objs; ++ i)
+		{
+			bool const is_child = (num_children_per_parent > 0) && (i % (num_children_per_parent + 1) != 0);
+			uint32_t const attrib = SceneObject::SOA_Cullable | ((i % 7 == 0) ? SceneObject::SOA_Moveable : 0);
+
+			auto so = MakeSharedPtr<SceneObjectHelper>(box, attrib);
+			so->ModelMatrix(MathLib::scaling(float3(scale_dist(gen), scale_dist(gen), scale_dist(gen)))
+				* MathLib::translation(pos_dist(gen), pos_dist(gen), pos_dist(gen)));
+			if (is_child)
+			{
+				so->Parent(parent);
+			}
+			else
+			{
+				parent = so.get();
+			}
+			so->UpdateAbsModelMatrix();
+
+			objs[i] = so;
+		}
+
+		return objs;
+	}
+
+	double AverageMilliseconds(uint32_t num_iterations, std::function<void(uint32_t)> const & func)
+	{
+		Timer timer;
+		for (uint32_t i = 0; i < num_iterations; ++ i)
+		{
+			func(i);
+		}
+		return timer.elapsed() * 1000 / num_iterations;
+	}
 }
 
 int main(int argc, char** argv)
@@ -7,6 +7,9 @@
 #pragma clang diagnostic pop
 #endif
 
+#include <functional>
+#include <vector>
+
 namespace KlayGE
 {
 	bool CompareBuffer(GraphicsBuffer& buff0, uint32_t buff0_offset,
@@ -16,4 +19,13 @@ namespace KlayGE
 	bool Compare2D(Texture& tex0, uint32_t tex0_array_index, uint32_t tex0_level, uint32_t tex0_x_offset, uint32_t tex0_y_offset,
 		Texture& tex1, uint32_t tex1_array_index, uint32_t tex1_level, uint32_t tex1_x_offset, uint32_t tex1_y_offset,
 		uint32_t width, uint32_t height, float tolerance);
+
+	// A box renderable shared by the objects of the scene tests
+	RenderablePtr MakeTestBox();
+	// Boxes scattered and scaled at random with a fixed seed, every 7th one moveable. If num_children_per_parent
+	//  isn't 0, every root is followed by that many children of it.
+	std::vector<SceneObjectPtr> MakeTestSceneObjects(uint32_t num_objs, uint32_t num_children_per_parent);
+
+	// Runs func(0) to func(num_iterations - 1), returns the average time of a call in milliseconds
+	double AverageMilliseconds(uint32_t num_iterations, std::function<void(uint32_t)> const & func);
 }
@@ -0,0 +1,237 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/LZMACodec.hpp>
+#include <KlayGE/RenderMaterial.hpp>
+#include <KlayGE/Mesh.hpp>
+
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	struct TestModel
+	{
+		std::vector<RenderMaterialPtr> mtls;
+		std::vector<VertexElement> merged_ves;
+		char all_is_index_16_bit;
+		std::vector<std::vector<uint8_t>> merged_buffs;
+		std::vector<uint8_t> merged_indices;
+		std::vector<std::string> mesh_names;
+		std::vector<int32_t> mtl_ids;
+		std::vector<uint32_t> mesh_lods;
+		std::vector<AABBox> pos_bbs;
+		std::vector<AABBox> tc_bbs;
+		std::vector<uint32_t> mesh_num_vertices;
+		std::vector<uint32_t> mesh_base_vertices;
+		std::vector<uint32_t> mesh_num_indices;
+		std::vector<uint32_t> mesh_base_indices;
+	};
+
+	// A grid mesh, positions and texcoords are smooth like real meshes so the compressors have something to work with
+	TestModel GenerateTestModel(uint32_t grid_size)
+	{
+		TestModel model;
+
+		auto mtl = MakeSharedPtr<RenderMaterial>();
+		mtl->name = "ModelBinTest";
+		mtl->albedo = float4(1, 1, 1, 1);
+		mtl->metalness = 0;
+		mtl->glossiness = 0.5f;
+		mtl->emissive = float3(0, 0, 0);
+		mtl->transparent = false;
+		mtl->alpha_test = 0;
+		mtl->sss = false;
+		mtl->two_sided = false;
+		mtl->detail_mode = RenderMaterial::SDM_Parallax;
+		mtl->height_offset_scale = float2(-0.5f, 0.06f);
+		mtl->tess_factors = float4(5, 5, 1, 9);
+		model.mtls.push_back(mtl);
+
+		model.merged_ves.push_back(VertexElement(VEU_Position, 0, EF_BGR32F));
+		model.merged_ves.push_back(VertexElement(VEU_Tangent, 0, EF_ABGR8));
+		model.merged_ves.push_back(VertexElement(VEU_TextureCoord, 0, EF_GR32F));
+		model.all_is_index_16_bit = false;
+
+		std::mt19937 gen(0x30DE1);
+		std::uniform_real_distribution<float> height_dist(-0.01f, 0.01f);
+
+		uint32_t const num_vertices = grid_size * grid_size;
+		std::vector<float3> positions(num_vertices);
+		std::vector<uint32_t> tangents(num_vertices);
+		std::vector<float2> texcoords(num_vertices);
+		for (uint32_t y = 0; y < grid_size; ++ y)
+		{
+			for (uint32_t x = 0; x < grid_size; ++ x)
+			{
+				uint32_t const index = y * grid_size + x;
+				positions[index] = float3(static_cast<float>(x), height_dist(gen), static_cast<float>(y));
+				tangents[index] = 0xFF7F7F7F;
+				texcoords[index] = float2(static_cast<float>(x) / grid_size, static_cast<float>(y) / grid_size);
+			}
+		}
+
+		model.merged_buffs.resize(3);
+		model.merged_buffs[0].resize(num_vertices * sizeof(float3));
+		std::memcpy(model.merged_buffs[0].data(), positions.data(), model.merged_buffs[0].size());
+		model.merged_buffs[1].resize(num_vertices * sizeof(uint32_t));
+		std::memcpy(model.merged_buffs[1].data(), tangents.data(), model.merged_buffs[1].size());
+		model.merged_buffs[2].resize(num_vertices * sizeof(float2));
+		std::memcpy(model.merged_buffs[2].data(), texcoords.data(), model.merged_buffs[2].size());
+
+		std::vector<uint32_t> indices;
+		for (uint32_t y = 0; y < grid_size - 1; ++ y)
+		{
+			for (uint32_t x = 0; x < grid_size - 1; ++ x)
+			{
+				uint32_t const index = y * grid_size + x;
+				indices.push_back(index);
+				indices.push_back(index + grid_size);
+				indices.push_back(index + 1);
+				indices.push_back(index + 1);
+				indices.push_back(index + grid_size);
+				indices.push_back(index + grid_size + 1);
+			}
+		}
+		model.merged_indices.resize(indices.size() * sizeof(uint32_t));
+		std::memcpy(model.merged_indices.data(), indices.data(), model.merged_indices.size());
+
+		model.mesh_names.push_back("grid");
+		model.mtl_ids.push_back(0);
+		model.mesh_lods.push_back(1);
+		model.pos_bbs.push_back(AABBox(float3(0, -0.01f, 0), float3(static_cast<float>(grid_size), 0.01f, static_cast<float>(grid_size))));
+		model.tc_bbs.push_back(AABBox(float3(0, 0, 0), float3(1, 1, 0)));
+		model.mesh_num_vertices.push_back(num_vertices);
+		model.mesh_base_vertices.push_back(0);
+		model.mesh_num_indices.push_back(static_cast<uint32_t>(indices.size()));
+		model.mesh_base_indices.push_back(0);
+		// Totals come last, as in the output of MeshMLJIT
+		model.mesh_base_vertices.push_back(num_vertices);
+		model.mesh_base_indices.push_back(static_cast<uint32_t>(indices.size()));
+
+		return model;
+	}
+
+	void SaveTestModel(TestModel const & model, std::string const & name, bool compress_streams)
+	{
+		SaveModel(ResLoader::Instance().LocalFolder() + name, model.mtls, model.merged_ves, model.all_is_index_16_bit,
+			model.merged_buffs, model.merged_indices,
+			model.mesh_names, model.mtl_ids, model.mesh_lods, model.pos_bbs, model.tc_bbs,
+			model.mesh_num_vertices, model.mesh_base_vertices, model.mesh_num_indices, model.mesh_base_indices,
+			std::vector<Joint>(), std::shared_ptr<AnimationActionsType>(), std::shared_ptr<KeyFramesType>(), 0, 0,
+			compress_streams);
+	}
+
+	double TimeLoadModel(std::string const & name, TestModel const & expected)
+	{
+		int const NUM_ITERATIONS = 10;
+
+		std::vector<RenderMaterialPtr> mtls;
+		std::vector<VertexElement> merged_ves;
+		char all_is_index_16_bit;
+		std::vector<std::vector<uint8_t>> merged_buffs;
+		std::vector<uint8_t> merged_indices;
+		std::vector<std::string> mesh_names;
+		std::vector<int32_t> mtl_ids;
+		std::vector<uint32_t> mesh_lods;
+		std::vector<AABBox> pos_bbs;
+		std::vector<AABBox> tc_bbs;
+		std::vector<uint32_t> mesh_num_vertices;
+		std::vector<uint32_t> mesh_base_vertices;
+		std::vector<uint32_t> mesh_num_indices;
+		std::vector<uint32_t> mesh_base_indices;
+		std::vector<Joint> joints;
+		std::shared_ptr<AnimationActionsType> actions;
+		std::shared_ptr<KeyFramesType> kfs;
+		uint32_t num_frames = 0;
+		uint32_t frame_rate = 0;
+		std::vector<std::shared_ptr<AABBKeyFrames>> frame_pos_bbs;
+
+		Timer timer;
+		for (int i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			LoadModel(name, mtls, merged_ves, all_is_index_16_bit, merged_buffs, merged_indices,
+				mesh_names, mtl_ids, mesh_lods, pos_bbs, tc_bbs,
+				mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_base_indices,
+				joints, actions, kfs, num_frames, frame_rate, frame_pos_bbs);
+		}
+		double const time = timer.elapsed() / NUM_ITERATIONS;
+
+		EXPECT_EQ(mesh_names, expected.mesh_names);
+		EXPECT_EQ(merged_ves.size(), expected.merged_ves.size());
+		EXPECT_TRUE(merged_indices == expected.merged_indices);
+		for (size_t i = 0; i < merged_ves.size(); ++ i)
+		{
+			// The loader converts the vertex formats unsupported by the device, compare the untouched ones only
+			if (merged_ves[i].format == expected.merged_ves[i].format)
+			{
+				EXPECT_TRUE(merged_buffs[i] == expected.merged_buffs[i]);
+			}
+		}
+
+		return time;
+	}
+
+	// Version 15 and earlier kept the vertex and index streams inside the one LZMA stream, loading was a whole LZMA decode
+	//  followed by copying every stream out of a stringstream
+	double TimeLegacyLayout(TestModel const & model)
+	{
+		int const NUM_ITERATIONS = 10;
+
+		std::vector<uint8_t> all_streams;
+		for (auto const & buff : model.merged_buffs)
+		{
+			all_streams.insert(all_streams.end(), buff.begin(), buff.end());
+		}
+		all_streams.insert(all_streams.end(), model.merged_indices.begin(), model.merged_indices.end());
+
+		LZMACodec lzma;
+		std::vector<uint8_t> encoded;
+		lzma.Encode(encoded, all_streams.data(), all_streams.size());
+
+		std::vector<std::vector<uint8_t>> merged_buffs(model.merged_buffs.size());
+		std::vector<uint8_t> merged_indices(model.merged_indices.size());
+
+		Timer timer;
+		for (int i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			std::stringstream ss;
+			lzma.Decode(ss, encoded.data(), encoded.size(), all_streams.size());
+			for (size_t j = 0; j < merged_buffs.size(); ++ j)
+			{
+				merged_buffs[j].resize(model.merged_buffs[j].size());
+				ss.read(reinterpret_cast<char*>(merged_buffs[j].data()), merged_buffs[j].size());
+			}
+			ss.read(reinterpret_cast<char*>(merged_indices.data()), merged_indices.size());
+		}
+		double const time = timer.elapsed() / NUM_ITERATIONS;
+
+		EXPECT_TRUE(merged_indices == model.merged_indices);
+
+		return time;
+	}
+}
+
+TEST(ModelBinTest, LoadTime)
+{
+	TestModel const model = GenerateTestModel(512);
+
+	SaveTestModel(model, "ModelBinTest.model_bin", false);
+	SaveTestModel(model, "ModelBinTestLZ4.model_bin", true);
+
+	double const legacy_time = TimeLegacyLayout(model);
+	double const raw_time = TimeLoadModel("ModelBinTest.model_bin", model);
+	double const lz4_time = TimeLoadModel("ModelBinTestLZ4.model_bin", model);
+
+	LogInfo("Loading a model of %u vertices: version 15 layout %f ms, uncompressed streams %f ms, LZ4 streams %f ms",
+		model.mesh_base_vertices.back(), legacy_time * 1000, raw_time * 1000, lz4_time * 1000);
+}
@@ -0,0 +1,166 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObject.hpp>
+
+#include <random>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Moves the moveable roots, some of them far enough to leave their nodes or the root
+	void MoveObjects(SceneManager& sm, uint32_t iteration)
+	{
+		std::mt19937 gen(0x0C7EF + iteration);
+		std::uniform_real_distribution<float> offset_dist(-50, 50);
+
+		for (uint32_t i = 0; i < sm.NumSceneObjects(); ++ i)
+		{
+			SceneObjectPtr const & so = sm.GetSceneObject(i);
+			if ((so->Attrib() & SceneObject::SOA_Moveable) && !so->Parent())
+			{
+				float4x4 mat = so->ModelMatrix();
+				float const scale = (gen() % 16 == 0) ? 40.0f : 1.0f;
+				mat(3, 0) += offset_dist(gen) * scale;
+				mat(3, 1) += offset_dist(gen) * scale;
+				mat(3, 2) += offset_dist(gen) * scale;
+				so->ModelMatrix(mat);
+			}
+		}
+	}
+
+	std::vector<float4x4> ModelMatrices(SceneManager const & sm)
+	{
+		std::vector<float4x4> mats(sm.NumSceneObjects());
+		for (uint32_t i = 0; i < mats.size(); ++ i)
+		{
+			mats[i] = sm.GetSceneObject(i)->ModelMatrix();
+		}
+		return mats;
+	}
+
+	void ModelMatrices(SceneManager& sm, std::vector<float4x4> const & mats)
+	{
+		for (uint32_t i = 0; i < mats.size(); ++ i)
+		{
+			sm.GetSceneObject(i)->ModelMatrix(mats[i]);
+		}
+	}
+
+	std::vector<BoundOverlap> VisibleMarks(SceneManager const & sm)
+	{
+		std::vector<BoundOverlap> marks(sm.NumSceneObjects());
+		for (uint32_t i = 0; i < marks.size(); ++ i)
+		{
+			marks[i] = sm.GetSceneObject(i)->VisibleMark();
+		}
+		return marks;
+	}
+
+	// The rebuild mode tests objects against the nodes that overlap them first. A box outside of a different
+	//  frustum plane in each of those nodes can still straddle the frustum, it's culled there but not in
+	//  loose mode.
+	bool OnFrustumBoundary(SceneManager const & sm, uint32_t index)
+	{
+		Frustum const & frustum = Context::Instance().AppInstance().ActiveCamera().ViewFrustum();
+		for (SceneObject const * so = sm.GetSceneObject(index).get(); so; so = so->Parent())
+		{
+			if (BO_Partial == frustum.Intersect(so->PosBoundWS()))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void TestOCTreeCulling(uint32_t num_objs, uint32_t num_children_per_parent)
+	{
+		Camera& camera = Context::Instance().AppInstance().ActiveCamera();
+		camera.ViewParams(float3(0, 0, -200), float3(0, 0, 0));
+		camera.ProjParams(PI / 4, 16.0f / 9, 1, 1000);
+
+		// The plugin is only reached through the SceneManager interface, as in applications
+		if (Context::Instance().Config().scene_manager_name != "OCTree")
+		{
+			Context::Instance().LoadSceneManager("OCTree");
+		}
+		SceneManager& sm = Context::Instance().SceneManagerInstance();
+		sm.ClearObject();
+		for (auto const & so : MakeTestSceneObjects(num_objs, num_children_per_parent))
+		{
+			sm.AddSceneObjectLocked(so);
+		}
+		sm.CullingFrustum(camera.ViewFrustum());
+
+		uint32_t const NUM_ITERATIONS = 10;
+
+		auto const init_mats = ModelMatrices(sm);
+
+		// Both modes run the same movements and read the same marks. The loose tree is kept across the iterations,
+		//  the moved objects are relocated incrementally. The rebuild mode tests the moveable objects against the
+		//  tree of static ones.
+		std::vector<std::vector<BoundOverlap>> loose_marks(NUM_ITERATIONS);
+		std::vector<std::vector<BoundOverlap>> rebuild_marks(NUM_ITERATIONS);
+		double times[2];
+		for (int mode = 0; mode < 2; ++ mode)
+		{
+			bool loose = (0 == mode);
+			auto& marks = loose ? loose_marks : rebuild_marks;
+
+			ModelMatrices(sm, init_mats);
+			sm.SetCustomAttrib("LOOSE_MODE", &loose);
+			times[mode] = AverageMilliseconds(NUM_ITERATIONS, [&sm, &marks](uint32_t i)
+				{
+					MoveObjects(sm, i);
+					sm.ClipScene();
+					marks[i] = VisibleMarks(sm);
+				});
+		}
+
+		// Replays the rebuild mode untimed, the boundary check needs the bounds of each iteration
+		ModelMatrices(sm, init_mats);
+		for (uint32_t i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			MoveObjects(sm, i);
+			sm.ClipScene();
+
+			uint32_t num_visible = 0;
+			for (uint32_t j = 0; j < num_objs; ++ j)
+			{
+				if ((rebuild_marks[i][j] != BO_No) != (loose_marks[i][j] != BO_No))
+				{
+					EXPECT_TRUE((BO_No == rebuild_marks[i][j]) && OnFrustumBoundary(sm, j));
+				}
+				if (loose_marks[i][j] != BO_No)
+				{
+					++ num_visible;
+				}
+			}
+			EXPECT_GT(num_visible, 0U);
+			EXPECT_LT(num_visible, num_objs);
+		}
+
+		sm.ClearObject();
+
+		LogInfo("OCTree ClipScene with %u objects: rebuild mode %f ms, loose mode %f ms", num_objs, times[1], times[0]);
+	}
+}
+
+TEST(OCTreeCullingTest, Flat)
+{
+	TestOCTreeCulling(50000, 0);
+}
+
+TEST(OCTreeCullingTest, Hierarchy)
+{
+	TestOCTreeCulling(50000, 3);
+}
@@ -0,0 +1,145 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/ParticleSystem.hpp>
+
+#include <string>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Only has the per particle Update, the particle system goes through the scalar fallback
+	class PerParticleUpdater : public ParticleUpdater
+	{
+	public:
+		PerParticleUpdater(SceneObjectPtr const & ps, ParticleUpdaterPtr const & updater)
+			: ParticleUpdater(ps), updater_(updater)
+		{
+		}
+
+		std::string const & Type() const override
+		{
+			static std::string const type("per_particle");
+			return type;
+		}
+
+		ParticleUpdaterPtr Clone() override
+		{
+			return MakeSharedPtr<PerParticleUpdater>(ps_.lock(), updater_);
+		}
+
+		using ParticleUpdater::Update;
+		void Update(Particle& par, float elapse_time) override
+		{
+			updater_->Update(par, elapse_time);
+		}
+
+	private:
+		ParticleUpdaterPtr updater_;
+	};
+
+	float const FRAME_TIME = 1.0f / 60;
+
+	ParticleSystemPtr MakeTestParticleSystem(uint32_t num_particles, bool batched)
+	{
+		auto ps = MakeSharedPtr<ParticleSystem>(num_particles);
+		ps->MediaDensity(0.5f);
+		ps->Force(float3(0.1f, 0, 0.05f));
+
+		auto emitter = ps->MakeEmitter("point");
+		// Fills the system in the first frame, and keeps refilling the slots of the dead ones
+		emitter->Frequency(num_particles / FRAME_TIME);
+		emitter->EmitAngle(PI / 3);
+		emitter->MinPosition(float3(-0.1f, -0.1f, -0.1f));
+		emitter->MaxPosition(float3(+0.1f, +0.1f, +0.1f));
+		emitter->MinVelocity(1);
+		emitter->MaxVelocity(2);
+		emitter->MinLife(0.05f);
+		emitter->MaxLife(0.3f);
+		emitter->MinSize(0.1f);
+		emitter->MaxSize(0.2f);
+		ps->AddEmitter(emitter);
+
+		auto polyline = checked_pointer_cast<PolylineParticleUpdater>(ps->MakeUpdater("polyline"));
+		polyline->SizeOverLife({ float2(0, 0.1f), float2(0.3f, 0.5f), float2(1, 1) });
+		polyline->MassOverLife({ float2(0, 1), float2(1, 0.5f) });
+		polyline->OpacityOverLife({ float2(0, 1), float2(0.7f, 0.8f), float2(1, 0) });
+		if (batched)
+		{
+			ps->AddUpdater(polyline);
+		}
+		else
+		{
+			ps->AddUpdater(MakeSharedPtr<PerParticleUpdater>(ps, polyline));
+		}
+
+		return ps;
+	}
+
+	double TimeParticleUpdate(ParticleSystem& ps, int num_frames)
+	{
+		Timer timer;
+		for (int i = 0; i < num_frames; ++ i)
+		{
+			ps.SubThreadUpdate(i * FRAME_TIME, FRAME_TIME);
+		}
+		return timer.elapsed() / num_frames;
+	}
+
+	void TestParticleSystem(uint32_t num_particles)
+	{
+		int const NUM_FRAMES = 30;
+
+		Camera& camera = Context::Instance().AppInstance().ActiveCamera();
+		camera.ViewParams(float3(0, 0, -5), float3(0, 0, 0));
+
+		auto per_particle_ps = MakeTestParticleSystem(num_particles, false);
+		auto batched_ps = MakeTestParticleSystem(num_particles, true);
+
+		double const per_particle_time = TimeParticleUpdate(*per_particle_ps, NUM_FRAMES);
+		double const batched_time = TimeParticleUpdate(*batched_ps, NUM_FRAMES);
+
+		// Both emit the same particles, lives are updated the same way
+		uint32_t const num_active = batched_ps->NumActiveParticles();
+		EXPECT_EQ(per_particle_ps->NumActiveParticles(), num_active);
+		EXPECT_GT(num_active, 0U);
+
+		// The other attributes come from sampled curves in the batched path
+		for (uint32_t i = 0; i < num_particles; i += 97)
+		{
+			Particle const expected = per_particle_ps->GetParticle(i);
+			Particle const par = batched_ps->GetParticle(i);
+			EXPECT_EQ(par.life, expected.life);
+			if (par.life > 0)
+			{
+				EXPECT_NEAR(par.size, expected.size, 0.01f);
+				EXPECT_NEAR(par.alpha, expected.alpha, 0.01f);
+				EXPECT_NEAR(par.pos.x(), expected.pos.x(), 0.01f);
+				EXPECT_NEAR(par.pos.y(), expected.pos.y(), 0.01f);
+				EXPECT_NEAR(par.pos.z(), expected.pos.z(), 0.01f);
+			}
+		}
+
+		LogInfo("Updating %u particles (%u alive): per particle %f ms, batched %f ms", num_particles, num_active,
+			per_particle_time * 1000, batched_time * 1000);
+	}
+}
+
+TEST(ParticleSystemTest, Update100K)
+{
+	TestParticleSystem(100000);
+}
+
+TEST(ParticleSystemTest, Update1M)
+{
+	TestParticleSystem(1000000);
+}
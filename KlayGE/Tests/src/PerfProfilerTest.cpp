@@ -0,0 +1,148 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/PerfProfiler.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	size_t CountOccurrences(std::string const & str, std::string const & pattern)
+	{
+		size_t count = 0;
+		for (size_t pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos + pattern.size()))
+		{
+			++ count;
+		}
+		return count;
+	}
+
+	void NestedZones()
+	{
+		KLAYGE_PERF_ZONE("PerfProfilerTest::Outer");
+		for (int i = 0; i < 2; ++ i)
+		{
+			KLAYGE_PERF_ZONE("PerfProfilerTest::Inner");
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+TEST(PerfProfilerTest, Zones)
+{
+	uint32_t const NUM_THREADS = 3;
+	uint32_t const NUM_FRAMES = 4;
+
+	PerfProfiler& profiler = PerfProfiler::Instance();
+	profiler.EnableZones(true);
+
+	for (uint32_t frame = 0; frame < NUM_FRAMES; ++ frame)
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < NUM_THREADS; ++ i)
+		{
+			threads.emplace_back(NestedZones);
+		}
+		NestedZones();
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		profiler.EndFrame();
+	}
+
+	PerfZoneStats const outer = profiler.ZoneStats("PerfProfilerTest::Outer");
+	PerfZoneStats const inner = profiler.ZoneStats("PerfProfilerTest::Inner");
+	EXPECT_EQ(outer.num_frames, NUM_FRAMES);
+	EXPECT_EQ(inner.num_frames, NUM_FRAMES);
+	// Each frame has 2 inner zones of at least 1 ms on each thread, nested inside the outer ones
+	EXPECT_GE(inner.min_time, 2.0 * (NUM_THREADS + 1));
+	EXPECT_GE(outer.min_time, inner.min_time);
+	EXPECT_LE(outer.min_time, outer.avg_time);
+	EXPECT_LE(outer.avg_time, outer.max_time);
+
+	std::string const file_name = ResLoader::Instance().LocalFolder() + "PerfProfilerTest.json";
+	profiler.ExportToChromeTrace(file_name);
+
+	std::ifstream ifs(file_name.c_str());
+	std::stringstream ss;
+	ss << ifs.rdbuf();
+	std::string const trace = ss.str();
+
+	EXPECT_EQ(trace.find("{\"traceEvents\":["), 0U);
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"PerfProfilerTest::Outer\""), NUM_FRAMES * (NUM_THREADS + 1));
+	EXPECT_EQ(CountOccurrences(trace, "\"name\":\"PerfProfilerTest::Inner\""), 2 * NUM_FRAMES * (NUM_THREADS + 1));
+	EXPECT_EQ(CountOccurrences(trace, "\"depth\":1}"), 2 * NUM_FRAMES * (NUM_THREADS + 1));
+}
+
+TEST(PerfProfilerTest, ThreadBufferReuse)
+{
+	uint32_t const NUM_THREADS = 32;
+
+	PerfProfiler& profiler = PerfProfiler::Instance();
+	profiler.EnableZones(true);
+
+	std::string const file_name = ResLoader::Instance().LocalFolder() + "PerfProfilerTest.json";
+	auto count_threads = [&profiler, &file_name]
+	{
+		profiler.ExportToChromeTrace(file_name);
+
+		std::ifstream ifs(file_name.c_str());
+		std::stringstream ss;
+		ss << ifs.rdbuf();
+		return CountOccurrences(ss.str(), "\"name\":\"thread_name\"");
+	};
+
+	size_t const num_threads_before = count_threads();
+
+	// Each thread exits before the next starts, so they all share one buffer
+	for (uint32_t i = 0; i < NUM_THREADS; ++ i)
+	{
+		std::thread thread(NestedZones);
+		thread.join();
+	}
+	profiler.EndFrame();
+
+	EXPECT_LE(count_threads(), num_threads_before + 1);
+	EXPECT_GE(profiler.ZoneStats("PerfProfilerTest::Outer").num_frames, 1U);
+}
+
+TEST(PerfProfilerTest, ZoneOverhead)
+{
+	uint32_t const NUM_ZONES = 1000000;
+
+	PerfProfiler& profiler = PerfProfiler::Instance();
+
+	profiler.EnableZones(false);
+	Timer timer;
+	for (uint32_t i = 0; i < NUM_ZONES; ++ i)
+	{
+		KLAYGE_PERF_ZONE("PerfProfilerTest::Overhead");
+	}
+	double const disabled_time = timer.elapsed();
+
+	profiler.EnableZones(true);
+	timer.restart();
+	for (uint32_t i = 0; i < NUM_ZONES; ++ i)
+	{
+		KLAYGE_PERF_ZONE("PerfProfilerTest::Overhead");
+	}
+	double const enabled_time = timer.elapsed();
+	profiler.EndFrame();
+
+	EXPECT_EQ(profiler.ZoneStats("PerfProfilerTest::Overhead").num_frames, 1U);
+
+	LogInfo("PerfZone: disabled %f ns, enabled %f ns per zone",
+		disabled_time * 1e9 / NUM_ZONES, enabled_time * 1e9 / NUM_ZONES);
+}
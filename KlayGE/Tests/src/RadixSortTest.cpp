@@ -0,0 +1,100 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/RadixSort.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Same layout as the render queue items of SceneManager
+	struct SortItem
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	void TestRadixSort(uint32_t num, uint32_t num_distinct_high, bool parallel)
+	{
+		std::mt19937 gen(0x5047);
+		std::uniform_int_distribution<uint32_t> high_dist(0, num_distinct_high - 1);
+		std::uniform_real_distribution<float> depth_dist(-100, 1000);
+
+		std::vector<SortItem> items(num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			items[i].key = (static_cast<uint64_t>(high_dist(gen)) << 32) | RadixSortKey(depth_dist(gen));
+			items[i].index = i;
+		}
+
+		std::vector<SortItem> expected = items;
+		Timer timer;
+		std::stable_sort(expected.begin(), expected.end(),
+			[](SortItem const & lhs, SortItem const & rhs)
+			{
+				return lhs.key < rhs.key;
+			});
+		double const std_time = timer.elapsed();
+
+		std::vector<SortItem> tmp(num);
+		timer.restart();
+		RadixSort(items.data(), tmp.data(), num,
+			[](SortItem const & item)
+			{
+				return item.key;
+			},
+			parallel ? &Context::Instance().TaskScheduler() : nullptr);
+		double const radix_time = timer.elapsed();
+
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			EXPECT_EQ(items[i].key, expected[i].key);
+			EXPECT_EQ(items[i].index, expected[i].index);
+		}
+
+		LogInfo("Sorting %u items: std::stable_sort %f ms, %s radix sort %f ms", num, std_time * 1000,
+			parallel ? "parallel" : "serial", radix_time * 1000);
+	}
+}
+
+TEST(RadixSortTest, FloatKeys)
+{
+	std::vector<float> values = { 3.5f, -1, 0, -0.0f, 1e-20f, -1e20f, 1e20f, 2 };
+	std::vector<float> expected = values;
+	std::stable_sort(expected.begin(), expected.end());
+
+	std::vector<float> tmp(values.size());
+	RadixSort(values.data(), tmp.data(), static_cast<uint32_t>(values.size()),
+		[](float v)
+		{
+			return RadixSortKey(v);
+		});
+
+	for (size_t i = 0; i < values.size(); ++ i)
+	{
+		EXPECT_EQ(values[i], expected[i]);
+	}
+}
+
+TEST(RadixSortTest, SmallSerial)
+{
+	TestRadixSort(1000, 8, false);
+}
+
+TEST(RadixSortTest, LargeSerial)
+{
+	TestRadixSort(1000000, 64, false);
+}
+
+TEST(RadixSortTest, LargeParallel)
+{
+	TestRadixSort(1000000, 64, true);
+}
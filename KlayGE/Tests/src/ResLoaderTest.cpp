@@ -1,6 +1,10 @@
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/Hash.hpp>
 #include <KlayGE/ResLoader.hpp>
 
+#include <future>
+#include <mutex>
+
 #include "KlayGETests.hpp"
 
 using namespace KlayGE;
@@ -97,3 +101,144 @@ TEST(ResLoaderTest, MountUnmountInsideEncrypt7zPath)
 	ResLoader::Instance().Unmount("ResLoaderTestData", "../../Tests/media/ResLoader/TestPassword.7z|1234/ResLoader");
 	EXPECT_TRUE(ResLoader::Instance().Locate("ResLoaderTestData/Test.txt").empty());
 }
+
+namespace
+{
+	class TestLoadingDesc : public ResLoadingDesc
+	{
+	public:
+		TestLoadingDesc(std::string const & name, std::shared_future<void> const & gate,
+				std::vector<std::string>& loaded_names, std::mutex& loaded_mutex)
+			: name_(name), gate_(gate), loaded_names_(&loaded_names), loaded_mutex_(&loaded_mutex)
+		{
+		}
+
+		uint64_t Type() const override
+		{
+			static uint64_t const type = CT_HASH("TestLoadingDesc");
+			return type;
+		}
+
+		std::string_view Name() const override
+		{
+			return name_;
+		}
+
+		bool StateLess() const override
+		{
+			return true;
+		}
+
+		std::shared_ptr<void> CreateResource() override
+		{
+			res_ = MakeSharedPtr<int>(0);
+			return res_;
+		}
+
+		void SubThreadStage() override
+		{
+			gate_.wait();
+
+			std::lock_guard<std::mutex> lock(*loaded_mutex_);
+			loaded_names_->push_back(name_);
+		}
+
+		void MainThreadStage() override
+		{
+			*res_ = 1;
+		}
+
+		bool HasSubThreadStage() const override
+		{
+			return true;
+		}
+
+		bool Match(ResLoadingDesc const & rhs) const override
+		{
+			return (this->Type() == rhs.Type()) && (this->Name() == rhs.Name());
+		}
+
+		void CopyDataFrom(ResLoadingDesc const & rhs) override
+		{
+			TestLoadingDesc const & tld = static_cast<TestLoadingDesc const &>(rhs);
+			name_ = tld.name_;
+			res_ = tld.res_;
+		}
+
+		std::shared_ptr<void> CloneResourceFrom(std::shared_ptr<void> const & resource) override
+		{
+			return resource;
+		}
+
+		std::shared_ptr<void> Resource() const override
+		{
+			return res_;
+		}
+
+	private:
+		std::string name_;
+		std::shared_future<void> gate_;
+		std::vector<std::string>* loaded_names_;
+		std::mutex* loaded_mutex_;
+		std::shared_ptr<int> res_;
+	};
+}
+
+TEST(ResLoaderTest, ASyncQueryPriorityCancel)
+{
+	ResLoader& rl = ResLoader::Instance();
+	uint32_t const num_threads = rl.NumLoadingThreads();
+	rl.NumLoadingThreads(1);
+
+	std::promise<void> gate;
+	std::shared_future<void> gate_future = gate.get_future().share();
+	std::shared_future<void> open_future;
+	{
+		std::promise<void> opened;
+		opened.set_value();
+		open_future = opened.get_future().share();
+	}
+
+	std::vector<std::string> loaded_names;
+	std::mutex loaded_mutex;
+
+	// Occupies the only loading thread until the others are queued
+	auto blocker = rl.ASyncQueryT<int>(MakeSharedPtr<TestLoadingDesc>("Blocker", gate_future, loaded_names, loaded_mutex));
+	while (rl.Stats().queue_depth > 0)
+	{
+		std::this_thread::yield();
+	}
+
+	auto low = rl.ASyncQueryT<int>(MakeSharedPtr<TestLoadingDesc>("Low", open_future, loaded_names, loaded_mutex), 0);
+	auto high = rl.ASyncQueryT<int>(MakeSharedPtr<TestLoadingDesc>("High", open_future, loaded_names, loaded_mutex), 10);
+	auto dropped = rl.ASyncQueryT<int>(MakeSharedPtr<TestLoadingDesc>("Dropped", open_future, loaded_names, loaded_mutex), 20);
+	rl.Unload(dropped);
+
+	// Still loaded for the remaining requester after the other one unloads it
+	auto shared = rl.ASyncQueryT<int>(MakeSharedPtr<TestLoadingDesc>("Shared", open_future, loaded_names, loaded_mutex), 5);
+	auto shared_dup = rl.ASyncQueryT<int>(MakeSharedPtr<TestLoadingDesc>("Shared", open_future, loaded_names, loaded_mutex), 5);
+	rl.Unload(shared_dup);
+
+	ResLoader::Statistics const stats_before = rl.Stats();
+	gate.set_value();
+
+	while ((*blocker == 0) || (*low == 0) || (*high == 0) || (*shared == 0))
+	{
+		rl.Update();
+		std::this_thread::yield();
+	}
+
+	ResLoader::Statistics const stats_after = rl.Stats();
+
+	ASSERT_EQ(loaded_names.size(), 4U);
+	EXPECT_EQ(loaded_names[0], "Blocker");
+	EXPECT_EQ(loaded_names[1], "High");
+	EXPECT_EQ(loaded_names[2], "Shared");
+	EXPECT_EQ(loaded_names[3], "Low");
+	EXPECT_EQ(*dropped, 0);
+	EXPECT_EQ(stats_after.num_completed - stats_before.num_completed, 4U);
+	EXPECT_EQ(stats_after.num_cancelled - stats_before.num_cancelled, 1U);
+	EXPECT_EQ(stats_after.queue_depth, 0U);
+
+	rl.NumLoadingThreads(num_threads);
+}
@@ -0,0 +1,156 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObject.hpp>
+
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Owns its objects directly, so the culling paths of SceneManager can be compared without a scene plugin
+	class CullingTestSceneManager : public SceneManager
+	{
+	public:
+		explicit CullingTestSceneManager(bool cull_left_half)
+			: cull_left_half_(cull_left_half)
+		{
+		}
+
+		void Populate(uint32_t num_objs, uint32_t num_children_per_parent)
+		{
+			scene_objs_ = MakeTestSceneObjects(num_objs, num_children_per_parent);
+		}
+
+		// Stands for a subclass with its own culling, such as occlusion
+		BoundOverlap AABBVisible(AABBox const & aabb) const override
+		{
+			if (cull_left_half_ && (aabb.Max().x() < 0))
+			{
+				return BO_No;
+			}
+			return SceneManager::AABBVisible(aabb);
+		}
+
+		void Clip(bool parallel)
+		{
+			frustum_ = &Context::Instance().AppInstance().ActiveCamera().ViewFrustum();
+			if (parallel)
+			{
+				this->ClipSceneParallel();
+			}
+			else
+			{
+				this->ClipSceneSerial();
+			}
+		}
+
+		std::vector<BoundOverlap> VisibleMarks() const
+		{
+			std::vector<BoundOverlap> marks(scene_objs_.size());
+			for (size_t i = 0; i < scene_objs_.size(); ++ i)
+			{
+				marks[i] = scene_objs_[i]->VisibleMark();
+			}
+			return marks;
+		}
+
+	private:
+		void OnAddSceneObject(SceneObjectPtr const & obj) override
+		{
+			KFL_UNUSED(obj);
+		}
+		void OnDelSceneObject(std::vector<SceneObjectPtr>::iterator iter) override
+		{
+			KFL_UNUSED(iter);
+		}
+		void DoSuspend() override
+		{
+		}
+		void DoResume() override
+		{
+		}
+
+	private:
+		bool cull_left_half_;
+	};
+
+	void TestSceneCulling(uint32_t num_objs, uint32_t num_children_per_parent, float small_obj_threshold, bool omni_dir,
+		bool cull_left_half = false)
+	{
+		Camera& camera = Context::Instance().AppInstance().ActiveCamera();
+		camera.ViewParams(float3(0, 0, -200), float3(0, 0, 0));
+		camera.ProjParams(PI / 4, 16.0f / 9, 1, 1000);
+		camera.OmniDirectionalMode(omni_dir);
+
+		CullingTestSceneManager sm(cull_left_half);
+		sm.SmallObjectThreshold(small_obj_threshold);
+		sm.Populate(num_objs, num_children_per_parent);
+
+		uint32_t const NUM_ITERATIONS = 10;
+
+		double const serial_time = AverageMilliseconds(NUM_ITERATIONS, [&sm](uint32_t i)
+			{
+				KFL_UNUSED(i);
+				sm.Clip(false);
+			});
+		auto const serial_marks = sm.VisibleMarks();
+
+		double const parallel_time = AverageMilliseconds(NUM_ITERATIONS, [&sm](uint32_t i)
+			{
+				KFL_UNUSED(i);
+				sm.Clip(true);
+			});
+		auto const parallel_marks = sm.VisibleMarks();
+
+		camera.OmniDirectionalMode(false);
+
+		EXPECT_TRUE(serial_marks == parallel_marks);
+		if (cull_left_half)
+		{
+			for (uint32_t i = 0; i < num_objs; ++ i)
+			{
+				SceneObjectPtr const & so = sm.GetSceneObject(i);
+				if (!so->Parent() && (so->PosBoundWS().Max().x() < 0))
+				{
+					EXPECT_EQ(BO_No, parallel_marks[i]);
+				}
+			}
+		}
+
+		LogInfo("ClipScene with %u objects: serial %f ms, parallel %f ms", num_objs, serial_time, parallel_time);
+	}
+}
+
+TEST(SceneCullingTest, Flat)
+{
+	TestSceneCulling(50000, 0, 0, false);
+}
+
+TEST(SceneCullingTest, Hierarchy)
+{
+	TestSceneCulling(50000, 3, 0, false);
+}
+
+TEST(SceneCullingTest, SmallObjects)
+{
+	TestSceneCulling(50000, 3, 0.5f, false);
+}
+
+TEST(SceneCullingTest, OmniDirectional)
+{
+	TestSceneCulling(50000, 3, 0.5f, true);
+}
+
+TEST(SceneCullingTest, AABBVisibleOverride)
+{
+	TestSceneCulling(50000, 3, 0, false, true);
+}
@@ -0,0 +1,154 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Drives SubThreadUpdate of its objects directly, without rendering frames
+	class UpdateTestSceneManager : public SceneManager
+	{
+	public:
+		void Populate(uint32_t num_objs, uint32_t work_per_update)
+		{
+			RenderablePtr const box = MakeTestBox();
+
+			for (uint32_t i = 0; i < num_objs; ++ i)
+			{
+				auto so = MakeSharedPtr<SceneObjectHelper>(box, SceneObject::SOA_Cullable | SceneObject::SOA_Moveable);
+				so->BindSubThreadUpdateFunc([work_per_update](SceneObject& obj, float app_time, float elapsed_time)
+					{
+						KFL_UNUSED(elapsed_time);
+
+						float4x4 mat = obj.ModelMatrix();
+						float const x = mat(3, 0) + 1;
+						if (work_per_update > 0)
+						{
+							mat = float4x4::Identity();
+							for (uint32_t j = 0; j < work_per_update; ++ j)
+							{
+								mat *= MathLib::rotation_y(app_time + j);
+							}
+						}
+						// Counts the updates in the translation
+						mat(3, 0) = x;
+						obj.ModelMatrix(mat);
+					});
+				scene_objs_.push_back(so);
+			}
+		}
+
+		void Tick()
+		{
+			this->KickSubThreadUpdate();
+		}
+
+		void Sync()
+		{
+			this->SyncSubThreadUpdate();
+		}
+
+	private:
+		void OnAddSceneObject(SceneObjectPtr const & obj) override
+		{
+			KFL_UNUSED(obj);
+		}
+		void OnDelSceneObject(std::vector<SceneObjectPtr>::iterator iter) override
+		{
+			KFL_UNUSED(iter);
+		}
+		void DoSuspend() override
+		{
+		}
+		void DoResume() override
+		{
+		}
+	};
+
+	double TimeUpdate(bool parallel, float& stall_time)
+	{
+		uint32_t const NUM_ITERATIONS = 10;
+
+		UpdateTestSceneManager sm;
+		sm.ParallelSubThreadUpdate(parallel);
+		sm.Populate(10000, 16);
+
+		stall_time = 0;
+		double const update_time = AverageMilliseconds(NUM_ITERATIONS, [&sm, &stall_time](uint32_t i)
+			{
+				KFL_UNUSED(i);
+				sm.Tick();
+				sm.Sync();
+				stall_time += sm.MainThreadStallTime();
+			});
+		stall_time /= NUM_ITERATIONS;
+		return update_time;
+	}
+}
+
+TEST(SceneUpdateTest, DoubleBuffering)
+{
+	UpdateTestSceneManager sm;
+	sm.Populate(1000, 0);
+
+	SceneObjectPtr const extra = MakeSharedPtr<SceneObjectHelper>(SceneObject::SOA_Moveable);
+	bool extra_added = false;
+	sm.GetSceneObject(0)->BindSubThreadUpdateFunc([&sm, &extra, &extra_added](SceneObject& obj, float /*app_time*/, float /*elapsed_time*/)
+		{
+			obj.ModelMatrix(obj.ModelMatrix() * MathLib::translation(1.0f, 0.0f, 0.0f));
+
+			if (!extra_added)
+			{
+				sm.AddSceneObject(extra);
+				extra_added = true;
+			}
+		});
+
+	bool const has_workers = Context::Instance().TaskScheduler().num_workers() > 0;
+
+	for (int tick = 0; tick < 3; ++ tick)
+	{
+		sm.Tick();
+
+		// Nothing is visible to the main thread before the frame boundary
+		for (uint32_t i = 0; i < 1000; ++ i)
+		{
+			EXPECT_EQ(static_cast<float>(tick), sm.GetSceneObject(i)->ModelMatrix()(3, 0));
+		}
+		if (has_workers && (0 == tick))
+		{
+			EXPECT_EQ(1000U, sm.NumSceneObjects());
+		}
+
+		sm.Sync();
+
+		for (uint32_t i = 0; i < 1000; ++ i)
+		{
+			EXPECT_EQ(static_cast<float>(tick + 1), sm.GetSceneObject(i)->ModelMatrix()(3, 0));
+		}
+		if (0 == tick)
+		{
+			EXPECT_EQ(1001U, sm.NumSceneObjects());
+		}
+	}
+}
+
+TEST(SceneUpdateTest, UpdateTime)
+{
+	float serial_stall_time;
+	double const serial_time = TimeUpdate(false, serial_stall_time);
+	float parallel_stall_time;
+	double const parallel_time = TimeUpdate(true, parallel_stall_time);
+
+	LogInfo("SubThreadUpdate of 10000 objects: serial %f ms (main thread stall %f ms), parallel %f ms (main thread stall %f ms)",
+		serial_time, serial_stall_time * 1000, parallel_time, parallel_stall_time * 1000);
+}
@@ -0,0 +1,90 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/TaskScheduler.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <atomic>
+#include <numeric>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+TEST(TaskSchedulerTest, ParallelFor)
+{
+	task_scheduler& ts = Context::Instance().TaskScheduler();
+
+	std::vector<uint32_t> values(100000, 0);
+	ts.parallel_for(0, static_cast<uint32_t>(values.size()), 0, [&values](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++ i)
+			{
+				values[i] = i;
+			}
+		});
+
+	for (uint32_t i = 0; i < values.size(); ++ i)
+	{
+		EXPECT_EQ(values[i], i);
+	}
+}
+
+TEST(TaskSchedulerTest, NestedParallelFor)
+{
+	task_scheduler& ts = Context::Instance().TaskScheduler();
+
+	std::atomic<uint32_t> count(0);
+	ts.parallel_for(0, 64, 1, [&ts, &count](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++ i)
+			{
+				ts.parallel_for(0, 64, 1, [&count](uint32_t inner_begin, uint32_t inner_end)
+					{
+						count += inner_end - inner_begin;
+					});
+			}
+		});
+
+	EXPECT_EQ(count, 64U * 64U);
+}
+
+TEST(TaskSchedulerTest, Continuation)
+{
+	task_scheduler& ts = Context::Instance().TaskScheduler();
+
+	std::atomic<int> order(0);
+	int a = -1;
+	int b = -1;
+	int c = -1;
+	auto task_a = ts.schedule([&] { a = order ++; });
+	auto task_b = ts.continue_with(task_a, [&] { b = order ++; });
+	auto task_c = ts.when_all({ task_a, task_b }, [&] { c = order ++; });
+	ts.wait(task_c);
+
+	EXPECT_TRUE(ts.is_done(task_a));
+	EXPECT_TRUE(ts.is_done(task_b));
+	EXPECT_EQ(a, 0);
+	EXPECT_EQ(b, 1);
+	EXPECT_EQ(c, 2);
+}
+
+TEST(TaskSchedulerTest, TaskGroup)
+{
+	task_scheduler ts(3);
+
+	std::vector<int> results(16, 0);
+	{
+		task_group group(ts);
+		for (size_t i = 0; i < results.size(); ++ i)
+		{
+			group.run([&results, i] { results[i] = static_cast<int>(i * i); });
+		}
+		group.wait();
+	}
+
+	for (size_t i = 0; i < results.size(); ++ i)
+	{
+		EXPECT_EQ(results[i], static_cast<int>(i * i));
+	}
+}
@@ -0,0 +1,273 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/RenderableHelper.hpp>
+#include <KlayGE/SceneObjectHelper.hpp>
+#include <KlayGE/TransformHierarchy.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	float4x4 RandomMatrix(std::mt19937& gen)
+	{
+		std::uniform_real_distribution<float> angle_dist(-PI, PI);
+		std::uniform_real_distribution<float> pos_dist(-10, 10);
+		std::uniform_real_distribution<float> scale_dist(0.5f, 2);
+
+		return MathLib::scaling(float3(scale_dist(gen), scale_dist(gen), scale_dist(gen)))
+			* MathLib::rotation_y(angle_dist(gen)) * MathLib::rotation_x(angle_dist(gen))
+			* MathLib::translation(pos_dist(gen), pos_dist(gen), pos_dist(gen));
+	}
+
+	AABBox TransformCorners(AABBox const & aabb, float4x4 const & mat)
+	{
+		float3 min_pt = MathLib::transform_coord(aabb.Corner(0), mat);
+		float3 max_pt = min_pt;
+		for (size_t i = 1; i < 8; ++ i)
+		{
+			float3 const v = MathLib::transform_coord(aabb.Corner(i), mat);
+			min_pt = MathLib::minimize(min_pt, v);
+			max_pt = MathLib::maximize(max_pt, v);
+		}
+		return AABBox(min_pt, max_pt);
+	}
+
+	void ExpectNear(float4x4 const & expected, float4x4 const & actual)
+	{
+		for (size_t i = 0; i < float4x4::size(); ++ i)
+		{
+			EXPECT_NEAR(expected[i], actual[i], 1e-3f * std::max(1.0f, std::abs(expected[i])));
+		}
+	}
+
+	void ExpectNear(AABBox const & expected, AABBox const & actual)
+	{
+		for (size_t i = 0; i < 3; ++ i)
+		{
+			EXPECT_NEAR(expected.Min()[i], actual.Min()[i], 1e-3f * std::max(1.0f, std::abs(expected.Min()[i])));
+			EXPECT_NEAR(expected.Max()[i], actual.Max()[i], 1e-3f * std::max(1.0f, std::abs(expected.Max()[i])));
+		}
+	}
+}
+
+TEST(TransformHierarchyTest, WorldTransforms)
+{
+	uint32_t const NUM_NODES = 1000;
+
+	std::mt19937 gen(0x7AF0);
+	AABBox const bound(float3(-1, -2, -3), float3(2, 1, 0.5f));
+
+	TransformHierarchy hierarchy;
+	std::vector<uint32_t> handles(NUM_NODES);
+	std::vector<int> parents(NUM_NODES);
+	std::vector<float4x4> locals(NUM_NODES);
+	for (uint32_t i = 0; i < NUM_NODES; ++ i)
+	{
+		parents[i] = (i % 10 == 0) ? -1 : static_cast<int>(gen() % i);
+		locals[i] = RandomMatrix(gen);
+		handles[i] = hierarchy.AddNode(nullptr,
+			(parents[i] < 0) ? TransformHierarchy::INVALID_HANDLE : handles[parents[i]], locals[i]);
+		hierarchy.LocalBound(handles[i], bound);
+	}
+
+	// Children of a deleted node become roots
+	uint32_t const deleted = 3;
+	hierarchy.DelNode(handles[deleted]);
+	EXPECT_EQ(NUM_NODES - 1, hierarchy.NumNodes());
+
+	hierarchy.Update();
+	EXPECT_EQ(NUM_NODES - 1, hierarchy.UpdatedOwners().size());
+
+	std::vector<float4x4> worlds(NUM_NODES);
+	for (uint32_t i = 0; i < NUM_NODES; ++ i)
+	{
+		if (i != deleted)
+		{
+			int const parent = (parents[i] == static_cast<int>(deleted)) ? -1 : parents[i];
+			worlds[i] = (parent < 0) ? locals[i] : worlds[parent] * locals[i];
+
+			ExpectNear(worlds[i], hierarchy.WorldMatrix(handles[i]));
+			ExpectNear(TransformCorners(bound, worlds[i]), hierarchy.WorldBound(handles[i]));
+		}
+	}
+}
+
+TEST(TransformHierarchyTest, LateParents)
+{
+	uint32_t const NUM_NODES = 1000;
+
+	std::mt19937 gen(0x7AF3);
+
+	// Every node gets a parent added after it, as children attached before their parents do
+	TransformHierarchy hierarchy;
+	std::vector<uint32_t> handles(NUM_NODES);
+	std::vector<int> parents(NUM_NODES);
+	std::vector<float4x4> locals(NUM_NODES);
+	for (uint32_t i = 0; i < NUM_NODES; ++ i)
+	{
+		locals[i] = RandomMatrix(gen);
+		handles[i] = hierarchy.AddNode(nullptr, TransformHierarchy::INVALID_HANDLE, locals[i]);
+	}
+	for (uint32_t i = 0; i < NUM_NODES; ++ i)
+	{
+		parents[i] = (i % 10 == 9) ? -1 : static_cast<int>(i + 1 + gen() % (NUM_NODES - 1 - i));
+		if (parents[i] >= 0)
+		{
+			hierarchy.Parent(handles[i], handles[parents[i]]);
+		}
+	}
+
+	// Children of the deleted nodes become roots
+	uint32_t const deleted[] = { NUM_NODES / 2, NUM_NODES - 1 };
+	for (auto index : deleted)
+	{
+		hierarchy.DelNode(handles[index]);
+	}
+	EXPECT_EQ(NUM_NODES - std::size(deleted), hierarchy.NumNodes());
+
+	hierarchy.Update();
+	EXPECT_EQ(NUM_NODES - std::size(deleted), hierarchy.UpdatedOwners().size());
+
+	std::vector<float4x4> worlds(NUM_NODES);
+	for (uint32_t i = NUM_NODES; i > 0; -- i)
+	{
+		uint32_t const index = i - 1;
+		if (std::find(std::begin(deleted), std::end(deleted), index) == std::end(deleted))
+		{
+			int parent = parents[index];
+			if (std::find(std::begin(deleted), std::end(deleted), static_cast<uint32_t>(parent)) != std::end(deleted))
+			{
+				parent = -1;
+			}
+			worlds[index] = (parent < 0) ? locals[index] : worlds[parent] * locals[index];
+
+			ExpectNear(worlds[index], hierarchy.WorldMatrix(handles[index]));
+		}
+	}
+}
+
+TEST(TransformHierarchyTest, DirtySubtrees)
+{
+	uint32_t const NUM_CHAINS = 10;
+	uint32_t const CHAIN_LENGTH = 8;
+
+	std::mt19937 gen(0x7AF1);
+
+	TransformHierarchy hierarchy;
+	std::vector<uint32_t> handles;
+	for (uint32_t c = 0; c < NUM_CHAINS; ++ c)
+	{
+		uint32_t parent = TransformHierarchy::INVALID_HANDLE;
+		for (uint32_t i = 0; i < CHAIN_LENGTH; ++ i)
+		{
+			parent = hierarchy.AddNode(nullptr, parent, RandomMatrix(gen));
+			handles.push_back(parent);
+		}
+	}
+
+	hierarchy.Update();
+	EXPECT_EQ(NUM_CHAINS * CHAIN_LENGTH, hierarchy.UpdatedOwners().size());
+
+	hierarchy.Update();
+	EXPECT_EQ(0U, hierarchy.UpdatedOwners().size());
+
+	// Setting the same matrix doesn't dirty the node
+	hierarchy.LocalMatrix(handles[0], float4x4(hierarchy.LocalMatrix(handles[0])));
+	hierarchy.Update();
+	EXPECT_EQ(0U, hierarchy.UpdatedOwners().size());
+
+	// Moving the third node of a chain updates it and the nodes below
+	uint32_t const moved = 2 * CHAIN_LENGTH + 2;
+	float4x4 const parent_world = hierarchy.WorldMatrix(handles[moved - 1]);
+	float4x4 const mat = MathLib::translation(1.0f, 2.0f, 3.0f);
+	hierarchy.LocalMatrix(handles[moved], mat);
+	hierarchy.Update();
+	EXPECT_EQ(CHAIN_LENGTH - 2, hierarchy.UpdatedOwners().size());
+	ExpectNear(parent_world * mat, hierarchy.WorldMatrix(handles[moved]));
+}
+
+TEST(TransformHierarchyTest, UpdateTime)
+{
+	uint32_t const NUM_OBJS = 50000;
+	uint32_t const CHAIN_LENGTH = 8;
+	int const NUM_ITERATIONS = 10;
+
+	std::mt19937 gen(0x7AF2);
+
+	RenderablePtr box = MakeSharedPtr<RenderableTriBox>(
+		MathLib::convert_to_obbox(AABBox(float3(-1, -1, -1), float3(1, 1, 1))),
+		Color(1, 1, 1, 1));
+
+	// Declared before the objects, which detach from it when destructed
+	TransformHierarchy hierarchy;
+
+	std::vector<SceneObjectPtr> objs(NUM_OBJS);
+	for (uint32_t i = 0; i < NUM_OBJS; ++ i)
+	{
+		objs[i] = MakeSharedPtr<SceneObjectHelper>(box, SceneObject::SOA_Cullable | SceneObject::SOA_Moveable);
+		objs[i]->ModelMatrix(RandomMatrix(gen));
+		if (i % CHAIN_LENGTH != 0)
+		{
+			objs[i]->Parent(objs[i - 1].get());
+		}
+	}
+
+	// Every root moves in every iteration, so all the world transforms are recomputed
+	auto move_roots = [&objs](int iteration)
+	{
+		for (uint32_t i = 0; i < NUM_OBJS; i += CHAIN_LENGTH)
+		{
+			float4x4 mat = objs[i]->ModelMatrix();
+			mat(3, 0) = static_cast<float>(iteration);
+			objs[i]->ModelMatrix(mat);
+		}
+	};
+
+	Timer timer;
+	for (int i = 0; i < NUM_ITERATIONS; ++ i)
+	{
+		move_roots(i);
+		for (auto const & obj : objs)
+		{
+			obj->UpdateAbsModelMatrix();
+		}
+	}
+	double const per_object_time = timer.elapsed() / NUM_ITERATIONS;
+
+	for (auto const & obj : objs)
+	{
+		obj->AttachTransform(&hierarchy);
+	}
+	hierarchy.Update();
+
+	timer.restart();
+	for (int i = 0; i < NUM_ITERATIONS; ++ i)
+	{
+		move_roots(NUM_ITERATIONS + i);
+		for (auto const & obj : objs)
+		{
+			obj->QueueAbsModelMatrixUpdate();
+		}
+		hierarchy.Update();
+		for (auto so : hierarchy.UpdatedOwners())
+		{
+			so->OnAbsModelMatrixUpdated();
+		}
+	}
+	double const batched_time = timer.elapsed() / NUM_ITERATIONS;
+
+	EXPECT_EQ(NUM_OBJS, hierarchy.UpdatedOwners().size());
+
+	LogInfo("World transforms of %u objects in chains of %u: per object %f ms, transform hierarchy %f ms",
+		NUM_OBJS, CHAIN_LENGTH, per_object_time * 1000, batched_time * 1000);
+}
@@ -0,0 +1,96 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Log.hpp>
+#include <KFL/TaskScheduler.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/GraphicsBuffer.hpp>
+#include <KlayGE/TransientBuffer.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Quads of the size of UIManager::VertexFormat ones
+	uint32_t const QUAD_SIZE = 4 * 24;
+
+	double TimeAllocs(TransientBuffer& tb, uint32_t num_allocs, std::vector<SubAlloc>& allocs)
+	{
+		std::vector<uint8_t> quad(QUAD_SIZE, 0);
+
+		allocs.resize(num_allocs);
+		Timer timer;
+		for (uint32_t i = 0; i < num_allocs; ++ i)
+		{
+			allocs[i] = tb.Alloc(QUAD_SIZE, quad.data());
+		}
+		for (uint32_t i = 0; i < num_allocs; ++ i)
+		{
+			tb.Dealloc(allocs[i]);
+		}
+		tb.EnsureDataReady();
+		return timer.elapsed();
+	}
+
+	void CheckNoOverlap(std::vector<SubAlloc> allocs, uint32_t buffer_size)
+	{
+		std::sort(allocs.begin(), allocs.end(),
+			[](SubAlloc const & lhs, SubAlloc const & rhs)
+			{
+				return lhs.offset_ < rhs.offset_;
+			});
+		for (size_t i = 0; i < allocs.size(); ++ i)
+		{
+			EXPECT_LE(allocs[i].offset_ + allocs[i].length_, buffer_size);
+			if (i > 0)
+			{
+				EXPECT_LE(allocs[i - 1].offset_ + allocs[i - 1].length_, allocs[i].offset_);
+			}
+		}
+	}
+}
+
+TEST(TransientBufferTest, FreeListVsRing)
+{
+	uint32_t const NUM_ALLOCS = 20000;
+
+	TransientBuffer free_list_tb(1024 * QUAD_SIZE, TransientBuffer::BF_Vertex, TransientBuffer::AM_FreeList);
+	TransientBuffer ring_tb(1024 * QUAD_SIZE, TransientBuffer::BF_Vertex, TransientBuffer::AM_Ring);
+
+	std::vector<SubAlloc> allocs;
+	double const free_list_time = TimeAllocs(free_list_tb, NUM_ALLOCS, allocs);
+	double const ring_time = TimeAllocs(ring_tb, NUM_ALLOCS, allocs);
+	CheckNoOverlap(allocs, ring_tb.GetBuffer()->Size());
+
+	LogInfo("%u allocs of %u bytes: free list %f ms, ring %f ms, %u wrap stalls", NUM_ALLOCS, QUAD_SIZE,
+		free_list_time * 1000, ring_time * 1000, ring_tb.NumWrapStalls());
+}
+
+TEST(TransientBufferTest, ConcurrentRingAllocs)
+{
+	uint32_t const NUM_ALLOCS = 100000;
+
+	// Small enough to grow several times in the middle of the allocs
+	TransientBuffer tb(64 * QUAD_SIZE, TransientBuffer::BF_Vertex, TransientBuffer::AM_Ring);
+
+	std::vector<uint8_t> quad(QUAD_SIZE, 0);
+	std::vector<SubAlloc> allocs(NUM_ALLOCS);
+	Context::Instance().TaskScheduler().parallel_for(0, NUM_ALLOCS, 0,
+		[&tb, &quad, &allocs](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++ i)
+			{
+				allocs[i] = tb.Alloc(QUAD_SIZE, quad.data());
+			}
+		});
+	tb.EnsureDataReady();
+
+	EXPECT_GT(tb.NumWrapStalls(), 0U);
+	EXPECT_GE(tb.GetBuffer()->Size(), NUM_ALLOCS * QUAD_SIZE);
+	CheckNoOverlap(allocs, tb.GetBuffer()->Size());
+}
@@ -0,0 +1,94 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/Log.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/UI.hpp>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	UIDialogPtr const & TestDialog()
+	{
+		UIManager& ui_mgr = UIManager::Instance();
+		if (!ui_mgr.GetDialog("UIRenderTest"))
+		{
+			ui_mgr.Load(ResLoader::Instance().Open("UIRenderTest.uiml"));
+		}
+		return ui_mgr.GetDialog("UIRenderTest");
+	}
+
+	double TimeRender(UIDialog& dialog, bool force_rebuild)
+	{
+		int const NUM_ITERATIONS = 100;
+
+		Timer timer;
+		for (int i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			if (force_rebuild)
+			{
+				dialog.MarkDirty();
+			}
+			UIManager::Instance().Render();
+		}
+		double const time = timer.elapsed() / NUM_ITERATIONS;
+
+		// Nothing presents the frames here, drop the overlays UIManager::Render keeps adding
+		Context::Instance().SceneManagerInstance().ClearObject();
+
+		return time;
+	}
+}
+
+TEST(UIRenderTest, DirtyTracking)
+{
+	UIDialogPtr const & dialog = TestDialog();
+	ASSERT_TRUE(dialog);
+
+	UIManager::Instance().Render();
+	EXPECT_FALSE(dialog->Dirty());
+
+	UIManager::Instance().Render();
+	EXPECT_FALSE(dialog->Dirty());
+
+	dialog->Control<UIStatic>(dialog->IDFromName("Label"))->SetText(L"Changed");
+	EXPECT_TRUE(dialog->Dirty());
+	UIManager::Instance().Render();
+	EXPECT_FALSE(dialog->Dirty());
+
+	dialog->Control<UISlider>(dialog->IDFromName("Slider"))->SetValue(75);
+	EXPECT_TRUE(dialog->Dirty());
+	UIManager::Instance().Render();
+	EXPECT_FALSE(dialog->Dirty());
+
+	dialog->SetLocation(10, 10);
+	EXPECT_TRUE(dialog->Dirty());
+	UIManager::Instance().Render();
+	EXPECT_FALSE(dialog->Dirty());
+
+	// A focused edit box blinks its caret, so the dialog regenerates while it has the focus
+	auto edit_box = dialog->Control<UIEditBox>(dialog->IDFromName("EditBox"));
+	dialog->RequestFocus(*edit_box);
+	EXPECT_TRUE(dialog->Animating());
+	dialog->ClearFocus();
+	EXPECT_FALSE(dialog->Animating());
+
+	Context::Instance().SceneManagerInstance().ClearObject();
+}
+
+TEST(UIRenderTest, RenderTime)
+{
+	UIDialogPtr const & dialog = TestDialog();
+	ASSERT_TRUE(dialog);
+
+	double const rebuild_time = TimeRender(*dialog, true);
+	double const retained_time = TimeRender(*dialog, false);
+
+	LogInfo("UIManager::Render of one dialog: regenerating every frame %f ms, retained geometry %f ms",
+		rebuild_time * 1000, retained_time * 1000);
+}
@@ -38,7 +38,10 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderEffect.hpp>
 
+#include <ctime>
+#include <fstream>
 #include <iostream>
+#include <unordered_set>
 
 #if defined(KLAYGE_COMPILER_CLANGC2)
 #pragma clang diagnostic push
@@ -61,7 +64,7 @@
 using namespace std;
 using namespace KlayGE;
 
-uint32_t const KFX_VERSION = 0x0140;
+uint32_t const KFX_VERSION = 0x0143;
 
 #ifdef KLAYGE_HAS_STRUCT_PACK
 #pragma pack(push, 1)
@@ -144,6 +147,117 @@ std::string RetrieveNodeValue(XMLNodePtr root, std::string const & node_name, st
 	return default_value;
 }
 
+#if defined(KLAYGE_CXX17_LIBRARY_FILESYSTEM_SUPPORT) || defined(KLAYGE_TS_LIBRARY_FILESYSTEM_SUPPORT)
+typedef filesystem::file_time_type FileTime;
+
+FileTime CurrentFileTime()
+{
+	return FileTime::clock::now();
+}
+#else
+typedef std::time_t FileTime;
+
+FileTime CurrentFileTime()
+{
+	return std::time(nullptr);
+}
+#endif
+
+// The kfx ends with the keys of its native shader blocks in ShaderCache, 3 uint64 each, and their count. The blocks
+//  are named after the first one, the same way as in ShaderCache. A kfx with inline blocks lists none.
+bool ReadShaderBlockNames(filesystem::path const & kfx_path, std::vector<std::string>& block_names)
+{
+	static char const HEX_DIGITS[] = "0123456789abcdef";
+
+	std::ifstream ifs(kfx_path.string().c_str(), std::ios_base::binary | std::ios_base::in);
+
+	uint32_t fourcc = 0;
+	ifs.read(reinterpret_cast<char*>(&fourcc), sizeof(fourcc));
+	uint32_t ver = 0;
+	ifs.read(reinterpret_cast<char*>(&ver), sizeof(ver));
+	if (!ifs)
+	{
+		return false;
+	}
+	if ((LE2Native(fourcc) != MakeFourCC<'K', 'F', 'X', ' '>::value) || (LE2Native(ver) != KFX_VERSION))
+	{
+		// Other versions can't use the blocks of this one
+		return true;
+	}
+
+	ifs.seekg(0, std::ios_base::end);
+	uint64_t const file_size = static_cast<uint64_t>(ifs.tellg());
+
+	uint32_t num_blocks = 0;
+	ifs.seekg(-static_cast<std::streamoff>(sizeof(num_blocks)), std::ios_base::end);
+	ifs.read(reinterpret_cast<char*>(&num_blocks), sizeof(num_blocks));
+	num_blocks = LE2Native(num_blocks);
+
+	uint64_t const footer_size = num_blocks * 3ULL * sizeof(uint64_t) + sizeof(num_blocks);
+	if (!ifs || (sizeof(fourcc) + sizeof(ver) + footer_size > file_size))
+	{
+		return false;
+	}
+
+	ifs.seekg(-static_cast<std::streamoff>(footer_size), std::ios_base::end);
+	for (uint32_t i = 0; i < num_blocks; ++ i)
+	{
+		uint64_t key[3];
+		ifs.read(reinterpret_cast<char*>(key), sizeof(key));
+		uint64_t const name_hash = LE2Native(key[0]);
+
+		std::string name;
+		for (int shift = 60; shift >= 0; shift -= 4)
+		{
+			name += HEX_DIGITS[(name_hash >> shift) & 0xF];
+		}
+		name += ".shader";
+		block_names.push_back(name);
+	}
+	return static_cast<bool>(ifs);
+}
+
+// Deletes the blocks in the ShaderCache of a folder that no kfx there refers to. Blocks written since start_time can
+//  belong to a kfx another FXMLJIT hasn't finished yet, they are kept.
+void PruneShaderBlocks(filesystem::path const & folder, FileTime start_time)
+{
+	filesystem::path const cache_dir = folder / "ShaderCache";
+	if (!filesystem::exists(cache_dir))
+	{
+		return;
+	}
+
+	std::unordered_set<std::string> referenced;
+	for (auto const & entry : filesystem::directory_iterator(folder))
+	{
+		if (entry.path().extension() == ".kfx")
+		{
+			std::vector<std::string> block_names;
+			if (!ReadShaderBlockNames(entry.path(), block_names))
+			{
+				// Probably being written, nothing can be known to be unreferenced
+				return;
+			}
+			referenced.insert(block_names.begin(), block_names.end());
+		}
+	}
+
+	std::vector<filesystem::path> unreferenced;
+	for (auto const & entry : filesystem::directory_iterator(cache_dir))
+	{
+		filesystem::path const & block_path = entry.path();
+		if ((block_path.extension() == ".shader") && (referenced.find(block_path.filename().string()) == referenced.end())
+			&& (filesystem::last_write_time(block_path) < start_time))
+		{
+			unreferenced.push_back(block_path);
+		}
+	}
+	for (auto const & block_path : unreferenced)
+	{
+		filesystem::remove(block_path);
+	}
+}
+
 PlatformDefinition LoadPlatformConfig(std::string const & platform)
 {
 	ResIdentifierPtr plat = ResLoader::Instance().Open("PlatConf/" + platform + ".plat");
@@ -189,12 +303,24 @@ PlatformDefinition LoadPlatformConfig(std::string const & platform)
 
 int main(int argc, char* argv[])
 {
-	if (argc < 2)
+	// Platforms that can't rebuild effects need the native shader blocks in the kfx itself
+	bool inline_shader_blocks = false;
+	if ((argc >= 2) && (std::string(argv[1]) == "--inline_shaders"))
 	{
-		cout << "Usage: FXMLJIT d3d_12_1|d3d_12_0|d3d_11_1|d3d_11_0|gl_4_6|gl_4_5|gl_4_4|gl_4_3|gl_4_2|gl_4_1|gles_3_2|gles_3_1|gles_3_0 xxx.fxml [target folder]" << endl;
+		inline_shader_blocks = true;
+		-- argc;
+		++ argv;
+	}
+
+	if (argc < 3)
+	{
+		cout << "Usage: FXMLJIT [--inline_shaders] d3d_12_1|d3d_12_0|d3d_11_1|d3d_11_0|gl_4_6|gl_4_5|gl_4_4|gl_4_3|gl_4_2|gl_4_1|gles_3_2|gles_3_1|gles_3_0 xxx.fxml [target folder]" << endl;
 		return 1;
 	}
 
+	// Before anything is written, blocks newer than this are kept by the pruning
+	FileTime const start_time = CurrentFileTime();
+
 	ResLoader::Instance().AddPath("../../Tools/media/PlatformDeployer");
 
 	std::string platform = argv[1];
@@ -284,6 +410,7 @@ int main(int argc, char* argv[])
 	re.SetCustomAttrib("TEXTURE_FORMAT", &texture_format);
 	re.SetCustomAttrib("UAV_FORMAT", &uav_format);
 	re.SetCustomAttrib("FRAG_DEPTH_SUPPORT", &frag_depth_support);
+	re.SetCustomAttrib("INLINE_SHADER_BLOCKS", &inline_shader_blocks);
 
 	std::string fxml_name(argv[2]);
 	filesystem::path fxml_path(fxml_name);
@@ -330,7 +457,12 @@ int main(int argc, char* argv[])
 				uint64_t timestamp;
 				kfx_source->read(&timestamp, sizeof(timestamp));
 				timestamp = LE2Native(timestamp);
-				if (src_timestamp <= timestamp)
+
+				uint8_t inline_blocks;
+				kfx_source->read(&inline_blocks, sizeof(inline_blocks));
+
+				// A kfx with inline blocks is fine for any platform
+				if ((src_timestamp <= timestamp) && (inline_blocks || !inline_shader_blocks))
 				{
 					skip_jit = true;
 				}
@@ -369,7 +501,32 @@ int main(int argc, char* argv[])
 			filesystem::copy_option::overwrite_if_exists);
 #endif
 		kfx_path = target_folder / kfx_name;
+
+		// The kfx only references its native shader blocks. The blocks are content addressed, the ones already in the
+		//  target are identical and only touched, so pruning sees them as recent.
+		std::vector<std::string> block_names;
+		if (ReadShaderBlockNames(kfx_path, block_names) && !block_names.empty())
+		{
+			filesystem::path const cache_dir = fxml_directory / "ShaderCache";
+			filesystem::path const target_cache_dir = target_folder / "ShaderCache";
+			filesystem::create_directories(target_cache_dir);
+			for (auto const & block_name : block_names)
+			{
+				filesystem::path const target_block_path = target_cache_dir / block_name;
+				if (filesystem::exists(target_block_path))
+				{
+					filesystem::last_write_time(target_block_path, CurrentFileTime());
+				}
+				else if (filesystem::exists(cache_dir / block_name))
+				{
+					filesystem::copy_file(cache_dir / block_name, target_block_path);
+				}
+			}
+		}
+
+		PruneShaderBlocks(target_folder, start_time);
 	}
+	PruneShaderBlocks(fxml_directory, start_time);
 
 	if (filesystem::exists(kfx_path))
 	{
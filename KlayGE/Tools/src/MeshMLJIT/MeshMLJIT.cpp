@@ -1916,7 +1916,8 @@ namespace
 		return ret;
 	}
 
-	void MeshMLJIT(std::string const & meshml_name, std::string const & output_name, std::string const & platform)
+	void MeshMLJIT(std::string const & meshml_name, std::string const & output_name, std::string const & platform,
+		bool compress_streams)
 	{
 		ResIdentifierPtr file = ResLoader::Instance().Open(meshml_name);
 		KlayGE::XMLDocument doc;
@@ -2060,7 +2061,7 @@ namespace
 		SaveModel(output_name, output_mtls, merged_ves, is_index_16_bit, merged_vertices, merged_indices,
 			mesh_names, mtl_ids, mesh_lods, pos_bbs, tc_bbs,
 			mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_start_indices,
-			joints, actions, kfs, num_frames, frame_rate);
+			joints, actions, kfs, num_frames, frame_rate, compress_streams);
 	}
 }
 
@@ -2070,6 +2071,7 @@ int main(int argc, char* argv[])
 	filesystem::path target_folder;
 	std::string platform;
 	bool quiet = false;
+	bool compress_streams = false;
 
 	boost::program_options::options_description desc("Allowed options");
 	desc.add_options()
@@ -2078,6 +2080,8 @@ int main(int argc, char* argv[])
 		("target-folder,T", boost::program_options::value<std::string>(), "Target folder.")
 		("platform,P", boost::program_options::value<std::string>()->implicit_value(""), "Platform name.")
 		("quiet,q", boost::program_options::value<bool>()->implicit_value(true), "Quiet mode.")
+		("compress-streams,C", boost::program_options::value<bool>()->implicit_value(true),
+			"LZ4 compress vertex and index streams. Smaller file, but the streams can't be used in place.")
 		("version,v", "Version.");
 
 	boost::program_options::variables_map vm;
@@ -2115,6 +2119,10 @@ int main(int argc, char* argv[])
 	{
 		quiet = vm["quiet"].as<bool>();
 	}
+	if (vm.count("compress-streams") > 0)
+	{
+		compress_streams = vm["compress-streams"].as<bool>();
+	}
 
 	std::string meshml_name = ResLoader::Instance().Locate(input_name);
 	if (meshml_name.empty())
@@ -2165,7 +2173,7 @@ int main(int argc, char* argv[])
 
 		std::string output_name = (target_folder / filesystem::path(file_name)).string() + JIT_EXT_NAME;
 
-		MeshMLJIT(meshml_name, output_name, platform);
+		MeshMLJIT(meshml_name, output_name, platform, compress_streams);
 
 		if (!quiet)
 		{
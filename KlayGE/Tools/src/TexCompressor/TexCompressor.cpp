@@ -446,7 +446,7 @@ namespace
 
 	void PrintSupportedFormats()
 	{
-		cout << "Supported formats: bc1, bc2, bc3, bc4, bc5, bc7, etc1" << endl;
+		cout << "Supported formats: bc1, bc2, bc3, bc4, bc5, bc6, bc6s, bc7, etc1" << endl;
 	}
 }
 
@@ -485,6 +485,14 @@ int main(int argc, char* argv[])
 	{
 		fmt = EF_BC5;
 	}
+	else if (CT_HASH("bc6") == fmt_hash)
+	{
+		fmt = EF_BC6;
+	}
+	else if (CT_HASH("bc6s") == fmt_hash)
+	{
+		fmt = EF_SIGNED_BC6;
+	}
 	else if (CT_HASH("bc7") == fmt_hash)
 	{
 		fmt = EF_BC7;